@@ -46,10 +46,203 @@
 #include <string.h>
 #include <stdio.h>
 
-// the maximum payload transferred by block1 we accumulate per server
-#define MAX_BLOCK1_SIZE 4096
+// the maximum payload accumulated by a buffered block1 transfer
+#ifndef LWM2M_BLOCK1_MAX_SIZE
+#define LWM2M_BLOCK1_MAX_SIZE       (1024 * 1024)
+#endif
+// the maximum number of block1 transfers in progress per server, the oldest one is dropped beyond
+#ifndef LWM2M_BLOCK1_MAX_TRANSFERS
+#define LWM2M_BLOCK1_MAX_TRANSFERS  4
+#endif
+// received blocks are appended to chunks of at least this size, so that a
+// transfer does not copy what it already received on every block
+#ifndef LWM2M_BLOCK1_CHUNK_SIZE
+#define LWM2M_BLOCK1_CHUNK_SIZE     4096
+#endif
+
+// the chunk data follows the structure
+typedef struct _lwm2m_block1_chunk_
+{
+    struct _lwm2m_block1_chunk_ * next;
+    size_t                        length;
+    size_t                        size;
+} prv_chunk_t;
+
+#define PRV_CHUNK_DATA(C)   ((uint8_t *)((C) + 1))
+
+static void prv_freeTransfer(lwm2m_block1_data_t * blockP)
+{
+    // a single chunk is used in place as the whole payload
+    if (blockP->chunkList == NULL)
+    {
+        lwm2m_free(blockP->block1buffer);
+    }
+    while (blockP->chunkList != NULL)
+    {
+        prv_chunk_t * chunkP = blockP->chunkList;
+
+        blockP->chunkList = chunkP->next;
+        lwm2m_free(chunkP);
+    }
+    lwm2m_free(blockP);
+}
+
+static void prv_remove(lwm2m_block1_data_t ** blockPP)
+{
+    lwm2m_block1_data_t * blockP = *blockPP;
+
+    *blockPP = blockP->next;
+    prv_freeTransfer(blockP);
+}
+
+static lwm2m_block1_data_t ** prv_find(lwm2m_block1_data_t ** pBlock1Data,
+                                       const uint8_t * token,
+                                       uint8_t tokenLen)
+{
+    lwm2m_block1_data_t ** blockPP;
+
+    for (blockPP = pBlock1Data ; *blockPP != NULL ; blockPP = &(*blockPP)->next)
+    {
+        if ((*blockPP)->tokenLen == tokenLen
+         && 0 == memcmp((*blockPP)->token, token, tokenLen))
+        {
+            return blockPP;
+        }
+    }
+
+    return NULL;
+}
+
+// Peers may change the token between the blocks of a transfer: fall back on
+// the only transfer in progress expecting this offset.
+static lwm2m_block1_data_t ** prv_findByOffset(lwm2m_block1_data_t ** pBlock1Data,
+                                               bool streaming,
+                                               size_t offset)
+{
+    lwm2m_block1_data_t ** resultPP = NULL;
+    lwm2m_block1_data_t ** blockPP;
+
+    for (blockPP = pBlock1Data ; *blockPP != NULL ; blockPP = &(*blockPP)->next)
+    {
+        if ((*blockPP)->complete == false
+         && (*blockPP)->streaming == streaming
+         && (*blockPP)->block1bufferSize == offset)
+        {
+            if (resultPP != NULL) return NULL;
+            resultPP = blockPP;
+        }
+    }
+
+    return resultPP;
+}
+
+static lwm2m_block1_data_t * prv_new(lwm2m_block1_data_t ** pBlock1Data,
+                                     const uint8_t * token,
+                                     uint8_t tokenLen)
+{
+    lwm2m_block1_data_t ** blockPP;
+    lwm2m_block1_data_t * blockP;
+    size_t count;
+
+    // completed transfers are only kept to answer retransmissions of their last block
+    count = 1;
+    blockPP = pBlock1Data;
+    while (*blockPP != NULL)
+    {
+        if ((*blockPP)->complete || count == LWM2M_BLOCK1_MAX_TRANSFERS)
+        {
+            prv_remove(blockPP);
+        }
+        else
+        {
+            count++;
+            blockPP = &(*blockPP)->next;
+        }
+    }
+
+    blockP = (lwm2m_block1_data_t *)lwm2m_malloc(sizeof(lwm2m_block1_data_t));
+    if (blockP == NULL) return NULL;
+    memset(blockP, 0, sizeof(lwm2m_block1_data_t));
+    blockP->tokenLen = MIN(tokenLen, sizeof(blockP->token));
+    memcpy(blockP->token, token, blockP->tokenLen);
+    blockP->next = *pBlock1Data;
+    *pBlock1Data = blockP;
+
+    return blockP;
+}
+
+static bool prv_append(lwm2m_block1_data_t * blockP,
+                       uint8_t * buffer,
+                       size_t length)
+{
+    prv_chunk_t * chunkP = blockP->lastChunk;
+
+    if (chunkP == NULL || chunkP->size - chunkP->length < length)
+    {
+        size_t size = length > LWM2M_BLOCK1_CHUNK_SIZE ? length : LWM2M_BLOCK1_CHUNK_SIZE;
+
+        chunkP = (prv_chunk_t *)lwm2m_malloc(sizeof(prv_chunk_t) + size);
+        if (chunkP == NULL) return false;
+        chunkP->next = NULL;
+        chunkP->length = 0;
+        chunkP->size = size;
+        if (blockP->lastChunk == NULL)
+        {
+            blockP->chunkList = chunkP;
+        }
+        else
+        {
+            blockP->lastChunk->next = chunkP;
+        }
+        blockP->lastChunk = chunkP;
+    }
+
+    memcpy(PRV_CHUNK_DATA(chunkP) + chunkP->length, buffer, length);
+    chunkP->length += length;
+    blockP->block1bufferSize += length;
+
+    return true;
+}
+
+// Gathers the chunks in a single buffer, copying each received byte once.
+static bool prv_complete(lwm2m_block1_data_t * blockP)
+{
+    prv_chunk_t * chunkP;
+    size_t length;
+
+    if (blockP->chunkList == NULL)
+    {
+        blockP->complete = true;
+        return true;
+    }
+    if (blockP->chunkList->next == NULL)
+    {
+        blockP->block1buffer = PRV_CHUNK_DATA(blockP->chunkList);
+        blockP->complete = true;
+        return true;
+    }
+
+    // on failure, the chunks are kept and a retransmission of the last block tries again
+    blockP->block1buffer = (uint8_t *)lwm2m_malloc(blockP->block1bufferSize);
+    if (blockP->block1buffer == NULL) return false;
+    length = 0;
+    while (blockP->chunkList != NULL)
+    {
+        chunkP = blockP->chunkList;
+        memcpy(blockP->block1buffer + length, PRV_CHUNK_DATA(chunkP), chunkP->length);
+        length += chunkP->length;
+        blockP->chunkList = chunkP->next;
+        lwm2m_free(chunkP);
+    }
+    blockP->lastChunk = NULL;
+    blockP->complete = true;
+
+    return true;
+}
 
 uint8_t coap_block1_handler(lwm2m_block1_data_t ** pBlock1Data,
+                            const uint8_t * token,
+                            uint8_t tokenLen,
                             uint16_t mid,
                             uint8_t * buffer,
                             size_t length,
@@ -59,95 +252,491 @@ uint8_t coap_block1_handler(lwm2m_block1_data_t ** pBlock1Data,
                             uint8_t ** outputBuffer,
                             size_t * outputLength)
 {
-    lwm2m_block1_data_t * block1Data = *pBlock1Data;;
+    lwm2m_block1_data_t ** blockPP;
+    lwm2m_block1_data_t * blockP;
+    size_t offset = (size_t)blockSize * blockNum;
 
-    // manage new block1 transfer
-    if (blockNum == 0)
+    blockPP = prv_find(pBlock1Data, token, tokenLen);
+    if (blockPP == NULL && blockNum != 0)
+    {
+        blockPP = prv_findByOffset(pBlock1Data, false, offset);
+    }
+
+    if (blockPP != NULL
+     && (*blockPP)->streaming == false
+     && (*blockPP)->lastmid == mid
+     && (*blockPP)->block1bufferSize != 0)
     {
-       // we already have block1 data for this server, clear it
-       if (block1Data != NULL)
-       {
-           lwm2m_free(block1Data->block1buffer);
-       }
-       else
-       {
-           block1Data = lwm2m_malloc(sizeof(lwm2m_block1_data_t));
-           *pBlock1Data = block1Data;
-           if (NULL == block1Data) return COAP_500_INTERNAL_SERVER_ERROR;
-       }
-
-       block1Data->block1buffer = lwm2m_malloc(length);
-       block1Data->block1bufferSize = length;
-
-       // write new block in buffer
-       memcpy(block1Data->block1buffer, buffer, length);
-       block1Data->lastmid = mid;
-    }
-    // manage already started block1 transfer
+        // If this is a retransmission, we already did that.
+        blockP = *blockPP;
+    }
     else
     {
-       if (block1Data == NULL)
-       {
-           // we never receive the first block
-           // TODO should we clean block1 data for this server ?
-           return COAP_408_REQ_ENTITY_INCOMPLETE;
-       }
-
-       // If this is a retransmission, we already did that.
-       if (block1Data->lastmid != mid)
-       {
-          uint8_t * oldBuffer = block1Data->block1buffer;
-          size_t oldSize = block1Data->block1bufferSize;
-
-          if (block1Data->block1bufferSize != blockSize * blockNum)
-          {
-              // we don't receive block in right order
-              // TODO should we clean block1 data for this server ?
-              return COAP_408_REQ_ENTITY_INCOMPLETE;
-          }
-
-          // is it too large?
-          if (block1Data->block1bufferSize + length >= MAX_BLOCK1_SIZE) {
-              return COAP_413_ENTITY_TOO_LARGE;
-          }
-          // re-alloc new buffer
-          block1Data->block1bufferSize = oldSize+length;
-          block1Data->block1buffer = lwm2m_malloc(block1Data->block1bufferSize);
-          if (NULL == block1Data->block1buffer) return COAP_500_INTERNAL_SERVER_ERROR;
-          memcpy(block1Data->block1buffer, oldBuffer, oldSize);
-          lwm2m_free(oldBuffer);
-
-          // write new block in buffer
-          memcpy(block1Data->block1buffer + oldSize, buffer, length);
-          block1Data->lastmid = mid;
-       }
+        // manage new block1 transfer
+        if (blockNum == 0)
+        {
+            // the same transfer started again
+            if (blockPP != NULL) prv_remove(blockPP);
+
+            blockP = prv_new(pBlock1Data, token, tokenLen);
+            if (NULL == blockP) return COAP_500_INTERNAL_SERVER_ERROR;
+            blockPP = pBlock1Data;
+        }
+        // manage already started block1 transfer
+        else
+        {
+            // we never receive the first block
+            if (blockPP == NULL || (*blockPP)->streaming) return COAP_408_REQ_ENTITY_INCOMPLETE;
+            blockP = *blockPP;
+
+            // we don't receive block in right order
+            if (blockP->complete || blockP->block1bufferSize != offset) return COAP_408_REQ_ENTITY_INCOMPLETE;
+        }
+
+        // is it too large?
+        if (blockP->block1bufferSize + length > LWM2M_BLOCK1_MAX_SIZE)
+        {
+            prv_remove(blockPP);
+            return COAP_413_ENTITY_TOO_LARGE;
+        }
+        if (length != 0 && !prv_append(blockP, buffer, length))
+        {
+            prv_remove(blockPP);
+            return COAP_500_INTERNAL_SERVER_ERROR;
+        }
+        blockP->lastmid = mid;
     }
 
     if (blockMore)
     {
-        *outputLength = -1;
+        *outputLength = 0;
         return COAP_231_CONTINUE;
     }
+
+    if (!blockP->complete && !prv_complete(blockP))
+    {
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+
+    // buffer is full, set output parameter
+    // we don't free it to be able to send retransmission
+    *outputLength = blockP->block1bufferSize;
+    *outputBuffer = blockP->block1buffer;
+
+    return NO_ERROR;
+}
+
+#ifdef LWM2M_CLIENT_MODE
+uint8_t coap_block1_stream(lwm2m_context_t * contextP,
+                           lwm2m_server_t * serverP,
+                           coap_packet_t * message,
+                           uint16_t blockSize,
+                           uint32_t blockNum,
+                           bool blockMore)
+{
+    lwm2m_block1_data_t ** blockPP;
+    lwm2m_block1_data_t * blockP;
+    lwm2m_object_t * objectP;
+    lwm2m_uri_t uri;
+    size_t offset = (size_t)blockSize * blockNum;
+    uint8_t result;
+
+    // only opaque resource values written by a registered server are streamed
+    if (message->code != COAP_PUT) return COAP_IGNORE;
+    if (!IS_OPTION(message, COAP_OPTION_CONTENT_TYPE)
+     || utils_convertMediaType(message->content_type) != LWM2M_CONTENT_OPAQUE)
+    {
+        return COAP_IGNORE;
+    }
+    if (!uri_decode(contextP->altPath, message->uri_path, &uri)
+     || (uri.flag & LWM2M_URI_MASK_TYPE) != LWM2M_URI_FLAG_DM
+     || !LWM2M_URI_IS_SET_RESOURCE(&uri)
+     || uri.objectId == LWM2M_SECURITY_OBJECT_ID)
+    {
+        return COAP_IGNORE;
+    }
+    if (serverP->status != STATE_REGISTERED
+     && serverP->status != STATE_REG_UPDATE_NEEDED
+     && serverP->status != STATE_REG_FULL_UPDATE_NEEDED
+     && serverP->status != STATE_REG_UPDATE_PENDING)
+    {
+        return COAP_IGNORE;
+    }
+    objectP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, uri.objectId);
+    if (objectP == NULL || objectP->blockWriteFunc == NULL) return COAP_IGNORE;
+
+    blockPP = prv_find(&serverP->block1Data, message->token, message->token_len);
+    if (blockPP == NULL && blockNum != 0)
+    {
+        blockPP = prv_findByOffset(&serverP->block1Data, true, offset);
+    }
+
+    // a retransmission gets the same answer, the block is not written again
+    if (blockPP != NULL
+     && (*blockPP)->streaming
+     && (*blockPP)->lastResult != 0
+     && (*blockPP)->lastmid == message->mid)
+    {
+        return (*blockPP)->lastResult;
+    }
+
+    if (blockNum == 0)
+    {
+        if (blockPP != NULL) prv_remove(blockPP);
+        if (NULL == LWM2M_LIST_FIND(objectP->instanceList, uri.instanceId)) return COAP_404_NOT_FOUND;
+
+        blockP = prv_new(&serverP->block1Data, message->token, message->token_len);
+        if (NULL == blockP) return COAP_500_INTERNAL_SERVER_ERROR;
+        blockP->streaming = true;
+    }
     else
     {
-        // buffer is full, set output parameter
-        // we don't free it to be able to send retransmission
-        *outputLength = block1Data->block1bufferSize;
-        *outputBuffer = block1Data->block1buffer;
+        if (blockPP == NULL || (*blockPP)->streaming == false) return COAP_408_REQ_ENTITY_INCOMPLETE;
+        blockP = *blockPP;
+        if (blockP->complete || blockP->block1bufferSize != offset) return COAP_408_REQ_ENTITY_INCOMPLETE;
+    }
 
-        return NO_ERROR;
+    LOG_ARG("Streaming block %u (%u bytes) at offset %u", blockNum, message->payload_len, offset);
+    result = objectP->blockWriteFunc(uri.instanceId, uri.resourceId, (uint32_t)offset, message->payload, message->payload_len, blockMore, objectP);
+    if (result == COAP_204_CHANGED && blockMore)
+    {
+        result = COAP_231_CONTINUE;
     }
+    else
+    {
+        // done or aborted by the object
+        blockP->complete = true;
+    }
+    blockP->block1bufferSize += message->payload_len;
+    blockP->lastmid = message->mid;
+    blockP->lastResult = result;
+
+    return result;
 }
+#endif
 
 void free_block1_buffer(lwm2m_block1_data_t * block1Data)
 {
-    if (block1Data != NULL)
+    while (block1Data != NULL)
     {
-        // free block1 buffer
-        lwm2m_free(block1Data->block1buffer);
-        block1Data->block1bufferSize = 0 ;
+        lwm2m_block1_data_t * nextP = block1Data->next;
 
-        // free current element
-        lwm2m_free(block1Data);
+        prv_freeTransfer(block1Data);
+        block1Data = nextP;
     }
 }
+
+#if defined(LWM2M_SERVER_MODE) || defined(LWM2M_BOOTSTRAP_SERVER_MODE)
+/*
+ * Sending side: a request with a payload larger than the block size is sent
+ * as a Block1 transfer (RFC 7959 section 2.5). Each block is a transaction of
+ * its own, with the token of the request. The caller's transaction is never
+ * sent: it is the template of the blocks and gets the final response.
+ */
+
+// default size of the blocks sent, the client may ask for smaller ones: with
+// the header, a block fits the 1024-byte receive buffers of the examples
+#ifndef LWM2M_BLOCK1_SEND_SIZE
+#define LWM2M_BLOCK1_SEND_SIZE      512
+#endif
+
+typedef struct
+{
+    lwm2m_context_t *     contextP;
+    lwm2m_transaction_t * templateP;
+    uint8_t *             payload;
+    size_t                length;
+    size_t                offset;       // of the next block to send
+    uint16_t              blockSize;
+    uint8_t               inFlight;     // blocks waiting for an answer
+} prv_sender_t;
+
+static void prv_blockCallback(lwm2m_transaction_t * transacP, void * message);
+
+static uint16_t prv_blockSize(lwm2m_context_t * contextP)
+{
+    return contextP->block1Size != 0 ? contextP->block1Size : LWM2M_BLOCK1_SEND_SIZE;
+}
+
+// Removes the blocks waiting for an answer, but currentP which is being answered.
+static void prv_cancel(prv_sender_t * senderP,
+                       lwm2m_transaction_t * currentP)
+{
+    lwm2m_transaction_t * transacP;
+
+    transacP = senderP->contextP->transactionList;
+    while (transacP != NULL)
+    {
+        lwm2m_transaction_t * nextP = transacP->next;
+
+        if (transacP != currentP
+         && transacP->callback == prv_blockCallback
+         && transacP->userData == senderP)
+        {
+            senderP->inFlight--;
+            transaction_remove(senderP->contextP, transacP);
+        }
+        transacP = nextP;
+    }
+}
+
+static void prv_freeSender(prv_sender_t * senderP)
+{
+    transaction_free(senderP->templateP);
+    lwm2m_free(senderP->payload);
+    lwm2m_free(senderP);
+}
+
+static void prv_finish(prv_sender_t * senderP,
+                       lwm2m_transaction_t * currentP,
+                       coap_packet_t * message)
+{
+    prv_cancel(senderP, currentP);
+    if (senderP->templateP->callback != NULL)
+    {
+        senderP->templateP->callback(senderP->templateP, message);
+    }
+    prv_freeSender(senderP);
+}
+
+// Returns 0 when the block is sent, -1 when the transfer failed and was
+// finished, an error when no block was sent.
+static int prv_sendBlock(prv_sender_t * senderP)
+{
+    lwm2m_context_t * contextP = senderP->contextP;
+    coap_packet_t * templateP = (coap_packet_t *)senderP->templateP->message;
+    lwm2m_transaction_t * transacP;
+    coap_packet_t message[1];
+    multi_option_t * optP;
+    size_t length;
+    bool more;
+
+    more = senderP->length - senderP->offset > senderP->blockSize;
+    length = more ? senderP->blockSize : senderP->length - senderP->offset;
+
+    transacP = transaction_new(senderP->templateP->peerH, (coap_method_t)templateP->code, NULL, NULL, contextP->nextMID++, templateP->token_len, templateP->token);
+    if (transacP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    // serializing frees the option lists: the block gets lists referencing
+    // the options of the template
+    memcpy(message, templateP, sizeof(coap_packet_t));
+    message->uri_path = NULL;
+    message->uri_query = NULL;
+    message->location_path = NULL;
+    for (optP = templateP->uri_path ; optP != NULL ; optP = optP->next)
+    {
+        coap_add_multi_option(&message->uri_path, optP->data, optP->len, 1);
+    }
+    for (optP = templateP->uri_query ; optP != NULL ; optP = optP->next)
+    {
+        coap_add_multi_option(&message->uri_query, optP->data, optP->len, 1);
+    }
+    message->mid = transacP->mID;
+    coap_set_header_block1(message, (uint32_t)(senderP->offset / senderP->blockSize), more, senderP->blockSize);
+    coap_set_payload(message, senderP->payload + senderP->offset, length);
+
+    transacP->buffer_len = (uint16_t)coap_serialize_get_size(message);
+    if (transacP->buffer_len != 0)
+    {
+        transacP->buffer = (uint8_t *)lwm2m_malloc(transacP->buffer_len);
+    }
+    if (transacP->buffer == NULL)
+    {
+        coap_free_header(message);
+        transaction_free(transacP);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    transacP->buffer_len = (uint16_t)coap_serialize_message(message, transacP->buffer);
+    if (transacP->buffer_len == 0)
+    {
+        coap_free_header(message);
+        transaction_free(transacP);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+
+    LOG_ARG("Sending block %u of %u bytes at offset %u", senderP->offset / senderP->blockSize, length, senderP->offset);
+    transacP->callback = prv_blockCallback;
+    transacP->userData = senderP;
+    senderP->offset += length;
+    senderP->inFlight++;
+    transaction_add(contextP, transacP);
+
+    return transaction_send(contextP, transacP);
+}
+
+// The first block goes alone for the client to answer with its block size.
+static int prv_sendBlocks(prv_sender_t * senderP)
+{
+    uint8_t window;
+
+    window = 1;
+    if (senderP->offset != 0 && senderP->contextP->block1Window != 0)
+    {
+        window = senderP->contextP->block1Window;
+    }
+
+    while (senderP->offset < senderP->length && senderP->inFlight < window)
+    {
+        int result;
+
+        result = prv_sendBlock(senderP);
+        if (result != 0) return result;
+    }
+
+    return 0;
+}
+
+static void prv_blockCallback(lwm2m_transaction_t * transacP,
+                              void * message)
+{
+    prv_sender_t * senderP = (prv_sender_t *)transacP->userData;
+    coap_packet_t * packet = (coap_packet_t *)message;
+    uint16_t size;
+
+    senderP->inFlight--;
+    if (packet == NULL)
+    {
+        prv_finish(senderP, transacP, NULL);
+        return;
+    }
+
+    size = senderP->blockSize;
+    coap_get_header_block1(packet, NULL, NULL, &size, NULL);
+
+    if (packet->code == COAP_231_CONTINUE
+     && (senderP->offset < senderP->length || senderP->inFlight != 0))
+    {
+        // the offsets sent so far are multiples of any smaller block size
+        if (size < senderP->blockSize)
+        {
+            LOG_ARG("Client asks for blocks of %u bytes", size);
+            senderP->blockSize = size;
+        }
+        if (COAP_500_INTERNAL_SERVER_ERROR == prv_sendBlocks(senderP))
+        {
+            prv_finish(senderP, transacP, NULL);
+        }
+        return;
+    }
+
+    if (packet->code == COAP_413_ENTITY_TOO_LARGE
+     && IS_OPTION(packet, COAP_OPTION_BLOCK1)
+     && size < senderP->blockSize)
+    {
+        LOG_ARG("Starting again with blocks of %u bytes", size);
+        prv_cancel(senderP, transacP);
+        senderP->blockSize = size;
+        senderP->offset = 0;
+        if (COAP_500_INTERNAL_SERVER_ERROR == prv_sendBlocks(senderP))
+        {
+            prv_finish(senderP, transacP, NULL);
+        }
+        return;
+    }
+
+    prv_finish(senderP, transacP, packet);
+}
+
+int block1_send(lwm2m_context_t * contextP,
+                lwm2m_transaction_t * transacP,
+                uint8_t * buffer,
+                size_t length)
+{
+    prv_sender_t * senderP;
+    int result;
+
+    if (length <= prv_blockSize(contextP))
+    {
+        coap_set_payload(transacP->message, buffer, length);
+        transaction_add(contextP, transacP);
+        return transaction_send(contextP, transacP);
+    }
+
+    senderP = (prv_sender_t *)lwm2m_malloc(sizeof(prv_sender_t));
+    if (senderP == NULL)
+    {
+        transaction_free(transacP);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    memset(senderP, 0, sizeof(prv_sender_t));
+    // the caller's buffer is only valid during this call
+    senderP->payload = (uint8_t *)lwm2m_malloc(length);
+    if (senderP->payload == NULL)
+    {
+        lwm2m_free(senderP);
+        transaction_free(transacP);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    memcpy(senderP->payload, buffer, length);
+    senderP->contextP = contextP;
+    senderP->templateP = transacP;
+    senderP->length = length;
+    senderP->blockSize = prv_blockSize(contextP);
+
+    result = prv_sendBlocks(senderP);
+    if (result > 0)
+    {
+        prv_freeSender(senderP);
+    }
+
+    return result;
+}
+
+void block1_clear(lwm2m_context_t * contextP)
+{
+    lwm2m_transaction_t * transacP;
+
+    // the transfers in progress are dropped without calling back, like the other transactions
+    transacP = contextP->transactionList;
+    while (transacP != NULL)
+    {
+        if (transacP->callback == prv_blockCallback)
+        {
+            prv_sender_t * senderP = (prv_sender_t *)transacP->userData;
+
+            prv_cancel(senderP, NULL);
+            prv_freeSender(senderP);
+            transacP = contextP->transactionList;
+        }
+        else
+        {
+            transacP = transacP->next;
+        }
+    }
+}
+
+void block1_removePeer(lwm2m_context_t * contextP,
+                       void * sessionH)
+{
+    lwm2m_transaction_t * transacP;
+
+    // the transfers end as on a timeout: the request is answered and freed
+    transacP = contextP->transactionList;
+    while (transacP != NULL)
+    {
+        if (transacP->callback == prv_blockCallback
+         && transacP->peerH == sessionH)
+        {
+            prv_finish((prv_sender_t *)transacP->userData, NULL, NULL);
+            transacP = contextP->transactionList;
+        }
+        else
+        {
+            transacP = transacP->next;
+        }
+    }
+}
+
+int lwm2m_set_block1_options(lwm2m_context_t * contextP,
+                             uint16_t blockSize,
+                             uint8_t window)
+{
+    if (blockSize < 16 || blockSize > 1024 || (blockSize & (blockSize - 1)) != 0) return COAP_400_BAD_REQUEST;
+    if (window == 0) return COAP_400_BAD_REQUEST;
+
+    contextP->block1Size = blockSize;
+    contextP->block1Window = window;
+
+    return COAP_NO_ERROR;
+}
+#endif
@@ -0,0 +1,515 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * Continuation state of Block2 transfers.
+ *
+ * When a response does not fit in the block size asked by the peer, its
+ * payload is kept with the session, URI and Accept of the request. The
+ * following block requests are then answered by slicing the kept payload
+ * instead of reading and serializing the resource again. Notifications
+ * larger than the block size of their observe request are kept the same way
+ * for the peer to fetch the rest (RFC 7959 section 2.6).
+ *
+ * A kept payload is dropped once its last block is sent, when a new
+ * transfer of the same request starts, or after COAP_EXCHANGE_LIFETIME
+ * without block requests.
+ */
+
+#include "internals.h"
+
+#include <string.h>
+
+// number of transfers kept at once, the oldest one is dropped beyond
+#ifndef LWM2M_BLOCK2_MAX_EXCHANGES
+#define LWM2M_BLOCK2_MAX_EXCHANGES  8
+#endif
+
+#define PRV_LIFETIME    ((time_t)COAP_EXCHANGE_LIFETIME)
+
+static bool prv_decodeUri(lwm2m_context_t * contextP,
+                          coap_packet_t * message,
+                          lwm2m_uri_t * uriP)
+{
+#ifdef LWM2M_CLIENT_MODE
+    return uri_decode(contextP->altPath, message->uri_path, uriP);
+#else
+    (void)contextP;
+    return uri_decode(NULL, message->uri_path, uriP);
+#endif
+}
+
+static int prv_getAccept(coap_packet_t * message)
+{
+    if (IS_OPTION(message, COAP_OPTION_ACCEPT)) return message->accept[0];
+    return BLOCK2_ACCEPT_NONE;
+}
+
+static bool prv_sameUri(lwm2m_uri_t * uri1P,
+                        lwm2m_uri_t * uri2P)
+{
+    return uri1P->flag == uri2P->flag
+        && uri1P->objectId == uri2P->objectId
+        && (!LWM2M_URI_IS_SET_INSTANCE(uri1P) || uri1P->instanceId == uri2P->instanceId)
+        && (!LWM2M_URI_IS_SET_RESOURCE(uri1P) || uri1P->resourceId == uri2P->resourceId);
+}
+
+// exact is false when looking up a block request: notifications match any Accept
+// of the payload format
+static lwm2m_block2_data_t ** prv_find(lwm2m_context_t * contextP,
+                                       void * sessionH,
+                                       lwm2m_uri_t * uriP,
+                                       int accept,
+                                       bool exact)
+{
+    lwm2m_block2_data_t ** blockPP;
+
+    for (blockPP = &contextP->block2List ; *blockPP != NULL ; blockPP = &(*blockPP)->next)
+    {
+        lwm2m_block2_data_t * blockP = *blockPP;
+
+        if (!prv_sameUri(&blockP->uri, uriP)) continue;
+        if (blockP->accept != accept
+         && (exact
+          || blockP->accept != BLOCK2_ACCEPT_ANY
+          || (accept != BLOCK2_ACCEPT_NONE && accept != blockP->format)))
+        {
+            continue;
+        }
+        if (lwm2m_session_is_equal(blockP->sessionH, sessionH, contextP->userData)) return blockPP;
+    }
+
+    return NULL;
+}
+
+static void prv_remove(lwm2m_context_t * contextP,
+                       lwm2m_block2_data_t ** blockPP)
+{
+    lwm2m_block2_data_t * blockP = *blockPP;
+
+    *blockPP = blockP->next;
+    timer_cancel(contextP, &blockP->timer);
+    lwm2m_free(blockP->payload);
+    lwm2m_free(blockP);
+}
+
+static void prv_expiryCallback(lwm2m_context_t * contextP,
+                               void * userData,
+                               time_t currentTime)
+{
+    lwm2m_block2_data_t ** blockPP;
+
+    (void)currentTime;
+
+    for (blockPP = &contextP->block2List ; *blockPP != NULL ; blockPP = &(*blockPP)->next)
+    {
+        if (*blockPP == userData)
+        {
+            LOG_ARG("Dropping kept payload of %u bytes", (*blockPP)->length);
+            prv_remove(contextP, blockPP);
+            return;
+        }
+    }
+}
+
+bool block2_getBlock(lwm2m_context_t * contextP,
+                     void * sessionH,
+                     coap_packet_t * message,
+                     coap_packet_t * response,
+                     uint32_t blockNum,
+                     uint16_t blockSize)
+{
+    lwm2m_block2_data_t ** blockPP;
+    lwm2m_block2_data_t * blockP;
+    lwm2m_uri_t uri;
+    size_t offset;
+    bool more;
+
+    if (message->code != COAP_GET) return false;
+    if (contextP->block2List == NULL) return false;
+    if (!prv_decodeUri(contextP, message, &uri)) return false;
+
+    blockPP = prv_find(contextP, sessionH, &uri, prv_getAccept(message), false);
+    if (blockPP == NULL) return false;
+    blockP = *blockPP;
+
+    // let the caller reject it
+    offset = (size_t)blockNum * blockSize;
+    if (offset >= blockP->length) return false;
+
+    more = blockP->length - offset > blockSize;
+    LOG_ARG("Block %u of %u bytes from the kept payload of %u bytes", blockNum, blockSize, blockP->length);
+
+    coap_set_status_code(response, COAP_205_CONTENT);
+    coap_set_header_content_type(response, blockP->format);
+    coap_set_header_block2(response, blockNum, more, blockSize);
+    coap_set_payload(response, blockP->payload + offset, more ? blockSize : blockP->length - offset);
+
+    // once the last block is sent, the payload goes at the next lwm2m_step()
+    (void)timer_schedule(contextP, &blockP->timer, more ? lwm2m_gettime() + PRV_LIFETIME : lwm2m_gettime());
+
+    return true;
+}
+
+bool block2_storeResponse(lwm2m_context_t * contextP,
+                          void * sessionH,
+                          coap_packet_t * message,
+                          coap_packet_t * response)
+{
+    lwm2m_uri_t uri;
+    uint8_t * payload;
+
+    if (message->code != COAP_GET || response->code != COAP_205_CONTENT) return false;
+    if (!IS_OPTION(response, COAP_OPTION_CONTENT_TYPE)) return false;
+    if (!prv_decodeUri(contextP, message, &uri)) return false;
+
+    if (response->payload != contextP->payloadBuffer)
+    {
+        return block2_store(contextP, sessionH, &uri, prv_getAccept(message), (uint16_t)response->content_type, response->payload, response->payload_len);
+    }
+
+    // the buffer of the context is reused by the next read
+    payload = (uint8_t *)lwm2m_malloc(response->payload_len);
+    if (payload == NULL) return false;
+    memcpy(payload, response->payload, response->payload_len);
+    if (!block2_store(contextP, sessionH, &uri, prv_getAccept(message), (uint16_t)response->content_type, payload, response->payload_len))
+    {
+        lwm2m_free(payload);
+        return false;
+    }
+
+    return true;
+}
+
+bool block2_store(lwm2m_context_t * contextP,
+                  void * sessionH,
+                  lwm2m_uri_t * uriP,
+                  int accept,
+                  uint16_t format,
+                  uint8_t * payload,
+                  size_t length)
+{
+    lwm2m_block2_data_t ** blockPP;
+    lwm2m_block2_data_t * blockP;
+    size_t count;
+
+    if (payload == NULL || length == 0) return false;
+
+    // a new transfer of the same request replaces the previous one
+    blockPP = prv_find(contextP, sessionH, uriP, accept, true);
+    if (blockPP != NULL) prv_remove(contextP, blockPP);
+
+    // make room by dropping the oldest transfers, at the tail
+    count = 1;
+    for (blockPP = &contextP->block2List ; *blockPP != NULL ; blockPP = &(*blockPP)->next)
+    {
+        if (count == LWM2M_BLOCK2_MAX_EXCHANGES)
+        {
+            LOG("Too many kept payloads, dropping the oldest ones");
+            while (*blockPP != NULL) prv_remove(contextP, blockPP);
+            break;
+        }
+        count++;
+    }
+
+    blockP = (lwm2m_block2_data_t *)lwm2m_malloc(sizeof(lwm2m_block2_data_t));
+    if (blockP == NULL) return false;
+    memset(blockP, 0, sizeof(lwm2m_block2_data_t));
+    blockP->sessionH = sessionH;
+    blockP->uri = *uriP;
+    blockP->accept = accept;
+    blockP->format = format;
+    blockP->timer.callback = prv_expiryCallback;
+    blockP->timer.userData = blockP;
+    if (0 == timer_schedule(contextP, &blockP->timer, lwm2m_gettime() + PRV_LIFETIME))
+    {
+        lwm2m_free(blockP);
+        return false;
+    }
+    blockP->payload = payload;
+    blockP->length = length;
+    blockP->next = contextP->block2List;
+    contextP->block2List = blockP;
+
+    return true;
+}
+
+void block2_clear(lwm2m_context_t * contextP)
+{
+    while (contextP->block2List != NULL)
+    {
+        prv_remove(contextP, &contextP->block2List);
+    }
+}
+
+#ifdef LWM2M_SERVER_MODE
+/*
+ * Client side of Block2 transfers, for the server: when a client answers a
+ * GET with the first block of a larger response, the following blocks are
+ * fetched and appended before the request gets its answer. The request's
+ * transaction is the template of the block requests and its callback gets
+ * the first response with the whole payload.
+ */
+
+// the largest response reassembled, the transfer fails with 4.13 beyond
+#ifndef LWM2M_BLOCK2_MAX_SIZE
+#define LWM2M_BLOCK2_MAX_SIZE   (1024 * 1024)
+#endif
+
+typedef struct
+{
+    lwm2m_context_t *     contextP;
+    lwm2m_transaction_t * templateP;
+    coap_packet_t         response;     // the first block, without its options pointing in the datagram
+    utils_buffer_t        payload;
+} prv_fetch_t;
+
+static void prv_fetchCallback(lwm2m_transaction_t * transacP, void * message);
+
+static void prv_freeFetch(prv_fetch_t * fetchP)
+{
+    transaction_free(fetchP->templateP);
+    utils_bufferFree(&fetchP->payload);
+    lwm2m_free(fetchP);
+}
+
+// Gives the request its answer: the whole response, NULL on timeout or an error code.
+static void prv_finishFetch(prv_fetch_t * fetchP,
+                            bool timeout,
+                            uint8_t code)
+{
+    if (fetchP->templateP->callback != NULL)
+    {
+        if (timeout)
+        {
+            fetchP->templateP->callback(fetchP->templateP, NULL);
+        }
+        else
+        {
+            if (code != COAP_205_CONTENT)
+            {
+                fetchP->response.code = code;
+                fetchP->payload.length = 0;
+            }
+            fetchP->response.payload = fetchP->payload.data;
+            fetchP->response.payload_len = (uint32_t)fetchP->payload.length;
+            fetchP->templateP->callback(fetchP->templateP, &fetchP->response);
+        }
+    }
+    prv_freeFetch(fetchP);
+}
+
+static uint8_t prv_append(prv_fetch_t * fetchP,
+                          coap_packet_t * response)
+{
+    uint8_t * targetP;
+
+    if (fetchP->payload.length + response->payload_len > LWM2M_BLOCK2_MAX_SIZE) return COAP_413_ENTITY_TOO_LARGE;
+    targetP = utils_bufferReserve(&fetchP->payload, response->payload_len);
+    if (targetP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+    memcpy(targetP, response->payload, response->payload_len);
+    fetchP->payload.length += response->payload_len;
+
+    return COAP_NO_ERROR;
+}
+
+// Requests the block following the received payload, in blocks of blockSize.
+static bool prv_requestBlock(prv_fetch_t * fetchP,
+                             uint16_t blockSize)
+{
+    lwm2m_context_t * contextP = fetchP->contextP;
+    coap_packet_t * templateP = (coap_packet_t *)fetchP->templateP->message;
+    lwm2m_transaction_t * transacP;
+    coap_packet_t * messageP;
+    multi_option_t * optP;
+    uint8_t i;
+
+    // a token of its own, the request's may be an observation's
+    transacP = transaction_new(fetchP->templateP->peerH, COAP_GET, NULL, NULL, contextP->nextMID++, 4, NULL);
+    if (transacP == NULL) return false;
+    messageP = (coap_packet_t *)transacP->message;
+
+    // the path options reference the template's, which outlives the transaction
+    for (optP = templateP->uri_path ; optP != NULL ; optP = optP->next)
+    {
+        coap_add_multi_option(&messageP->uri_path, optP->data, optP->len, 1);
+        SET_OPTION(messageP, COAP_OPTION_URI_PATH);
+    }
+    // the same representation is asked for, without observing it again
+    for (i = 0 ; i < templateP->accept_num ; i++)
+    {
+        coap_set_header_accept(messageP, templateP->accept[i]);
+    }
+    coap_set_header_block2(messageP, (uint32_t)(fetchP->payload.length / blockSize), 0, blockSize);
+
+    LOG_ARG("Fetching block %u of %u bytes", fetchP->payload.length / blockSize, blockSize);
+    transacP->callback = prv_fetchCallback;
+    transacP->userData = fetchP;
+    transaction_add(contextP, transacP);
+
+    // on failure, the transaction already called back
+    (void)transaction_send(contextP, transacP);
+
+    return true;
+}
+
+static void prv_fetchCallback(lwm2m_transaction_t * transacP,
+                              void * message)
+{
+    prv_fetch_t * fetchP = (prv_fetch_t *)transacP->userData;
+    coap_packet_t * packet = (coap_packet_t *)message;
+    uint8_t result;
+
+    if (packet == NULL)
+    {
+        prv_finishFetch(fetchP, true, 0);
+        return;
+    }
+    if (packet->code != COAP_205_CONTENT)
+    {
+        prv_finishFetch(fetchP, false, packet->code);
+        return;
+    }
+
+    // not the expected block, or the resource changed meanwhile
+    if (!IS_OPTION(packet, COAP_OPTION_BLOCK2)
+     || (size_t)packet->block2_num * packet->block2_size != fetchP->payload.length
+     || packet->etag_len != fetchP->response.etag_len
+     || 0 != memcmp(packet->etag, fetchP->response.etag, packet->etag_len))
+    {
+        prv_finishFetch(fetchP, false, COAP_408_REQ_ENTITY_INCOMPLETE);
+        return;
+    }
+
+    result = prv_append(fetchP, packet);
+    if (result != COAP_NO_ERROR)
+    {
+        prv_finishFetch(fetchP, false, result);
+    }
+    else if (!packet->block2_more)
+    {
+        prv_finishFetch(fetchP, false, COAP_205_CONTENT);
+    }
+    else if (!prv_requestBlock(fetchP, packet->block2_size))
+    {
+        prv_finishFetch(fetchP, false, COAP_500_INTERNAL_SERVER_ERROR);
+    }
+}
+
+bool block2_fetch(lwm2m_context_t * contextP,
+                  lwm2m_transaction_t * transacP,
+                  coap_packet_t * response)
+{
+    prv_fetch_t * fetchP;
+    uint8_t result;
+
+    if (((coap_packet_t *)transacP->message)->code != COAP_GET) return false;
+    if (response->code != COAP_205_CONTENT
+     || !IS_OPTION(response, COAP_OPTION_BLOCK2)
+     || !response->block2_more
+     || response->block2_num != 0)
+    {
+        return false;
+    }
+
+    fetchP = (prv_fetch_t *)lwm2m_malloc(sizeof(prv_fetch_t));
+    if (fetchP == NULL) return false;
+    memset(fetchP, 0, sizeof(prv_fetch_t));
+    fetchP->contextP = contextP;
+    fetchP->templateP = transacP;
+
+    // only the options stored in the packet are kept
+    memcpy(&fetchP->response, response, sizeof(coap_packet_t));
+    fetchP->response.proxy_uri = NULL;
+    fetchP->response.uri_host = NULL;
+    fetchP->response.location_path = NULL;
+    fetchP->response.location_query = NULL;
+    fetchP->response.uri_path = NULL;
+    fetchP->response.uri_query = NULL;
+    fetchP->response.error_message = NULL;
+    fetchP->response.parsed_option_count = 0;
+    fetchP->response.options[COAP_OPTION_BLOCK2 / OPTION_MAP_SIZE] &= ~(1 << (COAP_OPTION_BLOCK2 % OPTION_MAP_SIZE));
+
+    // from now on, the request is only answered by prv_finishFetch()
+    transaction_unlink(contextP, transacP);
+
+    // the client may tell the size of the whole response
+    if (IS_OPTION(response, COAP_OPTION_SIZE) && response->size > LWM2M_BLOCK2_MAX_SIZE)
+    {
+        result = COAP_413_ENTITY_TOO_LARGE;
+    }
+    else
+    {
+        if (IS_OPTION(response, COAP_OPTION_SIZE)) (void)utils_bufferReserve(&fetchP->payload, response->size);
+        result = prv_append(fetchP, response);
+    }
+    if (result == COAP_NO_ERROR && !prv_requestBlock(fetchP, response->block2_size))
+    {
+        result = COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    if (result != COAP_NO_ERROR)
+    {
+        prv_finishFetch(fetchP, false, result);
+    }
+
+    return true;
+}
+
+void block2_removeFetches(lwm2m_context_t * contextP,
+                          void * sessionH)
+{
+    lwm2m_transaction_t * transacP;
+
+    // the transfers end as on a timeout: the request is answered and freed
+    transacP = contextP->transactionList;
+    while (transacP != NULL)
+    {
+        if (transacP->callback == prv_fetchCallback
+         && transacP->peerH == sessionH)
+        {
+            prv_fetch_t * fetchP = (prv_fetch_t *)transacP->userData;
+
+            transaction_remove(contextP, transacP);
+            prv_finishFetch(fetchP, true, 0);
+            transacP = contextP->transactionList;
+        }
+        else
+        {
+            transacP = transacP->next;
+        }
+    }
+}
+
+void block2_clearFetches(lwm2m_context_t * contextP)
+{
+    lwm2m_transaction_t * transacP;
+
+    // the transfers in progress are dropped without calling back, like the other transactions
+    transacP = contextP->transactionList;
+    while (transacP != NULL)
+    {
+        lwm2m_transaction_t * nextP = transacP->next;
+
+        if (transacP->callback == prv_fetchCallback)
+        {
+            prv_freeFetch((prv_fetch_t *)transacP->userData);
+            transaction_remove(contextP, transacP);
+        }
+        transacP = nextP;
+    }
+}
+#endif
@@ -111,7 +111,7 @@ static void prv_requestBootstrap(lwm2m_context_t * context,
         coap_set_header_uri_query(transaction->message, query);
         transaction->callback = prv_handleBootstrapReply;
         transaction->userData = (void *)bootstrapServer;
-        context->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(context->transactionList, transaction);
+        transaction_add(context, transaction);
         if (transaction_send(context, transaction) == 0)
         {
             LOG("CI bootstrap requested to BS server");
@@ -687,7 +687,7 @@ int lwm2m_bootstrap_delete(lwm2m_context_t * contextP,
     transaction->callback = prv_resultCallback;
     transaction->userData = (void *)dataP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
 
     return transaction_send(contextP, transaction);
 }
@@ -714,7 +714,6 @@ int lwm2m_bootstrap_write(lwm2m_context_t * contextP,
     if (transaction == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
     coap_set_header_content_type(transaction->message, format);
-    coap_set_payload(transaction->message, buffer, length);
 
     dataP = (bs_data_t *)lwm2m_malloc(sizeof(bs_data_t));
     if (dataP == NULL)
@@ -730,9 +729,7 @@ int lwm2m_bootstrap_write(lwm2m_context_t * contextP,
     transaction->callback = prv_resultCallback;
     transaction->userData = (void *)dataP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
-
-    return transaction_send(contextP, transaction);
+    return block1_send(contextP, transaction, buffer, length);
 }
 
 int lwm2m_bootstrap_finish(lwm2m_context_t * contextP,
@@ -760,7 +757,7 @@ int lwm2m_bootstrap_finish(lwm2m_context_t * contextP,
     transaction->callback = prv_resultCallback;
     transaction->userData = (void *)dataP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
 
     return transaction_send(contextP, transaction);
 }
@@ -0,0 +1,352 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * Bulk operations of the server.
+ *
+ * The targeted clients are resolved to a list of internal IDs when the
+ * operation starts. A timer of the operation then starts the requests with
+ * the lwm2m_dm_*() and lwm2m_observe() APIs, at most rate per second and
+ * while fewer than concurrency are in flight, so a large fleet does not get
+ * all its requests, and the server all its transactions, at once. The
+ * payload is copied once so the caller's buffer can go, each request still
+ * serializes it in the buffer of its transaction: concurrency also bounds
+ * the number of these copies.
+ *
+ * Once a bulk observe is established with a client, its observation calls
+ * the application's callback directly.
+ */
+
+#include "internals.h"
+
+#include <string.h>
+
+#ifdef LWM2M_SERVER_MODE
+
+static bool prv_isSuccess(lwm2m_bulk_t * bulkP,
+                          int status)
+{
+    // an observe established reports 0, one canceled before reports COAP_202_DELETED
+    if (bulkP->operation == LWM2M_BULK_OBSERVE) return status == COAP_NO_ERROR;
+
+    return (status >> 5) == 2;
+}
+
+static void prv_free(lwm2m_context_t * contextP,
+                     lwm2m_bulk_t * bulkP)
+{
+    lwm2m_bulk_t ** targetP;
+
+    targetP = &contextP->bulkList;
+    while (*targetP != NULL && *targetP != bulkP)
+    {
+        targetP = &(*targetP)->next;
+    }
+    if (*targetP != NULL)
+    {
+        *targetP = bulkP->next;
+    }
+
+    timer_cancel(contextP, &bulkP->timer);
+    if (bulkP->buffer != NULL) lwm2m_free(bulkP->buffer);
+    lwm2m_free(bulkP->clientIDs);
+    lwm2m_free(bulkP);
+}
+
+static void prv_resultCallback(uint16_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int status,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    lwm2m_bulk_t * bulkP = (lwm2m_bulk_t *)userData;
+
+    if (bulkP->operation == LWM2M_BULK_OBSERVE && prv_isSuccess(bulkP, status))
+    {
+        lwm2m_client_t * clientP;
+        lwm2m_observation_t * observationP;
+
+        // the following notifications do not go through the bulk
+        clientP = registry_findById(bulkP->contextP, clientID);
+        observationP = clientP == NULL ? NULL : clientP->observationList;
+        while (observationP != NULL && &observationP->uri != uriP)
+        {
+            observationP = observationP->next;
+        }
+        if (observationP != NULL)
+        {
+            observationP->callback = bulkP->resultCallback;
+            observationP->userData = bulkP->userData;
+        }
+    }
+
+    bulkP->progress.inFlight--;
+    if (prv_isSuccess(bulkP, status))
+    {
+        bulkP->progress.succeeded++;
+    }
+    else
+    {
+        bulkP->progress.failed++;
+    }
+    completion_report(bulkP->contextP, bulkP->resultCallback, clientID, uriP, status, format, data, dataLength, bulkP->userData);
+
+    // a slot is free
+    (void)timer_schedule(bulkP->contextP, &bulkP->timer, lwm2m_gettime());
+}
+
+static void prv_start(lwm2m_context_t * contextP,
+                      lwm2m_bulk_t * bulkP,
+                      uint16_t clientID)
+{
+    int result;
+
+    bulkP->progress.started++;
+    bulkP->progress.inFlight++;
+
+    switch (bulkP->operation)
+    {
+    case LWM2M_BULK_READ:
+        result = lwm2m_dm_read(contextP, clientID, &bulkP->uri, prv_resultCallback, bulkP);
+        break;
+
+    case LWM2M_BULK_WRITE:
+        result = lwm2m_dm_write(contextP, clientID, &bulkP->uri, bulkP->format, bulkP->buffer, bulkP->length, prv_resultCallback, bulkP);
+        break;
+
+    case LWM2M_BULK_EXECUTE:
+        result = lwm2m_dm_execute(contextP, clientID, &bulkP->uri, bulkP->format, bulkP->buffer, bulkP->length, prv_resultCallback, bulkP);
+        break;
+
+    case LWM2M_BULK_OBSERVE:
+        result = lwm2m_observe(contextP, clientID, &bulkP->uri, prv_resultCallback, bulkP);
+        break;
+
+    default:
+        result = COAP_400_BAD_REQUEST;
+        break;
+    }
+
+    // on -1, the request failed after calling back
+    if (result > 0)
+    {
+        LOG_ARG("Request to client %d not started: %d", clientID, result);
+        bulkP->progress.inFlight--;
+        bulkP->progress.failed++;
+        completion_report(contextP, bulkP->resultCallback, clientID, &bulkP->uri, result, LWM2M_CONTENT_TEXT, NULL, 0, bulkP->userData);
+    }
+}
+
+static void prv_timerCallback(lwm2m_context_t * contextP,
+                              void * userData,
+                              time_t currentTime)
+{
+    lwm2m_bulk_t * bulkP = (lwm2m_bulk_t *)userData;
+    lwm2m_bulk_progress_t * progressP = &bulkP->progress;
+
+    if (currentTime != bulkP->windowStart)
+    {
+        bulkP->windowStart = currentTime;
+        bulkP->windowCount = 0;
+    }
+
+    while (!bulkP->cancelled
+        && progressP->started < progressP->total
+        && (bulkP->concurrency == 0 || progressP->inFlight < bulkP->concurrency)
+        && (bulkP->rate == 0 || bulkP->windowCount < bulkP->rate))
+    {
+        bulkP->windowCount++;
+        prv_start(contextP, bulkP, bulkP->clientIDs[progressP->started]);
+    }
+
+    if (bulkP->cancelled || progressP->started == progressP->total)
+    {
+        if (progressP->inFlight == 0)
+        {
+            LOG_ARG("Bulk operation done: %d succeeded, %d failed", progressP->succeeded, progressP->failed);
+            if (bulkP->doneCallback != NULL)
+            {
+                bulkP->doneCallback(bulkP, progressP, bulkP->userData);
+            }
+            prv_free(contextP, bulkP);
+        }
+    }
+    else if (bulkP->concurrency == 0 || progressP->inFlight < bulkP->concurrency)
+    {
+        // out of the requests of this second, the others wait for a result
+        (void)timer_schedule(contextP, &bulkP->timer, bulkP->windowStart + 1);
+    }
+}
+
+// Fills bulkP->clientIDs with the targets of the request.
+static int prv_selectClients(lwm2m_context_t * contextP,
+                             lwm2m_bulk_request_t * requestP,
+                             lwm2m_bulk_t * bulkP)
+{
+    lwm2m_client_t * clientP;
+    size_t count;
+
+    if (requestP->clientIDs != NULL)
+    {
+        count = requestP->clientCount;
+    }
+    else
+    {
+        count = 0;
+        for (clientP = contextP->clientList ; clientP != NULL ; clientP = clientP->next)
+        {
+            if (requestP->filter == NULL || requestP->filter(clientP, requestP->filterData)) count++;
+        }
+    }
+    if (count == 0) return COAP_404_NOT_FOUND;
+
+    bulkP->clientIDs = (uint16_t *)lwm2m_malloc(count * sizeof(uint16_t));
+    if (bulkP->clientIDs == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    if (requestP->clientIDs != NULL)
+    {
+        memcpy(bulkP->clientIDs, requestP->clientIDs, count * sizeof(uint16_t));
+    }
+    else
+    {
+        count = 0;
+        for (clientP = contextP->clientList ; clientP != NULL ; clientP = clientP->next)
+        {
+            if (requestP->filter == NULL || requestP->filter(clientP, requestP->filterData))
+            {
+                bulkP->clientIDs[count++] = clientP->internalID;
+            }
+        }
+    }
+    bulkP->progress.total = count;
+
+    return COAP_NO_ERROR;
+}
+
+int lwm2m_bulk_start(lwm2m_context_t * contextP,
+                     lwm2m_bulk_request_t * requestP,
+                     lwm2m_result_callback_t resultCallback,
+                     lwm2m_bulk_callback_t doneCallback,
+                     void * userData,
+                     lwm2m_bulk_t ** bulkP)
+{
+    lwm2m_bulk_t * newP;
+    int result;
+
+    LOG_ARG("operation: %d", requestP->operation);
+    LOG_URI(&requestP->uri);
+
+    // the checks of the single operations, done once
+    switch (requestP->operation)
+    {
+    case LWM2M_BULK_READ:
+        break;
+
+    case LWM2M_BULK_WRITE:
+        if (!LWM2M_URI_IS_SET_INSTANCE(&requestP->uri)
+         || requestP->buffer == NULL
+         || requestP->length <= 0)
+        {
+            return COAP_400_BAD_REQUEST;
+        }
+        break;
+
+    case LWM2M_BULK_EXECUTE:
+        if (!LWM2M_URI_IS_SET_RESOURCE(&requestP->uri)) return COAP_400_BAD_REQUEST;
+        break;
+
+    case LWM2M_BULK_OBSERVE:
+        if (!LWM2M_URI_IS_SET_INSTANCE(&requestP->uri) && LWM2M_URI_IS_SET_RESOURCE(&requestP->uri)) return COAP_400_BAD_REQUEST;
+        break;
+
+    default:
+        return COAP_400_BAD_REQUEST;
+    }
+
+    newP = (lwm2m_bulk_t *)lwm2m_malloc(sizeof(lwm2m_bulk_t));
+    if (newP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+    memset(newP, 0, sizeof(lwm2m_bulk_t));
+
+    result = prv_selectClients(contextP, requestP, newP);
+    if (result != COAP_NO_ERROR)
+    {
+        lwm2m_free(newP);
+        return result;
+    }
+
+    if (requestP->buffer != NULL && requestP->length > 0)
+    {
+        newP->buffer = (uint8_t *)lwm2m_malloc(requestP->length);
+        if (newP->buffer == NULL)
+        {
+            lwm2m_free(newP->clientIDs);
+            lwm2m_free(newP);
+            return COAP_500_INTERNAL_SERVER_ERROR;
+        }
+        memcpy(newP->buffer, requestP->buffer, requestP->length);
+        newP->length = requestP->length;
+    }
+
+    newP->contextP = contextP;
+    newP->operation = requestP->operation;
+    memcpy(&newP->uri, &requestP->uri, sizeof(lwm2m_uri_t));
+    newP->format = requestP->format;
+    newP->rate = requestP->rate;
+    newP->concurrency = requestP->concurrency;
+    newP->resultCallback = resultCallback;
+    newP->doneCallback = doneCallback;
+    newP->userData = userData;
+    newP->timer.callback = prv_timerCallback;
+    newP->timer.userData = newP;
+
+    // the first requests go on the next lwm2m_step()
+    if (0 == timer_schedule(contextP, &newP->timer, lwm2m_gettime()))
+    {
+        if (newP->buffer != NULL) lwm2m_free(newP->buffer);
+        lwm2m_free(newP->clientIDs);
+        lwm2m_free(newP);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    newP->next = contextP->bulkList;
+    contextP->bulkList = newP;
+
+    if (bulkP != NULL) *bulkP = newP;
+
+    return COAP_NO_ERROR;
+}
+
+void lwm2m_bulk_cancel(lwm2m_context_t * contextP,
+                       lwm2m_bulk_t * bulkP)
+{
+    LOG_ARG("%d requests not started", bulkP->progress.total - bulkP->progress.started);
+
+    bulkP->cancelled = true;
+    (void)timer_schedule(contextP, &bulkP->timer, lwm2m_gettime());
+}
+
+void bulk_close(lwm2m_context_t * contextP)
+{
+    // like the transactions, dropped without calling back
+    while (contextP->bulkList != NULL)
+    {
+        prv_free(contextP, contextP->bulkList);
+    }
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * Completion queue of the server.
+ *
+ * The results of the requests made without a callback are kept in a ring
+ * buffer of the context instead of being delivered from inside
+ * lwm2m_handle_packet() or lwm2m_step(). The application polls them in
+ * batches when it is ready, and may issue new requests or hand them to other
+ * threads: a record holds its own copy of the payload.
+ *
+ * When the ring is full, the new record is dropped and counted.
+ */
+
+#include "internals.h"
+
+#include <string.h>
+
+#ifdef LWM2M_SERVER_MODE
+
+static void prv_post(lwm2m_context_t * contextP,
+                     uint16_t clientID,
+                     lwm2m_uri_t * uriP,
+                     int status,
+                     lwm2m_media_type_t format,
+                     uint8_t * data,
+                     int dataLength,
+                     void * userData)
+{
+    lwm2m_completion_queue_t * queueP = &contextP->completions;
+    lwm2m_completion_t * recordP;
+
+    if (queueP->size == 0) return;
+
+    if (queueP->count == queueP->size)
+    {
+        LOG_ARG("Completion queue full, dropping the result of client %d", clientID);
+        queueP->dropped++;
+        return;
+    }
+
+    recordP = queueP->records + (queueP->head + queueP->count) % queueP->size;
+    memset(recordP, 0, sizeof(lwm2m_completion_t));
+    if (data != NULL && dataLength > 0)
+    {
+        recordP->data = (uint8_t *)lwm2m_malloc(dataLength);
+        if (recordP->data == NULL)
+        {
+            queueP->dropped++;
+            return;
+        }
+        memcpy(recordP->data, data, dataLength);
+        recordP->dataLength = dataLength;
+    }
+    recordP->userData = userData;
+    recordP->clientID = clientID;
+    if (uriP != NULL) memcpy(&recordP->uri, uriP, sizeof(lwm2m_uri_t));
+    recordP->status = status;
+    recordP->format = format;
+
+    queueP->count++;
+}
+
+void completion_report(lwm2m_context_t * contextP,
+                       lwm2m_result_callback_t callback,
+                       uint16_t clientID,
+                       lwm2m_uri_t * uriP,
+                       int status,
+                       lwm2m_media_type_t format,
+                       uint8_t * data,
+                       int dataLength,
+                       void * userData)
+{
+    if (callback != NULL)
+    {
+        callback(clientID, uriP, status, format, data, dataLength, userData);
+    }
+    else if (contextP != NULL)
+    {
+        prv_post(contextP, clientID, uriP, status, format, data, dataLength, userData);
+    }
+}
+
+void completion_close(lwm2m_context_t * contextP)
+{
+    lwm2m_completion_queue_t * queueP = &contextP->completions;
+
+    while (queueP->count > 0)
+    {
+        lwm2m_completion_t * recordP = queueP->records + queueP->head;
+
+        if (recordP->data != NULL) lwm2m_free(recordP->data);
+        queueP->head = (queueP->head + 1) % queueP->size;
+        queueP->count--;
+    }
+    if (queueP->records != NULL) lwm2m_free(queueP->records);
+    memset(queueP, 0, sizeof(lwm2m_completion_queue_t));
+}
+
+int lwm2m_set_completion_queue(lwm2m_context_t * contextP,
+                               size_t capacity)
+{
+    lwm2m_completion_queue_t * queueP = &contextP->completions;
+    lwm2m_completion_t * recordsP;
+    size_t i;
+
+    LOG_ARG("capacity: %d", capacity);
+
+    if (capacity < queueP->count) return COAP_400_BAD_REQUEST;
+
+    recordsP = NULL;
+    if (capacity != 0)
+    {
+        recordsP = (lwm2m_completion_t *)lwm2m_malloc(capacity * sizeof(lwm2m_completion_t));
+        if (recordsP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+
+        // the queued records keep their order
+        for (i = 0 ; i < queueP->count ; i++)
+        {
+            memcpy(recordsP + i, queueP->records + (queueP->head + i) % queueP->size, sizeof(lwm2m_completion_t));
+        }
+    }
+
+    if (queueP->records != NULL) lwm2m_free(queueP->records);
+    queueP->records = recordsP;
+    queueP->size = capacity;
+    queueP->head = 0;
+
+    return COAP_NO_ERROR;
+}
+
+size_t lwm2m_poll_completions(lwm2m_context_t * contextP,
+                              lwm2m_completion_t * recordsP,
+                              size_t maxCount)
+{
+    lwm2m_completion_queue_t * queueP = &contextP->completions;
+    size_t count;
+
+    count = 0;
+    while (count < maxCount && queueP->count > 0)
+    {
+        memcpy(recordsP + count, queueP->records + queueP->head, sizeof(lwm2m_completion_t));
+        queueP->head = (queueP->head + 1) % queueP->size;
+        queueP->count--;
+        count++;
+    }
+
+    return count;
+}
+
+#endif
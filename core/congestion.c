@@ -0,0 +1,538 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * Congestion control of the transactions, per peer.
+ *
+ * The retransmission timeout of a peer follows CoCoA (draft-ietf-core-cocoa):
+ * a strong estimator is fed by the exchanges answered at the first
+ * transmission, a weak one by the exchanges answered after one or two
+ * retransmissions, and both update the overall timeout. The first timeout of
+ * an exchange is randomized between 1 and 1.5 times the overall timeout and
+ * grows by a variable backoff factor on each retransmission. The timeout of a
+ * peer without new samples ages back towards the default.
+ *
+ * lwm2m_gettime() counts seconds: a sample of n seconds stands for
+ * n + 0.5 seconds, and the timers are rounded up to the second.
+ *
+ * Up to NSTART transactions are in flight for each peer, the following ones
+ * wait in the queue of the peer. When the context limits the transactions
+ * in flight for all the peers, the peers with waiting transactions take turns
+ * as slots get free.
+ *
+ * The state of a peer is kept while it has transactions, then dropped after
+ * COAP_EXCHANGE_LIFETIME without any: by then its timeout is back close to
+ * the default.
+ */
+
+#include "internals.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// transactions in flight per peer by default (RFC 7252 section 4.7)
+#ifndef LWM2M_NSTART
+#define LWM2M_NSTART    1
+#endif
+
+#define PRV_RTO_INITIAL     ((uint32_t)COAP_RESPONSE_TIMEOUT * 1000)
+#define PRV_RTO_MAX         60000
+#define PRV_TABLE_MIN_SIZE  16
+#define PRV_IDLE_LIFETIME   ((time_t)COAP_EXCHANGE_LIFETIME)
+
+static size_t prv_hashPeer(void * peerP)
+{
+    return utils_hashPointer(((lwm2m_peer_t *)peerP)->sessionH);
+}
+
+static uint16_t prv_getNstart(lwm2m_peer_table_t * tableP)
+{
+    return tableP->nstart != 0 ? tableP->nstart : LWM2M_NSTART;
+}
+
+static lwm2m_peer_t * prv_find(lwm2m_context_t * contextP,
+                               void * sessionH)
+{
+    lwm2m_peer_table_t * tableP = &contextP->peers;
+    lwm2m_peer_t * peerP;
+
+    if (tableP->size == 0) return NULL;
+
+    for (peerP = tableP->buckets[utils_hashBucket(utils_hashPointer(sessionH), tableP->size)] ; peerP != NULL ; peerP = peerP->next)
+    {
+        if (lwm2m_session_is_equal(peerP->sessionH, sessionH, contextP->userData) == true) return peerP;
+    }
+
+    return NULL;
+}
+
+static void prv_removeReady(lwm2m_peer_table_t * tableP,
+                            lwm2m_peer_t * peerP)
+{
+    lwm2m_peer_t * prevP;
+    lwm2m_peer_t * targetP;
+
+    if (!peerP->ready) return;
+
+    prevP = NULL;
+    for (targetP = tableP->readyHead ; targetP != peerP ; targetP = targetP->readyNext)
+    {
+        prevP = targetP;
+    }
+    if (prevP == NULL)
+    {
+        tableP->readyHead = peerP->readyNext;
+    }
+    else
+    {
+        prevP->readyNext = peerP->readyNext;
+    }
+    if (tableP->readyTail == peerP) tableP->readyTail = prevP;
+    peerP->readyNext = NULL;
+    peerP->ready = false;
+}
+
+static void prv_free(lwm2m_context_t * contextP,
+                     lwm2m_peer_t * peerP)
+{
+    lwm2m_peer_table_t * tableP = &contextP->peers;
+    lwm2m_peer_t ** targetP;
+
+    targetP = tableP->buckets + utils_hashBucket(utils_hashPointer(peerP->sessionH), tableP->size);
+    while (*targetP != NULL && *targetP != peerP)
+    {
+        targetP = &(*targetP)->next;
+    }
+    if (*targetP != NULL)
+    {
+        *targetP = peerP->next;
+        tableP->count--;
+    }
+    prv_removeReady(tableP, peerP);
+    timer_cancel(contextP, &peerP->idleTimer);
+    lwm2m_free(peerP);
+}
+
+static void prv_idleCallback(lwm2m_context_t * contextP,
+                             void * userData,
+                             time_t currentTime)
+{
+    lwm2m_peer_t * peerP = (lwm2m_peer_t *)userData;
+
+    (void)currentTime;
+
+    LOG("Dropping the state of an idle peer");
+    prv_free(contextP, peerP);
+}
+
+static void prv_dispatchCallback(lwm2m_context_t * contextP,
+                                 void * userData,
+                                 time_t currentTime)
+{
+    (void)userData;
+    (void)currentTime;
+
+    congestion_dispatch(contextP);
+}
+
+static lwm2m_peer_t * prv_get(lwm2m_context_t * contextP,
+                              void * sessionH)
+{
+    lwm2m_peer_table_t * tableP = &contextP->peers;
+    lwm2m_peer_t ** bucketsP;
+    lwm2m_peer_t * peerP;
+    size_t size;
+
+    peerP = prv_find(contextP, sessionH);
+    if (peerP != NULL) return peerP;
+
+    size = utils_hashTableSize(tableP->size, tableP->count, PRV_TABLE_MIN_SIZE);
+    if (size != tableP->size)
+    {
+        bucketsP = (lwm2m_peer_t **)utils_hashTableResize((void **)tableP->buckets, tableP->size, size, offsetof(lwm2m_peer_t, next), prv_hashPeer);
+        if (bucketsP != NULL)
+        {
+            tableP->buckets = bucketsP;
+            tableP->size = size;
+        }
+        else if (tableP->size == 0)
+        {
+            return NULL;
+        }
+    }
+
+    peerP = (lwm2m_peer_t *)lwm2m_malloc(sizeof(lwm2m_peer_t));
+    if (peerP == NULL) return NULL;
+    memset(peerP, 0, sizeof(lwm2m_peer_t));
+    peerP->sessionH = sessionH;
+    peerP->rto = PRV_RTO_INITIAL;
+    peerP->rtoTime = lwm2m_gettime();
+    peerP->idleTimer.callback = prv_idleCallback;
+    peerP->idleTimer.userData = peerP;
+    peerP->next = tableP->buckets[utils_hashBucket(utils_hashPointer(sessionH), tableP->size)];
+    tableP->buckets[utils_hashBucket(utils_hashPointer(sessionH), tableP->size)] = peerP;
+    tableP->count++;
+
+    return peerP;
+}
+
+// The waiting transactions are sent at the latest on the next lwm2m_step().
+static void prv_scheduleDispatch(lwm2m_context_t * contextP)
+{
+    lwm2m_peer_table_t * tableP = &contextP->peers;
+
+    if (tableP->timer.index != 0) return;
+
+    tableP->timer.callback = prv_dispatchCallback;
+    tableP->timer.userData = NULL;
+    (void)timer_schedule(contextP, &tableP->timer, lwm2m_gettime());
+}
+
+// A peer whose next transaction can go once a slot of the context is free.
+static void prv_setReady(lwm2m_context_t * contextP,
+                         lwm2m_peer_t * peerP)
+{
+    lwm2m_peer_table_t * tableP = &contextP->peers;
+
+    if (peerP->ready
+     || peerP->queueHead == NULL
+     || peerP->inFlight >= prv_getNstart(tableP))
+    {
+        return;
+    }
+
+    peerP->ready = true;
+    peerP->readyNext = NULL;
+    if (tableP->readyTail == NULL)
+    {
+        tableP->readyHead = peerP;
+    }
+    else
+    {
+        tableP->readyTail->readyNext = peerP;
+    }
+    tableP->readyTail = peerP;
+
+    prv_scheduleDispatch(contextP);
+}
+
+static lwm2m_peer_t * prv_popReady(lwm2m_peer_table_t * tableP)
+{
+    lwm2m_peer_t * peerP;
+
+    peerP = tableP->readyHead;
+    if (peerP == NULL) return NULL;
+
+    tableP->readyHead = peerP->readyNext;
+    if (tableP->readyHead == NULL) tableP->readyTail = NULL;
+    peerP->readyNext = NULL;
+    peerP->ready = false;
+
+    return peerP;
+}
+
+static void prv_setInFlight(lwm2m_context_t * contextP,
+                            lwm2m_peer_t * peerP,
+                            lwm2m_transaction_t * transacP)
+{
+    timer_cancel(contextP, &peerP->idleTimer);
+    transacP->inFlight = true;
+    peerP->inFlight++;
+    contextP->peers.inFlight++;
+}
+
+// Ages the timeout of a peer without new samples back towards the default.
+static void prv_age(lwm2m_peer_t * peerP,
+                    time_t now)
+{
+    time_t idle;
+
+    if (now < peerP->rtoTime) return;
+    idle = (now - peerP->rtoTime) * 1000;
+
+    if (peerP->rto < 1000 && idle > 16 * (time_t)peerP->rto)
+    {
+        peerP->rto *= 2;
+        peerP->rtoTime = now;
+    }
+    else if (peerP->rto > 3000 && idle > 4 * (time_t)peerP->rto)
+    {
+        peerP->rto = (PRV_RTO_INITIAL + peerP->rto) / 2;
+        peerP->rtoTime = now;
+    }
+}
+
+// Updates an estimator with a sample and returns its timeout.
+static uint32_t prv_estimate(uint32_t * srttP,
+                             uint32_t * rttvarP,
+                             uint32_t rtt,
+                             uint32_t k)
+{
+    if (*srttP == 0)
+    {
+        *srttP = rtt;
+        *rttvarP = rtt / 2;
+    }
+    else
+    {
+        uint32_t delta;
+
+        delta = *srttP > rtt ? *srttP - rtt : rtt - *srttP;
+        *rttvarP = (3 * *rttvarP + delta) / 4;
+        *srttP = (7 * *srttP + rtt) / 8;
+    }
+
+    return *srttP + k * *rttvarP;
+}
+
+bool congestion_acquire(lwm2m_context_t * contextP,
+                        lwm2m_transaction_t * transacP)
+{
+    lwm2m_peer_table_t * tableP = &contextP->peers;
+    lwm2m_peer_t * peerP;
+
+    if (transacP->inFlight) return true;
+
+    // without its state, the peer is not limited
+    peerP = prv_get(contextP, transacP->peerH);
+    if (peerP == NULL) return true;
+
+    if (peerP->queueHead == NULL
+     && peerP->inFlight < prv_getNstart(tableP)
+     && (tableP->maxInFlight == 0 || (tableP->inFlight < tableP->maxInFlight && tableP->readyHead == NULL)))
+    {
+        prv_setInFlight(contextP, peerP, transacP);
+        return true;
+    }
+
+    LOG_ARG("Transaction %d waits for its turn, %d in flight", transacP->mID, peerP->inFlight);
+    timer_cancel(contextP, &peerP->idleTimer);
+    transacP->queued = true;
+    transacP->queueNext = NULL;
+    if (peerP->queueTail == NULL)
+    {
+        peerP->queueHead = transacP;
+    }
+    else
+    {
+        peerP->queueTail->queueNext = transacP;
+    }
+    peerP->queueTail = transacP;
+    if (tableP->maxInFlight != 0 && peerP->inFlight < prv_getNstart(tableP))
+    {
+        prv_setReady(contextP, peerP);
+    }
+
+    return false;
+}
+
+uint32_t congestion_getTimeout(lwm2m_context_t * contextP,
+                               lwm2m_transaction_t * transacP)
+{
+    lwm2m_peer_t * peerP;
+    uint32_t rto;
+
+    peerP = prv_find(contextP, transacP->peerH);
+    if (peerP == NULL)
+    {
+        rto = PRV_RTO_INITIAL;
+    }
+    else
+    {
+        prv_age(peerP, lwm2m_gettime());
+        rto = peerP->rto;
+    }
+
+    // variable backoff factor
+    if (rto < 1000)
+    {
+        transacP->backoff = 6;
+    }
+    else if (rto > 3000)
+    {
+        transacP->backoff = 3;
+    }
+    else
+    {
+        transacP->backoff = 4;
+    }
+    transacP->rto = rto + (uint32_t)rand() % (rto / 2 + 1);
+
+    return transacP->rto;
+}
+
+uint32_t congestion_getNextTimeout(lwm2m_transaction_t * transacP)
+{
+    transacP->rto = transacP->rto * transacP->backoff / 2;
+    if (transacP->rto > PRV_RTO_MAX) transacP->rto = PRV_RTO_MAX;
+
+    return transacP->rto;
+}
+
+void congestion_sample(lwm2m_context_t * contextP,
+                       lwm2m_transaction_t * transacP)
+{
+    lwm2m_peer_t * peerP;
+    time_t now;
+    uint32_t rtt;
+    uint32_t rto;
+
+    // transmissions so far, see transaction_send()
+    if (transacP->retrans_counter < 2 || transacP->retrans_counter > 4) return;
+
+    peerP = prv_find(contextP, transacP->peerH);
+    if (peerP == NULL) return;
+    now = lwm2m_gettime();
+    if (now < transacP->sendTime) return;
+
+    rtt = (uint32_t)(now - transacP->sendTime) * 1000 + 500;
+    if (transacP->retrans_counter == 2)
+    {
+        rto = prv_estimate(&peerP->strongSrtt, &peerP->strongRttvar, rtt, 4);
+        peerP->rto = (peerP->rto + rto) / 2;
+    }
+    else
+    {
+        rto = prv_estimate(&peerP->weakSrtt, &peerP->weakRttvar, rtt, 1);
+        peerP->rto = (3 * peerP->rto + rto) / 4;
+    }
+    if (peerP->rto > PRV_RTO_MAX) peerP->rto = PRV_RTO_MAX;
+    peerP->rtoTime = now;
+
+    LOG_ARG("RTT %u ms, RTO %u ms", rtt, peerP->rto);
+}
+
+void congestion_release(lwm2m_context_t * contextP,
+                        lwm2m_transaction_t * transacP)
+{
+    lwm2m_peer_table_t * tableP = &contextP->peers;
+    lwm2m_peer_t * peerP;
+
+    if (!transacP->queued && !transacP->inFlight) return;
+
+    peerP = prv_find(contextP, transacP->peerH);
+    if (peerP == NULL) return;
+
+    if (transacP->queued)
+    {
+        lwm2m_transaction_t * prevP;
+        lwm2m_transaction_t * targetP;
+
+        prevP = NULL;
+        for (targetP = peerP->queueHead ; targetP != NULL && targetP != transacP ; targetP = targetP->queueNext)
+        {
+            prevP = targetP;
+        }
+        if (targetP != NULL)
+        {
+            if (prevP == NULL)
+            {
+                peerP->queueHead = transacP->queueNext;
+            }
+            else
+            {
+                prevP->queueNext = transacP->queueNext;
+            }
+            if (peerP->queueTail == transacP) peerP->queueTail = prevP;
+        }
+        if (peerP->queueHead == NULL) prv_removeReady(tableP, peerP);
+        transacP->queued = false;
+        transacP->queueNext = NULL;
+    }
+    else
+    {
+        transacP->inFlight = false;
+        peerP->inFlight--;
+        tableP->inFlight--;
+        prv_setReady(contextP, peerP);
+        // another peer may take the slot of the context
+        if (tableP->readyHead != NULL) prv_scheduleDispatch(contextP);
+    }
+
+    if (peerP->inFlight == 0 && peerP->queueHead == NULL)
+    {
+        (void)timer_schedule(contextP, &peerP->idleTimer, lwm2m_gettime() + PRV_IDLE_LIFETIME);
+    }
+}
+
+void congestion_dispatch(lwm2m_context_t * contextP)
+{
+    lwm2m_peer_table_t * tableP = &contextP->peers;
+
+    timer_cancel(contextP, &tableP->timer);
+    while (tableP->readyHead != NULL
+        && (tableP->maxInFlight == 0 || tableP->inFlight < tableP->maxInFlight))
+    {
+        lwm2m_peer_t * peerP;
+        lwm2m_transaction_t * transacP;
+
+        peerP = prv_popReady(tableP);
+        transacP = peerP->queueHead;
+        peerP->queueHead = transacP->queueNext;
+        if (peerP->queueHead == NULL) peerP->queueTail = NULL;
+        transacP->queued = false;
+        transacP->queueNext = NULL;
+        prv_setInFlight(contextP, peerP, transacP);
+
+        // back in line behind the other peers
+        prv_setReady(contextP, peerP);
+
+        (void)transaction_send(contextP, transacP);
+    }
+}
+
+void congestion_removePeer(lwm2m_context_t * contextP,
+                           void * sessionH)
+{
+    lwm2m_peer_t * peerP;
+
+    peerP = prv_find(contextP, sessionH);
+    if (peerP != NULL) prv_free(contextP, peerP);
+}
+
+void congestion_close(lwm2m_context_t * contextP)
+{
+    lwm2m_peer_table_t * tableP = &contextP->peers;
+    size_t i;
+
+    timer_cancel(contextP, &tableP->timer);
+    for (i = 0 ; i < tableP->size ; i++)
+    {
+        while (tableP->buckets[i] != NULL)
+        {
+            lwm2m_peer_t * peerP = tableP->buckets[i];
+
+            tableP->buckets[i] = peerP->next;
+            timer_cancel(contextP, &peerP->idleTimer);
+            lwm2m_free(peerP);
+        }
+    }
+    if (tableP->buckets != NULL) lwm2m_free(tableP->buckets);
+    memset(tableP, 0, sizeof(lwm2m_peer_table_t));
+}
+
+int lwm2m_set_congestion_options(lwm2m_context_t * contextP,
+                                 uint16_t nstart,
+                                 size_t maxInFlight)
+{
+    if (nstart == 0) return COAP_400_BAD_REQUEST;
+
+    contextP->peers.nstart = nstart;
+    contextP->peers.maxInFlight = maxInFlight;
+
+    return COAP_NO_ERROR;
+}
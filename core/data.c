@@ -153,14 +153,11 @@ lwm2m_data_t * lwm2m_data_new(int size)
     return dataP;
 }
 
-void lwm2m_data_free(int size,
-                     lwm2m_data_t * dataP)
+void data_freeContent(int size,
+                      lwm2m_data_t * dataP)
 {
     int i;
 
-    LOG_ARG("size: %d", size);
-    if (size == 0 || dataP == NULL) return;
-
     for (i = 0; i < size; i++)
     {
         switch (dataP[i].type)
@@ -183,6 +180,15 @@ void lwm2m_data_free(int size,
             break;
         }
     }
+}
+
+void lwm2m_data_free(int size,
+                     lwm2m_data_t * dataP)
+{
+    LOG_ARG("size: %d", size);
+    if (size == 0 || dataP == NULL) return;
+
+    data_freeContent(size, dataP);
     lwm2m_free(dataP);
 }
 
@@ -570,20 +576,22 @@ int lwm2m_data_parse(lwm2m_uri_t * uriP,
         return json_parse(uriP, buffer, bufferLen, dataP);
 #endif
 
+#ifdef LWM2M_SUPPORT_SENML_CBOR
+    case LWM2M_CONTENT_SENML_CBOR:
+        return senml_cbor_parse(uriP, buffer, bufferLen, dataP);
+#endif
+
     default:
         return 0;
     }
 }
 
-int lwm2m_data_serialize(lwm2m_uri_t * uriP,
-                         int size,
-                         lwm2m_data_t * dataP,
-                         lwm2m_media_type_t * formatP,
-                         uint8_t ** bufferP)
+// Falls back to a format able to carry dataP. Returns false if there is none.
+static bool prv_selectFormat(lwm2m_uri_t * uriP,
+                             int size,
+                             lwm2m_data_t * dataP,
+                             lwm2m_media_type_t * formatP)
 {
-    LOG_URI(uriP);
-    LOG_ARG("size: %d, formatP: %s", size, STR_MEDIA_TYPE(*formatP));
-
     // Check format
     if (*formatP == LWM2M_CONTENT_TEXT
      || *formatP == LWM2M_CONTENT_OPAQUE)
@@ -606,11 +614,33 @@ int lwm2m_data_serialize(lwm2m_uri_t * uriP,
      && dataP->type != LWM2M_TYPE_OPAQUE)
     {
         LOG("Opaque format is reserved to opaque resources.");
-        return -1;
+        return false;
     }
 
     LOG_ARG("Final format: %s", STR_MEDIA_TYPE(*formatP));
 
+    return true;
+}
+
+static bool prv_isResourceInstance(lwm2m_uri_t * uriP,
+                                   int size,
+                                   lwm2m_data_t * dataP)
+{
+    return uriP != NULL && LWM2M_URI_IS_SET_RESOURCE(uriP)
+        && (size != 1 || dataP->id != uriP->resourceId);
+}
+
+int lwm2m_data_serialize(lwm2m_uri_t * uriP,
+                         int size,
+                         lwm2m_data_t * dataP,
+                         lwm2m_media_type_t * formatP,
+                         uint8_t ** bufferP)
+{
+    LOG_URI(uriP);
+    LOG_ARG("size: %d, formatP: %s", size, STR_MEDIA_TYPE(*formatP));
+
+    if (!prv_selectFormat(uriP, size, dataP, formatP)) return -1;
+
     switch (*formatP)
     {
     case LWM2M_CONTENT_TEXT:
@@ -624,20 +654,7 @@ int lwm2m_data_serialize(lwm2m_uri_t * uriP,
 
     case LWM2M_CONTENT_TLV:
     case LWM2M_CONTENT_TLV_OLD:
-    {
-            bool isResourceInstance;
-
-            if (uriP != NULL && LWM2M_URI_IS_SET_RESOURCE(uriP)
-             && (size != 1 || dataP->id != uriP->resourceId))
-            {
-                isResourceInstance = true;
-            }
-            else
-            {
-                isResourceInstance = false;
-            }
-            return tlv_serialize(isResourceInstance, size, dataP, bufferP);
-        }
+        return tlv_serialize(prv_isResourceInstance(uriP, size, dataP), size, dataP, bufferP);
 
 #ifdef LWM2M_CLIENT_MODE
     case LWM2M_CONTENT_LINK:
@@ -648,9 +665,188 @@ int lwm2m_data_serialize(lwm2m_uri_t * uriP,
     case LWM2M_CONTENT_JSON_OLD:
         return json_serialize(uriP, size, dataP, bufferP);
 #endif
+#ifdef LWM2M_SUPPORT_SENML_CBOR
+    case LWM2M_CONTENT_SENML_CBOR:
+        return senml_cbor_serialize(uriP, prv_isResourceInstance(uriP, size, dataP), size, dataP, bufferP);
+#endif
 
     default:
         return -1;
     }
 }
 
+int data_serializeTo(lwm2m_uri_t * uriP,
+                     int size,
+                     lwm2m_data_t * dataP,
+                     lwm2m_media_type_t * formatP,
+                     utils_buffer_t * outputP)
+{
+    uint8_t * bufferP;
+    uint8_t * targetP;
+    int res;
+
+    LOG_URI(uriP);
+    LOG_ARG("size: %d, formatP: %s", size, STR_MEDIA_TYPE(*formatP));
+
+    if (!prv_selectFormat(uriP, size, dataP, formatP)) return -1;
+
+    if (*formatP == LWM2M_CONTENT_TLV
+     || *formatP == LWM2M_CONTENT_TLV_OLD)
+    {
+        return tlv_serializeTo(prv_isResourceInstance(uriP, size, dataP), size, dataP, outputP);
+    }
+#ifdef LWM2M_SUPPORT_JSON
+    if (*formatP == LWM2M_CONTENT_JSON
+     || *formatP == LWM2M_CONTENT_JSON_OLD)
+    {
+        return json_serializeTo(uriP, size, dataP, outputP);
+    }
+#endif
+#ifdef LWM2M_SUPPORT_SENML_CBOR
+    if (*formatP == LWM2M_CONTENT_SENML_CBOR)
+    {
+        return senml_cbor_serializeTo(uriP, prv_isResourceInstance(uriP, size, dataP), size, dataP, outputP);
+    }
+#endif
+
+    res = lwm2m_data_serialize(uriP, size, dataP, formatP, &bufferP);
+    if (res <= 0) return res;
+
+    if (outputP->length == 0 && !outputP->isFixed)
+    {
+        // take over the serialized buffer rather than copying it
+        if (outputP->isAllocated) lwm2m_free(outputP->data);
+        outputP->data = bufferP;
+        outputP->size = (size_t)res;
+        outputP->length = (size_t)res;
+        outputP->isAllocated = true;
+        return res;
+    }
+
+    targetP = utils_bufferReserve(outputP, (size_t)res);
+    if (targetP == NULL)
+    {
+        res = -1;
+    }
+    else
+    {
+        memcpy(targetP, bufferP, res);
+        outputP->length += res;
+    }
+    lwm2m_free(bufferP);
+
+    return res;
+}
+
+lwm2m_data_t * data_findChild(lwm2m_data_t * parentP,
+                              uint16_t id)
+{
+    lwm2m_data_t * childrenP = parentP->value.asChildren.array;
+    size_t count = parentP->value.asChildren.count;
+    size_t i;
+
+    if (count == 0) return NULL;
+
+    // records of the same resource or instance usually follow each other
+    if (childrenP[count - 1].id == id) return childrenP + count - 1;
+    for (i = 0 ; i < count - 1 ; i++)
+    {
+        if (childrenP[i].id == id) return childrenP + i;
+    }
+
+    return NULL;
+}
+
+// Children arrays are allocated by powers of two: an array is full when its count is one.
+lwm2m_data_t * data_addChild(lwm2m_data_t * parentP,
+                             uint16_t id)
+{
+    size_t count = parentP->value.asChildren.count;
+    lwm2m_data_t * childP;
+
+    if ((count & (count - 1)) == 0)
+    {
+        lwm2m_data_t * newP;
+
+        newP = lwm2m_data_new(count == 0 ? 1 : count * 2);
+        if (newP == NULL) return NULL;
+        if (count != 0)
+        {
+            memcpy(newP, parentP->value.asChildren.array, count * sizeof(lwm2m_data_t));
+            lwm2m_free(parentP->value.asChildren.array);
+        }
+        parentP->value.asChildren.array = newP;
+    }
+
+    childP = parentP->value.asChildren.array + count;
+    childP->id = id;
+    parentP->value.asChildren.count = count + 1;
+
+    return childP;
+}
+
+int data_selectUri(lwm2m_uri_t * uriP,
+                   size_t size,
+                   lwm2m_data_t * dataP,
+                   lwm2m_data_t ** resultP)
+{
+    uint16_t uriIds[3];
+    int uriCount;
+    lwm2m_data_t parent;
+    lwm2m_data_t * nodeP;
+    int result;
+    int i;
+
+    if (uriP == NULL)
+    {
+        *resultP = dataP;
+        return (int)size;
+    }
+
+    uriCount = 0;
+    uriIds[uriCount++] = uriP->objectId;
+    if (LWM2M_URI_IS_SET_INSTANCE(uriP)) uriIds[uriCount++] = uriP->instanceId;
+    if (LWM2M_URI_IS_SET_RESOURCE(uriP)) uriIds[uriCount++] = uriP->resourceId;
+
+    memset(&parent, 0, sizeof(lwm2m_data_t));
+    parent.value.asChildren.array = dataP;
+    parent.value.asChildren.count = size;
+    nodeP = NULL;
+    for (i = 0 ; i < uriCount ; i++)
+    {
+        nodeP = data_findChild(&parent, uriIds[i]);
+        if (nodeP == NULL) goto error;
+        if (i < uriCount - 1)
+        {
+            if (nodeP->type != LWM2M_TYPE_OBJECT && nodeP->type != LWM2M_TYPE_OBJECT_INSTANCE) goto error;
+            parent = *nodeP;
+        }
+    }
+
+    if (nodeP->type == LWM2M_TYPE_OBJECT
+     || nodeP->type == LWM2M_TYPE_OBJECT_INSTANCE
+     || nodeP->type == LWM2M_TYPE_MULTIPLE_RESOURCE)
+    {
+        *resultP = nodeP->value.asChildren.array;
+        result = (int)nodeP->value.asChildren.count;
+        nodeP->value.asChildren.array = NULL;
+        nodeP->value.asChildren.count = 0;
+    }
+    else
+    {
+        *resultP = lwm2m_data_new(1);
+        if (*resultP == NULL) goto error;
+        memcpy(*resultP, nodeP, sizeof(lwm2m_data_t));
+        // now owned by *resultP
+        nodeP->type = LWM2M_TYPE_UNDEFINED;
+        result = 1;
+    }
+
+    lwm2m_data_free((int)size, dataP);
+    return result;
+
+error:
+    lwm2m_data_free((int)size, dataP);
+    *resultP = NULL;
+    return -1;
+}
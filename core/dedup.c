@@ -0,0 +1,276 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * Deduplication of the CON requests received (RFC 7252 section 4.5).
+ *
+ * When the ACK carrying a response is lost, the peer retransmits its request
+ * with the same message ID. The serialized response is kept with the session
+ * and message ID of the request, and a retransmission is answered with it
+ * without running the request again, so an Execute or a Create is not
+ * performed twice.
+ *
+ * Entries are kept COAP_EXCHANGE_LIFETIME in their order of arrival, a single
+ * timer drops the oldest ones as they expire. They are hashed by peer session
+ * handle, like the client registry, and a peer keeps at most
+ * LWM2M_DEDUP_MAX_PER_PEER of them: with NSTART at 1, a peer only retransmits
+ * its last requests.
+ *
+ * The store is allocated once by lwm2m_init(): LWM2M_DEDUP_MAX_ENTRIES entries
+ * with COAP_MAX_PACKET_SIZE bytes of response each, so answering a CON request
+ * does not allocate. When it is full, the oldest response is dropped before it
+ * expires. Larger responses are not kept.
+ */
+
+#include "internals.h"
+
+#include <string.h>
+
+// number of responses kept, the oldest one is dropped beyond
+#ifndef LWM2M_DEDUP_MAX_ENTRIES
+#define LWM2M_DEDUP_MAX_ENTRIES     32
+#endif
+
+// number of responses kept per peer, its oldest one is dropped beyond
+#ifndef LWM2M_DEDUP_MAX_PER_PEER
+#define LWM2M_DEDUP_MAX_PER_PEER    8
+#endif
+
+#define PRV_LIFETIME        ((time_t)COAP_EXCHANGE_LIFETIME)
+
+static lwm2m_dedup_entry_t ** prv_getBucket(lwm2m_dedup_cache_t * cacheP,
+                                            void * sessionH)
+{
+    return cacheP->buckets + utils_hashBucket(utils_hashPointer(sessionH), cacheP->size);
+}
+
+// Puts the entry back in the free list.
+static void prv_remove(lwm2m_context_t * contextP,
+                       lwm2m_dedup_entry_t * entryP)
+{
+    lwm2m_dedup_cache_t * cacheP = &contextP->dedupCache;
+    lwm2m_dedup_entry_t ** targetP;
+
+    targetP = prv_getBucket(cacheP, entryP->sessionH);
+    while (*targetP != NULL && *targetP != entryP)
+    {
+        targetP = &(*targetP)->next;
+    }
+    if (*targetP != NULL)
+    {
+        *targetP = entryP->next;
+    }
+
+    if (entryP->older == NULL)
+    {
+        cacheP->oldest = entryP->newer;
+    }
+    else
+    {
+        entryP->older->newer = entryP->newer;
+    }
+    if (entryP->newer == NULL)
+    {
+        cacheP->newest = entryP->older;
+    }
+    else
+    {
+        entryP->newer->older = entryP->older;
+    }
+
+    cacheP->count--;
+    entryP->next = cacheP->freeList;
+    cacheP->freeList = entryP;
+}
+
+static void prv_expiryCallback(lwm2m_context_t * contextP,
+                               void * userData,
+                               time_t currentTime)
+{
+    lwm2m_dedup_cache_t * cacheP = &contextP->dedupCache;
+
+    (void)userData;
+
+    while (cacheP->oldest != NULL && cacheP->oldest->expiry <= currentTime)
+    {
+        prv_remove(contextP, cacheP->oldest);
+    }
+    if (cacheP->oldest != NULL)
+    {
+        (void)timer_schedule(contextP, &cacheP->timer, cacheP->oldest->expiry);
+    }
+}
+
+bool dedup_replay(lwm2m_context_t * contextP,
+                  void * sessionH,
+                  coap_packet_t * message)
+{
+    lwm2m_dedup_cache_t * cacheP = &contextP->dedupCache;
+    lwm2m_dedup_entry_t * entryP;
+
+    if (cacheP->count == 0) return false;
+
+    for (entryP = *prv_getBucket(cacheP, sessionH) ; entryP != NULL ; entryP = entryP->next)
+    {
+        if (entryP->mid == message->mid
+         && entryP->sessionH == sessionH)
+        {
+            LOG_ARG("Duplicate of request %u, sending the kept response of %u bytes", message->mid, entryP->length);
+            (void)lwm2m_buffer_send(sessionH, entryP->response, entryP->length, contextP->userData);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int dedup_init(lwm2m_context_t * contextP)
+{
+    lwm2m_dedup_cache_t * cacheP = &contextP->dedupCache;
+    uint8_t * responseP;
+    size_t i;
+
+    // at most one entry per bucket on average
+    cacheP->size = 1;
+    while (cacheP->size < LWM2M_DEDUP_MAX_ENTRIES)
+    {
+        cacheP->size *= 2;
+    }
+    cacheP->buckets = (lwm2m_dedup_entry_t **)utils_hashTableAlloc(cacheP->size, 1);
+    if (cacheP->buckets == NULL) return 0;
+
+    // the responses follow the entries, in the same block
+    cacheP->entries = (lwm2m_dedup_entry_t *)lwm2m_malloc(LWM2M_DEDUP_MAX_ENTRIES * (sizeof(lwm2m_dedup_entry_t) + COAP_MAX_PACKET_SIZE));
+    if (cacheP->entries == NULL)
+    {
+        lwm2m_free(cacheP->buckets);
+        memset(cacheP, 0, sizeof(lwm2m_dedup_cache_t));
+        return 0;
+    }
+    memset(cacheP->entries, 0, LWM2M_DEDUP_MAX_ENTRIES * sizeof(lwm2m_dedup_entry_t));
+    responseP = (uint8_t *)(cacheP->entries + LWM2M_DEDUP_MAX_ENTRIES);
+    for (i = LWM2M_DEDUP_MAX_ENTRIES ; i > 0 ; i--)
+    {
+        lwm2m_dedup_entry_t * entryP = cacheP->entries + i - 1;
+
+        entryP->response = responseP + (i - 1) * COAP_MAX_PACKET_SIZE;
+        entryP->next = cacheP->freeList;
+        cacheP->freeList = entryP;
+    }
+
+    return 1;
+}
+
+void dedup_store(lwm2m_context_t * contextP,
+                 void * sessionH,
+                 uint16_t mid,
+                 uint8_t * response,
+                 size_t length)
+{
+    lwm2m_dedup_cache_t * cacheP = &contextP->dedupCache;
+    lwm2m_dedup_entry_t * entryP;
+    lwm2m_dedup_entry_t * oldestP;
+    size_t count;
+
+    if (cacheP->entries == NULL) return;
+    if (length > COAP_MAX_PACKET_SIZE)
+    {
+        LOG_ARG("Response of %u bytes not kept", length);
+        return;
+    }
+
+    // make room by dropping the oldest response of the peer, or the oldest one
+    count = 0;
+    oldestP = NULL;
+    for (entryP = *prv_getBucket(cacheP, sessionH) ; entryP != NULL ; entryP = entryP->next)
+    {
+        if (entryP->sessionH == sessionH)
+        {
+            count++;
+            oldestP = entryP;
+        }
+    }
+    if (count >= LWM2M_DEDUP_MAX_PER_PEER)
+    {
+        prv_remove(contextP, oldestP);
+    }
+    else if (cacheP->freeList == NULL)
+    {
+        prv_remove(contextP, cacheP->oldest);
+    }
+
+    entryP = cacheP->freeList;
+    cacheP->freeList = entryP->next;
+    entryP->sessionH = sessionH;
+    entryP->mid = mid;
+    entryP->expiry = lwm2m_gettime() + PRV_LIFETIME;
+    entryP->length = length;
+    memcpy(entryP->response, response, length);
+
+    entryP->next = *prv_getBucket(cacheP, sessionH);
+    *prv_getBucket(cacheP, sessionH) = entryP;
+    entryP->older = cacheP->newest;
+    entryP->newer = NULL;
+    if (cacheP->newest == NULL)
+    {
+        cacheP->oldest = entryP;
+    }
+    else
+    {
+        cacheP->newest->newer = entryP;
+    }
+    cacheP->newest = entryP;
+    cacheP->count++;
+
+    if (cacheP->timer.index == 0)
+    {
+        cacheP->timer.callback = prv_expiryCallback;
+        cacheP->timer.userData = NULL;
+        (void)timer_schedule(contextP, &cacheP->timer, entryP->expiry);
+    }
+}
+
+void dedup_removePeer(lwm2m_context_t * contextP,
+                      void * sessionH)
+{
+    lwm2m_dedup_cache_t * cacheP = &contextP->dedupCache;
+    lwm2m_dedup_entry_t * entryP;
+
+    if (cacheP->count == 0) return;
+
+    entryP = *prv_getBucket(cacheP, sessionH);
+    while (entryP != NULL)
+    {
+        lwm2m_dedup_entry_t * nextP = entryP->next;
+
+        if (entryP->sessionH == sessionH)
+        {
+            prv_remove(contextP, entryP);
+        }
+        entryP = nextP;
+    }
+}
+
+void dedup_close(lwm2m_context_t * contextP)
+{
+    lwm2m_dedup_cache_t * cacheP = &contextP->dedupCache;
+
+    timer_cancel(contextP, &cacheP->timer);
+    if (cacheP->entries != NULL) lwm2m_free(cacheP->entries);
+    if (cacheP->buckets != NULL) lwm2m_free(cacheP->buckets);
+    memset(cacheP, 0, sizeof(lwm2m_dedup_cache_t));
+}
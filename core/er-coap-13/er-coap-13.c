@@ -46,7 +46,7 @@
 
 #include "er-coap-13.h"
 
-#include "liblwm2m.h" /* for lwm2m_malloc() and lwm2m_free() */
+#include "../internals.h" /* for lwm2m_malloc(), lwm2m_free() and the object pools */
 
 #define DEBUG 0
 #if DEBUG
@@ -60,13 +60,6 @@
 #define PRINTLLADDR(addr)
 #endif
 
-/*-----------------------------------------------------------------------------------*/
-/*- Variables -----------------------------------------------------------------------*/
-/*-----------------------------------------------------------------------------------*/
-static uint16_t current_mid = 0;
-
-coap_status_t coap_error_code = NO_ERROR;
-const char *coap_error_message = "";
 /*-----------------------------------------------------------------------------------*/
 /*- LOCAL HELP FUNCTIONS ------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
@@ -256,11 +249,12 @@ coap_merge_multi_option(uint8_t **dst, size_t *dst_len, uint8_t *option, size_t
 void
 coap_add_multi_option(multi_option_t **dst, uint8_t *option, size_t option_len, uint8_t is_static)
 {
-  multi_option_t *opt = (multi_option_t *)lwm2m_malloc(sizeof(multi_option_t));
+  multi_option_t *opt = POOL_ALLOC(LWM2M_POOL_OPTION, multi_option_t);
 
   if (opt)
   {
     opt->next = NULL;
+    opt->in_packet = 0;
     opt->len = (uint8_t)option_len;
     if (is_static)
     {
@@ -273,7 +267,7 @@ coap_add_multi_option(multi_option_t **dst, uint8_t *option, size_t option_len,
         opt->data = (uint8_t *)lwm2m_malloc(option_len);
         if (opt->data == NULL)
         {
-            lwm2m_free(opt);
+            POOL_FREE(LWM2M_POOL_OPTION, opt);
             return;
         }
         memcpy(opt->data, option, option_len);
@@ -295,10 +289,38 @@ coap_add_multi_option(multi_option_t **dst, uint8_t *option, size_t option_len,
   }
 }
 
+/* Links an option of a received datagram without copying it. Nodes come from the
+ * packet itself, the heap is only used when a message has more options than that. */
+static void
+coap_parse_multi_option(coap_packet_t *coap_pkt, multi_option_t **dst, uint8_t *option, size_t option_len)
+{
+  multi_option_t *opt;
+
+  if (coap_pkt->parsed_option_count >= COAP_MAX_PARSED_OPTIONS)
+  {
+    coap_add_multi_option(dst, option, option_len, 1);
+    return;
+  }
+
+  opt = coap_pkt->parsed_options + coap_pkt->parsed_option_count;
+  coap_pkt->parsed_option_count++;
+  opt->next = NULL;
+  opt->is_static = 1;
+  opt->in_packet = 1;
+  opt->len = (uint8_t)option_len;
+  opt->data = option;
+
+  while (*dst)
+  {
+    dst = &((*dst)->next);
+  }
+  *dst = opt;
+}
+
 void
 free_multi_option(multi_option_t *dst)
 {
-  if (dst)
+  while (dst)
   {
     multi_option_t *n = dst->next;
     dst->next = NULL;
@@ -306,8 +328,11 @@ free_multi_option(multi_option_t *dst)
     {
         lwm2m_free(dst->data);
     }
-    lwm2m_free(dst);
-    free_multi_option(n);
+    if (dst->in_packet == 0)
+    {
+        POOL_FREE(LWM2M_POOL_OPTION, dst);
+    }
+    dst = n;
   }
 }
 
@@ -379,12 +404,6 @@ coap_get_variable(const uint8_t *buffer, size_t length, const char *name, const
   return 0;
 }
 
-/*-----------------------------------------------------------------------------------*/
-uint16_t
-coap_get_mid()
-{
-  return ++current_mid;
-}
 /*-----------------------------------------------------------------------------------*/
 /*- MEASSAGE PROCESSING -------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
@@ -637,7 +656,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
 
   if (coap_pkt->version != 1)
   {
-    coap_error_message = "CoAP version must be 1";
+    coap_pkt->error_message = "CoAP version must be 1";
     return BAD_REQUEST_4_00;
   }
 
@@ -776,18 +795,18 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
       case COAP_OPTION_URI_PATH:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
         // coap_merge_multi_option( (char **) &(coap_pkt->uri_path), &(coap_pkt->uri_path_len), current_option, option_length, 0);
-        coap_add_multi_option( &(coap_pkt->uri_path), current_option, option_length, 1);
+        coap_parse_multi_option(coap_pkt, &(coap_pkt->uri_path), current_option, option_length);
         PRINTF("Uri-Path [%.*s]\n", option_length, current_option);
         break;
       case COAP_OPTION_URI_QUERY:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
         // coap_merge_multi_option( (char **) &(coap_pkt->uri_query), &(coap_pkt->uri_query_len), current_option, option_length, '&');
-        coap_add_multi_option( &(coap_pkt->uri_query), current_option, option_length, 1);
+        coap_parse_multi_option(coap_pkt, &(coap_pkt->uri_query), current_option, option_length);
         PRINTF("Uri-Query [%.*s]\n", option_length, current_option);
         break;
 
       case COAP_OPTION_LOCATION_PATH:
-        coap_add_multi_option( &(coap_pkt->location_path), current_option, option_length, 1);
+        coap_parse_multi_option(coap_pkt, &(coap_pkt->location_path), current_option, option_length);
         break;
       case COAP_OPTION_LOCATION_QUERY:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
@@ -801,7 +820,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
         coap_pkt->proxy_uri_len = option_length;
         /*TODO length > 270 not implemented (actually not required) */
         PRINTF("Proxy-Uri NOT IMPLEMENTED [%.*s]\n", coap_pkt->proxy_uri_len, coap_pkt->proxy_uri);
-        coap_error_message = "This is a constrained server (Contiki)";
+        coap_pkt->error_message = "This is a constrained server (Contiki)";
         return PROXYING_NOT_SUPPORTED_5_05;
         break;
 
@@ -834,7 +853,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
         /* Check if critical (odd) */
         if (option_number & 1)
         {
-          coap_error_message = "Unsupported critical option";
+          coap_pkt->error_message = "Unsupported critical option";
           return BAD_OPTION_4_02;
         }
     }
@@ -1378,7 +1397,7 @@ coap_set_payload(void *packet, const void *payload, size_t length)
   coap_packet_t *const coap_pkt = (coap_packet_t *) packet;
 
   coap_pkt->payload = (uint8_t *) payload;
-  coap_pkt->payload_len = (uint16_t)(length);
+  coap_pkt->payload_len = (uint32_t)(length);
 
   return coap_pkt->payload_len;
 }
@@ -90,6 +90,11 @@
 #endif /* COAP_MAX_HEADER_SIZE */
 
 #define COAP_MAX_PACKET_SIZE  (COAP_MAX_HEADER_SIZE + REST_MAX_CHUNK_SIZE)
+
+/* Number of Uri-Path, Uri-Query and Location-Path options parsed without allocation. */
+#ifndef COAP_MAX_PARSED_OPTIONS
+#define COAP_MAX_PARSED_OPTIONS  16
+#endif
 /*                                        0/14          48 for IPv6 (28 for IPv4) */
 #if COAP_MAX_PACKET_SIZE > (UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN)
 //#error "UIP_CONF_BUFFER_SIZE too small for REST_MAX_CHUNK_SIZE"
@@ -211,6 +216,7 @@ typedef enum {
 typedef struct _multi_option_t {
   struct _multi_option_t *next;
   uint8_t is_static;
+  uint8_t in_packet; /* node taken from coap_packet_t.parsed_options, not allocated */
   uint8_t len;
   uint8_t *data;
 } multi_option_t;
@@ -258,9 +264,14 @@ typedef struct {
   multi_option_t *uri_query;
   uint8_t if_none_match;
 
-  uint16_t payload_len;
+  uint32_t payload_len;
   uint8_t *payload;
 
+  const char *error_message; /* human-readable reason when coap_parse_message() fails */
+
+  /* nodes of the multi-options lists pointing into the parsed datagram */
+  uint8_t parsed_option_count;
+  multi_option_t parsed_options[COAP_MAX_PARSED_OPTIONS];
 } coap_packet_t;
 
 /* Option format serialization*/
@@ -319,11 +330,6 @@ typedef struct {
       current_number = number; \
     }
 
-/* To store error code and human-readable payload */
-extern const char *coap_error_message;
-
-uint16_t coap_get_mid(void);
-
 void coap_init_message(void *packet, coap_message_type_t type, uint8_t code, uint16_t mid);
 size_t coap_serialize_get_size(void *packet);
 size_t coap_serialize_message(void *packet, uint8_t *buffer);
@@ -101,7 +101,8 @@
 ((M) == LWM2M_CONTENT_OPAQUE ? "LWM2M_CONTENT_OPAQUE" :  \
 ((M) == LWM2M_CONTENT_TLV ? "LWM2M_CONTENT_TLV" :        \
 ((M) == LWM2M_CONTENT_JSON ? "LWM2M_CONTENT_JSON" :      \
-"Unknown")))))
+((M) == LWM2M_CONTENT_SENML_CBOR ? "LWM2M_CONTENT_SENML_CBOR" :      \
+"Unknown"))))))
 #define STR_STATE(S)                                \
 ((S) == STATE_INITIAL ? "STATE_INITIAL" :      \
 ((S) == STATE_BOOTSTRAP_REQUIRED ? "STATE_BOOTSTRAP_REQUIRED" :      \
@@ -118,9 +119,15 @@
 
 #define LWM2M_DEFAULT_LIFETIME  86400
 
-#ifdef LWM2M_SUPPORT_JSON
+#if defined(LWM2M_SUPPORT_JSON) && defined(LWM2M_SUPPORT_SENML_CBOR)
+#define REG_LWM2M_RESOURCE_TYPE     ">;rt=\"oma.lwm2m\";ct=\"112 11543\","
+#define REG_LWM2M_RESOURCE_TYPE_LEN 32
+#elif defined(LWM2M_SUPPORT_JSON)
 #define REG_LWM2M_RESOURCE_TYPE     ">;rt=\"oma.lwm2m\";ct=11543,"
 #define REG_LWM2M_RESOURCE_TYPE_LEN 25
+#elif defined(LWM2M_SUPPORT_SENML_CBOR)
+#define REG_LWM2M_RESOURCE_TYPE     ">;rt=\"oma.lwm2m\";ct=112,"
+#define REG_LWM2M_RESOURCE_TYPE_LEN 24
 #else
 #define REG_LWM2M_RESOURCE_TYPE     ">;rt=\"oma.lwm2m\","
 #define REG_LWM2M_RESOURCE_TYPE_LEN 17
@@ -172,6 +179,8 @@
 #define REG_ATTR_CONTENT_KEY_LEN    2
 #define REG_ATTR_CONTENT_JSON       "11543"   // Temporary value
 #define REG_ATTR_CONTENT_JSON_LEN   5
+#define REG_ATTR_CONTENT_SENML_CBOR     "112"
+#define REG_ATTR_CONTENT_SENML_CBOR_LEN 3
 
 #define ATTR_SERVER_ID_STR       "ep="
 #define ATTR_SERVER_ID_LEN       3
@@ -216,9 +225,10 @@
 
 typedef struct
 {
+    lwm2m_context_t * contextP;
     uint16_t clientID;
     lwm2m_uri_t uri;
-    lwm2m_result_callback_t callback;
+    lwm2m_result_callback_t callback;   // NULL to post the result to the completion queue
     void * userData;
 } dm_data_t;
 
@@ -230,6 +240,24 @@ typedef enum
     URI_DEPTH_RESOURCE_INSTANCE
 } uri_depth_t;
 
+// Output of the serializers. data is either storage provided by the caller or allocated
+// with lwm2m_malloc(), in which case isAllocated is set and utils_bufferFree() releases it.
+// Unless isFixed is set, the buffer moves to the heap when it runs out of room.
+typedef struct
+{
+    uint8_t *   data;
+    size_t      size;
+    size_t      length;
+    bool        isAllocated;
+    bool        isFixed;
+} utils_buffer_t;
+
+// Intrusive hash tables: arrays of power of two sizes of chains linked by a pointer
+// stored in the entries. Gives the hash of an entry, before it is masked to a bucket.
+typedef size_t (*utils_hash_callback_t)(void * entryP);
+
+#define UTILS_HASH_SEED     2166136261u
+
 #ifdef LWM2M_BOOTSTRAP_SERVER_MODE
 typedef struct
 {
@@ -241,10 +269,20 @@ typedef struct
 #endif
 
 // defined in uri.c
-lwm2m_uri_t * uri_decode(char * altPath, multi_option_t *uriPath);
+bool uri_decode(char * altPath, multi_option_t *uriPath, lwm2m_uri_t * uriP);
 int uri_getNumber(uint8_t * uriString, size_t uriLength);
 int uri_toString(lwm2m_uri_t * uriP, uint8_t * buffer, size_t bufferLen, uri_depth_t * depthP);
 
+// defined in data.c
+int data_serializeTo(lwm2m_uri_t * uriP, int size, lwm2m_data_t * dataP, lwm2m_media_type_t * formatP, utils_buffer_t * outputP);
+void data_freeContent(int size, lwm2m_data_t * dataP);
+lwm2m_data_t * data_findChild(lwm2m_data_t * parentP, uint16_t id);
+// Appends a child to parentP, growing its children array by powers of two.
+lwm2m_data_t * data_addChild(lwm2m_data_t * parentP, uint16_t id);
+// Takes over the objects array dataP and returns the part targeted by uriP in resultP: the children
+// of the object, instance or multiple resource, or the single resource itself. Returns its size or -1.
+int data_selectUri(lwm2m_uri_t * uriP, size_t size, lwm2m_data_t * dataP, lwm2m_data_t ** resultP);
+
 // defined in objects.c
 uint8_t object_readData(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, int * sizeP, lwm2m_data_t ** dataP);
 uint8_t object_read(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_media_type_t * formatP, uint8_t ** bufferP, size_t * lengthP);
@@ -257,6 +295,8 @@ uint8_t object_checkReadable(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm
 bool object_isInstanceNew(lwm2m_context_t * contextP, uint16_t objectId, uint16_t instanceId);
 int object_getRegisterPayloadBufferLength(lwm2m_context_t * contextP);
 int object_getRegisterPayload(lwm2m_context_t * contextP, uint8_t * buffer, size_t length);
+uint8_t * object_getCachedRegisterPayload(lwm2m_context_t * contextP, int * lengthP);
+void object_invalidateRegisterPayload(lwm2m_context_t * contextP);
 int object_getServers(lwm2m_context_t * contextP, bool checkOnly);
 uint8_t object_createInstance(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_data_t * dataP);
 uint8_t object_writeInstance(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_data_t * dataP);
@@ -265,18 +305,21 @@ uint8_t object_writeInstance(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm
 lwm2m_transaction_t * transaction_new(void * sessionH, coap_method_t method, char * altPath, lwm2m_uri_t * uriP, uint16_t mID, uint8_t token_len, uint8_t* token);
 int transaction_send(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
 void transaction_free(lwm2m_transaction_t * transacP);
+int transaction_init(lwm2m_context_t * contextP);
+void transaction_add(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
+void transaction_unlink(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
 void transaction_remove(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
+void transaction_removePeer(lwm2m_context_t * contextP, void * sessionH);
+void transaction_close(lwm2m_context_t * contextP);
 bool transaction_handleResponse(lwm2m_context_t * contextP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
-void transaction_step(lwm2m_context_t * contextP, time_t currentTime, time_t * timeoutP);
 
 // defined in management.c
 uint8_t dm_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, coap_packet_t * message, coap_packet_t * response);
 
 // defined in observe.c
-uint8_t observe_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, int size, lwm2m_data_t * dataP, coap_packet_t * message, coap_packet_t * response);
+uint8_t observe_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, lwm2m_data_t * dataP, coap_packet_t * message, coap_packet_t * response);
 void observe_cancel(lwm2m_context_t * contextP, uint16_t mid, void * fromSessionH);
 uint8_t observe_setParameters(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, lwm2m_attributes_t * attrP);
-void observe_step(lwm2m_context_t * contextP, time_t currentTime, time_t * timeoutP);
 void observe_clear(lwm2m_context_t * contextP, lwm2m_uri_t * uriP);
 bool observe_handleNotify(lwm2m_context_t * contextP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
 void observe_remove(lwm2m_observation_t * observationP);
@@ -285,11 +328,36 @@ lwm2m_observed_t * observe_findByUri(lwm2m_context_t * contextP, lwm2m_uri_t * u
 // defined in registration.c
 uint8_t registration_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
 void registration_deregister(lwm2m_context_t * contextP, lwm2m_server_t * serverP);
-void registration_freeClient(lwm2m_client_t * clientP);
+void registration_freeClient(lwm2m_context_t * contextP, lwm2m_client_t * clientP);
 uint8_t registration_start(lwm2m_context_t * contextP);
 void registration_step(lwm2m_context_t * contextP, time_t currentTime, time_t * timeoutP);
 lwm2m_status_t registration_getStatus(lwm2m_context_t * contextP);
 
+// defined in timer.c
+int timer_schedule(lwm2m_context_t * contextP, lwm2m_timer_t * timerP, time_t deadline);
+void timer_cancel(lwm2m_context_t * contextP, lwm2m_timer_t * timerP);
+void timer_step(lwm2m_context_t * contextP, time_t currentTime, time_t * timeoutP);
+void timer_close(lwm2m_context_t * contextP);
+
+// defined in registry.c
+#ifdef LWM2M_SERVER_MODE
+bool registry_newId(lwm2m_context_t * contextP, uint16_t * idP);
+int registry_add(lwm2m_context_t * contextP, lwm2m_client_t * clientP);
+void registry_remove(lwm2m_context_t * contextP, lwm2m_client_t * clientP);
+lwm2m_client_t * registry_findById(lwm2m_context_t * contextP, uint16_t id);
+lwm2m_client_t * registry_findByName(lwm2m_context_t * contextP, const char * name);
+void registry_close(lwm2m_context_t * contextP);
+#endif
+
+// defined in objectlist.c
+#ifdef LWM2M_SERVER_MODE
+lwm2m_client_object_list_t * objectlist_intern(lwm2m_context_t * contextP, uint32_t * links, size_t count, const uint8_t * altPath, size_t altPathLength);
+void objectlist_release(lwm2m_context_t * contextP, lwm2m_client_object_list_t * listP);
+lwm2m_client_object_t * objectlist_findObject(lwm2m_client_object_list_t * listP, uint16_t id);
+bool objectlist_hasInstance(lwm2m_client_object_t * objectP, uint16_t id);
+void objectlist_close(lwm2m_context_t * contextP);
+#endif
+
 // defined in packet.c
 uint8_t message_send(lwm2m_context_t * contextP, coap_packet_t * message, void * sessionH);
 
@@ -305,19 +373,86 @@ lwm2m_status_t bootstrap_getStatus(lwm2m_context_t * contextP);
 // defined in tlv.c
 int tlv_parse(uint8_t * buffer, size_t bufferLen, lwm2m_data_t ** dataP);
 int tlv_serialize(bool isResourceInstance, int size, lwm2m_data_t * dataP, uint8_t ** bufferP);
+int tlv_serializeTo(bool isResourceInstance, int size, lwm2m_data_t * dataP, utils_buffer_t * outputP);
 
 // defined in json.c
 #ifdef LWM2M_SUPPORT_JSON
 int json_parse(lwm2m_uri_t * uriP, uint8_t * buffer, size_t bufferLen, lwm2m_data_t ** dataP);
 int json_serialize(lwm2m_uri_t * uriP, int size, lwm2m_data_t * tlvP, uint8_t ** bufferP);
+int json_serializeTo(lwm2m_uri_t * uriP, int size, lwm2m_data_t * tlvP, utils_buffer_t * outputP);
+#endif
+
+// defined in senml_cbor.c
+#ifdef LWM2M_SUPPORT_SENML_CBOR
+int senml_cbor_parse(lwm2m_uri_t * uriP, const uint8_t * buffer, size_t bufferLen, lwm2m_data_t ** dataP);
+int senml_cbor_serialize(lwm2m_uri_t * uriP, bool isResourceInstance, int size, lwm2m_data_t * dataP, uint8_t ** bufferP);
+int senml_cbor_serializeTo(lwm2m_uri_t * uriP, bool isResourceInstance, int size, lwm2m_data_t * dataP, utils_buffer_t * outputP);
 #endif
 
 // defined in discover.c
 int discover_serialize(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, int size, lwm2m_data_t * dataP, uint8_t ** bufferP);
 
 // defined in block1.c
-uint8_t coap_block1_handler(lwm2m_block1_data_t ** block1Data, uint16_t mid, uint8_t * buffer, size_t length, uint16_t blockSize, uint32_t blockNum, bool blockMore, uint8_t ** outputBuffer, size_t * outputLength);
+uint8_t coap_block1_handler(lwm2m_block1_data_t ** block1Data, const uint8_t * token, uint8_t tokenLen, uint16_t mid, uint8_t * buffer, size_t length, uint16_t blockSize, uint32_t blockNum, bool blockMore, uint8_t ** outputBuffer, size_t * outputLength);
+#ifdef LWM2M_CLIENT_MODE
+uint8_t coap_block1_stream(lwm2m_context_t * contextP, lwm2m_server_t * serverP, coap_packet_t * message, uint16_t blockSize, uint32_t blockNum, bool blockMore);
+#endif
 void free_block1_buffer(lwm2m_block1_data_t * block1Data);
+#if defined(LWM2M_SERVER_MODE) || defined(LWM2M_BOOTSTRAP_SERVER_MODE)
+int block1_send(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP, uint8_t * buffer, size_t length);
+void block1_removePeer(lwm2m_context_t * contextP, void * sessionH);
+void block1_clear(lwm2m_context_t * contextP);
+#endif
+
+// defined in congestion.c
+bool congestion_acquire(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
+uint32_t congestion_getTimeout(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
+uint32_t congestion_getNextTimeout(lwm2m_transaction_t * transacP);
+void congestion_sample(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
+void congestion_release(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
+void congestion_dispatch(lwm2m_context_t * contextP);
+void congestion_removePeer(lwm2m_context_t * contextP, void * sessionH);
+void congestion_close(lwm2m_context_t * contextP);
+
+#ifdef LWM2M_SERVER_MODE
+// defined in bulk.c
+void bulk_close(lwm2m_context_t * contextP);
+
+// defined in completion.c
+void completion_report(lwm2m_context_t * contextP, lwm2m_result_callback_t callback, uint16_t clientID, lwm2m_uri_t * uriP, int status, lwm2m_media_type_t format, uint8_t * data, int dataLength, void * userData);
+void completion_close(lwm2m_context_t * contextP);
+#endif
+
+// defined in dedup.c
+int dedup_init(lwm2m_context_t * contextP);
+bool dedup_replay(lwm2m_context_t * contextP, void * sessionH, coap_packet_t * message);
+void dedup_store(lwm2m_context_t * contextP, void * sessionH, uint16_t mid, uint8_t * response, size_t length);
+void dedup_removePeer(lwm2m_context_t * contextP, void * sessionH);
+void dedup_close(lwm2m_context_t * contextP);
+
+// defined in block2.c
+#define BLOCK2_ACCEPT_NONE  -1      // the request had no Accept option
+#define BLOCK2_ACCEPT_ANY   -2      // matches any Accept, used for notifications
+bool block2_getBlock(lwm2m_context_t * contextP, void * sessionH, coap_packet_t * message, coap_packet_t * response, uint32_t blockNum, uint16_t blockSize);
+bool block2_storeResponse(lwm2m_context_t * contextP, void * sessionH, coap_packet_t * message, coap_packet_t * response);
+bool block2_store(lwm2m_context_t * contextP, void * sessionH, lwm2m_uri_t * uriP, int accept, uint16_t format, uint8_t * payload, size_t length);
+void block2_clear(lwm2m_context_t * contextP);
+#ifdef LWM2M_SERVER_MODE
+bool block2_fetch(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP, coap_packet_t * response);
+void block2_removeFetches(lwm2m_context_t * contextP, void * sessionH);
+void block2_clearFetches(lwm2m_context_t * contextP);
+#endif
+
+// defined in pool.c
+#ifdef LWM2M_WITH_POOLS
+void * pool_alloc(lwm2m_pool_type_t type);
+void pool_free(lwm2m_pool_type_t type, void * objectP);
+#define POOL_ALLOC(P, T)    ((T *)pool_alloc(P))
+#define POOL_FREE(P, O)     pool_free(P, O)
+#else
+#define POOL_ALLOC(P, T)    ((T *)lwm2m_malloc(sizeof(T)))
+#define POOL_FREE(P, O)     lwm2m_free(O)
+#endif
 
 // defined in utils.c
 lwm2m_data_type_t utils_depthToDatatype(uri_depth_t depth);
@@ -332,6 +467,15 @@ int utils_textToFloat(uint8_t * buffer, int length, double * dataP);
 void utils_copyValue(void * dst, const void * src, size_t len);
 size_t utils_base64GetSize(size_t dataLen);
 size_t utils_base64Encode(uint8_t * dataP, size_t dataLen, uint8_t * bufferP, size_t bufferLen);
+void utils_bufferInit(utils_buffer_t * bufferP, uint8_t * storage, size_t size, bool isFixed);
+uint8_t * utils_bufferReserve(utils_buffer_t * bufferP, size_t length);
+void utils_bufferFree(utils_buffer_t * bufferP);
+uint32_t utils_hashBytes(uint32_t hash, const uint8_t * buffer, size_t length);
+size_t utils_hashPointer(void * pointer);
+size_t utils_hashBucket(size_t hash, size_t size);
+size_t utils_hashTableSize(size_t size, size_t count, size_t minSize);
+void ** utils_hashTableAlloc(size_t size, size_t tableCount);
+void ** utils_hashTableResize(void ** bucketsP, size_t size, size_t newSize, size_t nextOffset, utils_hash_callback_t hashCb);
 #ifdef LWM2M_CLIENT_MODE
 lwm2m_server_t * utils_findServer(lwm2m_context_t * contextP, void * fromSessionH);
 lwm2m_server_t * utils_findBootstrapServer(lwm2m_context_t * contextP, void * fromSessionH);
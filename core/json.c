@@ -21,34 +21,57 @@
 #include <string.h>
 #include <stdio.h>
 #include <inttypes.h>
+#include <limits.h>
 
 
 #ifdef LWM2M_SUPPORT_JSON
 
-#define PRV_JSON_BUFFER_SIZE 1024
+// longest text of an integer or a float value
+#define PRV_JSON_NUMBER_MAX_LEN 64
+// opaque values are base64 encoded by pieces of this many bytes
+#define PRV_JSON_B64_INPUT_LEN  48
+#define PRV_JSON_B64_OUTPUT_LEN 64
+
+// The parser looks for white spaces and string ends 16 bytes at a time where SSE2 is available.
+// Define LWM2M_JSON_AVX2 to scan 32 bytes at a time with AVX2 instead (only faster with long
+// strings), or LWM2M_JSON_NO_SIMD to use the plain C version everywhere.
+#if !defined(LWM2M_JSON_NO_SIMD) && defined(LWM2M_JSON_AVX2) && defined(__AVX2__)
+#include <immintrin.h>
+#define PRV_SIMD_WIDTH          32
+#define PRV_SIMD_FULL_MASK      0xFFFFFFFF
+#elif !defined(LWM2M_JSON_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define PRV_SIMD_WIDTH          16
+#define PRV_SIMD_FULL_MASK      0x0000FFFF
+#endif
+
+// type of the tree nodes whose depth is not known yet during parsing
+#define PRV_TYPE_CONTAINER      LWM2M_TYPE_OBJECT
 
-#define JSON_MIN_ARRAY_LEN      21      // e":[{"n":"N","v":X}]}
 #define JSON_MIN_BASE_LEN        7      // n":"N",
 #define JSON_ITEM_MAX_SIZE      36      // with ten characters for value
-#define JSON_MIN_BX_LEN          5      // bt":1
 
 #define JSON_FALSE_STRING  "false"
 #define JSON_TRUE_STRING   "true"
 
 #define JSON_RES_ITEM_URI           "{\"n\":\""
 #define JSON_RES_ITEM_URI_SIZE      6
-#define JSON_ITEM_BOOL_TRUE         "\",\"bv\":true},"
-#define JSON_ITEM_BOOL_TRUE_SIZE    13
-#define JSON_ITEM_BOOL_FALSE        "\",\"bv\":false},"
-#define JSON_ITEM_BOOL_FALSE_SIZE   14
+#define JSON_ITEM_BOOL_TRUE         "\",\"bv\":true}"
+#define JSON_ITEM_BOOL_TRUE_SIZE    12
+#define JSON_ITEM_BOOL_FALSE        "\",\"bv\":false}"
+#define JSON_ITEM_BOOL_FALSE_SIZE   13
 #define JSON_ITEM_NUM               "\",\"v\":"
 #define JSON_ITEM_NUM_SIZE          6
-#define JSON_ITEM_NUM_END           "},"
-#define JSON_ITEM_NUM_END_SIZE      2
+#define JSON_ITEM_NUM_END           "}"
+#define JSON_ITEM_NUM_END_SIZE      1
 #define JSON_ITEM_STRING_BEGIN      "\",\"sv\":\""
 #define JSON_ITEM_STRING_BEGIN_SIZE 8
-#define JSON_ITEM_STRING_END        "\"},"
-#define JSON_ITEM_STRING_END_SIZE   3
+#define JSON_ITEM_STRING_END        "\"}"
+#define JSON_ITEM_STRING_END_SIZE   2
+#define JSON_ITEM_OBJECT_LINK       "\",\"ov\":\""
+#define JSON_ITEM_OBJECT_LINK_SIZE  8
+#define JSON_ITEM_SEPARATOR         ","
+#define JSON_ITEM_SEPARATOR_SIZE    1
 
 #define JSON_BN_HEADER_1        "{\"bn\":\""
 #define JSON_BN_HEADER_1_SIZE   7
@@ -60,78 +83,114 @@
 #define JSON_FOOTER_SIZE        2
 
 
-#define _GO_TO_NEXT_CHAR(I,B,L)         \
-    {                                   \
-        I++;                            \
-        I += prv_skipSpace(B+I, L-I);   \
-        if (I == L) goto error;         \
-    }
-
-typedef enum
-{
-    _STEP_START,
-    _STEP_TOKEN,
-    _STEP_ANY_SEPARATOR,
-    _STEP_SEPARATOR,
-    _STEP_QUOTED_VALUE,
-    _STEP_VALUE,
-    _STEP_DONE
-} _itemState;
-
 typedef enum
 {
     _TYPE_UNSET,
     _TYPE_FALSE,
     _TYPE_TRUE,
     _TYPE_FLOAT,
-    _TYPE_STRING
+    _TYPE_STRING,
+    _TYPE_OBJECT_LINK
 } _type;
 
 typedef struct
 {
     uint16_t    ids[4];
+    int         idCount;
     _type       type;
     uint8_t *   value;
     size_t      valueLen;
 } _record_t;
 
-static int prv_isReserved(char sign)
+typedef struct
 {
-    if (sign == '['
-     || sign == '{'
-     || sign == ']'
-     || sign == '}'
-     || sign == ':'
-     || sign == ','
-     || sign == '"')
-    {
-        return 1;
-    }
+    utils_buffer_t *    outputP;
+    size_t              total;
+    bool                first;      // no separator before the first record
+} prv_writer_t;
 
-    return 0;
+static bool prv_isWhiteSpace(uint8_t sign)
+{
+    return (sign == 0x20
+         || sign == 0x09
+         || sign == 0x0A
+         || sign == 0x0D);
 }
 
-static int prv_isWhiteSpace(uint8_t sign)
+#ifdef PRV_SIMD_WIDTH
+
+// Bit i of the returned masks is set when p[i] is a white space, or a quote or a backslash.
+#if PRV_SIMD_WIDTH == 32
+
+static uint32_t prv_spaceMask(const uint8_t * p)
 {
-    if (sign == 0x20
-     || sign == 0x09
-     || sign == 0x0A
-     || sign == 0x0D)
-    {
-        return 1;
-    }
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+    __m256i mask;
+
+    mask = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(0x20)),
+                                           _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(0x09))),
+                           _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(0x0A)),
+                                           _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(0x0D))));
+    return (uint32_t)_mm256_movemask_epi8(mask);
+}
 
-    return 0;
+static uint32_t prv_quoteMask(const uint8_t * p)
+{
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+    __m256i mask;
+
+    mask = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')),
+                           _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\')));
+    return (uint32_t)_mm256_movemask_epi8(mask);
 }
 
-static size_t prv_skipSpace(uint8_t * buffer,
+#else
+
+static uint32_t prv_spaceMask(const uint8_t * p)
+{
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    __m128i mask;
+
+    mask = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x20)),
+                                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x09))),
+                        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x0A)),
+                                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x0D))));
+    return (uint32_t)_mm_movemask_epi8(mask);
+}
+
+static uint32_t prv_quoteMask(const uint8_t * p)
+{
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    __m128i mask;
+
+    mask = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')),
+                        _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')));
+    return (uint32_t)_mm_movemask_epi8(mask);
+}
+
+#endif
+#endif
+
+static size_t prv_skipSpace(const uint8_t * buffer,
                             size_t bufferLen)
 {
     size_t i;
 
-    i = 0;
-    while ((i < bufferLen)
-        && prv_isWhiteSpace(buffer[i]))
+    // most separators are not followed by spaces at all
+    if (bufferLen == 0 || !prv_isWhiteSpace(buffer[0])) return 0;
+
+    i = 1;
+#ifdef PRV_SIMD_WIDTH
+    while (i + PRV_SIMD_WIDTH <= bufferLen)
+    {
+        uint32_t mask;
+
+        mask = ~prv_spaceMask(buffer + i) & PRV_SIMD_FULL_MASK;
+        if (mask != 0) return i + __builtin_ctz(mask);
+        i += PRV_SIMD_WIDTH;
+    }
+#endif
+    while (i < bufferLen && prv_isWhiteSpace(buffer[i]))
     {
         i++;
     }
@@ -139,262 +198,234 @@ static size_t prv_skipSpace(uint8_t * buffer,
     return i;
 }
 
-static int prv_split(uint8_t * buffer,
-                     size_t bufferLen,
-                     int * tokenStartP,
-                     int * tokenLenP,
-                     int * valueStartP,
-                     int * valueLenP)
+// buffer[index] is the first character of a quoted string.
+// Returns the index of the closing quote or bufferLen if there is none.
+// Escaped characters are skipped but not decoded.
+static size_t prv_findQuote(const uint8_t * buffer,
+                            size_t index,
+                            size_t bufferLen)
 {
-    size_t index;
-    _itemState step;
-
-    index = 0;
-    step = _STEP_START;
-
-    index = prv_skipSpace(buffer + index, bufferLen - index);
-    if (index == bufferLen) return -1;
-
-    while ((index < bufferLen)
-        && (buffer[index] != ','))
+    while (index < bufferLen)
     {
-        switch (step)
+#ifdef PRV_SIMD_WIDTH
+        if (index + PRV_SIMD_WIDTH <= bufferLen)
         {
-        case _STEP_START:
-            if (buffer[index] != '"') return -1;
-            *tokenStartP = index+1;
-            step = _STEP_TOKEN;
-            break;
+            uint32_t mask;
 
-        case _STEP_TOKEN:
-            if (buffer[index] == '"')
+            mask = prv_quoteMask(buffer + index);
+            if (mask == 0)
             {
-                *tokenLenP = index - *tokenStartP;
-                step = _STEP_ANY_SEPARATOR;
-            }
-            break;
-
-        case _STEP_ANY_SEPARATOR:
-            if (buffer[index] != ':') return -1;
-            step = _STEP_SEPARATOR;
-            break;
-
-        case _STEP_SEPARATOR:
-            if (buffer[index] == '"')
-            {
-                *valueStartP = index;
-                step = _STEP_QUOTED_VALUE;
-            } else if (!prv_isReserved(buffer[index]))
-            {
-                *valueStartP = index;
-                step = _STEP_VALUE;
-            } else
-            {
-                return -1;
+                index += PRV_SIMD_WIDTH;
+                continue;
             }
-            break;
+            index += __builtin_ctz(mask);
+        }
+#endif
+        if (buffer[index] == '"') return index;
+        if (buffer[index] == '\\') index++;
+        index++;
+    }
 
-        case _STEP_QUOTED_VALUE:
-            if (buffer[index] == '"' && buffer[index-1] != '\\' )
-            {
-                *valueLenP = index - *valueStartP + 1;
-                step = _STEP_DONE;
-            }
-            break;
+    return bufferLen;
+}
 
-        case _STEP_VALUE:
-            if (prv_isWhiteSpace(buffer[index]))
-            {
-                *valueLenP = index - *valueStartP;
-                step = _STEP_DONE;
-            }
-            break;
+// Reads a quoted string or a literal (number, true, false) at buffer[*indexP].
+// On return, *indexP points after the token.
+static int prv_readToken(const uint8_t * buffer,
+                         size_t bufferLen,
+                         size_t * indexP,
+                         uint8_t ** tokenP,
+                         size_t * tokenLenP,
+                         bool * isQuotedP)
+{
+    size_t index = *indexP;
 
-        case _STEP_DONE:
-        default:
-            return -1;
-        }
+    if (index >= bufferLen) return -1;
 
-        index++;
-        if (step == _STEP_START
-         || step == _STEP_ANY_SEPARATOR
-         || step == _STEP_SEPARATOR
-         || step == _STEP_DONE)
+    if (buffer[index] == '"')
+    {
+        size_t end;
+
+        end = prv_findQuote(buffer, index + 1, bufferLen);
+        if (end == bufferLen) return -1;
+        *tokenP = (uint8_t *)buffer + index + 1;
+        *tokenLenP = end - index - 1;
+        *isQuotedP = true;
+        *indexP = end + 1;
+    }
+    else
+    {
+        size_t end;
+
+        end = index;
+        while (end < bufferLen
+            && buffer[end] != ','
+            && buffer[end] != '}'
+            && buffer[end] != ']'
+            && !prv_isWhiteSpace(buffer[end]))
         {
-            index += prv_skipSpace(buffer + index, bufferLen - index);
+            end++;
         }
+        if (end == index) return -1;
+        *tokenP = (uint8_t *)buffer + index;
+        *tokenLenP = end - index;
+        *isQuotedP = false;
+        *indexP = end;
     }
 
-    if (step == _STEP_VALUE)
-    {
-        *valueLenP = index - *valueStartP;
-        step = _STEP_DONE;
-    }
+    return 0;
+}
 
-    if (step != _STEP_DONE) return -1;
+// Reads a key and the following colon. On return, *indexP points to the value.
+static int prv_readKey(const uint8_t * buffer,
+                       size_t bufferLen,
+                       size_t * indexP,
+                       uint8_t ** keyP,
+                       size_t * keyLenP)
+{
+    size_t index;
+    bool isQuoted;
+
+    index = *indexP;
+    index += prv_skipSpace(buffer + index, bufferLen - index);
+    if (index == bufferLen || buffer[index] != '"') return -1;
+    if (0 != prv_readToken(buffer, bufferLen, &index, keyP, keyLenP, &isQuoted)) return -1;
+    index += prv_skipSpace(buffer + index, bufferLen - index);
+    if (index == bufferLen || buffer[index] != ':') return -1;
+    index++;
+    index += prv_skipSpace(buffer + index, bufferLen - index);
+    if (index == bufferLen) return -1;
 
-    return (int)index;
+    *indexP = index;
+    return 0;
 }
 
-static int prv_countItems(uint8_t * buffer,
-                          size_t bufferLen)
+// Skips the separator after a value. Returns 1 if another item follows, 0 if the closing
+// character follows, -1 on error. On return, *indexP points after the separator.
+static int prv_nextItem(const uint8_t * buffer,
+                        size_t bufferLen,
+                        size_t * indexP,
+                        uint8_t closing)
 {
-    int count;
     size_t index;
-    int in;
 
-    count = 0;
-    index = 0;
-    in = 0;
+    index = *indexP;
+    index += prv_skipSpace(buffer + index, bufferLen - index);
+    if (index == bufferLen) return -1;
+    *indexP = index + 1;
+    if (buffer[index] == ',') return 1;
+    if (buffer[index] == closing) return 0;
 
-    while (index < bufferLen)
+    return -1;
+}
+
+// Parses a record name like "3/0/1" or "/3/0/1".
+static int prv_parseName(uint8_t * name,
+                         size_t nameLen,
+                         _record_t * recordP)
+{
+    size_t i;
+
+    i = 0;
+    if (nameLen > 0 && name[0] == '/') i++;
+    if (i == nameLen) return -1;
+
+    recordP->idCount = 0;
+    while (i < nameLen)
     {
-        if (in == 0)
+        uint32_t id;
+        size_t start;
+
+        if (recordP->idCount == 4) return -1;
+
+        id = 0;
+        start = i;
+        while (i < nameLen && name[i] != '/')
         {
-            if (buffer[index] != '{') return -1;
-            in = 1;
-            _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
+            if (name[i] < '0' || name[i] > '9') return -1;
+            id = id * 10 + (name[i] - '0');
+            if (id > LWM2M_MAX_ID) return -1;
+            i++;
         }
-        else
+        if (i == start) return -1;
+        recordP->ids[recordP->idCount] = (uint16_t)id;
+        recordP->idCount++;
+
+        if (i < nameLen)
         {
-            if (buffer[index] == '{') return -1;
-            if (buffer[index] == '}')
-            {
-                in = 0;
-                count++;
-                _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-                if (buffer[index] == ']')
-                {
-                    break;
-                }
-                if (buffer[index] != ',') return -1;
-                _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-            }
-            else
-            {
-                _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-            }
+            // skip the slash, a trailing one is not allowed
+            i++;
+            if (i == nameLen) return -1;
         }
     }
-    if (in == 1) return -1;
 
-    return count;
-
-error:
-    return -1;
+    return 0;
 }
 
-static int prv_parseItem(uint8_t * buffer,
-                         size_t bufferLen,
-                         _record_t * recordP)
+// buffer[*indexP] is the opening brace of a record.
+static int prv_parseRecord(const uint8_t * buffer,
+                           size_t bufferLen,
+                           size_t * indexP,
+                           _record_t * recordP)
 {
     size_t index;
+    bool nameFound;
+    int res;
 
-    memset(recordP->ids, 0xFF, 4*sizeof(uint16_t));
-    recordP->type = _TYPE_UNSET;
-    recordP->value = NULL;
-    recordP->valueLen = 0;
+    memset(recordP, 0, sizeof(_record_t));
+    nameFound = false;
+    index = *indexP + 1;
 
-    index = 0;
     do
     {
-        int tokenStart;
-        int tokenLen;
-        int valueStart;
-        int valueLen;
-        int next;
-
-        next = prv_split(buffer+index, bufferLen-index, &tokenStart, &tokenLen, &valueStart, &valueLen);
-        if (next < 0) return -1;
-
-        switch (tokenLen)
-        {
-        case 1:
+        uint8_t * key;
+        size_t keyLen;
+        uint8_t * value;
+        size_t valueLen;
+        bool isQuoted;
+        _type type;
+
+        if (0 != prv_readKey(buffer, bufferLen, &index, &key, &keyLen)) return -1;
+        if (0 != prv_readToken(buffer, bufferLen, &index, &value, &valueLen, &isQuoted)) return -1;
+
+        type = _TYPE_UNSET;
+        if (keyLen == 1)
         {
-            switch (buffer[index+tokenStart])
+            switch (key[0])
             {
             case 'n':
-            {
-                int i;
-                int j;
-
-                if (recordP->ids[0] != LWM2M_MAX_ID) return -1;
-
-                // Check for " around URI
-                if (valueLen < 3
-                 || buffer[index+valueStart] != '"'
-                 || buffer[index+valueStart+valueLen-1] != '"')
-                {
-                    return -1;
-                }
-                // Ignore starting /
-                if (buffer[index + valueStart + 1] == '/')
-                {
-                    if (valueLen < 4)
-                    {
-                        return -1;
-                    }
-                    valueStart += 1;
-                    valueLen -= 1;
-                }
-                i = 0;
-                j = 0;
-                do {
-                    uint32_t readId;
-
-                    readId = 0;
-                    i++;
-                    while (i < valueLen-1 && buffer[index+valueStart+i] != '/')
-                    {
-                        if (buffer[index+valueStart+i] < '0'
-                         || buffer[index+valueStart+i] > '9')
-                        {
-                            return -1;
-                        }
-                        readId *= 10;
-                        readId += buffer[index+valueStart+i] - '0';
-                        if (readId > LWM2M_MAX_ID) return -1;
-                        i++;
-                    }
-                    recordP->ids[j] = readId;
-                    j++;
-                } while (i < valueLen-1 && j < 4 && buffer[index+valueStart+i] == '/');
-                if (i < valueLen-1 ) return -1;
-            }
-            break;
+                if (nameFound || !isQuoted) return -1;
+                if (0 != prv_parseName(value, valueLen, recordP)) return -1;
+                nameFound = true;
+                break;
 
             case 'v':
-                if (recordP->type != _TYPE_UNSET) return -1;
-                recordP->type = _TYPE_FLOAT;
-                recordP->value = buffer + index + valueStart;
-                recordP->valueLen = valueLen;
+                if (isQuoted) return -1;
+                type = _TYPE_FLOAT;
                 break;
 
             case 't':
-                // TODO: support time
+                // time is ignored
+                if (isQuoted) return -1;
                 break;
 
             default:
                 return -1;
             }
         }
-        break;
-
-        case 2:
+        else if (keyLen == 2 && key[1] == 'v')
         {
-            // "bv", "ov", or "sv"
-            if (buffer[index+tokenStart+1] != 'v') return -1;
-            switch (buffer[index+tokenStart])
+            switch (key[0])
             {
             case 'b':
-                if (recordP->type != _TYPE_UNSET) return -1;
-                if (0 == lwm2m_strncmp(JSON_TRUE_STRING, (char *)buffer + index + valueStart, valueLen))
+                if (isQuoted) return -1;
+                if (valueLen == 4 && 0 == memcmp(value, JSON_TRUE_STRING, 4))
                 {
-                    recordP->type = _TYPE_TRUE;
+                    type = _TYPE_TRUE;
                 }
-                else if (0 == lwm2m_strncmp(JSON_FALSE_STRING, (char *)buffer + index + valueStart, valueLen))
+                else if (valueLen == 5 && 0 == memcmp(value, JSON_FALSE_STRING, 5))
                 {
-                    recordP->type = _TYPE_FALSE;
+                    type = _TYPE_FALSE;
                 }
                 else
                 {
@@ -402,41 +433,66 @@ static int prv_parseItem(uint8_t * buffer,
                 }
                 break;
 
-            case 'o':
-                if (recordP->type != _TYPE_UNSET) return -1;
-                // TODO: support object link
+            case 's':
+                if (!isQuoted) return -1;
+                type = _TYPE_STRING;
                 break;
 
-            case 's':
-                if (recordP->type != _TYPE_UNSET) return -1;
-                // Check for " around value
-                if (valueLen < 2
-                 || buffer[index+valueStart] != '"'
-                 || buffer[index+valueStart+valueLen-1] != '"')
-                {
-                    return -1;
-                }
-                recordP->type = _TYPE_STRING;
-                recordP->value = buffer + index + valueStart + 1;
-                recordP->valueLen = valueLen - 2;
+            case 'o':
+                if (!isQuoted) return -1;
+                type = _TYPE_OBJECT_LINK;
                 break;
 
             default:
                 return -1;
             }
         }
-        break;
-
-        default:
+        else
+        {
             return -1;
         }
 
-        index += next + 1;
-    } while (index < bufferLen);
+        if (type != _TYPE_UNSET)
+        {
+            // only one value per record
+            if (recordP->type != _TYPE_UNSET) return -1;
+            recordP->type = type;
+            recordP->value = value;
+            recordP->valueLen = valueLen;
+        }
+
+        res = prv_nextItem(buffer, bufferLen, &index, '}');
+    } while (res == 1);
 
+    if (res != 0 || recordP->type == _TYPE_UNSET) return -1;
+
+    *indexP = index;
     return 0;
 }
 
+static int prv_parseObjectLinkId(uint8_t * buffer,
+                                 size_t length,
+                                 uint16_t * idP)
+{
+    int64_t value;
+
+    // the null link may be written in hexadecimal
+    if (length == 4 && 0 == memcmp(buffer, "FFFF", 4))
+    {
+        *idP = LWM2M_MAX_ID;
+        return 1;
+    }
+    if (1 != utils_textToInt(buffer, length, &value)
+     || value < 0
+     || value > LWM2M_MAX_ID)
+    {
+        return 0;
+    }
+    *idP = (uint16_t)value;
+
+    return 1;
+}
+
 static bool prv_convertValue(_record_t * recordP,
                              lwm2m_data_t * targetP)
 {
@@ -454,7 +510,9 @@ static bool prv_convertValue(_record_t * recordP,
 
         i = 0;
         while (i < recordP->valueLen
-            && recordP->value[i] != '.')
+            && recordP->value[i] != '.'
+            && recordP->value[i] != 'e'
+            && recordP->value[i] != 'E')
         {
             i++;
         }
@@ -492,723 +550,315 @@ static bool prv_convertValue(_record_t * recordP,
         targetP->type = LWM2M_TYPE_STRING;
         break;
 
-    case _TYPE_UNSET:
-    default:
-        return false;
-    }
-
-    return true;
-}
-
-static lwm2m_data_t * prv_findDataItem(lwm2m_data_t * listP,
-                                       int count,
-                                       uint16_t id)
-{
-    int i;
-
-    i = 0;
-    while (i < count)
+    case _TYPE_OBJECT_LINK:
     {
-        if (listP[i].type != LWM2M_TYPE_UNDEFINED && listP[i].id == id)
+        uint16_t objectId;
+        uint16_t objectInstanceId;
+        size_t i;
+
+        i = 0;
+        while (i < recordP->valueLen && recordP->value[i] != ':')
         {
-            return listP + i;
+            i++;
         }
-        i++;
+        if (i == recordP->valueLen
+         || 1 != prv_parseObjectLinkId(recordP->value, i, &objectId)
+         || 1 != prv_parseObjectLinkId(recordP->value + i + 1, recordP->valueLen - i - 1, &objectInstanceId))
+        {
+            return false;
+        }
+        lwm2m_data_encode_objlink(objectId, objectInstanceId, targetP);
     }
+    break;
 
-    return NULL;
-}
-
-static uri_depth_t prv_decreaseLevel(uri_depth_t level)
-{
-    switch(level)
-    {
-    case URI_DEPTH_OBJECT:
-        return URI_DEPTH_OBJECT_INSTANCE;
-    case URI_DEPTH_OBJECT_INSTANCE:
-        return URI_DEPTH_RESOURCE;
-    case URI_DEPTH_RESOURCE:
-        return URI_DEPTH_RESOURCE_INSTANCE;
-    case URI_DEPTH_RESOURCE_INSTANCE:
-        return URI_DEPTH_RESOURCE_INSTANCE;
+    case _TYPE_UNSET:
     default:
-        return URI_DEPTH_RESOURCE;
+        return false;
     }
+
+    return true;
 }
 
-static lwm2m_data_t * prv_extendData(lwm2m_data_t * parentP)
+static void prv_clearValue(lwm2m_data_t * dataP)
 {
-    lwm2m_data_t * newP;
-
-    newP = lwm2m_data_new(parentP->value.asChildren.count + 1);
-    if (newP == NULL) return NULL;
-    if (parentP->value.asChildren.array != NULL)
+    if ((dataP->type == LWM2M_TYPE_STRING || dataP->type == LWM2M_TYPE_OPAQUE)
+     && dataP->value.asBuffer.buffer != NULL)
     {
-        memcpy(newP, parentP->value.asChildren.array, parentP->value.asChildren.count * sizeof(lwm2m_data_t));
-        lwm2m_free(parentP->value.asChildren.array);     // do not use lwm2m_data_free() to keep pointed values
+        lwm2m_free(dataP->value.asBuffer.buffer);
     }
-    parentP->value.asChildren.array = newP;
-    parentP->value.asChildren.count += 1;
-
-    return newP + parentP->value.asChildren.count - 1;
+    memset(&(dataP->value), 0, sizeof(dataP->value));
+    dataP->type = LWM2M_TYPE_UNDEFINED;
 }
 
-static int prv_convertRecord(lwm2m_uri_t * uriP,
-                             _record_t * recordArray,
-                             int count,
-                             lwm2m_data_t ** dataP)
+// Inserts the record in the tree below rootP. Intermediate nodes are typed
+// PRV_TYPE_CONTAINER until their depth is known.
+static int prv_addRecord(lwm2m_data_t * rootP,
+                         _record_t * recordP)
 {
-    int index;
-    int freeIndex;
-    lwm2m_data_t * rootP;
-    int size;
-    uri_depth_t rootLevel;
-
-    if (uriP == NULL)
-    {
-        size = count;
-        *dataP = lwm2m_data_new(count);
-        if (NULL == *dataP) return -1;
-        rootLevel = URI_DEPTH_OBJECT;
-        rootP = *dataP;
-    }
-    else
-    {
-        lwm2m_data_t * parentP;
-        size = 1;
-
-        *dataP = lwm2m_data_new(1);
-        if (NULL == *dataP) return -1;
-        (*dataP)->type = LWM2M_TYPE_OBJECT;
-        (*dataP)->id = uriP->objectId;
-        rootLevel = URI_DEPTH_OBJECT_INSTANCE;
-        parentP = *dataP;
-        if (LWM2M_URI_IS_SET_INSTANCE(uriP))
-        {
-            parentP->value.asChildren.count = 1;
-            parentP->value.asChildren.array = lwm2m_data_new(1);
-            if (NULL == parentP->value.asChildren.array) goto error;
-            parentP = parentP->value.asChildren.array;
-            parentP->type = LWM2M_TYPE_OBJECT_INSTANCE;
-            parentP->id = uriP->instanceId;
-            rootLevel = URI_DEPTH_RESOURCE;
-            if (LWM2M_URI_IS_SET_RESOURCE(uriP))
-            {
-                parentP->value.asChildren.count = 1;
-                parentP->value.asChildren.array = lwm2m_data_new(1);
-                if (NULL == parentP->value.asChildren.array) goto error;
-                parentP = parentP->value.asChildren.array;
-                parentP->type = LWM2M_TYPE_UNDEFINED;
-                parentP->id = uriP->resourceId;
-                rootLevel = URI_DEPTH_RESOURCE_INSTANCE;
-            }
-        }
-        parentP->value.asChildren.count = count;
-        parentP->value.asChildren.array = lwm2m_data_new(count);
-        if (NULL == parentP->value.asChildren.array) goto error;
-        rootP = parentP->value.asChildren.array;
-    }
+    lwm2m_data_t * parentP;
+    lwm2m_data_t * targetP;
+    int i;
 
-    freeIndex = 0;
-    for (index = 0 ; index < count ; index++)
+    parentP = rootP;
+    targetP = NULL;
+    for (i = 0 ; i < recordP->idCount ; i++)
     {
-        lwm2m_data_t * targetP;
-        int resSegmentIndex;
-        int i;
-
-        // check URI depth
-        // resSegmentIndex is set to the resource segment position
-        switch(rootLevel)
-        {
-        case URI_DEPTH_OBJECT:
-            resSegmentIndex = 2;
-            break;
-        case URI_DEPTH_OBJECT_INSTANCE:
-            resSegmentIndex = 1;
-            break;
-        case URI_DEPTH_RESOURCE:
-            resSegmentIndex = 0;
-            break;
-        case URI_DEPTH_RESOURCE_INSTANCE:
-            resSegmentIndex = -1;
-            break;
-        default:
-            goto error;
-        }
-        for (i = 0 ; i <= resSegmentIndex ; i++)
-        {
-            if (recordArray[index].ids[i] == LWM2M_MAX_ID) goto error;
-        }
-        if (resSegmentIndex < 2)
-        {
-            if (recordArray[index].ids[resSegmentIndex + 2] != LWM2M_MAX_ID) goto error;
-        }
+        bool isLeaf = (i == recordP->idCount - 1);
 
-        targetP = prv_findDataItem(rootP, count, recordArray[index].ids[0]);
+        targetP = data_findChild(parentP, recordP->ids[i]);
         if (targetP == NULL)
         {
-            targetP = rootP + freeIndex;
-            freeIndex++;
-            targetP->id = recordArray[index].ids[0];
-            targetP->type = utils_depthToDatatype(rootLevel);
+            targetP = data_addChild(parentP, recordP->ids[i]);
+            if (targetP == NULL) return -1;
+            if (!isLeaf) targetP->type = PRV_TYPE_CONTAINER;
         }
-        if (recordArray[index].ids[1] != LWM2M_MAX_ID)
+        else if (isLeaf)
         {
-            lwm2m_data_t * parentP;
-            uri_depth_t level;
-
-            parentP = targetP;
-            level = prv_decreaseLevel(rootLevel);
-            for (i = 1 ; i <= resSegmentIndex ; i++)
-            {
-                targetP = prv_findDataItem(parentP->value.asChildren.array, parentP->value.asChildren.count, recordArray[index].ids[i]);
-                if (targetP == NULL)
-                {
-                    targetP = prv_extendData(parentP);
-                    if (targetP == NULL) goto error;
-                    targetP->id = recordArray[index].ids[i];
-                    targetP->type = utils_depthToDatatype(level);
-                }
-                level = prv_decreaseLevel(level);
-                parentP = targetP;
-            }
-            if (recordArray[index].ids[resSegmentIndex + 1] != LWM2M_MAX_ID)
-            {
-                targetP->type = LWM2M_TYPE_MULTIPLE_RESOURCE;
-                targetP = prv_extendData(targetP);
-                if (targetP == NULL) goto error;
-                targetP->id = recordArray[index].ids[resSegmentIndex + 1];
-                targetP->type = LWM2M_TYPE_UNDEFINED;
-            }
-        }
-
-        if (true != prv_convertValue(recordArray + index, targetP)) goto error;
-    }
-
-    return size;
-
-error:
-    lwm2m_data_free(size, *dataP);
-    *dataP = NULL;
-
-    return -1;
-}
-
-static int prv_dataStrip(int size,
-                         lwm2m_data_t * dataP,
-                         lwm2m_data_t ** resultP)
-{
-    int i;
-    int j;
-    int realSize;
-
-    realSize = 0;
-    for (i = 0 ; i < size ; i++)
-    {
-        if (dataP[i].type != LWM2M_TYPE_UNDEFINED)
-        {
-            realSize++;
+            // a later record overrides the previous value
+            if (targetP->type == PRV_TYPE_CONTAINER) return -1;
+            prv_clearValue(targetP);
         }
-    }
-
-    *resultP = lwm2m_data_new(realSize);
-    if (*resultP == NULL) return -1;
-
-    j = 0;
-    for (i = 0 ; i < size ; i++)
-    {
-        if (dataP[i].type != LWM2M_TYPE_UNDEFINED)
+        else if (targetP->type != PRV_TYPE_CONTAINER)
         {
-            memcpy((*resultP) + j, dataP + i, sizeof(lwm2m_data_t));
-
-            if (dataP[i].type == LWM2M_TYPE_OBJECT
-             || dataP[i].type == LWM2M_TYPE_OBJECT_INSTANCE
-             || dataP[i].type == LWM2M_TYPE_MULTIPLE_RESOURCE)
-            {
-                int childLen;
-
-                childLen = prv_dataStrip(dataP[i].value.asChildren.count, dataP[i].value.asChildren.array, &((*resultP)[j].value.asChildren.array));
-                if (childLen <= 0)
-                {
-                    // skip this one
-                    j--;
-                }
-                else
-                {
-                    (*resultP)[j].value.asChildren.count = childLen;
-                }
-            }
-            else
-            {
-                dataP[i].value.asBuffer.buffer = NULL;
-            }
-
-            j++;
+            return -1;
         }
+        parentP = targetP;
     }
 
-    return realSize;
+    return prv_convertValue(recordP, targetP) ? 0 : -1;
 }
 
-int json_parse(lwm2m_uri_t * uriP,
-               uint8_t * buffer,
-               size_t bufferLen,
-               lwm2m_data_t ** dataP)
+// Sets the type of the containers from their depth and checks the resources are where they belong.
+static bool prv_setTypes(lwm2m_data_t * dataP,
+                         size_t count,
+                         int depth)
 {
-    size_t index;
-    int count = 0;
-    bool eFound = false;
-    bool bnFound = false;
-    bool btFound = false;
-    int bnStart;
-    int bnLen;
-    _record_t * recordArray;
-    lwm2m_data_t * parsedP;
-
-    LOG_ARG("bufferLen: %d, buffer: \"%s\"", bufferLen, (char *)buffer);
-    LOG_URI(uriP);
-    *dataP = NULL;
-    recordArray = NULL;
-    parsedP = NULL;
-
-    index = prv_skipSpace(buffer, bufferLen);
-    if (index == bufferLen) return -1;
+    size_t i;
 
-    if (buffer[index] != '{') return -1;
-    do
+    for (i = 0 ; i < count ; i++)
     {
-        _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-        if (buffer[index] != '"') goto error;
-        if (index++ >= bufferLen) goto error;
-        switch (buffer[index])
-        {
-        case 'e':
+        if (dataP[i].type == PRV_TYPE_CONTAINER)
         {
-            int recordIndex;
-
-            if (bufferLen-index < JSON_MIN_ARRAY_LEN) goto error;
-            index++;
-            if (buffer[index] != '"') goto error;
-            if (eFound == true) goto error;
-            eFound = true;
-
-            _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-            if (buffer[index] != ':') goto error;
-            _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-            if (buffer[index] != '[') goto error;
-            _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-            count = prv_countItems(buffer + index, bufferLen - index);
-            if (count <= 0) goto error;
-            recordArray = (_record_t*)lwm2m_malloc(count * sizeof(_record_t));
-            if (recordArray == NULL) goto error;
-            // at this point we are sure buffer[index] is '{' and all { and } are matching
-            recordIndex = 0;
-            while (recordIndex < count)
-            {
-                int itemLen;
-
-                if (buffer[index] != '{') goto error;
-                itemLen = 0;
-                while (buffer[index + itemLen] != '}') itemLen++;
-                if (0 != prv_parseItem(buffer + index + 1, itemLen - 1, recordArray + recordIndex))
-                {
-                    goto error;
-                }
-                recordIndex++;
-                index += itemLen;
-                _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-                switch (buffer[index])
-                {
-                case ',':
-                    _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-                    break;
-                case ']':
-                    if (recordIndex == count) break;
-                    // else this is an error
-                default:
-                    goto error;
-                }
-            }
-            if (buffer[index] != ']') goto error;
-        }
-        break;
-
-        case 'b':
-            if (bufferLen-index < JSON_MIN_BX_LEN) goto error;
-            index++;
-            switch (buffer[index])
+            switch (depth)
             {
-            case 't':
-                index++;
-                if (buffer[index] != '"') goto error;
-                if (btFound == true) goto error;
-                btFound = true;
-
-                // TODO: handle timed values
-                // temp: skip this token
-                while(index < bufferLen && buffer[index] != ',' && buffer[index] != '}') index++;
-                if (index == bufferLen) goto error;
-                index--;
-                // end temp
+            case 0:
+                dataP[i].type = LWM2M_TYPE_OBJECT;
                 break;
-            case 'n':
-                {
-                    int next;
-                    int tokenStart;
-                    int tokenLen;
-                    int itemLen;
-
-                    index++;
-                    if (buffer[index] != '"') goto error;
-                    if (bnFound == true) goto error;
-                    bnFound = true;
-                    index -= 3;
-                    itemLen = 0;
-                    while (buffer[index + itemLen] != '}'
-                        && buffer[index + itemLen] != ','
-                        && index + itemLen < bufferLen)
-                    {
-                        itemLen++;
-                    }
-                    if (index + itemLen == bufferLen) goto error;
-                    next = prv_split(buffer+index, itemLen, &tokenStart, &tokenLen, &bnStart, &bnLen);
-                    if (next < 0) goto error;
-                    bnStart += index;
-                    index += next - 1;
-                }
+            case 1:
+                dataP[i].type = LWM2M_TYPE_OBJECT_INSTANCE;
+                break;
+            case 2:
+                dataP[i].type = LWM2M_TYPE_MULTIPLE_RESOURCE;
                 break;
             default:
-                goto error;
-            }
-            break;
-
-        default:
-            goto error;
-        }
-
-        _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-    } while (buffer[index] == ',');
-
-    if (buffer[index] != '}') goto error;
-
-    if (eFound == true)
-    {
-        lwm2m_uri_t baseURI;
-        lwm2m_uri_t * baseUriP;
-        lwm2m_data_t * resultP;
-        int size;
-
-        memset(&baseURI, 0, sizeof(lwm2m_uri_t));
-        if (bnFound == false)
-        {
-            baseUriP = uriP;
-        }
-        else
-        {
-            int res;
-
-            // we ignore the request URI and use the bn one.
-
-            // Check for " around URI
-            if (bnLen < 3
-             || buffer[bnStart] != '"'
-             || buffer[bnStart+bnLen-1] != '"')
-            {
-                goto error;
-            }
-            bnStart += 1;
-            bnLen -= 2;
-
-            if (bnLen == 1)
-            {
-                if (buffer[bnStart] != '/') goto error;
-                baseUriP = NULL;
-            }
-            else
-            {
-                res = lwm2m_stringToUri((char *)buffer + bnStart, bnLen, &baseURI);
-                if (res < 0 || res != bnLen) goto error;
-                baseUriP = &baseURI;
-            }
-        }
-
-        count = prv_convertRecord(baseUriP, recordArray, count, &parsedP);
-        lwm2m_free(recordArray);
-        recordArray = NULL;
-
-        if (count > 0 && uriP != NULL)
-        {
-            if (parsedP->type != LWM2M_TYPE_OBJECT || parsedP->id != uriP->objectId) goto error;
-            if (!LWM2M_URI_IS_SET_INSTANCE(uriP))
-            {
-                size = parsedP->value.asChildren.count;
-                resultP = parsedP->value.asChildren.array;
-            }
-            else
-            {
-                int i;
-
-                resultP = NULL;
-                // be permissive and allow full object JSON when requesting for a single instance
-                for (i = 0 ; i < (int)parsedP->value.asChildren.count && resultP == NULL; i++)
-                {
-                    lwm2m_data_t * targetP;
-
-                    targetP = parsedP->value.asChildren.array + i;
-                    if (targetP->id == uriP->instanceId)
-                    {
-                        resultP = targetP->value.asChildren.array;
-                        size = targetP->value.asChildren.count;
-                    }
-                }
-                if (resultP == NULL) goto error;
-                if (LWM2M_URI_IS_SET_RESOURCE(uriP))
-                {
-                    lwm2m_data_t * resP;
-
-                    resP = NULL;
-                    for (i = 0 ; i < size && resP == NULL; i++)
-                    {
-                        lwm2m_data_t * targetP;
-
-                        targetP = resultP + i;
-                        if (targetP->id == uriP->resourceId)
-                        {
-                            if (targetP->type == LWM2M_TYPE_MULTIPLE_RESOURCE)
-                            {
-                                resP = targetP->value.asChildren.array;
-                                size = targetP->value.asChildren.count;
-                            }
-                            else
-                            {
-                                size = prv_dataStrip(1, targetP, &resP);
-                                if (size <= 0) goto error;
-                                lwm2m_data_free(count, parsedP);
-                                parsedP = NULL;
-                            }
-                        }
-                    }
-                    if (resP == NULL) goto error;
-                    resultP = resP;
-                }
+                return false;
             }
+            if (!prv_setTypes(dataP[i].value.asChildren.array, dataP[i].value.asChildren.count, depth + 1)) return false;
         }
-        else
-        {
-            resultP = parsedP;
-            size = count;
-        }
-
-        if (parsedP != NULL)
+        else if (depth != 2 && depth != 3)
         {
-            lwm2m_data_t * tempP;
-
-            size = prv_dataStrip(size, resultP, &tempP);
-            if (size <= 0) goto error;
-            lwm2m_data_free(count, parsedP);
-            resultP = tempP;
+            return false;
         }
-        count = size;
-        *dataP = resultP;
-    }
-
-    LOG_ARG("Parsing successful. count: %d", count);
-    return count;
-
-error:
-    LOG("Parsing failed");
-    if (parsedP != NULL)
-    {
-        lwm2m_data_free(count, parsedP);
-        parsedP = NULL;
-    }
-    if (recordArray != NULL)
-    {
-        lwm2m_free(recordArray);
     }
-    return -1;
+
+    return true;
 }
 
-static int prv_serializeValue(lwm2m_data_t * tlvP,
-                              uint8_t * buffer,
-                              size_t bufferLen)
+int json_parse(lwm2m_uri_t * uriP,
+               uint8_t * buffer,
+               size_t bufferLen,
+               lwm2m_data_t ** dataP)
 {
+    size_t index;
+    bool eFound = false;
+    bool bnFound = false;
+    bool btFound = false;
+    uint8_t * bnP = NULL;
+    size_t bnLen = 0;
+    lwm2m_data_t root;
+    lwm2m_data_t baseValue;
+    bool hasBaseValue = false;
+    uint16_t baseIds[3];
+    int baseCount;
+    lwm2m_data_t * topP = NULL;
+    size_t topCount = 0;
     int res;
-    int head;
-
-    switch (tlvP->type)
-    {
-    case LWM2M_TYPE_STRING:
-        if (bufferLen < JSON_ITEM_STRING_BEGIN_SIZE) return -1;
-        memcpy(buffer, JSON_ITEM_STRING_BEGIN, JSON_ITEM_STRING_BEGIN_SIZE);
-        head = JSON_ITEM_STRING_BEGIN_SIZE;
-
-        if (bufferLen - head < tlvP->value.asBuffer.length) return -1;
-        memcpy(buffer + head, tlvP->value.asBuffer.buffer, tlvP->value.asBuffer.length);
-        head += tlvP->value.asBuffer.length;
 
-        if (bufferLen - head < JSON_ITEM_STRING_END_SIZE) return -1;
-        memcpy(buffer + head, JSON_ITEM_STRING_END, JSON_ITEM_STRING_END_SIZE);
-        head += JSON_ITEM_STRING_END_SIZE;
-
-        break;
-
-    case LWM2M_TYPE_INTEGER:
-    {
-        int64_t value;
-
-        if (0 == lwm2m_data_decode_int(tlvP, &value)) return -1;
-
-        if (bufferLen < JSON_ITEM_NUM_SIZE) return -1;
-        memcpy(buffer, JSON_ITEM_NUM, JSON_ITEM_NUM_SIZE);
-        head = JSON_ITEM_NUM_SIZE;
+    LOG_ARG("bufferLen: %d, buffer: \"%s\"", bufferLen, (char *)buffer);
+    LOG_URI(uriP);
+    *dataP = NULL;
 
-        res = utils_intToText(value, buffer + head, bufferLen - head);
-        if (res <= 0) return -1;
-        head += res;
+    // The records are added to the tree as they are read, relatively to the base name which may come last.
+    memset(&root, 0, sizeof(lwm2m_data_t));
+    root.type = PRV_TYPE_CONTAINER;
+    memset(&baseValue, 0, sizeof(lwm2m_data_t));
 
-        if (bufferLen - head < JSON_ITEM_NUM_END_SIZE) return -1;
-        memcpy(buffer + head, JSON_ITEM_NUM_END, JSON_ITEM_NUM_END_SIZE);
-        head += JSON_ITEM_NUM_END_SIZE;
-    }
-    break;
+    index = prv_skipSpace(buffer, bufferLen);
+    if (index == bufferLen || buffer[index] != '{') return -1;
+    index++;
 
-    case LWM2M_TYPE_FLOAT:
+    do
     {
-        double value;
+        uint8_t * key;
+        size_t keyLen;
 
-        if (0 == lwm2m_data_decode_float(tlvP, &value)) return -1;
+        if (0 != prv_readKey(buffer, bufferLen, &index, &key, &keyLen)) goto error;
 
-        if (bufferLen < JSON_ITEM_NUM_SIZE) return -1;
-        memcpy(buffer, JSON_ITEM_NUM, JSON_ITEM_NUM_SIZE);
-        head = JSON_ITEM_NUM_SIZE;
+        if (keyLen == 1 && key[0] == 'e')
+        {
+            if (eFound || buffer[index] != '[') goto error;
+            eFound = true;
+            index++;
 
-        res = utils_floatToText(value, buffer + head, bufferLen - head);
-        if (res <= 0) return -1;
-        head += res;
+            do
+            {
+                _record_t record;
 
-        if (bufferLen - head < JSON_ITEM_NUM_END_SIZE) return -1;
-        memcpy(buffer + head, JSON_ITEM_NUM_END, JSON_ITEM_NUM_END_SIZE);
-        head += JSON_ITEM_NUM_END_SIZE;
-    }
-    break;
+                index += prv_skipSpace(buffer + index, bufferLen - index);
+                if (index == bufferLen || buffer[index] != '{') goto error;
+                if (0 != prv_parseRecord(buffer, bufferLen, &index, &record)) goto error;
 
-    case LWM2M_TYPE_BOOLEAN:
-    {
-        bool value;
+                if (record.idCount == 0)
+                {
+                    // the record is the base name itself
+                    if (hasBaseValue) prv_clearValue(&baseValue);
+                    hasBaseValue = true;
+                    if (!prv_convertValue(&record, &baseValue)) goto error;
+                }
+                else if (0 != prv_addRecord(&root, &record))
+                {
+                    goto error;
+                }
 
-        if (0 == lwm2m_data_decode_bool(tlvP, &value)) return -1;
+                res = prv_nextItem(buffer, bufferLen, &index, ']');
+            } while (res == 1);
+            if (res != 0) goto error;
+        }
+        else if (keyLen == 2 && key[0] == 'b' && key[1] == 'n')
+        {
+            bool isQuoted;
 
-        if (value == true)
+            if (bnFound) goto error;
+            bnFound = true;
+            if (0 != prv_readToken(buffer, bufferLen, &index, &bnP, &bnLen, &isQuoted)
+             || !isQuoted)
+            {
+                goto error;
+            }
+        }
+        else if (keyLen == 2 && key[0] == 'b' && key[1] == 't')
         {
-            if (bufferLen < JSON_ITEM_BOOL_TRUE_SIZE) return -1;
-            memcpy(buffer, JSON_ITEM_BOOL_TRUE, JSON_ITEM_BOOL_TRUE_SIZE);
-            head = JSON_ITEM_BOOL_TRUE_SIZE;
+            uint8_t * value;
+            size_t valueLen;
+            bool isQuoted;
+
+            // base time is ignored
+            if (btFound) goto error;
+            btFound = true;
+            if (0 != prv_readToken(buffer, bufferLen, &index, &value, &valueLen, &isQuoted)
+             || isQuoted)
+            {
+                goto error;
+            }
         }
         else
         {
-            if (bufferLen < JSON_ITEM_BOOL_FALSE_SIZE) return -1;
-            memcpy(buffer, JSON_ITEM_BOOL_FALSE, JSON_ITEM_BOOL_FALSE_SIZE);
-            head = JSON_ITEM_BOOL_FALSE_SIZE;
+            goto error;
         }
-    }
-    break;
-
-    case LWM2M_TYPE_OPAQUE:
-        if (bufferLen < JSON_ITEM_STRING_BEGIN_SIZE) return -1;
-        memcpy(buffer, JSON_ITEM_STRING_BEGIN, JSON_ITEM_STRING_BEGIN_SIZE);
-        head = JSON_ITEM_STRING_BEGIN_SIZE;
 
-        res = utils_base64Encode(tlvP->value.asBuffer.buffer, tlvP->value.asBuffer.length, buffer+head, bufferLen - head);
-        if (res == 0) return -1;
-        head += res;
+        res = prv_nextItem(buffer, bufferLen, &index, '}');
+    } while (res == 1);
+    if (res != 0) goto error;
 
-        if (bufferLen - head < JSON_ITEM_STRING_END_SIZE) return -1;
-        memcpy(buffer + head, JSON_ITEM_STRING_END, JSON_ITEM_STRING_END_SIZE);
-        head += JSON_ITEM_STRING_END_SIZE;
-        break;
+    if (!eFound) return 0;
+    if (root.value.asChildren.count == 0 && !hasBaseValue) goto error;
 
-    case LWM2M_TYPE_OBJECT_LINK:
-        // TODO: implement
-        return -1;
+    // Resolve the base name
+    baseCount = 0;
+    if (bnFound)
+    {
+        if (bnLen != 1 || bnP[0] != '/')
+        {
+            lwm2m_uri_t baseUri;
 
-    default:
-        return -1;
+            res = lwm2m_stringToUri((char *)bnP, bnLen, &baseUri);
+            if (res <= 0 || (size_t)res != bnLen) goto error;
+            baseIds[baseCount++] = baseUri.objectId;
+            if (LWM2M_URI_IS_SET_INSTANCE(&baseUri)) baseIds[baseCount++] = baseUri.instanceId;
+            if (LWM2M_URI_IS_SET_RESOURCE(&baseUri)) baseIds[baseCount++] = baseUri.resourceId;
+        }
+    }
+    else if (uriP != NULL)
+    {
+        baseIds[baseCount++] = uriP->objectId;
+        if (LWM2M_URI_IS_SET_INSTANCE(uriP)) baseIds[baseCount++] = uriP->instanceId;
+        if (LWM2M_URI_IS_SET_RESOURCE(uriP)) baseIds[baseCount++] = uriP->resourceId;
     }
 
-    return head;
-}
-
-int prv_serializeData(lwm2m_data_t * tlvP,
-                      uint8_t * parentUriStr,
-                      size_t parentUriLen,
-                      uint8_t * buffer,
-                      size_t bufferLen)
-{
-    int head;
-    int res;
-
-    head = 0;
-
-    switch (tlvP->type)
+    // Build the objects level above the records
+    if (baseCount == 0)
     {
-    case LWM2M_TYPE_OBJECT:
-    case LWM2M_TYPE_OBJECT_INSTANCE:
-    case LWM2M_TYPE_MULTIPLE_RESOURCE:
+        if (hasBaseValue) goto error;
+        topP = root.value.asChildren.array;
+        topCount = root.value.asChildren.count;
+        root.value.asChildren.array = NULL;
+        root.value.asChildren.count = 0;
+    }
+    else
     {
-        uint8_t uriStr[URI_MAX_STRING_LEN];
-        size_t uriLen;
-        size_t index;
+        if (hasBaseValue && root.value.asChildren.count != 0) goto error;
 
-        if (parentUriLen > 0)
+        topP = lwm2m_data_new(1);
+        if (topP == NULL) goto error;
+        if (hasBaseValue)
         {
-            if (URI_MAX_STRING_LEN < parentUriLen) return -1;
-            memcpy(uriStr, parentUriStr, parentUriLen);
-            uriLen = parentUriLen;
+            memcpy(topP, &baseValue, sizeof(lwm2m_data_t));
+            hasBaseValue = false;
         }
         else
         {
-            uriLen = 0;
+            topP->type = PRV_TYPE_CONTAINER;
+            topP->value.asChildren.array = root.value.asChildren.array;
+            topP->value.asChildren.count = root.value.asChildren.count;
+            root.value.asChildren.array = NULL;
+            root.value.asChildren.count = 0;
         }
-        res = utils_intToText(tlvP->id, uriStr + uriLen, URI_MAX_STRING_LEN - uriLen);
-        if (res <= 0) return -1;
-        uriLen += res;
-        uriStr[uriLen] = '/';
-        uriLen++;
+        topP->id = baseIds[baseCount - 1];
+        topCount = 1;
 
-        head = 0;
-        for (index = 0 ; index < tlvP->value.asChildren.count; index++)
+        for (res = baseCount - 2 ; res >= 0 ; res--)
         {
-            res = prv_serializeData(tlvP->value.asChildren.array + index, uriStr, uriLen, buffer + head, bufferLen - head);
-            if (res < 0) return -1;
-            head += res;
+            lwm2m_data_t * parentP;
+
+            parentP = lwm2m_data_new(1);
+            if (parentP == NULL) goto error;
+            parentP->type = PRV_TYPE_CONTAINER;
+            parentP->id = baseIds[res];
+            parentP->value.asChildren.array = topP;
+            parentP->value.asChildren.count = 1;
+            topP = parentP;
         }
     }
-    break;
 
-    default:
-        if (bufferLen < JSON_RES_ITEM_URI_SIZE) return -1;
-        memcpy(buffer, JSON_RES_ITEM_URI, JSON_RES_ITEM_URI_SIZE);
-        head = JSON_RES_ITEM_URI_SIZE;
-
-        if (parentUriLen > 0)
-        {
-            if (bufferLen - head < parentUriLen) return -1;
-            memcpy(buffer + head, parentUriStr, parentUriLen);
-            head += parentUriLen;
-        }
+    if (!prv_setTypes(topP, topCount, 0)) goto error;
 
-        res = utils_intToText(tlvP->id, buffer + head, bufferLen - head);
-        if (res <= 0) return -1;
-        head += res;
+    return data_selectUri(uriP, topCount, topP, dataP);
 
-        res = prv_serializeValue(tlvP, buffer + head, bufferLen - head);
-        if (res < 0) return -1;
-        head += res;
-        break;
+error:
+    LOG("Parsing failed");
+    if (topP != NULL)
+    {
+        lwm2m_data_free((int)topCount, topP);
     }
-
-    return head;
+    if (root.value.asChildren.count != 0)
+    {
+        lwm2m_data_free((int)root.value.asChildren.count, root.value.asChildren.array);
+    }
+    if (hasBaseValue)
+    {
+        prv_clearValue(&baseValue);
+    }
+    return -1;
 }
 
 static int prv_findAndCheckData(lwm2m_uri_t * uriP,
@@ -1353,14 +1003,180 @@ static int prv_findAndCheckData(lwm2m_uri_t * uriP,
     return result;
 }
 
-int json_serialize(lwm2m_uri_t * uriP,
-                   int size,
-                   lwm2m_data_t * tlvP,
-                   uint8_t ** bufferP)
+static int prv_write(prv_writer_t * writerP,
+                     const void * data,
+                     size_t length)
+{
+    utils_buffer_t * outputP = writerP->outputP;
+
+    if (length == 0) return 0;
+    if (NULL == utils_bufferReserve(outputP, length)) return -1;
+    memcpy(outputP->data + outputP->length, data, length);
+    outputP->length += length;
+    writerP->total += length;
+
+    return 0;
+}
+
+static int prv_writeInt(prv_writer_t * writerP,
+                        int64_t value)
+{
+    uint8_t text[PRV_JSON_NUMBER_MAX_LEN];
+    size_t res;
+
+    res = utils_intToText(value, text, PRV_JSON_NUMBER_MAX_LEN);
+    if (res == 0) return -1;
+
+    return prv_write(writerP, text, res);
+}
+
+static int prv_writeValue(prv_writer_t * writerP,
+                          lwm2m_data_t * tlvP)
+{
+    switch (tlvP->type)
+    {
+    case LWM2M_TYPE_STRING:
+        if (0 != prv_write(writerP, JSON_ITEM_STRING_BEGIN, JSON_ITEM_STRING_BEGIN_SIZE)) return -1;
+        if (0 != prv_write(writerP, tlvP->value.asBuffer.buffer, tlvP->value.asBuffer.length)) return -1;
+        return prv_write(writerP, JSON_ITEM_STRING_END, JSON_ITEM_STRING_END_SIZE);
+
+    case LWM2M_TYPE_INTEGER:
+    {
+        int64_t value;
+
+        if (0 == lwm2m_data_decode_int(tlvP, &value)) return -1;
+        if (0 != prv_write(writerP, JSON_ITEM_NUM, JSON_ITEM_NUM_SIZE)) return -1;
+        if (0 != prv_writeInt(writerP, value)) return -1;
+        return prv_write(writerP, JSON_ITEM_NUM_END, JSON_ITEM_NUM_END_SIZE);
+    }
+
+    case LWM2M_TYPE_FLOAT:
+    {
+        uint8_t text[PRV_JSON_NUMBER_MAX_LEN];
+        double value;
+        size_t res;
+
+        if (0 == lwm2m_data_decode_float(tlvP, &value)) return -1;
+        res = utils_floatToText(value, text, PRV_JSON_NUMBER_MAX_LEN);
+        if (res == 0) return -1;
+        if (0 != prv_write(writerP, JSON_ITEM_NUM, JSON_ITEM_NUM_SIZE)) return -1;
+        if (0 != prv_write(writerP, text, res)) return -1;
+        return prv_write(writerP, JSON_ITEM_NUM_END, JSON_ITEM_NUM_END_SIZE);
+    }
+
+    case LWM2M_TYPE_BOOLEAN:
+    {
+        bool value;
+
+        if (0 == lwm2m_data_decode_bool(tlvP, &value)) return -1;
+        if (value == true)
+        {
+            return prv_write(writerP, JSON_ITEM_BOOL_TRUE, JSON_ITEM_BOOL_TRUE_SIZE);
+        }
+        return prv_write(writerP, JSON_ITEM_BOOL_FALSE, JSON_ITEM_BOOL_FALSE_SIZE);
+    }
+
+    case LWM2M_TYPE_OPAQUE:
+    {
+        size_t index;
+
+        if (0 != prv_write(writerP, JSON_ITEM_STRING_BEGIN, JSON_ITEM_STRING_BEGIN_SIZE)) return -1;
+        // whole 3-byte groups, so that only the last piece is padded
+        for (index = 0 ; index < tlvP->value.asBuffer.length ; index += PRV_JSON_B64_INPUT_LEN)
+        {
+            uint8_t text[PRV_JSON_B64_OUTPUT_LEN];
+            size_t length;
+            size_t res;
+
+            length = MIN(tlvP->value.asBuffer.length - index, PRV_JSON_B64_INPUT_LEN);
+            res = utils_base64Encode(tlvP->value.asBuffer.buffer + index, length, text, PRV_JSON_B64_OUTPUT_LEN);
+            if (res == 0) return -1;
+            if (0 != prv_write(writerP, text, res)) return -1;
+        }
+        return prv_write(writerP, JSON_ITEM_STRING_END, JSON_ITEM_STRING_END_SIZE);
+    }
+
+    case LWM2M_TYPE_OBJECT_LINK:
+        if (0 != prv_write(writerP, JSON_ITEM_OBJECT_LINK, JSON_ITEM_OBJECT_LINK_SIZE)) return -1;
+        if (0 != prv_writeInt(writerP, tlvP->value.asObjLink.objectId)) return -1;
+        if (0 != prv_write(writerP, ":", 1)) return -1;
+        if (0 != prv_writeInt(writerP, tlvP->value.asObjLink.objectInstanceId)) return -1;
+        return prv_write(writerP, JSON_ITEM_STRING_END, JSON_ITEM_STRING_END_SIZE);
+
+    default:
+        return -1;
+    }
+}
+
+static int prv_writeData(prv_writer_t * writerP,
+                         lwm2m_data_t * tlvP,
+                         uint8_t * parentUriStr,
+                         size_t parentUriLen)
+{
+    int res;
+
+    switch (tlvP->type)
+    {
+    case LWM2M_TYPE_OBJECT:
+    case LWM2M_TYPE_OBJECT_INSTANCE:
+    case LWM2M_TYPE_MULTIPLE_RESOURCE:
+    {
+        uint8_t uriStr[URI_MAX_STRING_LEN];
+        size_t uriLen;
+        size_t index;
+
+        if (parentUriLen > 0)
+        {
+            if (URI_MAX_STRING_LEN < parentUriLen) return -1;
+            memcpy(uriStr, parentUriStr, parentUriLen);
+            uriLen = parentUriLen;
+        }
+        else
+        {
+            uriLen = 0;
+        }
+        res = utils_intToText(tlvP->id, uriStr + uriLen, URI_MAX_STRING_LEN - uriLen);
+        if (res <= 0) return -1;
+        uriLen += res;
+        if (uriLen >= URI_MAX_STRING_LEN) return -1;
+        uriStr[uriLen] = '/';
+        uriLen++;
+
+        for (index = 0 ; index < tlvP->value.asChildren.count; index++)
+        {
+            if (0 != prv_writeData(writerP, tlvP->value.asChildren.array + index, uriStr, uriLen)) return -1;
+        }
+    }
+    break;
+
+    default:
+        if (writerP->first)
+        {
+            writerP->first = false;
+        }
+        else
+        {
+            if (0 != prv_write(writerP, JSON_ITEM_SEPARATOR, JSON_ITEM_SEPARATOR_SIZE)) return -1;
+        }
+        if (0 != prv_write(writerP, JSON_RES_ITEM_URI, JSON_RES_ITEM_URI_SIZE)) return -1;
+        if (parentUriLen > 0)
+        {
+            if (0 != prv_write(writerP, parentUriStr, parentUriLen)) return -1;
+        }
+        if (0 != prv_writeInt(writerP, tlvP->id)) return -1;
+        if (0 != prv_writeValue(writerP, tlvP)) return -1;
+        break;
+    }
+
+    return 0;
+}
+
+static int prv_serialize(prv_writer_t * writerP,
+                         lwm2m_uri_t * uriP,
+                         int size,
+                         lwm2m_data_t * tlvP)
 {
     int index;
-    size_t head;
-    uint8_t bufferJSON[PRV_JSON_BUFFER_SIZE];
     uint8_t baseUriStr[URI_MAX_STRING_LEN];
     int baseUriLen;
     uri_depth_t rootLevel;
@@ -1385,9 +1201,9 @@ int json_serialize(lwm2m_uri_t * uriP,
         int res;
 
         res = utils_intToText(targetP->id, baseUriStr + baseUriLen, URI_MAX_STRING_LEN - baseUriLen);
-        if (res <= 0) return 0;
+        if (res <= 0) return -1;
         baseUriLen += res;
-        if (baseUriLen >= URI_MAX_STRING_LEN -1) return 0;
+        if (baseUriLen >= URI_MAX_STRING_LEN -1) return -1;
         num = targetP->value.asChildren.count;
         targetP = targetP->value.asChildren.array;
         baseUriStr[baseUriLen] = '/';
@@ -1396,41 +1212,67 @@ int json_serialize(lwm2m_uri_t * uriP,
 
     if (baseUriLen > 0)
     {
-        memcpy(bufferJSON, JSON_BN_HEADER_1, JSON_BN_HEADER_1_SIZE);
-        head = JSON_BN_HEADER_1_SIZE;
-        memcpy(bufferJSON + head, baseUriStr, baseUriLen);
-        head += baseUriLen;
-        memcpy(bufferJSON + head, JSON_BN_HEADER_2, JSON_BN_HEADER_2_SIZE);
-        head += JSON_BN_HEADER_2_SIZE;
+        if (0 != prv_write(writerP, JSON_BN_HEADER_1, JSON_BN_HEADER_1_SIZE)) return -1;
+        if (0 != prv_write(writerP, baseUriStr, baseUriLen)) return -1;
+        if (0 != prv_write(writerP, JSON_BN_HEADER_2, JSON_BN_HEADER_2_SIZE)) return -1;
     }
     else
     {
-        memcpy(bufferJSON, JSON_HEADER, JSON_HEADER_SIZE);
-        head = JSON_HEADER_SIZE;
+        if (0 != prv_write(writerP, JSON_HEADER, JSON_HEADER_SIZE)) return -1;
     }
 
-    for (index = 0 ; index < num && head < PRV_JSON_BUFFER_SIZE ; index++)
+    writerP->first = true;
+    for (index = 0 ; index < num ; index++)
     {
-        int res;
-
-        res = prv_serializeData(targetP + index, NULL, 0, bufferJSON + head, PRV_JSON_BUFFER_SIZE - head);
-        if (res < 0) return 0;
-        head += res;
+        if (0 != prv_writeData(writerP, targetP + index, NULL, 0)) return -1;
     }
 
-    if (head + JSON_FOOTER_SIZE - 1 > PRV_JSON_BUFFER_SIZE) return 0;
+    if (0 != prv_write(writerP, JSON_FOOTER, JSON_FOOTER_SIZE)) return -1;
+
+    return 0;
+}
+
+int json_serializeTo(lwm2m_uri_t * uriP,
+                     int size,
+                     lwm2m_data_t * tlvP,
+                     utils_buffer_t * outputP)
+{
+    prv_writer_t writer;
+    size_t start;
+
+    memset(&writer, 0, sizeof(writer));
+    writer.outputP = outputP;
+
+    start = outputP->length;
+    if (0 != prv_serialize(&writer, uriP, size, tlvP)
+     || writer.total > INT_MAX)
+    {
+        outputP->length = start;
+        return -1;
+    }
 
-    if (num > 0) head = head - 1;
+    return (int)writer.total;
+}
 
-    memcpy(bufferJSON + head, JSON_FOOTER, JSON_FOOTER_SIZE);
-    head = head + JSON_FOOTER_SIZE;
+int json_serialize(lwm2m_uri_t * uriP,
+                   int size,
+                   lwm2m_data_t * tlvP,
+                   uint8_t ** bufferP)
+{
+    utils_buffer_t output;
+    int length;
 
-    *bufferP = (uint8_t *)lwm2m_malloc(head);
-    if (*bufferP == NULL) return 0;
-    memcpy(*bufferP, bufferJSON, head);
+    utils_bufferInit(&output, NULL, 0, false);
+    length = json_serializeTo(uriP, size, tlvP, &output);
+    if (length <= 0)
+    {
+        utils_bufferFree(&output);
+        *bufferP = NULL;
+        return length;
+    }
+    *bufferP = output.data;
 
-    return head;
+    return length;
 }
 
 #endif
-
@@ -69,6 +69,29 @@ lwm2m_context_t * lwm2m_init(void * userData)
         contextP->userData = userData;
         srand((int)lwm2m_gettime());
         contextP->nextMID = rand();
+
+        contextP->txBuffer = (uint8_t *)lwm2m_malloc(COAP_MAX_PACKET_SIZE);
+        if (NULL == contextP->txBuffer)
+        {
+            lwm2m_free(contextP);
+            return NULL;
+        }
+        contextP->txBufferSize = COAP_MAX_PACKET_SIZE;
+
+        if (0 == transaction_init(contextP))
+        {
+            lwm2m_free(contextP->txBuffer);
+            lwm2m_free(contextP);
+            return NULL;
+        }
+
+        if (0 == dedup_init(contextP))
+        {
+            transaction_close(contextP);
+            lwm2m_free(contextP->txBuffer);
+            lwm2m_free(contextP);
+            return NULL;
+        }
     }
 
     return contextP;
@@ -87,17 +110,23 @@ void lwm2m_deregister(lwm2m_context_t * context)
     }
 }
 
-static void prv_deleteServer(lwm2m_server_t * serverP, void *userData)
+static void prv_deleteServer(lwm2m_context_t * contextP, lwm2m_server_t * serverP)
 {
-    // TODO parse transaction and observation to remove the ones related to this server
+    // TODO parse observation to remove the ones related to this server
     if (serverP->sessionH != NULL)
     {
-         lwm2m_close_connection(serverP->sessionH, userData);
+         transaction_removePeer(contextP, serverP->sessionH);
+         dedup_removePeer(contextP, serverP->sessionH);
+         lwm2m_close_connection(serverP->sessionH, contextP->userData);
     }
     if (NULL != serverP->location)
     {
         lwm2m_free(serverP->location);
     }
+    if (NULL != serverP->query)
+    {
+        lwm2m_free(serverP->query);
+    }
     free_block1_buffer(serverP->block1Data);
     lwm2m_free(serverP);
 }
@@ -109,17 +138,19 @@ static void prv_deleteServerList(lwm2m_context_t * context)
         lwm2m_server_t * server;
         server = context->serverList;
         context->serverList = server->next;
-        prv_deleteServer(server, context->userData);
+        prv_deleteServer(context, server);
     }
 }
 
-static void prv_deleteBootstrapServer(lwm2m_server_t * serverP, void *userData)
+static void prv_deleteBootstrapServer(lwm2m_context_t * contextP, lwm2m_server_t * serverP)
 {
     // TODO should we free location as in prv_deleteServer ?
-    // TODO should we parse transaction and observation to remove the ones related to this server ?
+    // TODO should we parse observation to remove the ones related to this server ?
     if (serverP->sessionH != NULL)
     {
-         lwm2m_close_connection(serverP->sessionH, userData);
+         transaction_removePeer(contextP, serverP->sessionH);
+         dedup_removePeer(contextP, serverP->sessionH);
+         lwm2m_close_connection(serverP->sessionH, contextP->userData);
     }
     free_block1_buffer(serverP->block1Data);
     lwm2m_free(serverP);
@@ -132,7 +163,7 @@ static void prv_deleteBootstrapServerList(lwm2m_context_t * context)
         lwm2m_server_t * server;
         server = context->bootstrapServerList;
         context->bootstrapServerList = server->next;
-        prv_deleteBootstrapServer(server, context->userData);
+        prv_deleteBootstrapServer(context, server);
     }
 }
 
@@ -146,29 +177,19 @@ static void prv_deleteObservedList(lwm2m_context_t * contextP)
         targetP = contextP->observedList;
         contextP->observedList = contextP->observedList->next;
 
-        for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+        while (targetP->watcherList != NULL)
         {
+            watcherP = targetP->watcherList;
+            targetP->watcherList = watcherP->next;
             if (watcherP->parameters != NULL) lwm2m_free(watcherP->parameters);
+            POOL_FREE(LWM2M_POOL_WATCHER, watcherP);
         }
-        LWM2M_LIST_FREE(targetP->watcherList);
 
         lwm2m_free(targetP);
     }
 }
 #endif
 
-void prv_deleteTransactionList(lwm2m_context_t * context)
-{
-    while (NULL != context->transactionList)
-    {
-        lwm2m_transaction_t * transaction;
-
-        transaction = context->transactionList;
-        context->transactionList = context->transactionList->next;
-        transaction_free(transaction);
-    }
-}
-
 void lwm2m_close(lwm2m_context_t * contextP)
 {
 #ifdef LWM2M_CLIENT_MODE
@@ -187,6 +208,7 @@ void lwm2m_close(lwm2m_context_t * contextP)
     {
         lwm2m_free(contextP->altPath);
     }
+    object_invalidateRegisterPayload(contextP);
 
 #endif
 
@@ -198,11 +220,26 @@ void lwm2m_close(lwm2m_context_t * contextP)
         clientP = contextP->clientList;
         contextP->clientList = contextP->clientList->next;
 
-        registration_freeClient(clientP);
+        registration_freeClient(contextP, clientP);
     }
+    registry_close(contextP);
+    objectlist_close(contextP);
+    bulk_close(contextP);
+    completion_close(contextP);
 #endif
 
-    prv_deleteTransactionList(contextP);
+#if defined(LWM2M_SERVER_MODE) || defined(LWM2M_BOOTSTRAP_SERVER_MODE)
+    block1_clear(contextP);
+#endif
+#ifdef LWM2M_SERVER_MODE
+    block2_clearFetches(contextP);
+#endif
+    transaction_close(contextP);
+    block2_clear(contextP);
+    dedup_close(contextP);
+    timer_close(contextP);
+    lwm2m_free(contextP->txBuffer);
+    if (contextP->payloadBuffer != NULL) lwm2m_free(contextP->payloadBuffer);
     lwm2m_free(contextP);
 }
 
@@ -226,7 +263,7 @@ static int prv_refreshServerList(lwm2m_context_t * contextP)
         }
         else
         {
-            prv_deleteServer(targetP, contextP->userData);
+            prv_deleteServer(contextP, targetP);
         }
         targetP = nextP;
     }
@@ -243,7 +280,7 @@ static int prv_refreshServerList(lwm2m_context_t * contextP)
         }
         else
         {
-            prv_deleteServer(targetP, contextP->userData);
+            prv_deleteServer(contextP, targetP);
         }
         targetP = nextP;
     }
@@ -316,6 +353,7 @@ int lwm2m_configure(lwm2m_context_t * contextP,
         objectList[i]->next = NULL;
         contextP->objectList = (lwm2m_object_t *)LWM2M_LIST_ADD(contextP->objectList, objectList[i]);
     }
+    object_invalidateRegisterPayload(contextP);
 
     return COAP_NO_ERROR;
 }
@@ -331,6 +369,7 @@ int lwm2m_add_object(lwm2m_context_t * contextP,
     objectP->next = NULL;
 
     contextP->objectList = (lwm2m_object_t *)LWM2M_LIST_ADD(contextP->objectList, objectP);
+    object_invalidateRegisterPayload(contextP);
 
     if (contextP->state == STATE_READY)
     {
@@ -349,6 +388,7 @@ int lwm2m_remove_object(lwm2m_context_t * contextP,
     contextP->objectList = (lwm2m_object_t *)LWM2M_LIST_RM(contextP->objectList, id, &targetP);
 
     if (targetP == NULL) return COAP_404_NOT_FOUND;
+    object_invalidateRegisterPayload(contextP);
 
     if (contextP->state == STATE_READY)
     {
@@ -469,11 +509,11 @@ next_step:
         break;
     }
 
-    observe_step(contextP, tv_sec, timeoutP);
 #endif
 
     registration_step(contextP, tv_sec, timeoutP);
-    transaction_step(contextP, tv_sec, timeoutP);
+    // transactions retransmissions, clients lifetimes and notifications
+    timer_step(contextP, tv_sec, timeoutP);
 
     LOG_ARG("Final timeoutP: %" PRId64, *timeoutP);
 #ifdef LWM2M_CLIENT_MODE
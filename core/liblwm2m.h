@@ -68,6 +68,9 @@ extern "C" {
 #ifndef LWM2M_SUPPORT_JSON
 #define LWM2M_SUPPORT_JSON
 #endif
+#ifndef LWM2M_SUPPORT_SENML_CBOR
+#define LWM2M_SUPPORT_SENML_CBOR
+#endif
 #endif
 
 #if defined(LWM2M_BOOTSTRAP) && defined(LWM2M_BOOTSTRAP_SERVER_MODE)
@@ -91,9 +94,9 @@ char * lwm2m_trace_strdup(const char * str, const char * file, const char * func
 void * lwm2m_trace_malloc(size_t size, const char * file, const char * function, int lineno);
 void    lwm2m_trace_free(void * mem, const char * file, const char * function, int lineno);
 
-#define lwm2m_strdup(S) lwm2m_trace_strdup(S, __FILE__, __FUNCTION__, __LINE__)
-#define lwm2m_malloc(S) lwm2m_trace_malloc(S, __FILE__, __FUNCTION__, __LINE__)
-#define lwm2m_free(M)   lwm2m_trace_free(M, __FILE__, __FUNCTION__, __LINE__)
+#define lwm2m_strdup(S) lwm2m_trace_strdup(S, __FILE__, __func__, __LINE__)
+#define lwm2m_malloc(S) lwm2m_trace_malloc(S, __FILE__, __func__, __LINE__)
+#define lwm2m_free(M)   lwm2m_trace_free(M, __FILE__, __func__, __LINE__)
 #endif
 // Compare at most the n first bytes of s1 and s2, return 0 if they match
 int lwm2m_strncmp(const char * s1, const char * s2, size_t n);
@@ -129,6 +132,8 @@ void lwm2m_close_connection(void * sessionH, void * userData);
 uint8_t lwm2m_buffer_send(void * sessionH, uint8_t * buffer, size_t length, void * userData);
 // Compare two session handles
 // Returns true if the two sessions identify the same peer. false otherwise.
+// The core also keys its tables by the session handle pointer: two sessions identifying
+// the same peer must be the same pointer.
 // userData: parameter to lwm2m_init()
 bool lwm2m_session_is_equal(void * session1, void * session2, void * userData);
 
@@ -329,6 +334,7 @@ typedef enum
     LWM2M_CONTENT_TEXT      = 0,        // Also used as undefined
     LWM2M_CONTENT_LINK      = 40,
     LWM2M_CONTENT_OPAQUE    = 42,
+    LWM2M_CONTENT_SENML_CBOR = 112,
     LWM2M_CONTENT_TLV_OLD   = 1542,     // Keep old value for backward-compatibility
     LWM2M_CONTENT_TLV       = 11542,
     LWM2M_CONTENT_JSON_OLD  = 1543,     // Keep old value for backward-compatibility
@@ -391,6 +397,10 @@ typedef uint8_t (*lwm2m_write_callback_t) (uint16_t instanceId, int numData, lwm
 typedef uint8_t (*lwm2m_execute_callback_t) (uint16_t instanceId, uint16_t resourceId, uint8_t * buffer, int length, lwm2m_object_t * objectP);
 typedef uint8_t (*lwm2m_create_callback_t) (uint16_t instanceId, int numData, lwm2m_data_t * dataArray, lwm2m_object_t * objectP);
 typedef uint8_t (*lwm2m_delete_callback_t) (uint16_t instanceId, lwm2m_object_t * objectP);
+// Receives an opaque resource value written with Block1 as the blocks arrive, without buffering
+// the whole value. offset is the position of buffer in the value, more is false for the last block.
+// Returns COAP_204_CHANGED to continue, any other code aborts the transfer.
+typedef uint8_t (*lwm2m_block_write_callback_t) (uint16_t instanceId, uint16_t resourceId, uint32_t offset, uint8_t * buffer, size_t length, bool more, lwm2m_object_t * objectP);
 
 struct _lwm2m_object_t
 {
@@ -403,6 +413,7 @@ struct _lwm2m_object_t
     lwm2m_create_callback_t   createFunc;
     lwm2m_delete_callback_t   deleteFunc;
     lwm2m_discover_callback_t discoverFunc;
+    lwm2m_block_write_callback_t blockWriteFunc;    // optional, used instead of writeFunc for opaque Block1 writes
     void * userData;
 };
 
@@ -446,16 +457,24 @@ typedef enum
 /*
  * LWM2M block1 data
  *
- * Temporary data needed to handle block1 request.
- * Currently support only one block1 request by server.
+ * Temporary data needed to handle a block1 request. A server can have
+ * several transfers in progress, told apart by their token.
  */
 typedef struct _lwm2m_block1_data_ lwm2m_block1_data_t;
 
 struct _lwm2m_block1_data_
 {
-    uint8_t *             block1buffer;     // data buffer
-    size_t                block1bufferSize; // buffer size
-    uint16_t              lastmid;          // mid of the last message received
+    struct _lwm2m_block1_data_ *  next;
+    uint8_t                       token[8];
+    uint8_t                       tokenLen;
+    bool                          streaming;        // blocks go to the object blockWriteFunc as they arrive
+    bool                          complete;         // the last block was received
+    uint8_t *                     block1buffer;     // whole payload once complete
+    size_t                        block1bufferSize; // bytes received so far
+    uint16_t                      lastmid;          // mid of the last message received
+    uint8_t                       lastResult;       // answer to the last message when streaming
+    struct _lwm2m_block1_chunk_ * chunkList;        // received blocks while not complete
+    struct _lwm2m_block1_chunk_ * lastChunk;
 };
 
 typedef struct _lwm2m_server_
@@ -469,8 +488,9 @@ typedef struct _lwm2m_server_
     void *                  sessionH;
     lwm2m_status_t          status;
     char *                  location;
+    char *                  query;        // cached registration query, built on the first registration
     bool                    dirty;
-    lwm2m_block1_data_t *   block1Data;   // buffer to handle block1 data, should be replace by a list to support several block1 transfer by server.
+    lwm2m_block1_data_t *   block1Data;   // block1 transfers in progress
 } lwm2m_server_t;
 
 
@@ -478,9 +498,18 @@ typedef struct _lwm2m_server_
  * LWM2M result callback
  *
  * When used with an observe, if 'data' is not nil, 'status' holds the observe counter.
+ * An observation removed by the core, like one canceled before the client answered it, reports COAP_202_DELETED.
  */
 typedef void (*lwm2m_result_callback_t) (uint16_t clientID, lwm2m_uri_t * uriP, int status, lwm2m_media_type_t format, uint8_t * data, int dataLength, void * userData);
 
+/*
+ * LWM2M observation release callback
+ *
+ * Called with the callback and userData of an observation once the core dropped it and will not call it anymore.
+ * releaseUserData is the one given to lwm2m_set_observe_release_callback().
+ */
+typedef void (*lwm2m_observe_release_callback_t) (uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData, void * releaseUserData);
+
 /*
  * LWM2M Observations
  *
@@ -499,6 +528,7 @@ typedef struct _lwm2m_observation_
     lwm2m_status_t          status;
     lwm2m_result_callback_t callback;
     void *                  userData;
+    struct _lwm2m_context_ * contextP;  // private: where the results go when callback is NULL
 } lwm2m_observation_t;
 
 /*
@@ -525,6 +555,36 @@ typedef struct
     double      step;
 } lwm2m_attributes_t;
 
+/*
+ * Timers
+ *
+ * Deadlines of the transactions, registered clients and observed resources are
+ * kept in a binary min-heap owned by the context so that lwm2m_step() only
+ * handles the ones which expired.
+ *
+ */
+
+struct _lwm2m_context_;
+
+typedef void (*lwm2m_timer_callback_t) (struct _lwm2m_context_ * contextP, void * userData, time_t currentTime);
+
+typedef struct
+{
+    time_t                 deadline;
+    size_t                 index;       // position in the heap plus one, 0 when not scheduled
+    lwm2m_timer_callback_t callback;
+    void *                 userData;
+} lwm2m_timer_t;
+
+typedef struct
+{
+    lwm2m_timer_t ** heap;
+    size_t           count;
+    size_t           size;
+    bool             stepping;      // true while expired timers are being fired
+    time_t           stepTime;
+} lwm2m_timer_heap_t;
+
 /*
  * LWM2M Clients
  *
@@ -533,13 +593,31 @@ typedef struct
  *
  */
 
-typedef struct _lwm2m_client_object_
+typedef struct
 {
-    struct _lwm2m_client_object_ * next; // matches lwm2m_list_t::next
-    uint16_t                 id;         // matches lwm2m_list_t::id
-    lwm2m_list_t *           instanceList;
+    uint16_t   id;
+    uint16_t   instanceCount;   // 0 if the object was declared without instances
+    uint16_t * instances;       // sorted instance IDs
 } lwm2m_client_object_t;
 
+/*
+ * Object list of a client
+ *
+ * The objects declared at registration, sorted by ID, and the alternate path.
+ * Clients declaring the same list share a single read-only copy (see objectlist.c).
+ */
+
+typedef struct _lwm2m_client_object_list_
+{
+    struct _lwm2m_client_object_list_ * next;   // private: chaining in the context's table
+    uint32_t                hash;               // private
+    uint32_t                refCount;           // number of clients sharing this list
+    size_t                  size;               // bytes used by this list
+    char *                  altPath;            // may be NULL
+    uint16_t                count;              // number of objects
+    lwm2m_client_object_t * objects;
+} lwm2m_client_object_list_t;
+
 typedef struct _lwm2m_client_
 {
     struct _lwm2m_client_ * next;       // matches lwm2m_list_t::next
@@ -547,15 +625,144 @@ typedef struct _lwm2m_client_
     char *                  name;
     lwm2m_binding_t         binding;
     char *                  msisdn;
-    char *                  altPath;
+    char *                  altPath;    // points in objectList
     bool                    supportJSON;
+    bool                    supportSenmlCbor;
     uint32_t                lifetime;
     time_t                  endOfLife;
     void *                  sessionH;
-    lwm2m_client_object_t * objectList;
+    lwm2m_client_object_list_t * objectList; // shared with other clients, do not modify
     lwm2m_observation_t *   observationList;
+    lwm2m_timer_t           lifetimeTimer;
+    // private: used by the client registry
+    struct _lwm2m_client_ * prev;
+    struct _lwm2m_client_ * idNext;
+    struct _lwm2m_client_ * nameNext;
 } lwm2m_client_t;
 
+/*
+ * Client registry
+ *
+ * Hash indexes over the registered clients, keyed by internal ID and endpoint
+ * name. The clients are also chained in the sorted
+ * clientList of the context which remains the way to iterate over them.
+ *
+ */
+
+typedef struct
+{
+    lwm2m_client_t ** idTable;
+    lwm2m_client_t ** nameTable;
+    size_t            size;     // number of buckets per table, a power of two
+    size_t            count;    // number of registered clients
+    lwm2m_client_t *  tail;     // last client of the clientList
+    uint16_t          nextID;   // next internal ID to try
+} lwm2m_client_registry_t;
+
+typedef struct
+{
+    lwm2m_client_object_list_t ** buckets;
+    size_t                        size;     // number of buckets, a power of two
+    size_t                        count;    // number of distinct object lists
+} lwm2m_object_list_table_t;
+
+/*
+ * Bulk operations
+ *
+ * One operation run against a set of clients. The requests are started at a
+ * limited rate and with a limited number in flight, every client result goes
+ * to the same callback.
+ *
+ */
+
+typedef enum
+{
+    LWM2M_BULK_READ,
+    LWM2M_BULK_WRITE,
+    LWM2M_BULK_EXECUTE,
+    LWM2M_BULK_OBSERVE
+} lwm2m_bulk_operation_t;
+
+typedef bool (*lwm2m_client_filter_t) (lwm2m_client_t * clientP, void * userData);
+
+typedef struct
+{
+    lwm2m_bulk_operation_t operation;
+    lwm2m_uri_t            uri;
+    lwm2m_media_type_t     format;      // of the payload of a write or an execute
+    uint8_t *              buffer;      // copied once for all the clients
+    int                    length;
+    uint16_t *             clientIDs;   // the targeted clients, NULL to select them with filter
+    size_t                 clientCount;
+    lwm2m_client_filter_t  filter;      // NULL to target all the registered clients
+    void *                 filterData;
+    uint32_t               rate;        // requests started per second, 0 for no limit
+    size_t                 concurrency; // requests in flight, 0 for no limit
+} lwm2m_bulk_request_t;
+
+typedef struct
+{
+    size_t total;       // clients targeted
+    size_t started;
+    size_t inFlight;
+    size_t succeeded;   // answered with a 2.xx code
+    size_t failed;      // answered with an error, timed out or not started
+} lwm2m_bulk_progress_t;
+
+typedef struct _lwm2m_bulk_ lwm2m_bulk_t;
+
+typedef void (*lwm2m_bulk_callback_t) (lwm2m_bulk_t * bulkP, lwm2m_bulk_progress_t * progressP, void * userData);
+
+struct _lwm2m_bulk_
+{
+    lwm2m_bulk_t *          next;
+    struct _lwm2m_context_ * contextP;
+    lwm2m_bulk_operation_t  operation;
+    lwm2m_uri_t             uri;
+    lwm2m_media_type_t      format;
+    uint8_t *               buffer;
+    int                     length;
+    uint16_t *              clientIDs;  // the targets, started in this order
+    uint32_t                rate;
+    size_t                  concurrency;
+    time_t                  windowStart; // second of the requests counted in windowCount
+    uint32_t                windowCount;
+    bool                    cancelled;
+    lwm2m_bulk_progress_t   progress;
+    lwm2m_result_callback_t resultCallback;
+    lwm2m_bulk_callback_t   doneCallback;
+    void *                  userData;
+    lwm2m_timer_t           timer;
+};
+
+/*
+ * Completion queue
+ *
+ * Ring buffer of the results of the requests made without a callback, drained
+ * by the application with lwm2m_poll_completions().
+ *
+ */
+
+typedef struct
+{
+    void *             userData;    // of the request
+    uint16_t           clientID;
+    lwm2m_uri_t        uri;
+    int                status;      // as given to a lwm2m_result_callback_t
+    lwm2m_media_type_t format;
+    uint8_t *          data;        // copy of the payload, owned by the application once polled
+    int                dataLength;
+} lwm2m_completion_t;
+
+typedef struct
+{
+    lwm2m_completion_t * records;
+    size_t               size;      // capacity, 0 when the queue is disabled
+    size_t               head;      // oldest record
+    size_t               count;
+    size_t               dropped;   // records lost because the queue was full
+} lwm2m_completion_queue_t;
+
 
 /*
  * LWM2M transaction
@@ -581,8 +788,126 @@ struct _lwm2m_transaction_
     uint8_t * buffer;
     lwm2m_transaction_callback_t callback;
     void * userData;
+    lwm2m_timer_t timer;
+    // private: used by the transaction indexes
+    lwm2m_transaction_t * prev;
+    lwm2m_transaction_t * midNext;
+    lwm2m_transaction_t * tokenNext;
+    lwm2m_transaction_t * peerNext;
+    // private: used by the congestion control
+    lwm2m_transaction_t * queueNext;    // waiting for its turn to be sent to the peer
+    bool                  queued;
+    bool                  inFlight;     // counted in the NSTART of the peer
+    time_t                sendTime;     // first transmission
+    uint32_t              rto;          // timeout of the last transmission, in milliseconds
+    uint8_t               backoff;      // multiplier of the timeout on retransmissions, in halves
 };
 
+/*
+ * Transaction indexes
+ *
+ * Hash indexes over the transactions in progress, keyed by message ID, by
+ * token and by peer session handle, so that a response is matched without
+ * walking the transactionList.
+ *
+ */
+
+typedef struct
+{
+    lwm2m_transaction_t ** midTable;
+    lwm2m_transaction_t ** tokenTable;
+    lwm2m_transaction_t ** peerTable;
+    size_t                 size;    // number of buckets per table, a power of two
+    size_t                 count;   // number of transactions in progress
+} lwm2m_transaction_index_t;
+
+/*
+ * LWM2M peers
+ *
+ * Congestion control state of a peer the transactions are sent to: the
+ * CoCoA round-trip time estimators and retransmission timeout, the
+ * transactions in flight and the ones waiting for their turn.
+ */
+typedef struct _lwm2m_peer_
+{
+    struct _lwm2m_peer_ * next;         // in the bucket
+    struct _lwm2m_peer_ * readyNext;    // waiting for a free slot of the context
+    void *                sessionH;
+    uint32_t              rto;          // overall retransmission timeout, in milliseconds
+    time_t                rtoTime;      // last update of rto, for its aging
+    uint32_t              strongSrtt;   // estimators, in milliseconds, 0 before the first sample
+    uint32_t              strongRttvar;
+    uint32_t              weakSrtt;
+    uint32_t              weakRttvar;
+    uint16_t              inFlight;
+    bool                  ready;
+    lwm2m_transaction_t * queueHead;
+    lwm2m_transaction_t * queueTail;
+    lwm2m_timer_t         idleTimer;    // drops the state of an idle peer
+} lwm2m_peer_t;
+
+typedef struct
+{
+    lwm2m_peer_t ** buckets;            // keyed by peer session handle
+    size_t          size;               // a power of two
+    size_t          count;
+    uint16_t        nstart;             // transactions in flight per peer, 0 for LWM2M_NSTART
+    size_t          maxInFlight;        // transactions in flight for all the peers, 0 for no limit
+    size_t          inFlight;
+    lwm2m_peer_t *  readyHead;          // served in turn as slots get free
+    lwm2m_peer_t *  readyTail;
+    lwm2m_timer_t   timer;              // sends the transactions whose turn came
+} lwm2m_peer_table_t;
+
+/*
+ * LWM2M block2 data
+ *
+ * Serialized response kept while a peer fetches it block by block, so the
+ * following blocks do not read and serialize the resource again.
+ */
+typedef struct _lwm2m_block2_data_
+{
+    struct _lwm2m_block2_data_ * next;
+    void *        sessionH;
+    lwm2m_uri_t   uri;
+    int           accept;       // Accept of the request, BLOCK2_ACCEPT_NONE or BLOCK2_ACCEPT_ANY
+    uint16_t      format;       // Content-Format of the payload
+    uint8_t *     payload;
+    size_t        length;
+    lwm2m_timer_t timer;
+} lwm2m_block2_data_t;
+
+/*
+ * LWM2M deduplication cache
+ *
+ * Serialized responses to the CON requests received, kept for
+ * COAP_EXCHANGE_LIFETIME so that a retransmitted request gets the same
+ * response again instead of being handled a second time.
+ */
+typedef struct _lwm2m_dedup_entry_
+{
+    struct _lwm2m_dedup_entry_ * next;  // in the bucket of the peer, or in the free list
+    struct _lwm2m_dedup_entry_ * older; // in the order of arrival
+    struct _lwm2m_dedup_entry_ * newer;
+    void *    sessionH;
+    uint16_t  mid;
+    time_t    expiry;
+    uint8_t * response;                 // COAP_MAX_PACKET_SIZE bytes of the store
+    size_t    length;
+} lwm2m_dedup_entry_t;
+
+typedef struct
+{
+    lwm2m_dedup_entry_t ** buckets;     // keyed by peer session handle
+    size_t                 size;        // a power of two
+    lwm2m_dedup_entry_t *  entries;     // the store, allocated by lwm2m_init()
+    lwm2m_dedup_entry_t *  freeList;
+    size_t                 count;
+    lwm2m_dedup_entry_t *  oldest;
+    lwm2m_dedup_entry_t *  newest;
+    lwm2m_timer_t          timer;       // drops the expired entries
+} lwm2m_dedup_cache_t;
+
 /*
  * LWM2M observed resources
  */
@@ -600,11 +925,15 @@ typedef struct _lwm2m_watcher_
     time_t lastTime;
     uint32_t counter;
     uint16_t lastMid;
+    uint16_t blockSize;     // Block2 size asked in the observe request, 0 if none
     union
     {
         int64_t asInteger;
         double  asFloat;
     } lastValue;
+    // used while stepping the observed resource
+    bool notify;
+    struct _lwm2m_watcher_ * groupNext;
 } lwm2m_watcher_t;
 
 typedef struct _lwm2m_observed_
@@ -613,6 +942,7 @@ typedef struct _lwm2m_observed_
 
     lwm2m_uri_t uri;
     lwm2m_watcher_t * watcherList;
+    lwm2m_timer_t timer;
 } lwm2m_observed_t;
 
 #ifdef LWM2M_CLIENT_MODE
@@ -643,7 +973,7 @@ typedef enum
 typedef int (*lwm2m_bootstrap_callback_t) (void * sessionH, uint8_t status, lwm2m_uri_t * uriP, char * name, void * userData);
 #endif
 
-typedef struct
+typedef struct _lwm2m_context_
 {
 #ifdef LWM2M_CLIENT_MODE
     lwm2m_client_state_t state;
@@ -654,11 +984,19 @@ typedef struct
     lwm2m_server_t *     serverList;
     lwm2m_object_t *     objectList;
     lwm2m_observed_t *   observedList;
+    uint8_t *            registerPayload;       // cached link-format list of the objects, NULL when out of date
+    int                  registerPayloadLength;
 #endif
 #ifdef LWM2M_SERVER_MODE
     lwm2m_client_t *        clientList;
+    lwm2m_client_registry_t clientRegistry;
+    lwm2m_object_list_table_t objectLists;
     lwm2m_result_callback_t monitorCallback;
     void *                  monitorUserData;
+    lwm2m_observe_release_callback_t observeReleaseCallback;
+    void *                  observeReleaseUserData;
+    lwm2m_bulk_t *          bulkList;       // bulk operations in progress
+    lwm2m_completion_queue_t completions;   // results of the requests made without a callback
 #endif
 #ifdef LWM2M_BOOTSTRAP_SERVER_MODE
     lwm2m_bootstrap_callback_t bootstrapCallback;
@@ -666,6 +1004,18 @@ typedef struct
 #endif
     uint16_t                nextMID;
     lwm2m_transaction_t *   transactionList;
+    lwm2m_transaction_index_t transactionIndex;
+    lwm2m_peer_table_t      peers;          // congestion control of the transactions
+    lwm2m_timer_heap_t      timers;
+    lwm2m_block2_data_t *   block2List;     // responses being fetched block by block
+    lwm2m_dedup_cache_t     dedupCache;     // responses to the CON requests received
+#if defined(LWM2M_SERVER_MODE) || defined(LWM2M_BOOTSTRAP_SERVER_MODE)
+    uint16_t                block1Size;     // size of the Block1 requests sent, 0 for the default
+    uint8_t                 block1Window;   // blocks sent without waiting for the previous ones, 0 for 1
+#endif
+    uint8_t *               txBuffer;       // serialization buffer reused by every outgoing message
+    size_t                  txBufferSize;
+    uint8_t *               payloadBuffer;  // payload of the read responses, of REST_MAX_CHUNK_SIZE bytes
     void *                  userData;
 } lwm2m_context_t;
 
@@ -679,6 +1029,11 @@ void lwm2m_close(lwm2m_context_t * contextP);
 int lwm2m_step(lwm2m_context_t * contextP, time_t * timeoutP);
 // dispatch received data to liblwm2m
 void lwm2m_handle_packet(lwm2m_context_t * contextP, uint8_t * buffer, int length, void * fromSessionH);
+// Congestion control of the requests sent. Up to nstart requests are in flight for each peer (LWM2M_NSTART, 1 by
+// default), the following ones wait for their turn. When maxInFlight is not 0, it limits the requests in flight for
+// all the peers together and the peers with waiting requests are served in turn.
+// Returns COAP_400_BAD_REQUEST if a parameter is invalid, COAP_NO_ERROR otherwise.
+int lwm2m_set_congestion_options(lwm2m_context_t * contextP, uint16_t nstart, size_t maxInFlight);
 
 #ifdef LWM2M_CLIENT_MODE
 // configure the client side with the Endpoint Name, binding, MSISDN (can be nil), alternative path
@@ -691,7 +1046,8 @@ int lwm2m_remove_object(lwm2m_context_t * contextP, uint16_t id);
 
 // send a registration update to the server specified by the server short identifier
 // or all if the ID is 0.
-// If withObjects is true, the registration update contains the object list.
+// If withObjects is true, the registration update contains the object list. This also refreshes the object list
+// sent on later registrations: call it after adding or removing object instances outside of liblwm2m.
 int lwm2m_update_registration(lwm2m_context_t * contextP, uint16_t shortServerID, bool withObjects);
 
 void lwm2m_resource_value_changed(lwm2m_context_t * contextP, lwm2m_uri_t * uriP);
@@ -706,6 +1062,23 @@ void lwm2m_resource_value_changed(lwm2m_context_t * contextP, lwm2m_uri_t * uriP
 // The lwm2m_client_t is present in the lwm2m_context_t's clientList when the callback is called. On a deregistration, it deleted when the callback returns.
 void lwm2m_set_monitoring_callback(lwm2m_context_t * contextP, lwm2m_result_callback_t callback, void * userData);
 
+// Returns the registered client with the given internal ID or NULL. Constant time, unlike walking the clientList.
+lwm2m_client_t * lwm2m_get_client(lwm2m_context_t * contextP, uint16_t clientID);
+lwm2m_client_t * lwm2m_get_client_by_name(lwm2m_context_t * contextP, const char * name);
+
+// Memory used by the object lists of the registered clients. Identical lists are stored once:
+// savedBytes is what one copy per client would use in addition, savedPerClient is savedBytes / clients.
+typedef struct
+{
+    size_t clients;
+    size_t lists;           // distinct object lists
+    size_t bytes;
+    size_t savedBytes;
+    size_t savedPerClient;
+} lwm2m_object_list_stats_t;
+
+void lwm2m_get_object_list_stats(lwm2m_context_t * contextP, lwm2m_object_list_stats_t * statsP);
+
 // Device Management APIs
 int lwm2m_dm_read(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
 int lwm2m_dm_discover(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
@@ -718,6 +1091,34 @@ int lwm2m_dm_delete(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t *
 // Information Reporting APIs
 int lwm2m_observe(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
 int lwm2m_observe_cancel(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+// The release callback is called when an observation ends: after its last result on an error or a cancellation,
+// when lwm2m_observe() gives it another callback or userData, when its object or instance is no longer registered
+// and when its client is freed, on deregistration, expiry or lwm2m_close(). It is not called for an observation
+// lwm2m_observe() returned a COAP_* error code for: the caller still owns its userData.
+void lwm2m_set_observe_release_callback(lwm2m_context_t * contextP, lwm2m_observe_release_callback_t callback, void * userData);
+
+// Bulk operation API.
+// Runs the operation against the clients listed in requestP, or the registered clients accepted by its filter,
+// or all the registered clients. The targets are taken when the operation starts.
+// resultCallback is called for each client like for a single lwm2m_dm_*() call. The notifications of a bulk
+// observe go to it too, with userData.
+// doneCallback is called with the final counters once every started request is answered, then the bulk is freed.
+// bulkP, if not NULL, receives a handle to follow the progress or to cancel the operation. The handle is freed when
+// doneCallback returns, or when the last result is reported if there is no doneCallback: it must not be used after.
+int lwm2m_bulk_start(lwm2m_context_t * contextP, lwm2m_bulk_request_t * requestP, lwm2m_result_callback_t resultCallback, lwm2m_bulk_callback_t doneCallback, void * userData, lwm2m_bulk_t ** bulkP);
+// Starts no more requests. The ones in flight are still reported before doneCallback is called.
+void lwm2m_bulk_cancel(lwm2m_context_t * contextP, lwm2m_bulk_t * bulkP);
+
+// Completion queue API.
+// Once the queue has a capacity, the requests made with a NULL callback (lwm2m_dm_*(), lwm2m_observe(),
+// lwm2m_observe_cancel() and lwm2m_bulk_start()) post their results, and the notifications of such observations,
+// to the queue of the context instead of calling back. Each record carries the userData of the request.
+// A capacity of 0 disables the queue, the results of the requests without a callback are then dropped.
+// Returns COAP_400_BAD_REQUEST if the records queued do not fit in the new capacity.
+int lwm2m_set_completion_queue(lwm2m_context_t * contextP, size_t capacity);
+// Moves up to maxCount records, oldest first, to recordsP and returns their number. Call it after lwm2m_step()
+// and lwm2m_handle_packet(). The data of a record belongs to the caller, who frees it with lwm2m_free().
+size_t lwm2m_poll_completions(lwm2m_context_t * contextP, lwm2m_completion_t * recordsP, size_t maxCount);
 #endif
 
 #ifdef LWM2M_BOOTSTRAP_SERVER_MODE
@@ -733,6 +1134,51 @@ int lwm2m_bootstrap_finish(lwm2m_context_t * contextP, void * sessionH);
 
 #endif
 
+#if defined(LWM2M_SERVER_MODE) || defined(LWM2M_BOOTSTRAP_SERVER_MODE)
+// Block1 transfers of the payloads of lwm2m_dm_write(), lwm2m_dm_create(), lwm2m_dm_execute() and lwm2m_bootstrap_write().
+// Payloads larger than blockSize are sent in blocks of blockSize bytes, a power of two from 16 to 1024 (1024 by default).
+// The client may ask for smaller blocks in its answers. Once the client answered the first block, up to window blocks
+// are sent without waiting for the answers to the previous ones (1 by default). The client must then get the blocks in order.
+// The result callback is called once with the answer to the last block, or the first error.
+// Returns COAP_400_BAD_REQUEST if a parameter is invalid, COAP_NO_ERROR otherwise.
+int lwm2m_set_block1_options(lwm2m_context_t * contextP, uint16_t blockSize, uint8_t window);
+#endif
+
+#ifdef LWM2M_WITH_POOLS
+/*
+ * Object pools
+ *
+ * When LWM2M_WITH_POOLS is defined, the core allocates its small fixed-size
+ * structures from static pools instead of lwm2m_malloc(). The capacity of
+ * each pool is set by LWM2M_POOL_<TYPE>_COUNT. When a pool is full,
+ * lwm2m_malloc() is used unless LWM2M_POOL_STATIC_ONLY is defined.
+ */
+
+typedef enum
+{
+    LWM2M_POOL_TRANSACTION = 0,
+    LWM2M_POOL_PACKET,          // CoAP message of a transaction
+    LWM2M_POOL_DM_DATA,         // server only
+    LWM2M_POOL_WATCHER,         // client only
+    LWM2M_POOL_OBSERVATION,     // server only
+    LWM2M_POOL_OPTION,          // CoAP multi-valued option
+    LWM2M_POOL_COUNT
+} lwm2m_pool_type_t;
+
+typedef struct
+{
+    size_t      objectSize;
+    size_t      capacity;       // number of static slots
+    size_t      used;           // objects currently allocated, in the pool or not
+    size_t      peak;           // highest value of used
+    uint32_t    allocations;
+    uint32_t    fallbacks;      // allocations done with lwm2m_malloc() because the pool was full
+    uint32_t    failures;
+} lwm2m_pool_stats_t;
+
+void lwm2m_pool_get_stats(lwm2m_pool_type_t type, lwm2m_pool_stats_t * statsP);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
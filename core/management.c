@@ -211,7 +211,7 @@ uint8_t dm_handleRequest(lwm2m_context_t * contextP,
                 result = object_readData(contextP, uriP, &size, &dataP);
                 if (COAP_205_CONTENT == result)
                 {
-                    result = observe_handleRequest(contextP, uriP, serverP, size, dataP, message, response);
+                    result = observe_handleRequest(contextP, uriP, serverP, dataP, message, response);
                     if (COAP_205_CONTENT == result)
                     {
                         if (IS_OPTION(message, COAP_OPTION_ACCEPT))
@@ -367,11 +367,12 @@ static void prv_resultCallback(lwm2m_transaction_t * transacP,
 
     if (message == NULL)
     {
-        dataP->callback(dataP->clientID,
-                        &dataP->uri,
-                        COAP_503_SERVICE_UNAVAILABLE,
-                        LWM2M_CONTENT_TEXT, NULL, 0,
-                        dataP->userData);
+        completion_report(dataP->contextP, dataP->callback,
+                          dataP->clientID,
+                          &dataP->uri,
+                          COAP_503_SERVICE_UNAVAILABLE,
+                          LWM2M_CONTENT_TEXT, NULL, 0,
+                          dataP->userData);
     }
     else
     {
@@ -406,15 +407,16 @@ static void prv_resultCallback(lwm2m_transaction_t * transacP,
             lwm2m_free(locationString);
         }
 
-        dataP->callback(dataP->clientID,
-                        &dataP->uri,
-                        packet->code,
-                        utils_convertMediaType(packet->content_type),
-                        packet->payload,
-                        packet->payload_len,
-                        dataP->userData);
+        completion_report(dataP->contextP, dataP->callback,
+                          dataP->clientID,
+                          &dataP->uri,
+                          packet->code,
+                          utils_convertMediaType(packet->content_type),
+                          packet->payload,
+                          packet->payload_len,
+                          dataP->userData);
     }
-    lwm2m_free(dataP);
+    POOL_FREE(LWM2M_POOL_DM_DATA, dataP);
 }
 
 static int prv_makeOperation(lwm2m_context_t * contextP,
@@ -431,7 +433,7 @@ static int prv_makeOperation(lwm2m_context_t * contextP,
     lwm2m_transaction_t * transaction;
     dm_data_t * dataP;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registry_findById(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     transaction = transaction_new(clientP->sessionH, method, clientP->altPath, uriP, contextP->nextMID++, 4, NULL);
@@ -444,19 +446,19 @@ static int prv_makeOperation(lwm2m_context_t * contextP,
     else if (buffer != NULL)
     {
         coap_set_header_content_type(transaction->message, format);
-        // TODO: Take care of fragmentation
-        coap_set_payload(transaction->message, buffer, length);
     }
 
-    if (callback != NULL)
+    // without a callback, the result goes to the completion queue if any
+    if (callback != NULL || contextP->completions.size != 0)
     {
-        dataP = (dm_data_t *)lwm2m_malloc(sizeof(dm_data_t));
+        dataP = POOL_ALLOC(LWM2M_POOL_DM_DATA, dm_data_t);
         if (dataP == NULL)
         {
             transaction_free(transaction);
             return COAP_500_INTERNAL_SERVER_ERROR;
         }
         memcpy(&dataP->uri, uriP, sizeof(lwm2m_uri_t));
+        dataP->contextP = contextP;
         dataP->clientID = clientP->internalID;
         dataP->callback = callback;
         dataP->userData = userData;
@@ -465,7 +467,13 @@ static int prv_makeOperation(lwm2m_context_t * contextP,
         transaction->userData = (void *)dataP;
     }
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    if (method != COAP_GET && buffer != NULL)
+    {
+        // sent in blocks when larger than the block size
+        return block1_send(contextP, transaction, buffer, (size_t)length);
+    }
+
+    transaction_add(contextP, transaction);
 
     return transaction_send(contextP, transaction);
 }
@@ -482,10 +490,14 @@ int lwm2m_dm_read(lwm2m_context_t * contextP,
     LOG_ARG("clientID: %d", clientID);
     LOG_URI(uriP);
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registry_findById(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
-    if (clientP->supportJSON == true)
+    if (clientP->supportSenmlCbor == true)
+    {
+        format = LWM2M_CONTENT_SENML_CBOR;
+    }
+    else if (clientP->supportJSON == true)
     {
         format = LWM2M_CONTENT_JSON;
     }
@@ -623,23 +635,24 @@ int lwm2m_dm_write_attributes(lwm2m_context_t * contextP,
     if (ATTR_FLAG_NUMERIC == (attrP->toSet & ATTR_FLAG_NUMERIC)
      && (attrP->lessThan + 2 * attrP->step >= attrP->greaterThan)) return COAP_400_BAD_REQUEST;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registry_findById(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     transaction = transaction_new(clientP->sessionH, COAP_PUT, clientP->altPath, uriP, contextP->nextMID++, 4, NULL);
     if (transaction == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
-    if (callback != NULL)
+    if (callback != NULL || contextP->completions.size != 0)
     {
         dm_data_t * dataP;
 
-        dataP = (dm_data_t *)lwm2m_malloc(sizeof(dm_data_t));
+        dataP = POOL_ALLOC(LWM2M_POOL_DM_DATA, dm_data_t);
         if (dataP == NULL)
         {
             transaction_free(transaction);
             return COAP_500_INTERNAL_SERVER_ERROR;
         }
         memcpy(&dataP->uri, uriP, sizeof(lwm2m_uri_t));
+        dataP->contextP = contextP;
         dataP->clientID = clientP->internalID;
         dataP->callback = callback;
         dataP->userData = userData;
@@ -736,7 +749,7 @@ int lwm2m_dm_write_attributes(lwm2m_context_t * contextP,
         SET_OPTION(coap_pkt, COAP_OPTION_URI_QUERY);
     }
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
 
     return transaction_send(contextP, transaction);
 }
@@ -753,7 +766,7 @@ int lwm2m_dm_discover(lwm2m_context_t * contextP,
 
     LOG_ARG("clientID: %d", clientID);
     LOG_URI(uriP);
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registry_findById(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     transaction = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, 4, NULL);
@@ -761,15 +774,16 @@ int lwm2m_dm_discover(lwm2m_context_t * contextP,
 
     coap_set_header_accept(transaction->message, LWM2M_CONTENT_LINK);
 
-    if (callback != NULL)
+    if (callback != NULL || contextP->completions.size != 0)
     {
-        dataP = (dm_data_t *)lwm2m_malloc(sizeof(dm_data_t));
+        dataP = POOL_ALLOC(LWM2M_POOL_DM_DATA, dm_data_t);
         if (dataP == NULL)
         {
             transaction_free(transaction);
             return COAP_500_INTERNAL_SERVER_ERROR;
         }
         memcpy(&dataP->uri, uriP, sizeof(lwm2m_uri_t));
+        dataP->contextP = contextP;
         dataP->clientID = clientP->internalID;
         dataP->callback = callback;
         dataP->userData = userData;
@@ -778,7 +792,7 @@ int lwm2m_dm_discover(lwm2m_context_t * contextP,
         transaction->userData = (void *)dataP;
     }
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
 
     return transaction_send(contextP, transaction);
 }
@@ -0,0 +1,390 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * Object lists of the clients registered to a LWM2M Server.
+ *
+ * A list is stored in a single allocation: the lwm2m_client_object_list_t
+ * header, the objects sorted by ID, their sorted instance IDs and the
+ * alternate path. Lists are interned in a hash table of the context and
+ * shared by all the clients which declared the same objects, instances and
+ * alternate path, so a fleet of identical devices keeps a single copy.
+ * An interned list is never modified: a registration update declaring other
+ * objects makes the client switch to another list and release its previous one.
+ *
+ * The links given to objectlist_intern() are the (object ID << 16 | instance ID)
+ * values of the registration payload, sorted and without duplicates. An object
+ * declared without instance uses LWM2M_MAX_ID, which sorts after its instances.
+ */
+
+#include "internals.h"
+
+#ifdef LWM2M_SERVER_MODE
+
+#define PRV_TABLE_MIN_SIZE  16
+#define PRV_NO_INSTANCE     LWM2M_MAX_ID
+
+#define PRV_LINK_OBJECT(L)      ((uint16_t)((L) >> 16))
+#define PRV_LINK_INSTANCE(L)    ((uint16_t)((L) & 0xFFFF))
+
+static uint32_t prv_hash(const uint32_t * links,
+                         size_t count,
+                         const uint8_t * altPath,
+                         size_t altPathLength)
+{
+    uint32_t hash;
+    uint8_t bytes[4];
+    size_t i;
+
+    hash = UTILS_HASH_SEED;
+    for (i = 0 ; i < count ; i++)
+    {
+        bytes[0] = (uint8_t)(links[i] >> 24);
+        bytes[1] = (uint8_t)(links[i] >> 16);
+        bytes[2] = (uint8_t)(links[i] >> 8);
+        bytes[3] = (uint8_t)links[i];
+        hash = utils_hashBytes(hash, bytes, sizeof(bytes));
+    }
+    // separate the links from the alternate path
+    bytes[0] = 0xFF;
+    hash = utils_hashBytes(hash, bytes, 1);
+
+    return utils_hashBytes(hash, altPath, altPathLength);
+}
+
+// drop the links of objects declared both with and without instances
+static size_t prv_normalize(uint32_t * links,
+                            size_t count)
+{
+    size_t i;
+    size_t j;
+
+    j = 0;
+    for (i = 0 ; i < count ; i++)
+    {
+        if (PRV_LINK_INSTANCE(links[i]) == PRV_NO_INSTANCE
+         && j > 0
+         && PRV_LINK_OBJECT(links[j - 1]) == PRV_LINK_OBJECT(links[i]))
+        {
+            continue;
+        }
+        links[j++] = links[i];
+    }
+
+    return j;
+}
+
+static bool prv_matches(lwm2m_client_object_list_t * listP,
+                        const uint32_t * links,
+                        size_t count,
+                        const uint8_t * altPath,
+                        size_t altPathLength)
+{
+    size_t index;
+    uint16_t i;
+    uint16_t j;
+
+    if (altPathLength == 0)
+    {
+        if (listP->altPath != NULL) return false;
+    }
+    else
+    {
+        if (listP->altPath == NULL
+         || strlen(listP->altPath) != altPathLength
+         || memcmp(listP->altPath, altPath, altPathLength) != 0)
+        {
+            return false;
+        }
+    }
+
+    index = 0;
+    for (i = 0 ; i < listP->count ; i++)
+    {
+        lwm2m_client_object_t * objectP = listP->objects + i;
+
+        if (objectP->instanceCount == 0)
+        {
+            if (index >= count
+             || links[index] != (((uint32_t)objectP->id << 16) | PRV_NO_INSTANCE))
+            {
+                return false;
+            }
+            index++;
+        }
+        for (j = 0 ; j < objectP->instanceCount ; j++)
+        {
+            if (index >= count
+             || links[index] != (((uint32_t)objectP->id << 16) | objectP->instances[j]))
+            {
+                return false;
+            }
+            index++;
+        }
+    }
+
+    return index == count;
+}
+
+static lwm2m_client_object_list_t * prv_build(const uint32_t * links,
+                                              size_t count,
+                                              const uint8_t * altPath,
+                                              size_t altPathLength)
+{
+    lwm2m_client_object_list_t * listP;
+    lwm2m_client_object_t * objectP;
+    uint16_t * instanceP;
+    size_t objectCount;
+    size_t instanceCount;
+    size_t size;
+    size_t i;
+
+    objectCount = 0;
+    instanceCount = 0;
+    for (i = 0 ; i < count ; i++)
+    {
+        if (i == 0 || PRV_LINK_OBJECT(links[i]) != PRV_LINK_OBJECT(links[i - 1])) objectCount++;
+        if (PRV_LINK_INSTANCE(links[i]) != PRV_NO_INSTANCE) instanceCount++;
+    }
+    if (objectCount > UINT16_MAX) return NULL;
+
+    size = sizeof(lwm2m_client_object_list_t)
+         + objectCount * sizeof(lwm2m_client_object_t)
+         + instanceCount * sizeof(uint16_t);
+    if (altPathLength != 0) size += altPathLength + 1;
+
+    listP = (lwm2m_client_object_list_t *)lwm2m_malloc(size);
+    if (listP == NULL) return NULL;
+    memset(listP, 0, sizeof(lwm2m_client_object_list_t));
+    listP->size = size;
+    listP->count = (uint16_t)objectCount;
+    listP->objects = (lwm2m_client_object_t *)(listP + 1);
+    instanceP = (uint16_t *)(listP->objects + objectCount);
+    if (altPathLength != 0)
+    {
+        listP->altPath = (char *)(instanceP + instanceCount);
+        memcpy(listP->altPath, altPath, altPathLength);
+        listP->altPath[altPathLength] = 0;
+    }
+
+    objectP = NULL;
+    for (i = 0 ; i < count ; i++)
+    {
+        if (objectP == NULL || objectP->id != PRV_LINK_OBJECT(links[i]))
+        {
+            objectP = (objectP == NULL) ? listP->objects : objectP + 1;
+            objectP->id = PRV_LINK_OBJECT(links[i]);
+            objectP->instanceCount = 0;
+            objectP->instances = instanceP;
+        }
+        if (PRV_LINK_INSTANCE(links[i]) != PRV_NO_INSTANCE)
+        {
+            *instanceP = PRV_LINK_INSTANCE(links[i]);
+            instanceP++;
+            objectP->instanceCount++;
+        }
+    }
+
+    return listP;
+}
+
+static size_t prv_hashList(void * listP)
+{
+    return ((lwm2m_client_object_list_t *)listP)->hash;
+}
+
+lwm2m_client_object_list_t * objectlist_intern(lwm2m_context_t * contextP,
+                                               uint32_t * links,
+                                               size_t count,
+                                               const uint8_t * altPath,
+                                               size_t altPathLength)
+{
+    lwm2m_object_list_table_t * tableP = &contextP->objectLists;
+    lwm2m_client_object_list_t ** bucketsP;
+    lwm2m_client_object_list_t * listP;
+    uint32_t hash;
+    size_t size;
+
+    count = prv_normalize(links, count);
+    if (count == 0) return NULL;
+    hash = prv_hash(links, count, altPath, altPathLength);
+
+    if (tableP->size != 0)
+    {
+        for (listP = tableP->buckets[utils_hashBucket(hash, tableP->size)] ; listP != NULL ; listP = listP->next)
+        {
+            if (listP->hash == hash
+             && prv_matches(listP, links, count, altPath, altPathLength))
+            {
+                listP->refCount++;
+                return listP;
+            }
+        }
+    }
+
+    size = utils_hashTableSize(tableP->size, tableP->count, PRV_TABLE_MIN_SIZE);
+    if (size != tableP->size)
+    {
+        bucketsP = (lwm2m_client_object_list_t **)utils_hashTableResize((void **)tableP->buckets, tableP->size, size, offsetof(lwm2m_client_object_list_t, next), prv_hashList);
+        if (bucketsP != NULL)
+        {
+            tableP->buckets = bucketsP;
+            tableP->size = size;
+        }
+        else if (tableP->size == 0)
+        {
+            return NULL;
+        }
+    }
+
+    listP = prv_build(links, count, altPath, altPathLength);
+    if (listP == NULL) return NULL;
+    listP->hash = hash;
+    listP->refCount = 1;
+    listP->next = tableP->buckets[utils_hashBucket(hash, tableP->size)];
+    tableP->buckets[utils_hashBucket(hash, tableP->size)] = listP;
+    tableP->count++;
+
+    LOG_ARG("New object list: %d objects, %d bytes", listP->count, listP->size);
+
+    return listP;
+}
+
+void objectlist_release(lwm2m_context_t * contextP,
+                        lwm2m_client_object_list_t * listP)
+{
+    lwm2m_object_list_table_t * tableP = &contextP->objectLists;
+    lwm2m_client_object_list_t ** targetP;
+
+    if (listP == NULL) return;
+
+    listP->refCount--;
+    if (listP->refCount != 0) return;
+
+    targetP = tableP->buckets + utils_hashBucket(listP->hash, tableP->size);
+    while (*targetP != NULL && *targetP != listP)
+    {
+        targetP = &(*targetP)->next;
+    }
+    if (*targetP != NULL)
+    {
+        *targetP = listP->next;
+        tableP->count--;
+    }
+    lwm2m_free(listP);
+}
+
+lwm2m_client_object_t * objectlist_findObject(lwm2m_client_object_list_t * listP,
+                                              uint16_t id)
+{
+    size_t low;
+    size_t high;
+
+    if (listP == NULL) return NULL;
+
+    low = 0;
+    high = listP->count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (listP->objects[middle].id == id) return listP->objects + middle;
+        if (listP->objects[middle].id < id)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return NULL;
+}
+
+bool objectlist_hasInstance(lwm2m_client_object_t * objectP,
+                            uint16_t id)
+{
+    size_t low;
+    size_t high;
+
+    low = 0;
+    high = objectP->instanceCount;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (objectP->instances[middle] == id) return true;
+        if (objectP->instances[middle] < id)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return false;
+}
+
+void objectlist_close(lwm2m_context_t * contextP)
+{
+    lwm2m_object_list_table_t * tableP = &contextP->objectLists;
+    size_t i;
+
+    for (i = 0 ; i < tableP->size ; i++)
+    {
+        while (tableP->buckets[i] != NULL)
+        {
+            lwm2m_client_object_list_t * listP = tableP->buckets[i];
+
+            tableP->buckets[i] = listP->next;
+            lwm2m_free(listP);
+        }
+    }
+    if (tableP->buckets != NULL) lwm2m_free(tableP->buckets);
+    memset(tableP, 0, sizeof(lwm2m_object_list_table_t));
+}
+
+void lwm2m_get_object_list_stats(lwm2m_context_t * contextP,
+                                 lwm2m_object_list_stats_t * statsP)
+{
+    lwm2m_object_list_table_t * tableP = &contextP->objectLists;
+    size_t i;
+
+    memset(statsP, 0, sizeof(lwm2m_object_list_stats_t));
+
+    for (i = 0 ; i < tableP->size ; i++)
+    {
+        lwm2m_client_object_list_t * listP;
+
+        for (listP = tableP->buckets[i] ; listP != NULL ; listP = listP->next)
+        {
+            statsP->lists++;
+            statsP->clients += listP->refCount;
+            statsP->bytes += listP->size;
+            statsP->savedBytes += (listP->refCount - 1) * listP->size;
+        }
+    }
+    if (statsP->clients != 0)
+    {
+        statsP->savedPerClient = statsP->savedBytes / statsP->clients;
+    }
+}
+
+#endif
@@ -105,6 +105,7 @@ uint8_t object_checkReadable(lwm2m_context_t * contextP,
     return result;
 }
 
+// A single resource is read in the record given in *dataP, if any.
 uint8_t object_readData(lwm2m_context_t * contextP,
                         lwm2m_uri_t * uriP,
                         int * sizeP,
@@ -126,8 +127,11 @@ uint8_t object_readData(lwm2m_context_t * contextP,
         if (LWM2M_URI_IS_SET_RESOURCE(uriP))
         {
             *sizeP = 1;
-            *dataP = lwm2m_data_new(*sizeP);
-            if (*dataP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+            if (*dataP == NULL)
+            {
+                *dataP = lwm2m_data_new(*sizeP);
+                if (*dataP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+            }
 
             (*dataP)->id = uriP->resourceId;
         }
@@ -181,26 +185,45 @@ uint8_t object_read(lwm2m_context_t * contextP,
                     size_t * lengthP)
 {
     uint8_t result;
-    lwm2m_data_t * dataP = NULL;
+    lwm2m_data_t record;
+    lwm2m_data_t * dataP;
+    utils_buffer_t output;
     int size = 0;
     int res;
 
     LOG_URI(uriP);
+    memset(&record, 0, sizeof(lwm2m_data_t));
+    dataP = LWM2M_URI_IS_SET_RESOURCE(uriP) ? &record : NULL;
     result = object_readData(contextP, uriP, &size, &dataP);
 
     if (result == COAP_205_CONTENT)
     {
-        res = lwm2m_data_serialize(uriP, size, dataP, formatP, bufferP);
+        // the payload is built in the buffer of the context, or on the heap when it does not fit
+        if (contextP->payloadBuffer == NULL)
+        {
+            contextP->payloadBuffer = (uint8_t *)lwm2m_malloc(REST_MAX_CHUNK_SIZE);
+        }
+        utils_bufferInit(&output, contextP->payloadBuffer, REST_MAX_CHUNK_SIZE, false);
+        res = data_serializeTo(uriP, size, dataP, formatP, &output);
         if (res < 0)
         {
+            utils_bufferFree(&output);
             result = COAP_500_INTERNAL_SERVER_ERROR;
         }
         else
         {
-            *lengthP = (size_t)res;
+            *bufferP = output.data;
+            *lengthP = output.length;
         }
     }
-    lwm2m_data_free(size, dataP);
+    if (dataP == &record)
+    {
+        data_freeContent(size, dataP);
+    }
+    else
+    {
+        lwm2m_data_free(size, dataP);
+    }
 
     LOG_ARG("result: %u.%2u, length: %d", (result & 0xFF) >> 5, (result & 0x1F), *lengthP);
 
@@ -323,6 +346,10 @@ uint8_t object_create(lwm2m_context_t * contextP,
 
 exit:
     lwm2m_data_free(size, dataP);
+    if (result == COAP_201_CREATED)
+    {
+        object_invalidateRegisterPayload(contextP);
+    }
 
     LOG_ARG("result: %u.%2u", (result & 0xFF) >> 5, (result & 0x1F));
 
@@ -370,6 +397,8 @@ uint8_t object_delete(lwm2m_context_t * contextP,
             instanceP = objectP->instanceList;
         }
     }
+    // instances may have been deleted even if the last one failed
+    object_invalidateRegisterPayload(contextP);
 
     LOG_ARG("result: %u.%2u", (result & 0xFF) >> 5, (result & 0x1F));
 
@@ -653,6 +682,44 @@ int object_getRegisterPayload(lwm2m_context_t * contextP,
     return index;
 }
 
+uint8_t * object_getCachedRegisterPayload(lwm2m_context_t * contextP,
+                                          int * lengthP)
+{
+    int length;
+
+    if (contextP->registerPayload == NULL)
+    {
+        length = object_getRegisterPayloadBufferLength(contextP);
+        if (length == 0) return NULL;
+        contextP->registerPayload = (uint8_t *)lwm2m_malloc(length);
+        if (contextP->registerPayload == NULL) return NULL;
+        length = object_getRegisterPayload(contextP, contextP->registerPayload, length);
+        if (length == 0)
+        {
+            object_invalidateRegisterPayload(contextP);
+            return NULL;
+        }
+        contextP->registerPayloadLength = length;
+    }
+    else
+    {
+        LOG("Reusing the cached payload");
+    }
+
+    *lengthP = contextP->registerPayloadLength;
+    return contextP->registerPayload;
+}
+
+void object_invalidateRegisterPayload(lwm2m_context_t * contextP)
+{
+    if (contextP->registerPayload != NULL)
+    {
+        lwm2m_free(contextP->registerPayload);
+        contextP->registerPayload = NULL;
+        contextP->registerPayloadLength = 0;
+    }
+}
+
 static lwm2m_list_t * prv_findServerInstance(lwm2m_object_t * objectP,
                                              uint16_t shortID)
 {
@@ -877,6 +944,7 @@ uint8_t object_createInstance(lwm2m_context_t * contextP,
         return COAP_405_METHOD_NOT_ALLOWED;
     }
 
+    object_invalidateRegisterPayload(contextP);
     return targetP->createFunc(lwm2m_list_newId(targetP->instanceList), dataP->value.asChildren.count, dataP->value.asChildren.array, targetP);
 }
 
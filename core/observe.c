@@ -109,9 +109,463 @@ static lwm2m_watcher_t * prv_findWatcher(lwm2m_observed_t * observedP,
     return targetP;
 }
 
+// one per content format a watcher may ask for, see utils_convertMediaType()
+#define PRV_MAX_PAYLOADS        8
+// most notifications fit in there, larger ones move to the heap
+#define PRV_PAYLOAD_STORAGE     128
+
+// payload of a notification, serialized once per requested format
+typedef struct
+{
+    lwm2m_media_type_t  requested;
+    lwm2m_media_type_t  format;
+    utils_buffer_t      output;
+    uint8_t             storage[PRV_PAYLOAD_STORAGE];
+} prv_payload_t;
+
+// Sends the first block of a notification larger than the block size of the
+// observe request. The payload is kept for the server to get the others.
+static void prv_setFirstBlock(lwm2m_context_t * contextP,
+                              lwm2m_observed_t * targetP,
+                              lwm2m_watcher_t * watcherP,
+                              prv_payload_t * payloadP,
+                              coap_packet_t * message)
+{
+    uint8_t * payload;
+
+    payload = (uint8_t *)lwm2m_malloc(payloadP->output.length);
+    if (payload == NULL) return;
+    memcpy(payload, payloadP->output.data, payloadP->output.length);
+    if (!block2_store(contextP, watcherP->server->sessionH, &targetP->uri, BLOCK2_ACCEPT_ANY, payloadP->format, payload, payloadP->output.length))
+    {
+        lwm2m_free(payload);
+        return;
+    }
+    coap_set_header_block2(message, 0, 1, watcherP->blockSize);
+    coap_set_payload(message, payload, watcherP->blockSize);
+}
+
+static bool prv_checkNotify(lwm2m_watcher_t * watcherP,
+                            lwm2m_data_type_t type,
+                            int64_t integerValue,
+                            double floatValue,
+                            time_t currentTime)
+{
+    bool notify = false;
+
+    if (watcherP->update == true)
+    {
+        // value changed, should we notify the server ?
+
+        if (watcherP->parameters == NULL || watcherP->parameters->toSet == 0)
+        {
+            // no conditions
+            notify = true;
+            LOG("Notify with no conditions");
+        }
+
+        if (notify == false
+         && watcherP->parameters != NULL
+         && (watcherP->parameters->toSet & ATTR_FLAG_NUMERIC) != 0)
+        {
+            if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_LESS_THAN) != 0)
+            {
+                LOG("Checking lower threshold");
+                // Did we cross the lower threshold ?
+                switch (type)
+                {
+                case LWM2M_TYPE_INTEGER:
+                    if ((integerValue < watcherP->parameters->lessThan
+                      && watcherP->lastValue.asInteger > watcherP->parameters->lessThan)
+                     || (integerValue > watcherP->parameters->lessThan
+                      && watcherP->lastValue.asInteger < watcherP->parameters->lessThan))
+                    {
+                        LOG("Notify on lower threshold crossing");
+                        notify = true;
+                    }
+                    break;
+                case LWM2M_TYPE_FLOAT:
+                    if ((floatValue < watcherP->parameters->lessThan
+                      && watcherP->lastValue.asFloat > watcherP->parameters->lessThan)
+                     || (floatValue > watcherP->parameters->lessThan
+                      && watcherP->lastValue.asFloat < watcherP->parameters->lessThan))
+                    {
+                        LOG("Notify on lower threshold crossing");
+                        notify = true;
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+            if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_GREATER_THAN) != 0)
+            {
+                LOG("Checking upper threshold");
+                // Did we cross the upper threshold ?
+                switch (type)
+                {
+                case LWM2M_TYPE_INTEGER:
+                    if ((integerValue < watcherP->parameters->greaterThan
+                      && watcherP->lastValue.asInteger > watcherP->parameters->greaterThan)
+                     || (integerValue > watcherP->parameters->greaterThan
+                      && watcherP->lastValue.asInteger < watcherP->parameters->greaterThan))
+                    {
+                        LOG("Notify on lower upper crossing");
+                        notify = true;
+                    }
+                    break;
+                case LWM2M_TYPE_FLOAT:
+                    if ((floatValue < watcherP->parameters->greaterThan
+                      && watcherP->lastValue.asFloat > watcherP->parameters->greaterThan)
+                     || (floatValue > watcherP->parameters->greaterThan
+                      && watcherP->lastValue.asFloat < watcherP->parameters->greaterThan))
+                    {
+                        LOG("Notify on lower upper crossing");
+                        notify = true;
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+            if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_STEP) != 0)
+            {
+                LOG("Checking step");
+
+                switch (type)
+                {
+                case LWM2M_TYPE_INTEGER:
+                {
+                    int64_t diff;
+
+                    diff = integerValue - watcherP->lastValue.asInteger;
+                    if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
+                     || (diff >= 0 && diff >= watcherP->parameters->step))
+                    {
+                        LOG("Notify on step condition");
+                        notify = true;
+                    }
+                }
+                    break;
+                case LWM2M_TYPE_FLOAT:
+                {
+                    double diff;
+
+                    diff = floatValue - watcherP->lastValue.asFloat;
+                    if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
+                     || (diff >= 0 && diff >= watcherP->parameters->step))
+                    {
+                        LOG("Notify on step condition");
+                        notify = true;
+                    }
+                }
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        if (watcherP->parameters != NULL
+         && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0)
+        {
+            LOG_ARG("Checking minimal period (%d s)", watcherP->parameters->minPeriod);
+
+            if (watcherP->lastTime + watcherP->parameters->minPeriod > currentTime)
+            {
+                // Minimum Period did not elapse yet
+                notify = false;
+            }
+            else
+            {
+                LOG("Notify on minimal period");
+                notify = true;
+            }
+        }
+    }
+
+    // Is the Maximum Period reached ?
+    if (notify == false
+     && watcherP->parameters != NULL
+     && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
+    {
+        LOG_ARG("Checking maximal period (%d s)", watcherP->parameters->maxPeriod);
+
+        if (watcherP->lastTime + watcherP->parameters->maxPeriod <= currentTime)
+        {
+            LOG("Notify on maximal period");
+            notify = true;
+        }
+    }
+
+    return notify;
+}
+
+static bool prv_sameValue(const void * value1P,
+                          const void * value2P,
+                          size_t size)
+{
+    // bitwise comparison: watchers in the same group saw exactly the same value
+    return memcmp(value1P, value2P, size) == 0;
+}
+
+static bool prv_sameAttributes(lwm2m_attributes_t * attr1P,
+                               lwm2m_attributes_t * attr2P)
+{
+    uint8_t toSet;
+
+    if (attr1P == attr2P) return true;
+
+    toSet = (attr1P == NULL) ? 0 : attr1P->toSet;
+    if (toSet != ((attr2P == NULL) ? 0 : attr2P->toSet)) return false;
+    if (toSet == 0) return true;
+
+    if ((toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0 && attr1P->minPeriod != attr2P->minPeriod) return false;
+    if ((toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0 && attr1P->maxPeriod != attr2P->maxPeriod) return false;
+    if ((toSet & LWM2M_ATTR_FLAG_GREATER_THAN) != 0
+     && !prv_sameValue(&attr1P->greaterThan, &attr2P->greaterThan, sizeof(double))) return false;
+    if ((toSet & LWM2M_ATTR_FLAG_LESS_THAN) != 0
+     && !prv_sameValue(&attr1P->lessThan, &attr2P->lessThan, sizeof(double))) return false;
+    if ((toSet & LWM2M_ATTR_FLAG_STEP) != 0
+     && !prv_sameValue(&attr1P->step, &attr2P->step, sizeof(double))) return false;
+
+    return true;
+}
+
+// Watchers in the same group reach the same notification decision: same
+// attributes and same state since their last notification.
+static bool prv_sameGroup(lwm2m_watcher_t * watcher1P,
+                          lwm2m_watcher_t * watcher2P,
+                          bool compareValue)
+{
+    return watcher1P->update == watcher2P->update
+        && watcher1P->lastTime == watcher2P->lastTime
+        && prv_sameAttributes(watcher1P->parameters, watcher2P->parameters)
+        && (compareValue == false
+         || prv_sameValue(&watcher1P->lastValue, &watcher2P->lastValue, sizeof(watcher1P->lastValue)));
+}
+
+static prv_payload_t * prv_getPayload(lwm2m_observed_t * targetP,
+                                      int size,
+                                      lwm2m_data_t * dataP,
+                                      lwm2m_media_type_t requested,
+                                      prv_payload_t * payloads,
+                                      int * countP)
+{
+    prv_payload_t * payloadP;
+    int res;
+    int i;
+
+    for (i = 0 ; i < *countP ; i++)
+    {
+        if (payloads[i].requested == requested) return payloads + i;
+    }
+    if (*countP == PRV_MAX_PAYLOADS)
+    {
+        // out of slots, the last one is serialized again for this watcher
+        (*countP)--;
+        utils_bufferFree(&payloads[*countP].output);
+    }
+
+    payloadP = payloads + *countP;
+    payloadP->requested = requested;
+    payloadP->format = requested;
+    utils_bufferInit(&payloadP->output, payloadP->storage, PRV_PAYLOAD_STORAGE, false);
+    res = data_serializeTo(&targetP->uri, size, dataP, &payloadP->format, &payloadP->output);
+    if (res < 0)
+    {
+        utils_bufferFree(&payloadP->output);
+        return NULL;
+    }
+    (*countP)++;
+
+    return payloadP;
+}
+
+static void prv_stepObserved(lwm2m_context_t * contextP,
+                             lwm2m_observed_t * targetP,
+                             time_t currentTime)
+{
+    lwm2m_watcher_t * watcherP;
+    lwm2m_watcher_t * groupList;
+    lwm2m_data_t * dataP = NULL;
+    lwm2m_data_type_t type = LWM2M_TYPE_UNDEFINED;
+    int size = 0;
+    double floatValue = 0;
+    int64_t integerValue = 0;
+    bool storeValue = false;
+    prv_payload_t payloads[PRV_MAX_PAYLOADS];
+    int payloadCount = 0;
+    coap_packet_t message[1];
+
+    LOG_URI(&(targetP->uri));
+    if (LWM2M_URI_IS_SET_RESOURCE(&targetP->uri))
+    {
+        if (COAP_205_CONTENT != object_readData(contextP, &targetP->uri, &size, &dataP)) return;
+        type = dataP->type;
+        switch (dataP->type)
+        {
+        case LWM2M_TYPE_INTEGER:
+            if (1 != lwm2m_data_decode_int(dataP, &integerValue))
+            {
+                lwm2m_data_free(size, dataP);
+                return;
+            }
+            storeValue = true;
+            break;
+        case LWM2M_TYPE_FLOAT:
+            if (1 != lwm2m_data_decode_float(dataP, &floatValue))
+            {
+                lwm2m_data_free(size, dataP);
+                return;
+            }
+            storeValue = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Decide once per group of watchers sharing the same attributes and state.
+    groupList = NULL;
+    for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+    {
+        lwm2m_watcher_t * leaderP;
+
+        watcherP->notify = false;
+        if (watcherP->active == false) continue;
+
+        leaderP = groupList;
+        while (leaderP != NULL && !prv_sameGroup(leaderP, watcherP, storeValue))
+        {
+            leaderP = leaderP->groupNext;
+        }
+        if (leaderP != NULL)
+        {
+            watcherP->notify = leaderP->notify;
+        }
+        else
+        {
+            watcherP->notify = prv_checkNotify(watcherP, type, integerValue, floatValue, currentTime);
+            watcherP->groupNext = groupList;
+            groupList = watcherP;
+        }
+    }
+
+    // Serialize once per format and send the notifications in a row.
+    for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+    {
+        prv_payload_t * payloadP;
+
+        if (watcherP->notify == false) continue;
+        watcherP->notify = false;
+
+        // an object or an instance is read once, on the first notification to send
+        if (dataP == NULL
+         && COAP_205_CONTENT != object_readData(contextP, &targetP->uri, &size, &dataP))
+        {
+            break;
+        }
+
+        payloadP = prv_getPayload(targetP, size, dataP, watcherP->format, payloads, &payloadCount);
+        if (payloadP == NULL) continue;
+
+        coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, 0);
+        coap_set_header_content_type(message, payloadP->format);
+        coap_set_payload(message, payloadP->output.data, payloadP->output.length);
+        if (watcherP->blockSize != 0 && payloadP->output.length > watcherP->blockSize)
+        {
+            prv_setFirstBlock(contextP, targetP, watcherP, payloadP, message);
+        }
+        watcherP->lastTime = currentTime;
+        watcherP->lastMid = contextP->nextMID++;
+        message->mid = watcherP->lastMid;
+        coap_set_header_token(message, watcherP->token, watcherP->tokenLen);
+        coap_set_header_observe(message, watcherP->counter++);
+        (void)message_send(contextP, message, watcherP->server->sessionH);
+        watcherP->update = false;
+
+        // Store this value
+        if (storeValue == true)
+        {
+            switch (type)
+            {
+            case LWM2M_TYPE_INTEGER:
+                watcherP->lastValue.asInteger = integerValue;
+                break;
+            case LWM2M_TYPE_FLOAT:
+                watcherP->lastValue.asFloat = floatValue;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    if (dataP != NULL) lwm2m_data_free(size, dataP);
+    while (payloadCount > 0)
+    {
+        payloadCount--;
+        utils_bufferFree(&payloads[payloadCount].output);
+    }
+}
+
+// schedule the timer of observedP on the earliest event among its watchers:
+// the end of the minimum period when a change is pending, the maximum period.
+static void prv_scheduleObserved(lwm2m_context_t * contextP,
+                                 lwm2m_observed_t * observedP)
+{
+    lwm2m_watcher_t * watcherP;
+    time_t deadline;
+    bool scheduled;
+
+    scheduled = false;
+    deadline = 0;
+    for (watcherP = observedP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+    {
+        if (watcherP->active == true && watcherP->parameters != NULL)
+        {
+            if (watcherP->update == true
+             && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0
+             && (scheduled == false || deadline > watcherP->lastTime + watcherP->parameters->minPeriod))
+            {
+                deadline = watcherP->lastTime + watcherP->parameters->minPeriod;
+                scheduled = true;
+            }
+            if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0
+             && (scheduled == false || deadline > watcherP->lastTime + watcherP->parameters->maxPeriod))
+            {
+                deadline = watcherP->lastTime + watcherP->parameters->maxPeriod;
+                scheduled = true;
+            }
+        }
+    }
+
+    if (scheduled == true)
+    {
+        (void)timer_schedule(contextP, &observedP->timer, deadline);
+    }
+    else
+    {
+        timer_cancel(contextP, &observedP->timer);
+    }
+}
+
+static void prv_observedCallback(lwm2m_context_t * contextP,
+                                 void * userData,
+                                 time_t currentTime)
+{
+    lwm2m_observed_t * observedP = (lwm2m_observed_t *)userData;
+
+    LOG_URI(&(observedP->uri));
+    prv_stepObserved(contextP, observedP, currentTime);
+    prv_scheduleObserved(contextP, observedP);
+}
+
 static lwm2m_watcher_t * prv_getWatcher(lwm2m_context_t * contextP,
                                         lwm2m_uri_t * uriP,
-                                        lwm2m_server_t * serverP)
+                                        lwm2m_server_t * serverP,
+                                        lwm2m_observed_t ** observedPP)
 {
     lwm2m_observed_t * observedP;
     bool allocatedObserver;
@@ -127,6 +581,8 @@ static lwm2m_watcher_t * prv_getWatcher(lwm2m_context_t * contextP,
         allocatedObserver = true;
         memset(observedP, 0, sizeof(lwm2m_observed_t));
         memcpy(&(observedP->uri), uriP, sizeof(lwm2m_uri_t));
+        observedP->timer.callback = prv_observedCallback;
+        observedP->timer.userData = observedP;
         observedP->next = contextP->observedList;
         contextP->observedList = observedP;
     }
@@ -134,7 +590,7 @@ static lwm2m_watcher_t * prv_getWatcher(lwm2m_context_t * contextP,
     watcherP = prv_findWatcher(observedP, serverP);
     if (watcherP == NULL)
     {
-        watcherP = (lwm2m_watcher_t *)lwm2m_malloc(sizeof(lwm2m_watcher_t));
+        watcherP = POOL_ALLOC(LWM2M_POOL_WATCHER, lwm2m_watcher_t);
         if (watcherP == NULL)
         {
             if (allocatedObserver == true)
@@ -150,13 +606,13 @@ static lwm2m_watcher_t * prv_getWatcher(lwm2m_context_t * contextP,
         observedP->watcherList = watcherP;
     }
 
+    *observedPP = observedP;
     return watcherP;
 }
 
 uint8_t observe_handleRequest(lwm2m_context_t * contextP,
                               lwm2m_uri_t * uriP,
                               lwm2m_server_t * serverP,
-                              int size,
                               lwm2m_data_t * dataP,
                               coap_packet_t * message,
                               coap_packet_t * response)
@@ -176,7 +632,7 @@ uint8_t observe_handleRequest(lwm2m_context_t * contextP,
         if (!LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(uriP)) return COAP_400_BAD_REQUEST;
         if (message->token_len == 0) return COAP_400_BAD_REQUEST;
 
-        watcherP = prv_getWatcher(contextP, uriP, serverP);
+        watcherP = prv_getWatcher(contextP, uriP, serverP, &observedP);
         if (watcherP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
         watcherP->tokenLen = message->token_len;
@@ -192,6 +648,14 @@ uint8_t observe_handleRequest(lwm2m_context_t * contextP,
         {
             watcherP->format = LWM2M_CONTENT_TLV;
         }
+        if (coap_get_header_block2(message, NULL, NULL, &watcherP->blockSize, NULL))
+        {
+            watcherP->blockSize = MIN(watcherP->blockSize, REST_MAX_CHUNK_SIZE);
+        }
+        else
+        {
+            watcherP->blockSize = 0;
+        }
 
         if (LWM2M_URI_IS_SET_RESOURCE(uriP))
         {
@@ -209,6 +673,7 @@ uint8_t observe_handleRequest(lwm2m_context_t * contextP,
         }
 
         coap_set_header_observe(response, watcherP->counter++);
+        prv_scheduleObserved(contextP, observedP);
 
         return COAP_205_CONTENT;
 
@@ -270,9 +735,10 @@ void observe_cancel(lwm2m_context_t * contextP,
         if (targetP != NULL)
         {
             if (targetP->parameters != NULL) lwm2m_free(targetP->parameters);
-            lwm2m_free(targetP);
+            POOL_FREE(LWM2M_POOL_WATCHER, targetP);
             if (observedP->watcherList == NULL)
             {
+                timer_cancel(contextP, &observedP->timer);
                 prv_unlinkObserved(contextP, observedP);
                 lwm2m_free(observedP);
             }
@@ -300,12 +766,15 @@ void observe_clear(lwm2m_context_t * contextP,
 
             nextP = observedP->next;
 
-            for (watcherP = observedP->watcherList; watcherP != NULL; watcherP = watcherP->next)
+            while (observedP->watcherList != NULL)
             {
+                watcherP = observedP->watcherList;
+                observedP->watcherList = watcherP->next;
                 if (watcherP->parameters != NULL) lwm2m_free(watcherP->parameters);
+                POOL_FREE(LWM2M_POOL_WATCHER, watcherP);
             }
-            LWM2M_LIST_FREE(observedP->watcherList);
 
+            timer_cancel(contextP, &observedP->timer);
             prv_unlinkObserved(contextP, observedP);
             lwm2m_free(observedP);
 
@@ -324,6 +793,7 @@ uint8_t observe_setParameters(lwm2m_context_t * contextP,
                               lwm2m_attributes_t * attrP)
 {
     uint8_t result;
+    lwm2m_observed_t * observedP;
     lwm2m_watcher_t * watcherP;
 
     LOG_URI(uriP);
@@ -335,7 +805,7 @@ uint8_t observe_setParameters(lwm2m_context_t * contextP,
     result = object_checkReadable(contextP, uriP, attrP);
     if (COAP_205_CONTENT != result) return result;
 
-    watcherP = prv_getWatcher(contextP, uriP, serverP);
+    watcherP = prv_getWatcher(contextP, uriP, serverP, &observedP);
     if (watcherP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
     // Check rule “lt” value + 2*”stp” values < “gt” value
@@ -410,6 +880,8 @@ uint8_t observe_setParameters(lwm2m_context_t * contextP,
     LOG_ARG("Final toSet: %08X, minPeriod: %d, maxPeriod: %d, greaterThan: %f, lessThan: %f, step: %f",
             watcherP->parameters->toSet, watcherP->parameters->minPeriod, watcherP->parameters->maxPeriod, watcherP->parameters->greaterThan, watcherP->parameters->lessThan, watcherP->parameters->step);
 
+    prv_scheduleObserved(contextP, observedP);
+
     return COAP_204_CHANGED;
 }
 
@@ -475,6 +947,8 @@ void lwm2m_resource_value_changed(lwm2m_context_t * contextP,
                             watcherP->update = true;
                         }
                     }
+                    // evaluated on the next lwm2m_step()
+                    (void)timer_schedule(contextP, &targetP->timer, 0);
                 }
             }
         }
@@ -482,275 +956,6 @@ void lwm2m_resource_value_changed(lwm2m_context_t * contextP,
     }
 }
 
-void observe_step(lwm2m_context_t * contextP,
-                  time_t currentTime,
-                  time_t * timeoutP)
-{
-    lwm2m_observed_t * targetP;
-
-    LOG("Entering");
-    for (targetP = contextP->observedList ; targetP != NULL ; targetP = targetP->next)
-    {
-        lwm2m_watcher_t * watcherP;
-        uint8_t * buffer = NULL;
-        size_t length = 0;
-        lwm2m_data_t * dataP = NULL;
-        int size = 0;
-        double floatValue = 0;
-        int64_t integerValue = 0;
-        bool storeValue = false;
-        coap_packet_t message[1];
-        time_t interval;
-
-        LOG_URI(&(targetP->uri));
-        if (LWM2M_URI_IS_SET_RESOURCE(&targetP->uri))
-        {
-            if (COAP_205_CONTENT != object_readData(contextP, &targetP->uri, &size, &dataP)) continue;
-            switch (dataP->type)
-            {
-            case LWM2M_TYPE_INTEGER:
-                if (1 != lwm2m_data_decode_int(dataP, &integerValue))
-                {
-                    lwm2m_data_free(size, dataP);
-                    continue;
-                }
-                storeValue = true;
-                break;
-            case LWM2M_TYPE_FLOAT:
-                if (1 != lwm2m_data_decode_float(dataP, &floatValue))
-                {
-                    lwm2m_data_free(size, dataP);
-                    continue;
-                }
-                storeValue = true;
-                break;
-            default:
-                break;
-            }
-        }
-        for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
-        {
-            if (watcherP->active == true)
-            {
-                bool notify = false;
-
-                if (watcherP->update == true)
-                {
-                    // value changed, should we notify the server ?
-
-                    if (watcherP->parameters == NULL || watcherP->parameters->toSet == 0)
-                    {
-                        // no conditions
-                        notify = true;
-                        LOG("Notify with no conditions");
-                        LOG_URI(&(targetP->uri));
-                    }
-
-                    if (notify == false
-                     && watcherP->parameters != NULL
-                     && (watcherP->parameters->toSet & ATTR_FLAG_NUMERIC) != 0)
-                    {
-                        if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_LESS_THAN) != 0)
-                        {
-                            LOG("Checking lower threshold");
-                            // Did we cross the lower threshold ?
-                            switch (dataP->type)
-                            {
-                            case LWM2M_TYPE_INTEGER:
-                                if ((integerValue < watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asInteger > watcherP->parameters->lessThan)
-                                 || (integerValue > watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asInteger < watcherP->parameters->lessThan))
-                                {
-                                    LOG("Notify on lower threshold crossing");
-                                    notify = true;
-                                }
-                                break;
-                            case LWM2M_TYPE_FLOAT:
-                                if ((floatValue < watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asFloat > watcherP->parameters->lessThan)
-                                 || (floatValue > watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asFloat < watcherP->parameters->lessThan))
-                                {
-                                    LOG("Notify on lower threshold crossing");
-                                    notify = true;
-                                }
-                                break;
-                            default:
-                                break;
-                            }
-                        }
-                        if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_GREATER_THAN) != 0)
-                        {
-                            LOG("Checking upper threshold");
-                            // Did we cross the upper threshold ?
-                            switch (dataP->type)
-                            {
-                            case LWM2M_TYPE_INTEGER:
-                                if ((integerValue < watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asInteger > watcherP->parameters->greaterThan)
-                                 || (integerValue > watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asInteger < watcherP->parameters->greaterThan))
-                                {
-                                    LOG("Notify on lower upper crossing");
-                                    notify = true;
-                                }
-                                break;
-                            case LWM2M_TYPE_FLOAT:
-                                if ((floatValue < watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asFloat > watcherP->parameters->greaterThan)
-                                 || (floatValue > watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asFloat < watcherP->parameters->greaterThan))
-                                {
-                                    LOG("Notify on lower upper crossing");
-                                    notify = true;
-                                }
-                                break;
-                            default:
-                                break;
-                            }
-                        }
-                        if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_STEP) != 0)
-                        {
-                            LOG("Checking step");
-
-                            switch (dataP->type)
-                            {
-                            case LWM2M_TYPE_INTEGER:
-                            {
-                                int64_t diff;
-
-                                diff = integerValue - watcherP->lastValue.asInteger;
-                                if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
-                                 || (diff >= 0 && diff >= watcherP->parameters->step))
-                                {
-                                    LOG("Notify on step condition");
-                                    notify = true;
-                                }
-                            }
-                                break;
-                            case LWM2M_TYPE_FLOAT:
-                            {
-                                double diff;
-
-                                diff = floatValue - watcherP->lastValue.asFloat;
-                                if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
-                                 || (diff >= 0 && diff >= watcherP->parameters->step))
-                                {
-                                    LOG("Notify on step condition");
-                                    notify = true;
-                                }
-                            }
-                                break;
-                            default:
-                                break;
-                            }
-                        }
-                    }
-
-                    if (watcherP->parameters != NULL
-                     && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0)
-                    {
-                        LOG_ARG("Checking minimal period (%d s)", watcherP->parameters->minPeriod);
-
-                        if (watcherP->lastTime + watcherP->parameters->minPeriod > currentTime)
-                        {
-                            // Minimum Period did not elapse yet
-                            interval = watcherP->lastTime + watcherP->parameters->minPeriod - currentTime;
-                            if (*timeoutP > interval) *timeoutP = interval;
-                            notify = false;
-                        }
-                        else
-                        {
-                            LOG("Notify on minimal period");
-                            notify = true;
-                        }
-                    }
-                }
-
-                // Is the Maximum Period reached ?
-                if (notify == false
-                 && watcherP->parameters != NULL
-                 && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
-                {
-                    LOG_ARG("Checking maximal period (%d s)", watcherP->parameters->maxPeriod);
-
-                    if (watcherP->lastTime + watcherP->parameters->maxPeriod <= currentTime)
-                    {
-                        LOG("Notify on maximal period");
-                        notify = true;
-                    }
-                }
-
-                if (notify == true)
-                {
-                    if (buffer == NULL)
-                    {
-                        if (dataP != NULL)
-                        {
-                            int res;
-
-                            res = lwm2m_data_serialize(&targetP->uri, size, dataP, &(watcherP->format), &buffer);
-                            if (res < 0)
-                            {
-                                break;
-                            }
-                            else
-                            {
-                                length = (size_t)res;
-                            }
-
-                        }
-                        else
-                        {
-                            if (COAP_205_CONTENT != object_read(contextP, &targetP->uri, &(watcherP->format), &buffer, &length))
-                            {
-                                buffer = NULL;
-                                break;
-                            }
-                        }
-                        coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, 0);
-                        coap_set_header_content_type(message, watcherP->format);
-                        coap_set_payload(message, buffer, length);
-                    }
-                    watcherP->lastTime = currentTime;
-                    watcherP->lastMid = contextP->nextMID++;
-                    message->mid = watcherP->lastMid;
-                    coap_set_header_token(message, watcherP->token, watcherP->tokenLen);
-                    coap_set_header_observe(message, watcherP->counter++);
-                    (void)message_send(contextP, message, watcherP->server->sessionH);
-                    watcherP->update = false;
-                }
-
-                // Store this value
-                if (notify == true && storeValue == true)
-                {
-                    switch (dataP->type)
-                    {
-                    case LWM2M_TYPE_INTEGER:
-                        watcherP->lastValue.asInteger = integerValue;
-                        break;
-                    case LWM2M_TYPE_FLOAT:
-                        watcherP->lastValue.asFloat = floatValue;
-                        break;
-                    default:
-                        break;
-                    }
-                }
-
-                if (watcherP->parameters != NULL && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
-                {
-                    // update timers
-                    interval = watcherP->lastTime + watcherP->parameters->maxPeriod - currentTime;
-                    if (*timeoutP > interval) *timeoutP = interval;
-                }
-            }
-        }
-        if (dataP != NULL) lwm2m_data_free(size, dataP);
-        if (buffer != NULL) lwm2m_free(buffer);
-    }
-}
-
 #endif
 
 #ifdef LWM2M_SERVER_MODE
@@ -784,11 +989,24 @@ static lwm2m_observation_t * prv_findObservationByURI(lwm2m_client_t * clientP,
     return targetP;
 }
 
+static void prv_release(lwm2m_observation_t * observationP)
+{
+    lwm2m_context_t * contextP = observationP->contextP;
+
+    if (contextP != NULL && contextP->observeReleaseCallback != NULL)
+    {
+        contextP->observeReleaseCallback(observationP->clientP->internalID, &observationP->uri,
+                                         observationP->callback, observationP->userData,
+                                         contextP->observeReleaseUserData);
+    }
+}
+
 void observe_remove(lwm2m_observation_t * observationP)
 {
     LOG("Entering");
     observationP->clientP->observationList = (lwm2m_observation_t *) LWM2M_LIST_RM(observationP->clientP->observationList, observationP->id, NULL);
-    lwm2m_free(observationP);
+    prv_release(observationP);
+    POOL_FREE(LWM2M_POOL_OBSERVATION, observationP);
 }
 
 static void prv_obsRequestCallback(lwm2m_transaction_t * transacP,
@@ -802,6 +1020,12 @@ static void prv_obsRequestCallback(lwm2m_transaction_t * transacP,
     {
     case STATE_DEREG_PENDING:
         // Observation was canceled by the user.
+        completion_report(observationP->contextP, observationP->callback,
+                          observationP->clientP->internalID,
+                          &observationP->uri,
+                          COAP_202_DELETED,
+                          LWM2M_CONTENT_TEXT, NULL, 0,
+                          observationP->userData);
         observe_remove(observationP);
         return;
 
@@ -829,20 +1053,22 @@ static void prv_obsRequestCallback(lwm2m_transaction_t * transacP,
 
     if (code != COAP_205_CONTENT)
     {
-        observationP->callback(observationP->clientP->internalID,
-                               &observationP->uri,
-                               code,
-                               LWM2M_CONTENT_TEXT, NULL, 0,
-                               observationP->userData);
+        completion_report(observationP->contextP, observationP->callback,
+                          observationP->clientP->internalID,
+                          &observationP->uri,
+                          code,
+                          LWM2M_CONTENT_TEXT, NULL, 0,
+                          observationP->userData);
         observe_remove(observationP);
     }
     else
     {
-        observationP->callback(observationP->clientP->internalID,
-                               &observationP->uri,
-                               0,
-                               packet->content_type, packet->payload, packet->payload_len,
-                               observationP->userData);
+        completion_report(observationP->contextP, observationP->callback,
+                          observationP->clientP->internalID,
+                          &observationP->uri,
+                          0,
+                          (lwm2m_media_type_t)packet->content_type, packet->payload, packet->payload_len,
+                          observationP->userData);
     }
 }
 
@@ -865,19 +1091,21 @@ static void prv_obsCancelRequestCallback(lwm2m_transaction_t * transacP,
 
     if (code != COAP_205_CONTENT)
     {
-        cancelP->callbackP(cancelP->observationP->clientP->internalID,
-                           &cancelP->observationP->uri,
-                           code,
-                           LWM2M_CONTENT_TEXT, NULL, 0,
-                           cancelP->userDataP);
+        completion_report(cancelP->observationP->contextP, cancelP->callbackP,
+                          cancelP->observationP->clientP->internalID,
+                          &cancelP->observationP->uri,
+                          code,
+                          LWM2M_CONTENT_TEXT, NULL, 0,
+                          cancelP->userDataP);
     }
     else
     {
-        cancelP->callbackP(cancelP->observationP->clientP->internalID,
-                           &cancelP->observationP->uri,
-                           0,
-                           packet->content_type, packet->payload, packet->payload_len,
-                           cancelP->userDataP);
+        completion_report(cancelP->observationP->contextP, cancelP->callbackP,
+                          cancelP->observationP->clientP->internalID,
+                          &cancelP->observationP->uri,
+                          0,
+                          (lwm2m_media_type_t)packet->content_type, packet->payload, packet->payload_len,
+                          cancelP->userDataP);
     }
 
     observe_remove(cancelP->observationP);
@@ -902,7 +1130,7 @@ int lwm2m_observe(lwm2m_context_t * contextP,
 
     if (!LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(uriP)) return COAP_400_BAD_REQUEST;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registry_findById(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     for (observationP = clientP->observationList; observationP != NULL; observationP = observationP->next)
@@ -918,7 +1146,7 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     }
     if (observationP == NULL)
     {
-        observationP = (lwm2m_observation_t *)lwm2m_malloc(sizeof(lwm2m_observation_t));
+        observationP = POOL_ALLOC(LWM2M_POOL_OBSERVATION, lwm2m_observation_t);
         if (observationP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
         memset(observationP, 0, sizeof(lwm2m_observation_t));
 
@@ -928,9 +1156,15 @@ int lwm2m_observe(lwm2m_context_t * contextP,
 
         observationP->clientP->observationList = (lwm2m_observation_t *)LWM2M_LIST_ADD(observationP->clientP->observationList, observationP);
     }
+    else if (observationP->callback != callback || observationP->userData != userData)
+    {
+        // the previous callback is not called anymore
+        prv_release(observationP);
+    }
     observationP->status = STATE_REG_PENDING;
     observationP->callback = callback;
     observationP->userData = userData;
+    observationP->contextP = contextP;
 
     token[0] = clientP->internalID >> 8;
     token[1] = clientP->internalID & 0xFF;
@@ -941,12 +1175,16 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     if (transactionP == NULL)
     {
         observationP->clientP->observationList = (lwm2m_observation_t *)LWM2M_LIST_RM(observationP->clientP->observationList, observationP->id, NULL);
-        lwm2m_free(observationP);
+        POOL_FREE(LWM2M_POOL_OBSERVATION, observationP);
         return COAP_500_INTERNAL_SERVER_ERROR;
     }
 
     coap_set_header_observe(transactionP->message, 0);
-    if (clientP->supportJSON == true)
+    if (clientP->supportSenmlCbor == true)
+    {
+        coap_set_header_accept(transactionP->message, LWM2M_CONTENT_SENML_CBOR);
+    }
+    else if (clientP->supportJSON == true)
     {
         coap_set_header_accept(transactionP->message, LWM2M_CONTENT_JSON);
     }
@@ -958,7 +1196,7 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     transactionP->callback = prv_obsRequestCallback;
     transactionP->userData = (void *)observationP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transactionP);
+    transaction_add(contextP, transactionP);
 
     return transaction_send(contextP, transactionP);
 }
@@ -975,7 +1213,7 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
     LOG_ARG("clientID: %d", clientID);
     LOG_URI(uriP);
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registry_findById(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     observationP = prv_findObservationByURI(clientP, uriP);
@@ -1002,7 +1240,7 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
         cancelP = (cancellation_data_t *)lwm2m_malloc(sizeof(cancellation_data_t));
         if (cancelP == NULL)
         {
-            lwm2m_free(transactionP);
+            transaction_free(transactionP);
             return COAP_500_INTERNAL_SERVER_ERROR;
         }
 
@@ -1015,7 +1253,7 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
         transactionP->callback = prv_obsCancelRequestCallback;
         transactionP->userData = (void *)cancelP;
 
-        contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transactionP);
+        transaction_add(contextP, transactionP);
 
         return transaction_send(contextP, transactionP);
     }
@@ -1032,6 +1270,85 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
     return COAP_NO_ERROR;
 }
 
+typedef struct
+{
+    lwm2m_context_t * contextP;
+    uint16_t          clientID;
+    uint16_t          obsID;
+    uint32_t          count;
+} notification_data_t;
+
+static void prv_notificationBlocksCallback(lwm2m_transaction_t * transacP,
+                                           void * message)
+{
+    notification_data_t * dataP = (notification_data_t *)transacP->userData;
+    coap_packet_t * packet = (coap_packet_t *)message;
+    lwm2m_client_t * clientP;
+    lwm2m_observation_t * observationP = NULL;
+
+    // the observation may be gone meanwhile
+    clientP = registry_findById(dataP->contextP, dataP->clientID);
+    if (clientP != NULL)
+    {
+        observationP = (lwm2m_observation_t *)lwm2m_list_find((lwm2m_list_t *)clientP->observationList, dataP->obsID);
+    }
+
+    if (observationP != NULL && packet != NULL && packet->code == COAP_205_CONTENT)
+    {
+        completion_report(dataP->contextP, observationP->callback,
+                          dataP->clientID,
+                          &observationP->uri,
+                          (int)dataP->count,
+                          utils_convertMediaType(packet->content_type), packet->payload, packet->payload_len,
+                          observationP->userData);
+    }
+    else
+    {
+        LOG("Dropping a notification which blocks could not be fetched");
+    }
+    lwm2m_free(dataP);
+}
+
+// Fetches the blocks following the first one of a notification, with the same content format.
+static bool prv_fetchNotification(lwm2m_context_t * contextP,
+                                  lwm2m_client_t * clientP,
+                                  lwm2m_observation_t * observationP,
+                                  uint32_t count,
+                                  coap_packet_t * message)
+{
+    lwm2m_transaction_t * transactionP;
+    notification_data_t * dataP;
+
+    transactionP = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, &observationP->uri, contextP->nextMID++, 4, NULL);
+    if (transactionP == NULL) return false;
+    if (IS_OPTION(message, COAP_OPTION_CONTENT_TYPE))
+    {
+        coap_set_header_accept(transactionP->message, message->content_type);
+    }
+
+    dataP = (notification_data_t *)lwm2m_malloc(sizeof(notification_data_t));
+    if (dataP == NULL)
+    {
+        transaction_free(transactionP);
+        return false;
+    }
+    dataP->contextP = contextP;
+    dataP->clientID = clientP->internalID;
+    dataP->obsID = observationP->id;
+    dataP->count = count;
+    transactionP->callback = prv_notificationBlocksCallback;
+    transactionP->userData = dataP;
+
+    if (!block2_fetch(contextP, transactionP, message))
+    {
+        lwm2m_free(dataP);
+        transaction_free(transactionP);
+        return false;
+    }
+
+    return true;
+}
+
 bool observe_handleNotify(lwm2m_context_t * contextP,
                            void * fromSessionH,
                            coap_packet_t * message,
@@ -1054,7 +1371,7 @@ bool observe_handleNotify(lwm2m_context_t * contextP,
     clientID = (tokenP[0] << 8) | tokenP[1];
     obsID = (tokenP[2] << 8) | tokenP[3];
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registry_findById(contextP, clientID);
     if (clientP == NULL) return false;
 
     observationP = (lwm2m_observation_t *)lwm2m_list_find((lwm2m_list_t *)clientP->observationList, obsID);
@@ -1069,11 +1386,19 @@ bool observe_handleNotify(lwm2m_context_t * contextP,
             coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
             message_send(contextP, response, fromSessionH);
         }
-        observationP->callback(clientID,
-                               &observationP->uri,
-                               (int)count,
-                               message->content_type, message->payload, message->payload_len,
-                               observationP->userData);
+        // the callback gets a large notification once its following blocks are fetched
+        if (IS_OPTION(message, COAP_OPTION_BLOCK2)
+         && message->block2_more
+         && prv_fetchNotification(contextP, clientP, observationP, count, message))
+        {
+            return true;
+        }
+        completion_report(contextP, observationP->callback,
+                          clientID,
+                          &observationP->uri,
+                          (int)count,
+                          (lwm2m_media_type_t)message->content_type, message->payload, message->payload_len,
+                          observationP->userData);
     }
     return true;
 }
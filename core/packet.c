@@ -93,6 +93,36 @@ Contains code snippets which are:
 #include <stdio.h>
 
 
+// Serializes the message in the buffer of the context.
+static uint8_t prv_serialize(lwm2m_context_t * contextP,
+                             coap_packet_t * message,
+                             size_t * lengthP)
+{
+    size_t allocLen;
+
+    allocLen = coap_serialize_get_size(message);
+    LOG_ARG("Size to allocate: %d", allocLen);
+    if (allocLen == 0) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    // The buffer only grows, to the largest message sent so far.
+    if (allocLen > contextP->txBufferSize)
+    {
+        uint8_t * newBuffer;
+
+        newBuffer = (uint8_t *)lwm2m_malloc(allocLen);
+        if (newBuffer == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+        if (contextP->txBuffer != NULL) lwm2m_free(contextP->txBuffer);
+        contextP->txBuffer = newBuffer;
+        contextP->txBufferSize = allocLen;
+    }
+
+    *lengthP = coap_serialize_message(message, contextP->txBuffer);
+    LOG_ARG("coap_serialize_message() returned %d", *lengthP);
+    if (0 == *lengthP) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    return NO_ERROR;
+}
+
 static void handle_reset(lwm2m_context_t * contextP,
                          void * fromSessionH,
                          coap_packet_t * message)
@@ -108,19 +138,18 @@ static uint8_t handle_request(lwm2m_context_t * contextP,
                               coap_packet_t * message,
                               coap_packet_t * response)
 {
-    lwm2m_uri_t * uriP;
+    lwm2m_uri_t uri;
+    lwm2m_uri_t * uriP = &uri;
     uint8_t result = COAP_IGNORE;
 
     LOG("Entering");
 	
 #ifdef LWM2M_CLIENT_MODE
-    uriP = uri_decode(contextP->altPath, message->uri_path);
+    if (!uri_decode(contextP->altPath, message->uri_path, uriP)) return COAP_400_BAD_REQUEST;
 #else
-    uriP = uri_decode(NULL, message->uri_path);
+    if (!uri_decode(NULL, message->uri_path, uriP)) return COAP_400_BAD_REQUEST;
 #endif
 
-    if (uriP == NULL) return COAP_400_BAD_REQUEST;
-
     switch(uriP->flag & LWM2M_URI_MASK_TYPE)
     {
 #ifdef LWM2M_CLIENT_MODE
@@ -189,7 +218,6 @@ static uint8_t handle_request(lwm2m_context_t * contextP,
         result = NO_ERROR;
     }
 
-    lwm2m_free(uriP);
     return result;
 }
 
@@ -197,14 +225,37 @@ static uint8_t handle_request(lwm2m_context_t * contextP,
  * Erbium is Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
  * All rights reserved.
  */
+// The responses to CON requests are kept for the retransmissions of the requests.
+static uint8_t prv_sendResponse(lwm2m_context_t * contextP,
+                                coap_packet_t * message,
+                                coap_packet_t * response,
+                                void * sessionH)
+{
+    size_t length = 0;
+    uint8_t result;
+
+    result = prv_serialize(contextP, response, &length);
+    if (result != NO_ERROR) return result;
+
+    result = lwm2m_buffer_send(sessionH, contextP->txBuffer, length, contextP->userData);
+    if (result == COAP_NO_ERROR && message->type == COAP_TYPE_CON)
+    {
+        dedup_store(contextP, sessionH, message->mid, contextP->txBuffer, length);
+    }
+
+    return result;
+}
+
 void lwm2m_handle_packet(lwm2m_context_t * contextP,
                          uint8_t * buffer,
                          int length,
                          void * fromSessionH)
 {
     uint8_t coap_error_code = NO_ERROR;
-    static coap_packet_t message[1];
-    static coap_packet_t response[1];
+    // per call packets: several contexts may handle packets concurrently
+    coap_packet_t message[1];
+    coap_packet_t response[1];
+    const char * error_message;
 
     LOG("Entering");
     coap_error_code = coap_parse_message(message, buffer, (uint16_t)length);
@@ -212,13 +263,20 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
     {
         LOG_ARG("Parsed: ver %u, type %u, tkl %u, code %u.%.2u, mid %u, Content type: %d",
                 message->version, message->type, message->token_len, message->code >> 5, message->code & 0x1F, message->mid, message->content_type);
-        LOG_ARG("Payload: %.*s", message->payload_len, message->payload);
-        if (message->code >= COAP_GET && message->code <= COAP_DELETE)
+        LOG_ARG("Payload: %.*s", (int)message->payload_len, message->payload);
+        if (message->type == COAP_TYPE_CON
+         && message->code >= COAP_GET && message->code <= COAP_DELETE
+         && dedup_replay(contextP, fromSessionH, message))
+        {
+            /* retransmission of a request already answered */
+        }
+        else if (message->code >= COAP_GET && message->code <= COAP_DELETE)
         {
             uint32_t block_num = 0;
             uint16_t block_size = REST_MAX_CHUNK_SIZE;
             uint32_t block_offset = 0;
             int64_t new_offset = 0;
+            bool kept = false;
 
             /* prepare response */
             if (message->type == COAP_TYPE_CON)
@@ -246,8 +304,14 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                 new_offset = block_offset;
             }
 
+            /* following blocks of a kept response do not run the request again */
+            if (block_num != 0)
+            {
+                kept = block2_getBlock(contextP, fromSessionH, message, response, block_num, block_size);
+            }
+
             /* handle block1 option */
-            if (IS_OPTION(message, COAP_OPTION_BLOCK1))
+            if (!kept && IS_OPTION(message, COAP_OPTION_BLOCK1))
             {
 #ifdef LWM2M_CLIENT_MODE
                 // get server
@@ -275,8 +339,12 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                     coap_get_header_block1(message, &block1_num, &block1_more, &block1_size, NULL);
                     LOG_ARG("Blockwise: block1 request NUM %u (SZX %u/ SZX Max%u) MORE %u", block1_num, block1_size, REST_MAX_CHUNK_SIZE, block1_more);
 
-                    // handle block 1
-                    coap_error_code = coap_block1_handler(&serverP->block1Data, message->mid, message->payload, message->payload_len, block1_size, block1_num, block1_more, &complete_buffer, &complete_buffer_size);
+                    // stream the blocks to the object when it accepts them, buffer them otherwise
+                    coap_error_code = coap_block1_stream(contextP, serverP, message, block1_size, block1_num, block1_more);
+                    if (coap_error_code == COAP_IGNORE)
+                    {
+                        coap_error_code = coap_block1_handler(&serverP->block1Data, message->token, message->token_len, message->mid, message->payload, message->payload_len, block1_size, block1_num, block1_more, &complete_buffer, &complete_buffer_size);
+                    }
 
                     // if payload is complete, replace it in the coap message.
                     if (coap_error_code == NO_ERROR)
@@ -289,16 +357,25 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                         block1_size = MIN(block1_size, REST_MAX_CHUNK_SIZE);
                         coap_set_header_block1(response,block1_num, block1_more,block1_size);
                     }
+                    else if (coap_error_code == COAP_204_CHANGED)
+                    {
+                        // last block of a streamed transfer
+                        coap_set_header_block1(response, block1_num, 0, MIN(block1_size, REST_MAX_CHUNK_SIZE));
+                    }
                 }
 #else
                 coap_error_code = COAP_501_NOT_IMPLEMENTED;
 #endif
             }
-            if (coap_error_code == NO_ERROR)
+            if (!kept && coap_error_code == NO_ERROR)
             {
                 coap_error_code = handle_request(contextP, fromSessionH, message, response);
             }
-            if (coap_error_code==NO_ERROR)
+            if (kept)
+            {
+                coap_error_code = prv_sendResponse(contextP, message, response, fromSessionH);
+            }
+            else if (coap_error_code==NO_ERROR)
             {
                 /* Save original payload pointer for later freeing. Payload in response may be updated. */
                 uint8_t *payload = response->payload;
@@ -317,6 +394,12 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                         }
                         else
                         {
+                            /* keep the payload for the following blocks, it is not freed below */
+                            if (response->payload_len - block_offset > block_size
+                             && block2_storeResponse(contextP, fromSessionH, message, response))
+                            {
+                                payload = NULL;
+                            }
                             coap_set_header_block2(response, block_num, response->payload_len - block_offset > block_size, block_size);
                             coap_set_payload(response, response->payload+block_offset, MIN(response->payload_len - block_offset, block_size));
                         } /* if (valid offset) */
@@ -337,9 +420,10 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                     coap_set_payload(response, response->payload, MIN(response->payload_len, REST_MAX_CHUNK_SIZE));
                 } /* if (blockwise request) */
 
-                coap_error_code = message_send(contextP, response, fromSessionH);
+                coap_error_code = prv_sendResponse(contextP, message, response, fromSessionH);
 
-                lwm2m_free(payload);
+                /* the buffer of the context is reused by the next read */
+                if (payload != contextP->payloadBuffer) lwm2m_free(payload);
                 response->payload = NULL;
                 response->payload_len = 0;
             }
@@ -347,7 +431,7 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
             {
                 if (1 == coap_set_status_code(response, coap_error_code))
                 {
-                    coap_error_code = message_send(contextP, response, fromSessionH);
+                    coap_error_code = prv_sendResponse(contextP, message, response, fromSessionH);
                 }
             }
         }
@@ -399,7 +483,8 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
 
     if (coap_error_code != NO_ERROR && coap_error_code != COAP_IGNORE)
     {
-        LOG_ARG("ERROR %u: %s", coap_error_code, coap_error_message);
+        error_message = (message->error_message != NULL) ? message->error_message : "";
+        LOG_ARG("ERROR %u: %s", coap_error_code, error_message);
 
         /* Set to sendable error code. */
         if (coap_error_code >= 192)
@@ -408,7 +493,7 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
         }
         /* Reuse input buffer for error message. */
         coap_init_message(message, COAP_TYPE_ACK, coap_error_code, message->mid);
-        coap_set_payload(message, coap_error_message, strlen(coap_error_message));
+        coap_set_payload(message, error_message, strlen(error_message));
         message_send(contextP, message, fromSessionH);
     }
 }
@@ -418,28 +503,12 @@ uint8_t message_send(lwm2m_context_t * contextP,
                      coap_packet_t * message,
                      void * sessionH)
 {
-    uint8_t result = COAP_500_INTERNAL_SERVER_ERROR;
-    uint8_t * pktBuffer;
     size_t pktBufferLen = 0;
-    size_t allocLen;
+    uint8_t result;
 
     LOG("Entering");
-    allocLen = coap_serialize_get_size(message);
-    LOG_ARG("Size to allocate: %d", allocLen);
-    if (allocLen == 0) return COAP_500_INTERNAL_SERVER_ERROR;
+    result = prv_serialize(contextP, message, &pktBufferLen);
+    if (result != NO_ERROR) return result;
 
-    pktBuffer = (uint8_t *)lwm2m_malloc(allocLen);
-    if (pktBuffer != NULL)
-    {
-        pktBufferLen = coap_serialize_message(message, pktBuffer);
-        LOG_ARG("coap_serialize_message() returned %d", pktBufferLen);
-        if (0 != pktBufferLen)
-        {
-            result = lwm2m_buffer_send(sessionH, pktBuffer, pktBufferLen, contextP->userData);
-        }
-        lwm2m_free(pktBuffer);
-    }
-
-    return result;
+    return lwm2m_buffer_send(sessionH, contextP->txBuffer, pktBufferLen, contextP->userData);
 }
-
@@ -0,0 +1,183 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * Fixed-size object pools for the small structures the core allocates on
+ * every exchange (transactions, their CoAP messages, management callbacks
+ * data, watchers, observations and CoAP options).
+ *
+ * Each pool is a static array of slots with a free list. Slots are handed
+ * out in order the first time, then recycled through the free list. When a
+ * pool is exhausted, allocations fall back to lwm2m_malloc() unless
+ * LWM2M_POOL_STATIC_ONLY is defined, in which case they fail.
+ *
+ * The pools are shared by all the contexts and are not thread-safe.
+ */
+
+#include "internals.h"
+
+#ifdef LWM2M_WITH_POOLS
+
+#ifndef LWM2M_POOL_TRANSACTION_COUNT
+#define LWM2M_POOL_TRANSACTION_COUNT    16
+#endif
+#ifndef LWM2M_POOL_PACKET_COUNT
+#define LWM2M_POOL_PACKET_COUNT         LWM2M_POOL_TRANSACTION_COUNT
+#endif
+#ifndef LWM2M_POOL_DM_DATA_COUNT
+#define LWM2M_POOL_DM_DATA_COUNT        16
+#endif
+#ifndef LWM2M_POOL_WATCHER_COUNT
+#define LWM2M_POOL_WATCHER_COUNT        16
+#endif
+#ifndef LWM2M_POOL_OBSERVATION_COUNT
+#define LWM2M_POOL_OBSERVATION_COUNT    16
+#endif
+#ifndef LWM2M_POOL_OPTION_COUNT
+#define LWM2M_POOL_OPTION_COUNT         32
+#endif
+
+typedef union
+{
+    void *      pointer;
+    double      real;
+    int64_t     integer;
+} prv_align_t;
+
+typedef struct _prv_slot_
+{
+    struct _prv_slot_ * next;
+} prv_slot_t;
+
+typedef struct
+{
+    prv_align_t *       storage;
+    size_t              slotSize;   // in prv_align_t units
+    size_t              next;       // first slot never handed out
+    prv_slot_t *        freeList;
+    lwm2m_pool_stats_t  stats;
+} prv_pool_t;
+
+#define PRV_SLOT_SIZE(T)    ((sizeof(T) + sizeof(prv_align_t) - 1) / sizeof(prv_align_t))
+#define PRV_STORAGE(T, N)   (PRV_SLOT_SIZE(T) * (N))
+#define PRV_POOL(S, T, N)   { S, PRV_SLOT_SIZE(T), 0, NULL, { sizeof(T), N, 0, 0, 0, 0, 0 } }
+
+static prv_align_t prv_transactionStorage[PRV_STORAGE(lwm2m_transaction_t, LWM2M_POOL_TRANSACTION_COUNT)];
+static prv_align_t prv_packetStorage[PRV_STORAGE(coap_packet_t, LWM2M_POOL_PACKET_COUNT)];
+static prv_align_t prv_optionStorage[PRV_STORAGE(multi_option_t, LWM2M_POOL_OPTION_COUNT)];
+#ifdef LWM2M_CLIENT_MODE
+static prv_align_t prv_watcherStorage[PRV_STORAGE(lwm2m_watcher_t, LWM2M_POOL_WATCHER_COUNT)];
+#endif
+#ifdef LWM2M_SERVER_MODE
+static prv_align_t prv_dmDataStorage[PRV_STORAGE(dm_data_t, LWM2M_POOL_DM_DATA_COUNT)];
+static prv_align_t prv_observationStorage[PRV_STORAGE(lwm2m_observation_t, LWM2M_POOL_OBSERVATION_COUNT)];
+#endif
+
+static prv_pool_t prv_pools[LWM2M_POOL_COUNT] =
+{
+    [LWM2M_POOL_TRANSACTION] = PRV_POOL(prv_transactionStorage, lwm2m_transaction_t, LWM2M_POOL_TRANSACTION_COUNT),
+    [LWM2M_POOL_PACKET] = PRV_POOL(prv_packetStorage, coap_packet_t, LWM2M_POOL_PACKET_COUNT),
+    [LWM2M_POOL_OPTION] = PRV_POOL(prv_optionStorage, multi_option_t, LWM2M_POOL_OPTION_COUNT),
+#ifdef LWM2M_CLIENT_MODE
+    [LWM2M_POOL_WATCHER] = PRV_POOL(prv_watcherStorage, lwm2m_watcher_t, LWM2M_POOL_WATCHER_COUNT),
+#endif
+#ifdef LWM2M_SERVER_MODE
+    [LWM2M_POOL_DM_DATA] = PRV_POOL(prv_dmDataStorage, dm_data_t, LWM2M_POOL_DM_DATA_COUNT),
+    [LWM2M_POOL_OBSERVATION] = PRV_POOL(prv_observationStorage, lwm2m_observation_t, LWM2M_POOL_OBSERVATION_COUNT),
+#endif
+};
+
+static bool prv_isPooled(prv_pool_t * poolP,
+                         void * objectP)
+{
+    uintptr_t address = (uintptr_t)objectP;
+    uintptr_t start = (uintptr_t)poolP->storage;
+
+    return poolP->storage != NULL
+        && address >= start
+        && address < start + poolP->stats.capacity * poolP->slotSize * sizeof(prv_align_t);
+}
+
+void * pool_alloc(lwm2m_pool_type_t type)
+{
+    prv_pool_t * poolP = prv_pools + type;
+    void * objectP;
+
+    if (poolP->freeList != NULL)
+    {
+        objectP = poolP->freeList;
+        poolP->freeList = poolP->freeList->next;
+    }
+    else if (poolP->next < poolP->stats.capacity)
+    {
+        objectP = poolP->storage + poolP->next * poolP->slotSize;
+        poolP->next++;
+    }
+    else
+    {
+#ifdef LWM2M_POOL_STATIC_ONLY
+        objectP = NULL;
+#else
+        objectP = lwm2m_malloc(poolP->stats.objectSize);
+        if (objectP != NULL) poolP->stats.fallbacks++;
+#endif
+        if (objectP == NULL)
+        {
+            LOG_ARG("Pool %d exhausted", type);
+            poolP->stats.failures++;
+            return NULL;
+        }
+    }
+
+    poolP->stats.allocations++;
+    poolP->stats.used++;
+    if (poolP->stats.used > poolP->stats.peak)
+    {
+        poolP->stats.peak = poolP->stats.used;
+    }
+
+    return objectP;
+}
+
+void pool_free(lwm2m_pool_type_t type,
+               void * objectP)
+{
+    prv_pool_t * poolP = prv_pools + type;
+
+    if (objectP == NULL) return;
+
+    poolP->stats.used--;
+    if (prv_isPooled(poolP, objectP))
+    {
+        prv_slot_t * slotP = (prv_slot_t *)objectP;
+
+        slotP->next = poolP->freeList;
+        poolP->freeList = slotP;
+    }
+    else
+    {
+        lwm2m_free(objectP);
+    }
+}
+
+void lwm2m_pool_get_stats(lwm2m_pool_type_t type,
+                          lwm2m_pool_stats_t * statsP)
+{
+    memcpy(statsP, &(prv_pools[type].stats), sizeof(lwm2m_pool_stats_t));
+}
+
+#endif
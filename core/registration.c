@@ -223,40 +223,27 @@ static void prv_handleRegistrationReply(lwm2m_transaction_t * transacP,
 static uint8_t prv_register(lwm2m_context_t * contextP,
                             lwm2m_server_t * server)
 {
-    char * query;
     int query_length;
     uint8_t * payload;
     int payload_length;
     lwm2m_transaction_t * transaction;
 
-    payload_length = object_getRegisterPayloadBufferLength(contextP);
-    if(payload_length == 0) return COAP_500_INTERNAL_SERVER_ERROR;
-    payload = lwm2m_malloc(payload_length);
-    if(!payload) return COAP_500_INTERNAL_SERVER_ERROR;
-    payload_length = object_getRegisterPayload(contextP, payload, payload_length);
-    if(payload_length == 0)
-    {
-        lwm2m_free(payload);
-        return COAP_500_INTERNAL_SERVER_ERROR;
-    }
+    payload = object_getCachedRegisterPayload(contextP, &payload_length);
+    if(payload == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
-    query_length = prv_getRegistrationQueryLength(contextP, server);
-    if(query_length == 0)
-    {
-        lwm2m_free(payload);
-        return COAP_500_INTERNAL_SERVER_ERROR;
-    }
-    query = lwm2m_malloc(query_length);
-    if(!query)
-    {
-        lwm2m_free(payload);
-        return COAP_500_INTERNAL_SERVER_ERROR;
-    }
-    if(prv_getRegistrationQuery(contextP, server, query, query_length) != query_length)
+    // lifetime and binding are read once when the server is created
+    if (server->query == NULL)
     {
-        lwm2m_free(payload);
-        lwm2m_free(query);
-        return COAP_500_INTERNAL_SERVER_ERROR;
+        query_length = prv_getRegistrationQueryLength(contextP, server);
+        if(query_length == 0) return COAP_500_INTERNAL_SERVER_ERROR;
+        server->query = lwm2m_malloc(query_length);
+        if(!server->query) return COAP_500_INTERNAL_SERVER_ERROR;
+        if(prv_getRegistrationQuery(contextP, server, server->query, query_length) != query_length)
+        {
+            lwm2m_free(server->query);
+            server->query = NULL;
+            return COAP_500_INTERNAL_SERVER_ERROR;
+        }
     }
 
     if (server->sessionH == NULL)
@@ -264,39 +251,22 @@ static uint8_t prv_register(lwm2m_context_t * contextP,
         server->sessionH = lwm2m_connect_server(server->secObjInstID, contextP->userData);
     }
 
-    if (NULL == server->sessionH)
-    {
-        lwm2m_free(payload);
-        lwm2m_free(query);
-        return COAP_503_SERVICE_UNAVAILABLE;
-    }
+    if (NULL == server->sessionH) return COAP_503_SERVICE_UNAVAILABLE;
 
     transaction = transaction_new(server->sessionH, COAP_POST, NULL, NULL, contextP->nextMID++, 4, NULL);
-    if (transaction == NULL)
-    {
-        lwm2m_free(payload);
-        lwm2m_free(query);
-        return COAP_503_SERVICE_UNAVAILABLE;
-    }
+    if (transaction == NULL) return COAP_503_SERVICE_UNAVAILABLE;
 
     coap_set_header_uri_path(transaction->message, "/"URI_REGISTRATION_SEGMENT);
-    coap_set_header_uri_query(transaction->message, query);
+    coap_set_header_uri_query(transaction->message, server->query);
     coap_set_header_content_type(transaction->message, LWM2M_CONTENT_LINK);
     coap_set_payload(transaction->message, payload, payload_length);
 
     transaction->callback = prv_handleRegistrationReply;
     transaction->userData = (void *) server;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
-    if (transaction_send(contextP, transaction) != 0)
-    {
-        lwm2m_free(payload);
-        lwm2m_free(query);
-        return COAP_503_SERVICE_UNAVAILABLE;
-    }
+    transaction_add(contextP, transaction);
+    if (transaction_send(contextP, transaction) != 0) return COAP_503_SERVICE_UNAVAILABLE;
 
-    lwm2m_free(payload);
-    lwm2m_free(query);
     server->status = STATE_REG_PENDING;
 
     return COAP_NO_ERROR;
@@ -333,7 +303,7 @@ static int prv_updateRegistration(lwm2m_context_t * contextP,
                                   bool withObjects)
 {
     lwm2m_transaction_t * transaction;
-    uint8_t * payload = NULL;
+    uint8_t * payload;
     int payload_length;
 
     transaction = transaction_new(server->sessionH, COAP_POST, NULL, NULL, contextP->nextMID++, 4, NULL);
@@ -343,25 +313,10 @@ static int prv_updateRegistration(lwm2m_context_t * contextP,
 
     if (withObjects == true)
     {
-        payload_length = object_getRegisterPayloadBufferLength(contextP);
-        if(payload_length == 0)
-        {
-            transaction_free(transaction);
-            return COAP_500_INTERNAL_SERVER_ERROR;
-        }
-
-        payload = lwm2m_malloc(payload_length);
-        if(!payload)
-        {
-            transaction_free(transaction);
-            return COAP_500_INTERNAL_SERVER_ERROR;
-        }
-
-        payload_length = object_getRegisterPayload(contextP, payload, payload_length);
-        if(payload_length == 0)
+        payload = object_getCachedRegisterPayload(contextP, &payload_length);
+        if(payload == NULL)
         {
             transaction_free(transaction);
-            lwm2m_free(payload);
             return COAP_500_INTERNAL_SERVER_ERROR;
         }
         coap_set_payload(transaction->message, payload, payload_length);
@@ -370,17 +325,13 @@ static int prv_updateRegistration(lwm2m_context_t * contextP,
     transaction->callback = prv_handleRegistrationUpdateReply;
     transaction->userData = (void *) server;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
 
     if (transaction_send(contextP, transaction) == 0)
     {
         server->status = STATE_REG_UPDATE_PENDING;
     }
 
-    if (withObjects == true)
-    {
-        lwm2m_free(payload);
-    }
     return COAP_NO_ERROR;
 }
 
@@ -396,6 +347,12 @@ int lwm2m_update_registration(lwm2m_context_t * contextP,
 
     result = COAP_NO_ERROR;
 
+    if (withObjects == true)
+    {
+        // the application may have changed the instances itself
+        object_invalidateRegisterPayload(contextP);
+    }
+
     targetP = contextP->serverList;
     if (targetP == NULL)
     {
@@ -580,7 +537,7 @@ void registration_deregister(lwm2m_context_t * contextP,
     transaction->callback = prv_handleDeregistrationReply;
     transaction->userData = (void *) serverP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
     if (transaction_send(contextP, transaction) == 0)
     {
         serverP->status = STATE_DEREG_PENDING;
@@ -589,27 +546,6 @@ void registration_deregister(lwm2m_context_t * contextP,
 #endif
 
 #ifdef LWM2M_SERVER_MODE
-static void prv_freeClientObjectList(lwm2m_client_object_t * objects)
-{
-    while (objects != NULL)
-    {
-        lwm2m_client_object_t * objP;
-
-        while (objects->instanceList != NULL)
-        {
-            lwm2m_list_t * target;
-
-            target = objects->instanceList;
-            objects->instanceList = objects->instanceList->next;
-            lwm2m_free(target);
-        }
-
-        objP = objects;
-        objects = objects->next;
-        lwm2m_free(objP);
-    }
-}
-
 static int prv_getParameters(multi_option_t * query,
                              char ** nameP,
                              uint32_t * lifetimeP,
@@ -739,17 +675,65 @@ static uint16_t prv_splitLinkAttribute(uint8_t * data,
     return end;
 }
 
+// Parses the value of the ct link attribute: a content format or a quoted list of them.
+// Content formats other than JSON and SenML CBOR are ignored.
+static int prv_parseContentFormats(uint8_t * data,
+                                   uint16_t length,
+                                   bool * supportJSON,
+                                   bool * supportSenmlCbor)
+{
+    uint16_t index;
+
+    if (length >= 2 && data[0] == '"' && data[length - 1] == '"')
+    {
+        data += 1;
+        length -= 2;
+    }
+
+    index = 0;
+    while (index < length)
+    {
+        uint16_t start;
+
+        while (index < length && data[index] == ' ') index++;
+        start = index;
+        while (index < length && data[index] != ' ')
+        {
+            if (data[index] < '0' || data[index] > '9') return 0;
+            index++;
+        }
+        if (index == start) break;
+
+        if (index - start == REG_ATTR_CONTENT_JSON_LEN
+         && 0 == lwm2m_strncmp(REG_ATTR_CONTENT_JSON, (char*)data + start, REG_ATTR_CONTENT_JSON_LEN))
+        {
+            *supportJSON = true;
+        }
+        else if (index - start == REG_ATTR_CONTENT_SENML_CBOR_LEN
+              && 0 == lwm2m_strncmp(REG_ATTR_CONTENT_SENML_CBOR, (char*)data + start, REG_ATTR_CONTENT_SENML_CBOR_LEN))
+        {
+            *supportSenmlCbor = true;
+        }
+    }
+
+    return 1;
+}
+
 static int prv_parseLinkAttributes(uint8_t * data,
                                    uint16_t length,
                                    bool * supportJSON,
-                                   char ** altPath)
+                                   bool * supportSenmlCbor,
+                                   uint8_t ** altPathP,
+                                   uint16_t * altPathLengthP)
 {
     uint16_t index;
     uint16_t pathStart;
     uint16_t pathLength;
     bool isValid;
+    bool contentFound;
 
     isValid = false;
+    contentFound = false;
 
     // Expecting application/link-format (RFC6690)
     // leading space were removed before. Remove trailing spaces.
@@ -808,13 +792,9 @@ static int prv_parseLinkAttributes(uint8_t * data,
         else if (keyLength == REG_ATTR_CONTENT_KEY_LEN
               && 0 == lwm2m_strncmp(REG_ATTR_CONTENT_KEY, (char*)data + index + keyStart, keyLength))
         {
-            if (*supportJSON == true) return 0; // declared twice
-            if (valueLength == REG_ATTR_CONTENT_JSON_LEN
-             && 0 == lwm2m_strncmp(REG_ATTR_CONTENT_JSON, (char*)data + index + valueStart, valueLength))
-            {
-                *supportJSON = true;
-            }
-            else
+            if (contentFound == true) return 0; // declared twice
+            contentFound = true;
+            if (0 == prv_parseContentFormats(data + index + valueStart, valueLength, supportJSON, supportSenmlCbor))
             {
                 return 0;
             }
@@ -826,13 +806,8 @@ static int prv_parseLinkAttributes(uint8_t * data,
 
     if (isValid == false) return 0;
 
-    if (pathLength != 0)
-    {
-        *altPath = (char *)lwm2m_malloc(pathLength + 1);
-        if (*altPath == NULL) return 0;
-        memcpy(*altPath, data + pathStart, pathLength);
-        (*altPath)[pathLength] = 0;
-    }
+    *altPathP = data + pathStart;
+    *altPathLengthP = pathLength;
 
     return 1;
 }
@@ -897,21 +872,55 @@ static int prv_getId(uint8_t * data,
     return 1;
 }
 
-static lwm2m_client_object_t * prv_decodeRegisterPayload(uint8_t * payload,
-                                                         uint16_t payloadLength,
-                                                         bool * supportJSON,
-                                                         char ** altPath)
+// insert a link in the sorted array, ignoring duplicates
+static size_t prv_addLink(uint32_t * links,
+                          size_t count,
+                          uint32_t link)
+{
+    size_t i;
+
+    // objects are usually listed in order
+    i = count;
+    while (i > 0 && links[i - 1] > link) i--;
+    if (i > 0 && links[i - 1] == link) return count;
+
+    memmove(links + i + 1, links + i, (count - i) * sizeof(uint32_t));
+    links[i] = link;
+
+    return count + 1;
+}
+
+static lwm2m_client_object_list_t * prv_decodeRegisterPayload(lwm2m_context_t * contextP,
+                                                              uint8_t * payload,
+                                                              uint16_t payloadLength,
+                                                              bool * supportJSON,
+                                                              bool * supportSenmlCbor)
 {
     uint16_t index;
-    lwm2m_client_object_t * objList;
+    uint32_t * links;
+    size_t count;
+    uint8_t * altPath;
+    uint16_t altPathLength;
+    lwm2m_client_object_list_t * listP;
     bool linkAttrFound;
 
-    *altPath = NULL;
     *supportJSON = false;
-    objList = NULL;
+    *supportSenmlCbor = false;
+    altPath = NULL;
+    altPathLength = 0;
     linkAttrFound = false;
-    index = 0;
 
+    // one link per delimiter at most
+    count = 1;
+    for (index = 0 ; index < payloadLength ; index++)
+    {
+        if (payload[index] == REG_DELIMITER) count++;
+    }
+    links = (uint32_t *)lwm2m_malloc(count * sizeof(uint32_t));
+    if (links == NULL) return NULL;
+
+    count = 0;
+    index = 0;
     while (index <= payloadLength)
     {
         uint16_t start;
@@ -930,34 +939,12 @@ static lwm2m_client_object_t * prv_decodeRegisterPayload(uint8_t * payload,
         result = prv_getId(payload + start, length, &id, &instance);
         if (result != 0)
         {
-            lwm2m_client_object_t * objectP;
-
-            objectP = (lwm2m_client_object_t *)lwm2m_list_find((lwm2m_list_t *)objList, id);
-            if (objectP == NULL)
-            {
-                objectP = (lwm2m_client_object_t *)lwm2m_malloc(sizeof(lwm2m_client_object_t));
-                memset(objectP, 0, sizeof(lwm2m_client_object_t));
-                if (objectP == NULL) goto error;
-                objectP->id = id;
-                objList = (lwm2m_client_object_t *)LWM2M_LIST_ADD(objList, objectP);
-            }
-            if (result == 2)
-            {
-                lwm2m_list_t * instanceP;
-
-                instanceP = lwm2m_list_find(objectP->instanceList, instance);
-                if (instanceP == NULL)
-                {
-                    instanceP = (lwm2m_list_t *)lwm2m_malloc(sizeof(lwm2m_list_t));
-                    memset(instanceP, 0, sizeof(lwm2m_list_t));
-                    instanceP->id = instance;
-                    objectP->instanceList = LWM2M_LIST_ADD(objectP->instanceList, instanceP);
-                }
-            }
+            if (result == 1) instance = LWM2M_MAX_ID;
+            count = prv_addLink(links, count, ((uint32_t)id << 16) | instance);
         }
         else if (linkAttrFound == false)
         {
-            result = prv_parseLinkAttributes(payload + start, length, supportJSON, altPath);
+            result = prv_parseLinkAttributes(payload + start, length, supportJSON, supportSenmlCbor, &altPath, &altPathLength);
             if (result == 0) goto error;
 
             linkAttrFound = true;
@@ -967,47 +954,29 @@ static lwm2m_client_object_t * prv_decodeRegisterPayload(uint8_t * payload,
         index++;
     }
 
-    return objList;
+    listP = objectlist_intern(contextP, links, count, altPath, altPathLength);
+    lwm2m_free(links);
+
+    return listP;
 
 error:
-    if (*altPath != NULL)
-    {
-        lwm2m_free(*altPath);
-        *altPath = NULL;
-    }
-    prv_freeClientObjectList(objList);
+    lwm2m_free(links);
 
     return NULL;
 }
 
-static lwm2m_client_t * prv_getClientByName(lwm2m_context_t * contextP,
-                                            char * name)
-{
-    lwm2m_client_t * targetP;
-
-    targetP = contextP->clientList;
-    while (targetP != NULL && strcmp(name, targetP->name) != 0)
-    {
-        targetP = targetP->next;
-    }
-
-    return targetP;
-}
-
-void registration_freeClient(lwm2m_client_t * clientP)
+void registration_freeClient(lwm2m_context_t * contextP,
+                             lwm2m_client_t * clientP)
 {
     LOG("Entering");
+    // still in the timer heap when the context is closed
+    timer_cancel(contextP, &clientP->lifetimeTimer);
     if (clientP->name != NULL) lwm2m_free(clientP->name);
     if (clientP->msisdn != NULL) lwm2m_free(clientP->msisdn);
-    if (clientP->altPath != NULL) lwm2m_free(clientP->altPath);
-    prv_freeClientObjectList(clientP->objectList);
+    objectlist_release(contextP, clientP->objectList);
     while(clientP->observationList != NULL)
     {
-        lwm2m_observation_t * targetP;
-
-        targetP = clientP->observationList;
-        clientP->observationList = clientP->observationList->next;
-        lwm2m_free(targetP);
+        observe_remove(clientP->observationList);
     }
     lwm2m_free(clientP);
 }
@@ -1026,10 +995,29 @@ static int prv_getLocationString(uint16_t id,
 
     result = utils_intToText(id, (uint8_t*)location + index, MAX_LOCATION_LENGTH - index);
     if (result == 0) return 0;
+    // utils_intToText() leaves digits after the number
+    location[index + result] = 0;
 
     return index + result;
 }
 
+static void prv_lifetimeCallback(lwm2m_context_t * contextP,
+                                 void * userData,
+                                 time_t currentTime)
+{
+    lwm2m_client_t * clientP = (lwm2m_client_t *)userData;
+
+    (void)currentTime;
+
+    LOG_ARG("Registration of client %d expired", clientP->internalID);
+    registry_remove(contextP, clientP);
+    if (contextP->monitorCallback != NULL)
+    {
+        contextP->monitorCallback(clientP->internalID, NULL, COAP_202_DELETED, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
+    }
+    registration_freeClient(contextP, clientP);
+}
+
 uint8_t registration_handleRequest(lwm2m_context_t * contextP,
                                    lwm2m_uri_t * uriP,
                                    void * fromSessionH,
@@ -1050,11 +1038,11 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
         char * name = NULL;
         uint32_t lifetime;
         char * msisdn;
-        char * altPath;
         char * version;
         lwm2m_binding_t binding;
-        lwm2m_client_object_t * objects;
+        lwm2m_client_object_list_t * objects;
         bool supportJSON;
+        bool supportSenmlCbor;
         lwm2m_client_t * clientP;
         char location[MAX_LOCATION_LENGTH];
 
@@ -1068,7 +1056,7 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
             return COAP_400_BAD_REQUEST;
         }
 
-        objects = prv_decodeRegisterPayload(message->payload, message->payload_len, &supportJSON, &altPath);
+        objects = prv_decodeRegisterPayload(contextP, message->payload, message->payload_len, &supportJSON, &supportSenmlCbor);
 
         switch (uriP->flag & LWM2M_URI_MASK_ID)
         {
@@ -1079,6 +1067,7 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
             {
                 if (name != NULL) lwm2m_free(name);
                 if (msisdn != NULL) lwm2m_free(msisdn);
+                objectlist_release(contextP, objects);
                 return COAP_400_BAD_REQUEST;
             }
             // Endpoint client name is mandatory
@@ -1086,6 +1075,7 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
             {
                 lwm2m_free(version);
                 if (msisdn != NULL) lwm2m_free(msisdn);
+                objectlist_release(contextP, objects);
                 return COAP_400_BAD_REQUEST;
             }
             // Object list is mandatory
@@ -1103,23 +1093,26 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
                 lwm2m_free(version);
                 lwm2m_free(name);
                 if (msisdn != NULL) lwm2m_free(msisdn);
+                objectlist_release(contextP, objects);
                 return COAP_412_PRECONDITION_FAILED;
             }
+            lwm2m_free(version);
 
             if (lifetime == 0)
             {
                 lifetime = LWM2M_DEFAULT_LIFETIME;
             }
 
-            clientP = prv_getClientByName(contextP, name);
+            clientP = registry_findByName(contextP, name);
             if (clientP != NULL)
             {
                 // we reset this registration
                 lwm2m_free(clientP->name);
                 if (clientP->msisdn != NULL) lwm2m_free(clientP->msisdn);
-                if (clientP->altPath != NULL) lwm2m_free(clientP->altPath);
-                prv_freeClientObjectList(clientP->objectList);
+                objectlist_release(contextP, clientP->objectList);
                 clientP->objectList = NULL;
+                clientP->name = name;
+                clientP->sessionH = fromSessionH;
             }
             else
             {
@@ -1127,33 +1120,41 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
                 if (clientP == NULL)
                 {
                     lwm2m_free(name);
-                    lwm2m_free(altPath);
                     if (msisdn != NULL) lwm2m_free(msisdn);
-                    prv_freeClientObjectList(objects);
+                    objectlist_release(contextP, objects);
                     return COAP_500_INTERNAL_SERVER_ERROR;
                 }
                 memset(clientP, 0, sizeof(lwm2m_client_t));
-                clientP->internalID = lwm2m_list_newId((lwm2m_list_t *)contextP->clientList);
-                contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_ADD(contextP->clientList, clientP);
+                clientP->name = name;
+                clientP->sessionH = fromSessionH;
+                clientP->lifetimeTimer.callback = prv_lifetimeCallback;
+                clientP->lifetimeTimer.userData = clientP;
+                if (!registry_newId(contextP, &clientP->internalID)
+                 || 0 == registry_add(contextP, clientP))
+                {
+                    lwm2m_free(clientP);
+                    lwm2m_free(name);
+                    if (msisdn != NULL) lwm2m_free(msisdn);
+                    objectlist_release(contextP, objects);
+                    return COAP_500_INTERNAL_SERVER_ERROR;
+                }
             }
-            clientP->name = name;
             clientP->binding = binding;
             clientP->msisdn = msisdn;
-            clientP->altPath = altPath;
+            clientP->altPath = objects->altPath;
             clientP->supportJSON = supportJSON;
+            clientP->supportSenmlCbor = supportSenmlCbor;
             clientP->lifetime = lifetime;
             clientP->endOfLife = tv_sec + lifetime;
             clientP->objectList = objects;
-            clientP->sessionH = fromSessionH;
 
-            if (prv_getLocationString(clientP->internalID, location) == 0)
+            if (prv_getLocationString(clientP->internalID, location) == 0
+             || coap_set_header_location_path(response, location) == 0
+             || timer_schedule(contextP, &clientP->lifetimeTimer, clientP->endOfLife) == 0)
             {
-                registration_freeClient(clientP);
-                return COAP_500_INTERNAL_SERVER_ERROR;
-            }
-            if (coap_set_header_location_path(response, location) == 0)
-            {
-                registration_freeClient(clientP);
+                timer_cancel(contextP, &clientP->lifetimeTimer);
+                registry_remove(contextP, clientP);
+                registration_freeClient(contextP, clientP);
                 return COAP_500_INTERNAL_SERVER_ERROR;
             }
 
@@ -1165,14 +1166,23 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
             break;
 
         case LWM2M_URI_FLAG_OBJECT_ID:
-            clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, uriP->objectId);
-            if (clientP == NULL) return COAP_404_NOT_FOUND;
+            // the version is only checked on registration
+            if (version != NULL) lwm2m_free(version);
+            clientP = registry_findById(contextP, uriP->objectId);
+            if (clientP == NULL)
+            {
+                if (name != NULL) lwm2m_free(name);
+                if (msisdn != NULL) lwm2m_free(msisdn);
+                objectlist_release(contextP, objects);
+                return COAP_404_NOT_FOUND;
+            }
 
             // Endpoint client name MUST NOT be present
             if (name != NULL)
             {
                 lwm2m_free(name);
                 if (msisdn != NULL) lwm2m_free(msisdn);
+                objectlist_release(contextP, objects);
                 return COAP_400_BAD_REQUEST;
             }
 
@@ -1192,7 +1202,12 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
             // client IP address, port or MSISDN may have changed
             clientP->sessionH = fromSessionH;
 
-            if (objects != NULL)
+            if (objects == clientP->objectList)
+            {
+                // same interned list: nothing changed
+                objectlist_release(contextP, objects);
+            }
+            else if (objects != NULL)
             {
                 lwm2m_observation_t * observationP;
 
@@ -1205,27 +1220,29 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
 
                     nextP = observationP->next;
 
-                    objP = (lwm2m_client_object_t *)lwm2m_list_find((lwm2m_list_t *)objects, observationP->uri.objectId);
+                    objP = objectlist_findObject(objects, observationP->uri.objectId);
                     if (objP == NULL)
                     {
-                        observationP->callback(clientP->internalID,
-                                               &observationP->uri,
-                                               COAP_202_DELETED,
-                                               LWM2M_CONTENT_TEXT, NULL, 0,
-                                               observationP->userData);
+                        completion_report(contextP, observationP->callback,
+                                          clientP->internalID,
+                                          &observationP->uri,
+                                          COAP_202_DELETED,
+                                          LWM2M_CONTENT_TEXT, NULL, 0,
+                                          observationP->userData);
                         observe_remove(observationP);
                     }
                     else
                     {
                         if ((observationP->uri.flag & LWM2M_URI_FLAG_INSTANCE_ID) != 0)
                         {
-                            if (lwm2m_list_find((lwm2m_list_t *)objP->instanceList, observationP->uri.instanceId) == NULL)
+                            if (!objectlist_hasInstance(objP, observationP->uri.instanceId))
                             {
-                                observationP->callback(clientP->internalID,
-                                                       &observationP->uri,
-                                                       COAP_202_DELETED,
-                                                       LWM2M_CONTENT_TEXT, NULL, 0,
-                                                       observationP->userData);
+                                completion_report(contextP, observationP->callback,
+                                                  clientP->internalID,
+                                                  &observationP->uri,
+                                                  COAP_202_DELETED,
+                                                  LWM2M_CONTENT_TEXT, NULL, 0,
+                                                  observationP->userData);
                                 observe_remove(observationP);
                             }
                         }
@@ -1234,11 +1251,16 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
                     observationP = nextP;
                 }
 
-                prv_freeClientObjectList(clientP->objectList);
+                objectlist_release(contextP, clientP->objectList);
                 clientP->objectList = objects;
+                clientP->altPath = objects->altPath;
             }
 
             clientP->endOfLife = tv_sec + clientP->lifetime;
+            if (timer_schedule(contextP, &clientP->lifetimeTimer, clientP->endOfLife) == 0)
+            {
+                return COAP_500_INTERNAL_SERVER_ERROR;
+            }
 
             if (contextP->monitorCallback != NULL)
             {
@@ -1259,13 +1281,15 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
 
         if ((uriP->flag & LWM2M_URI_MASK_ID) != LWM2M_URI_FLAG_OBJECT_ID) return COAP_400_BAD_REQUEST;
 
-        contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_RM(contextP->clientList, uriP->objectId, &clientP);
+        clientP = registry_findById(contextP, uriP->objectId);
         if (clientP == NULL) return COAP_400_BAD_REQUEST;
+        timer_cancel(contextP, &clientP->lifetimeTimer);
+        registry_remove(contextP, clientP);
         if (contextP->monitorCallback != NULL)
         {
             contextP->monitorCallback(clientP->internalID, NULL, COAP_202_DELETED, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
         }
-        registration_freeClient(clientP);
+        registration_freeClient(contextP, clientP);
         result = COAP_202_DELETED;
     }
     break;
@@ -1285,10 +1309,19 @@ void lwm2m_set_monitoring_callback(lwm2m_context_t * contextP,
     contextP->monitorCallback = callback;
     contextP->monitorUserData = userData;
 }
+
+void lwm2m_set_observe_release_callback(lwm2m_context_t * contextP,
+                                        lwm2m_observe_release_callback_t callback,
+                                        void * userData)
+{
+    LOG("Entering");
+    contextP->observeReleaseCallback = callback;
+    contextP->observeReleaseUserData = userData;
+}
 #endif
 
 // for each server update the registration if needed
-// for each client check if the registration expired
+// registered clients lifetimes are handled by their timers
 void registration_step(lwm2m_context_t * contextP,
                        time_t currentTime,
                        time_t * timeoutP)
@@ -1352,41 +1385,10 @@ void registration_step(lwm2m_context_t * contextP,
         }
         targetP = targetP->next;
     }
-
+#else
+    (void)contextP;
+    (void)currentTime;
+    (void)timeoutP;
 #endif
-#ifdef LWM2M_SERVER_MODE
-    lwm2m_client_t * clientP;
-
-    LOG("Entering");
-    // monitor clients lifetime
-    clientP = contextP->clientList;
-    while (clientP != NULL)
-    {
-        lwm2m_client_t * nextP = clientP->next;
-
-        if (clientP->endOfLife <= currentTime)
-        {
-            contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_RM(contextP->clientList, clientP->internalID, NULL);
-            if (contextP->monitorCallback != NULL)
-            {
-                contextP->monitorCallback(clientP->internalID, NULL, COAP_202_DELETED, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
-            }
-            registration_freeClient(clientP);
-        }
-        else
-        {
-            time_t interval;
-
-            interval = clientP->endOfLife - currentTime;
-
-            if (*timeoutP > interval)
-            {
-                *timeoutP = interval;
-            }
-        }
-        clientP = nextP;
-    }
-#endif
-
 }
 
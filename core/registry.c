@@ -0,0 +1,320 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * Registry of the clients registered to a LWM2M Server.
+ *
+ * Each client is chained in two hash tables (by internal ID and by endpoint
+ * name) using intrusive links stored in lwm2m_client_t.
+ * The clientList of the context is kept sorted by internal ID so existing
+ * code iterating over it or using lwm2m_list_find() on it keeps working.
+ */
+
+#include "internals.h"
+
+#ifdef LWM2M_SERVER_MODE
+
+#define PRV_REGISTRY_MIN_SIZE   16
+
+typedef enum
+{
+    PRV_INDEX_ID = 0,
+    PRV_INDEX_NAME
+} prv_index_t;
+
+static size_t prv_hashName(const char * name)
+{
+    return (size_t)utils_hashBytes(UTILS_HASH_SEED, (const uint8_t *)name, strlen(name));
+}
+
+static lwm2m_client_t ** prv_getTable(lwm2m_client_registry_t * registryP,
+                                      prv_index_t index)
+{
+    switch (index)
+    {
+    case PRV_INDEX_ID:
+        return registryP->idTable;
+    case PRV_INDEX_NAME:
+    default:
+        return registryP->nameTable;
+    }
+}
+
+static lwm2m_client_t ** prv_getNext(lwm2m_client_t * clientP,
+                                     prv_index_t index)
+{
+    switch (index)
+    {
+    case PRV_INDEX_ID:
+        return &clientP->idNext;
+    case PRV_INDEX_NAME:
+    default:
+        return &clientP->nameNext;
+    }
+}
+
+static size_t prv_getBucket(lwm2m_client_registry_t * registryP,
+                            lwm2m_client_t * clientP,
+                            prv_index_t index)
+{
+    size_t hash;
+
+    switch (index)
+    {
+    case PRV_INDEX_ID:
+        hash = clientP->internalID;
+        break;
+    case PRV_INDEX_NAME:
+    default:
+        hash = (clientP->name == NULL) ? 0 : prv_hashName(clientP->name);
+        break;
+    }
+
+    return utils_hashBucket(hash, registryP->size);
+}
+
+static void prv_insert(lwm2m_client_registry_t * registryP,
+                       lwm2m_client_t * clientP,
+                       prv_index_t index)
+{
+    lwm2m_client_t ** tableP;
+    size_t bucket;
+
+    tableP = prv_getTable(registryP, index);
+    bucket = prv_getBucket(registryP, clientP, index);
+
+    *prv_getNext(clientP, index) = tableP[bucket];
+    tableP[bucket] = clientP;
+}
+
+static void prv_extract(lwm2m_client_registry_t * registryP,
+                        lwm2m_client_t * clientP,
+                        prv_index_t index)
+{
+    lwm2m_client_t ** targetP;
+
+    targetP = prv_getTable(registryP, index) + prv_getBucket(registryP, clientP, index);
+    while (*targetP != NULL && *targetP != clientP)
+    {
+        targetP = prv_getNext(*targetP, index);
+    }
+    if (*targetP != NULL)
+    {
+        *targetP = *prv_getNext(clientP, index);
+    }
+    *prv_getNext(clientP, index) = NULL;
+}
+
+static int prv_resize(lwm2m_context_t * contextP,
+                      size_t size)
+{
+    lwm2m_client_registry_t * registryP = &contextP->clientRegistry;
+    lwm2m_client_t ** tablesP;
+    lwm2m_client_t * clientP;
+
+    tablesP = (lwm2m_client_t **)utils_hashTableAlloc(size, 2);
+    if (tablesP == NULL) return 0;
+
+    if (registryP->idTable != NULL) lwm2m_free(registryP->idTable);
+    registryP->idTable = tablesP;
+    registryP->nameTable = tablesP + size;
+    registryP->size = size;
+
+    for (clientP = contextP->clientList ; clientP != NULL ; clientP = clientP->next)
+    {
+        prv_insert(registryP, clientP, PRV_INDEX_ID);
+        prv_insert(registryP, clientP, PRV_INDEX_NAME);
+    }
+
+    return 1;
+}
+
+bool registry_newId(lwm2m_context_t * contextP,
+                    uint16_t * idP)
+{
+    lwm2m_client_registry_t * registryP = &contextP->clientRegistry;
+    uint32_t i;
+
+    for (i = 0 ; i <= UINT16_MAX ; i++)
+    {
+        uint16_t id = (uint16_t)(registryP->nextID + i);
+
+        if (registry_findById(contextP, id) == NULL)
+        {
+            registryP->nextID = id + 1;
+            *idP = id;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int registry_add(lwm2m_context_t * contextP,
+                 lwm2m_client_t * clientP)
+{
+    lwm2m_client_registry_t * registryP = &contextP->clientRegistry;
+    size_t size;
+
+    LOG_ARG("internalID: %d", clientP->internalID);
+
+    size = utils_hashTableSize(registryP->size, registryP->count, PRV_REGISTRY_MIN_SIZE);
+    if (size != registryP->size
+     && 0 == prv_resize(contextP, size)
+     && registryP->size == 0)
+    {
+        return 0;
+    }
+
+    prv_insert(registryP, clientP, PRV_INDEX_ID);
+    prv_insert(registryP, clientP, PRV_INDEX_NAME);
+
+    if (registryP->tail == NULL || registryP->tail->internalID < clientP->internalID)
+    {
+        // IDs are allocated in increasing order so this is the usual case
+        clientP->prev = registryP->tail;
+        clientP->next = NULL;
+        if (registryP->tail == NULL)
+        {
+            contextP->clientList = clientP;
+        }
+        else
+        {
+            registryP->tail->next = clientP;
+        }
+        registryP->tail = clientP;
+    }
+    else
+    {
+        // the ID counter wrapped around
+        lwm2m_client_t * targetP;
+
+        targetP = contextP->clientList;
+        while (targetP->internalID < clientP->internalID)
+        {
+            targetP = targetP->next;
+        }
+        clientP->next = targetP;
+        clientP->prev = targetP->prev;
+        if (targetP->prev == NULL)
+        {
+            contextP->clientList = clientP;
+        }
+        else
+        {
+            targetP->prev->next = clientP;
+        }
+        targetP->prev = clientP;
+    }
+
+    registryP->count++;
+
+    return 1;
+}
+
+void registry_remove(lwm2m_context_t * contextP,
+                     lwm2m_client_t * clientP)
+{
+    lwm2m_client_registry_t * registryP = &contextP->clientRegistry;
+
+    LOG_ARG("internalID: %d", clientP->internalID);
+
+    if (registryP->size == 0) return;
+
+    prv_extract(registryP, clientP, PRV_INDEX_ID);
+    prv_extract(registryP, clientP, PRV_INDEX_NAME);
+
+    if (clientP->prev == NULL)
+    {
+        contextP->clientList = clientP->next;
+    }
+    else
+    {
+        clientP->prev->next = clientP->next;
+    }
+    if (clientP->next == NULL)
+    {
+        registryP->tail = clientP->prev;
+    }
+    else
+    {
+        clientP->next->prev = clientP->prev;
+    }
+    clientP->next = NULL;
+    clientP->prev = NULL;
+
+    registryP->count--;
+}
+
+lwm2m_client_t * registry_findById(lwm2m_context_t * contextP,
+                                   uint16_t id)
+{
+    lwm2m_client_registry_t * registryP = &contextP->clientRegistry;
+    lwm2m_client_t * targetP;
+
+    if (registryP->size == 0) return NULL;
+
+    targetP = registryP->idTable[utils_hashBucket(id, registryP->size)];
+    while (targetP != NULL && targetP->internalID != id)
+    {
+        targetP = targetP->idNext;
+    }
+
+    return targetP;
+}
+
+lwm2m_client_t * registry_findByName(lwm2m_context_t * contextP,
+                                     const char * name)
+{
+    lwm2m_client_registry_t * registryP = &contextP->clientRegistry;
+    lwm2m_client_t * targetP;
+
+    if (registryP->size == 0 || name == NULL) return NULL;
+
+    targetP = registryP->nameTable[utils_hashBucket(prv_hashName(name), registryP->size)];
+    while (targetP != NULL
+        && (targetP->name == NULL || strcmp(name, targetP->name) != 0))
+    {
+        targetP = targetP->nameNext;
+    }
+
+    return targetP;
+}
+
+void registry_close(lwm2m_context_t * contextP)
+{
+    lwm2m_client_registry_t * registryP = &contextP->clientRegistry;
+
+    if (registryP->idTable != NULL) lwm2m_free(registryP->idTable);
+    memset(registryP, 0, sizeof(lwm2m_client_registry_t));
+}
+
+lwm2m_client_t * lwm2m_get_client(lwm2m_context_t * contextP,
+                                  uint16_t clientID)
+{
+    LOG_ARG("clientID: %d", clientID);
+    return registry_findById(contextP, clientID);
+}
+
+lwm2m_client_t * lwm2m_get_client_by_name(lwm2m_context_t * contextP,
+                                          const char * name)
+{
+    LOG_ARG("name: %s", name);
+    return registry_findByName(contextP, name);
+}
+
+#endif
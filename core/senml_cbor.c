@@ -0,0 +1,1007 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * SenML CBOR (RFC 8428) payloads: an array of maps with integer labels, one
+ * map per resource or resource instance value. Numbers, booleans and opaque
+ * values are carried in binary, so no text conversion nor base64 is needed.
+ *
+ * The serializer writes the base name in the first record only, and names
+ * relative to it. The parser accepts any base name and name split, with
+ * definite or indefinite length arrays and maps.
+ * Object links use the "vlo" label of LWM2M 1.1 with a "A:B" text value.
+ */
+
+#include "internals.h"
+#include <string.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+
+#ifdef LWM2M_SUPPORT_SENML_CBOR
+
+#define PRV_MAJOR_UNSIGNED      0
+#define PRV_MAJOR_NEGATIVE      1
+#define PRV_MAJOR_BYTES         2
+#define PRV_MAJOR_TEXT          3
+#define PRV_MAJOR_ARRAY         4
+#define PRV_MAJOR_MAP           5
+#define PRV_MAJOR_TAG           6
+#define PRV_MAJOR_SIMPLE        7
+
+#define PRV_INFO_UINT8          24
+#define PRV_INFO_UINT16         25
+#define PRV_INFO_UINT32         26
+#define PRV_INFO_UINT64         27
+#define PRV_INFO_INDEFINITE     31
+
+#define PRV_SIMPLE_FALSE        20
+#define PRV_SIMPLE_TRUE         21
+#define PRV_FLOAT_HALF          PRV_INFO_UINT16
+#define PRV_FLOAT_SINGLE        PRV_INFO_UINT32
+#define PRV_FLOAT_DOUBLE        PRV_INFO_UINT64
+#define PRV_BREAK               0xFF
+
+#define PRV_LABEL_BASE_NAME     (-2)
+#define PRV_LABEL_NAME          0
+#define PRV_LABEL_VALUE         2
+#define PRV_LABEL_STRING        3
+#define PRV_LABEL_BOOLEAN       4
+#define PRV_LABEL_DATA          8
+#define PRV_LABEL_OBJLNK        "vlo"
+#define PRV_LABEL_OBJLNK_LEN    3
+
+// "/65535/65535/65535/65535"
+#define PRV_NAME_MAX_LEN        24
+// nesting of the items skipped when parsing
+#define PRV_MAX_DEPTH           8
+
+typedef enum
+{
+    PRV_VALUE_UNSET = 0,
+    PRV_VALUE_INTEGER,
+    PRV_VALUE_FLOAT,
+    PRV_VALUE_BOOLEAN,
+    PRV_VALUE_STRING,
+    PRV_VALUE_OPAQUE,
+    PRV_VALUE_OBJECT_LINK
+} prv_value_type_t;
+
+typedef struct
+{
+    prv_value_type_t type;
+    int64_t          asInteger;
+    double           asFloat;
+    bool             asBoolean;
+    const uint8_t *  buffer;
+    size_t           length;
+} prv_value_t;
+
+/*
+ * Serialization
+ */
+
+static int prv_writeHead(utils_buffer_t * outputP,
+                         uint8_t major,
+                         uint64_t value)
+{
+    uint8_t * headP;
+    size_t length;
+    size_t i;
+
+    if (value < PRV_INFO_UINT8) length = 1;
+    else if (value <= 0xFF) length = 2;
+    else if (value <= 0xFFFF) length = 3;
+    else if (value <= 0xFFFFFFFF) length = 5;
+    else length = 9;
+
+    headP = utils_bufferReserve(outputP, length);
+    if (headP == NULL) return -1;
+
+    switch (length)
+    {
+    case 1:
+        headP[0] = (uint8_t)((major << 5) | value);
+        break;
+    case 2:
+        headP[0] = (uint8_t)((major << 5) | PRV_INFO_UINT8);
+        break;
+    case 3:
+        headP[0] = (uint8_t)((major << 5) | PRV_INFO_UINT16);
+        break;
+    case 5:
+        headP[0] = (uint8_t)((major << 5) | PRV_INFO_UINT32);
+        break;
+    default:
+        headP[0] = (uint8_t)((major << 5) | PRV_INFO_UINT64);
+        break;
+    }
+    // big endian argument
+    for (i = 1 ; i < length ; i++)
+    {
+        headP[i] = (uint8_t)(value >> (8 * (length - 1 - i)));
+    }
+    outputP->length += length;
+
+    return 0;
+}
+
+static int prv_writeString(utils_buffer_t * outputP,
+                           uint8_t major,
+                           const uint8_t * data,
+                           size_t length)
+{
+    uint8_t * targetP;
+
+    if (0 != prv_writeHead(outputP, major, length)) return -1;
+    if (length == 0) return 0;
+    targetP = utils_bufferReserve(outputP, length);
+    if (targetP == NULL) return -1;
+    memcpy(targetP, data, length);
+    outputP->length += length;
+
+    return 0;
+}
+
+static int prv_writeInt(utils_buffer_t * outputP,
+                        int64_t value)
+{
+    if (value >= 0)
+    {
+        return prv_writeHead(outputP, PRV_MAJOR_UNSIGNED, (uint64_t)value);
+    }
+    return prv_writeHead(outputP, PRV_MAJOR_NEGATIVE, (uint64_t)(-1 - value));
+}
+
+// Single precision when it is exact, double precision otherwise
+static int prv_writeFloat(utils_buffer_t * outputP,
+                          double value)
+{
+    uint8_t * targetP;
+    uint64_t bits;
+    size_t length;
+    size_t i;
+
+    memcpy(&bits, &value, sizeof(bits));
+    length = 8;
+    if ((value >= 0.0 - (double)FLT_MAX) && (value <= (double)FLT_MAX))
+    {
+        float single = (float)value;
+        double widened = (double)single;
+        uint64_t widenedBits;
+
+        memcpy(&widenedBits, &widened, sizeof(widenedBits));
+        if (widenedBits == bits)
+        {
+            uint32_t singleBits;
+
+            memcpy(&singleBits, &single, sizeof(singleBits));
+            bits = singleBits;
+            length = 4;
+        }
+    }
+
+    targetP = utils_bufferReserve(outputP, 1 + length);
+    if (targetP == NULL) return -1;
+    targetP[0] = (PRV_MAJOR_SIMPLE << 5) | (length == 4 ? PRV_FLOAT_SINGLE : PRV_FLOAT_DOUBLE);
+    for (i = 0 ; i < length ; i++)
+    {
+        targetP[1 + i] = (uint8_t)(bits >> (8 * (length - 1 - i)));
+    }
+    outputP->length += 1 + length;
+
+    return 0;
+}
+
+static int prv_writeValue(utils_buffer_t * outputP,
+                          lwm2m_data_t * dataP)
+{
+    switch (dataP->type)
+    {
+    case LWM2M_TYPE_STRING:
+        if (0 != prv_writeInt(outputP, PRV_LABEL_STRING)) return -1;
+        return prv_writeString(outputP, PRV_MAJOR_TEXT, dataP->value.asBuffer.buffer, dataP->value.asBuffer.length);
+
+    case LWM2M_TYPE_OPAQUE:
+        if (0 != prv_writeInt(outputP, PRV_LABEL_DATA)) return -1;
+        return prv_writeString(outputP, PRV_MAJOR_BYTES, dataP->value.asBuffer.buffer, dataP->value.asBuffer.length);
+
+    case LWM2M_TYPE_INTEGER:
+        if (0 != prv_writeInt(outputP, PRV_LABEL_VALUE)) return -1;
+        return prv_writeInt(outputP, dataP->value.asInteger);
+
+    case LWM2M_TYPE_FLOAT:
+        if (0 != prv_writeInt(outputP, PRV_LABEL_VALUE)) return -1;
+        return prv_writeFloat(outputP, dataP->value.asFloat);
+
+    case LWM2M_TYPE_BOOLEAN:
+    {
+        uint8_t * targetP;
+
+        if (0 != prv_writeInt(outputP, PRV_LABEL_BOOLEAN)) return -1;
+        targetP = utils_bufferReserve(outputP, 1);
+        if (targetP == NULL) return -1;
+        targetP[0] = (PRV_MAJOR_SIMPLE << 5) | (dataP->value.asBoolean ? PRV_SIMPLE_TRUE : PRV_SIMPLE_FALSE);
+        outputP->length += 1;
+        return 0;
+    }
+
+    case LWM2M_TYPE_OBJECT_LINK:
+    {
+        uint8_t text[12];    // "65535:65535"
+        size_t length;
+        size_t res;
+
+        if (0 != prv_writeString(outputP, PRV_MAJOR_TEXT, (uint8_t *)PRV_LABEL_OBJLNK, PRV_LABEL_OBJLNK_LEN)) return -1;
+        length = utils_intToText(dataP->value.asObjLink.objectId, text, sizeof(text));
+        if (length == 0) return -1;
+        text[length++] = ':';
+        res = utils_intToText(dataP->value.asObjLink.objectInstanceId, text + length, sizeof(text) - length);
+        if (res == 0) return -1;
+        return prv_writeString(outputP, PRV_MAJOR_TEXT, text, length + res);
+    }
+
+    default:
+        return -1;
+    }
+}
+
+static size_t prv_countRecords(int size,
+                               lwm2m_data_t * dataP)
+{
+    size_t count = 0;
+    int i;
+
+    for (i = 0 ; i < size ; i++)
+    {
+        switch (dataP[i].type)
+        {
+        case LWM2M_TYPE_OBJECT:
+        case LWM2M_TYPE_OBJECT_INSTANCE:
+        case LWM2M_TYPE_MULTIPLE_RESOURCE:
+            count += prv_countRecords((int)dataP[i].value.asChildren.count, dataP[i].value.asChildren.array);
+            break;
+        default:
+            count++;
+            break;
+        }
+    }
+
+    return count;
+}
+
+// name holds the path relative to the base name of the parent of dataP
+static int prv_writeRecords(utils_buffer_t * outputP,
+                            int size,
+                            lwm2m_data_t * dataP,
+                            uint8_t * baseName,
+                            size_t * baseNameLenP,
+                            uint8_t * name,
+                            size_t nameLen)
+{
+    int i;
+
+    for (i = 0 ; i < size ; i++)
+    {
+        size_t length;
+        size_t res;
+
+        if (nameLen + 6 > PRV_NAME_MAX_LEN) return -1;
+        length = nameLen;
+        if (length > 0) name[length++] = '/';
+        res = utils_intToText(dataP[i].id, name + length, PRV_NAME_MAX_LEN - length);
+        if (res == 0) return -1;
+        length += res;
+
+        switch (dataP[i].type)
+        {
+        case LWM2M_TYPE_OBJECT:
+        case LWM2M_TYPE_OBJECT_INSTANCE:
+        case LWM2M_TYPE_MULTIPLE_RESOURCE:
+            if (0 != prv_writeRecords(outputP, (int)dataP[i].value.asChildren.count, dataP[i].value.asChildren.array,
+                                      baseName, baseNameLenP, name, length))
+            {
+                return -1;
+            }
+            break;
+
+        default:
+            // only the first record carries the base name
+            if (0 != prv_writeHead(outputP, PRV_MAJOR_MAP, *baseNameLenP != 0 ? 3 : 2)) return -1;
+            if (*baseNameLenP != 0)
+            {
+                if (0 != prv_writeInt(outputP, PRV_LABEL_BASE_NAME)) return -1;
+                if (0 != prv_writeString(outputP, PRV_MAJOR_TEXT, baseName, *baseNameLenP)) return -1;
+                *baseNameLenP = 0;
+            }
+            if (0 != prv_writeInt(outputP, PRV_LABEL_NAME)) return -1;
+            if (0 != prv_writeString(outputP, PRV_MAJOR_TEXT, name, length)) return -1;
+            if (0 != prv_writeValue(outputP, dataP + i)) return -1;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+int senml_cbor_serializeTo(lwm2m_uri_t * uriP,
+                           bool isResourceInstance,
+                           int size,
+                           lwm2m_data_t * dataP,
+                           utils_buffer_t * outputP)
+{
+    uint8_t baseName[PRV_NAME_MAX_LEN];
+    size_t baseNameLen;
+    uint8_t name[PRV_NAME_MAX_LEN];
+    size_t start;
+
+    LOG_ARG("size: %d", size);
+    LOG_URI(uriP);
+
+    // The base name is the targeted object or instance, or the resource when dataP holds its instances.
+    // Without URI, it is the root.
+    baseNameLen = 0;
+    if (uriP != NULL)
+    {
+        uint16_t ids[3];
+        int count;
+        int i;
+
+        count = 0;
+        ids[count++] = uriP->objectId;
+        if (LWM2M_URI_IS_SET_INSTANCE(uriP)) ids[count++] = uriP->instanceId;
+        if (LWM2M_URI_IS_SET_RESOURCE(uriP) && isResourceInstance) ids[count++] = uriP->resourceId;
+        for (i = 0 ; i < count ; i++)
+        {
+            size_t res;
+
+            baseName[baseNameLen++] = '/';
+            res = utils_intToText(ids[i], baseName + baseNameLen, PRV_NAME_MAX_LEN - baseNameLen);
+            if (res == 0) return -1;
+            baseNameLen += res;
+        }
+    }
+    baseName[baseNameLen++] = '/';
+
+    start = outputP->length;
+    if (0 != prv_writeHead(outputP, PRV_MAJOR_ARRAY, prv_countRecords(size, dataP))
+     || 0 != prv_writeRecords(outputP, size, dataP, baseName, &baseNameLen, name, 0)
+     || outputP->length - start > INT_MAX)
+    {
+        outputP->length = start;
+        return -1;
+    }
+
+    LOG_ARG("returning %u", outputP->length - start);
+
+    return (int)(outputP->length - start);
+}
+
+int senml_cbor_serialize(lwm2m_uri_t * uriP,
+                         bool isResourceInstance,
+                         int size,
+                         lwm2m_data_t * dataP,
+                         uint8_t ** bufferP)
+{
+    utils_buffer_t output;
+    int length;
+
+    utils_bufferInit(&output, NULL, 0, false);
+    length = senml_cbor_serializeTo(uriP, isResourceInstance, size, dataP, &output);
+    if (length <= 0)
+    {
+        utils_bufferFree(&output);
+        *bufferP = NULL;
+    }
+    else
+    {
+        *bufferP = output.data;
+    }
+
+    return length;
+}
+
+/*
+ * Parsing
+ */
+
+// Reads the head of the item at buffer[*indexP]. *isIndefiniteP is set for the indefinite length
+// arrays, maps and strings, and for the break code.
+static int prv_readHead(const uint8_t * buffer,
+                        size_t bufferLen,
+                        size_t * indexP,
+                        uint8_t * majorP,
+                        uint8_t * infoP,
+                        uint64_t * valueP,
+                        bool * isIndefiniteP)
+{
+    size_t index = *indexP;
+    size_t length;
+    uint8_t info;
+
+    if (index >= bufferLen) return -1;
+
+    *majorP = buffer[index] >> 5;
+    info = buffer[index] & 0x1F;
+    *infoP = info;
+    *isIndefiniteP = false;
+    index++;
+
+    if (info < PRV_INFO_UINT8)
+    {
+        *valueP = info;
+        *indexP = index;
+        return 0;
+    }
+    switch (info)
+    {
+    case PRV_INFO_UINT8:
+        length = 1;
+        break;
+    case PRV_INFO_UINT16:
+        length = 2;
+        break;
+    case PRV_INFO_UINT32:
+        length = 4;
+        break;
+    case PRV_INFO_UINT64:
+        length = 8;
+        break;
+    case PRV_INFO_INDEFINITE:
+        if (*majorP == PRV_MAJOR_UNSIGNED
+         || *majorP == PRV_MAJOR_NEGATIVE
+         || *majorP == PRV_MAJOR_TAG)
+        {
+            return -1;
+        }
+        *isIndefiniteP = true;
+        *valueP = 0;
+        *indexP = index;
+        return 0;
+    default:
+        return -1;
+    }
+
+    if (bufferLen - index < length) return -1;
+    *valueP = 0;
+    while (length > 0)
+    {
+        *valueP = (*valueP << 8) | buffer[index];
+        index++;
+        length--;
+    }
+    *indexP = index;
+
+    return 0;
+}
+
+static int prv_readString(const uint8_t * buffer,
+                          size_t bufferLen,
+                          size_t * indexP,
+                          uint8_t major,
+                          const uint8_t ** dataP,
+                          size_t * lengthP)
+{
+    uint8_t readMajor;
+    uint8_t info;
+    uint64_t value;
+    bool isIndefinite;
+
+    if (0 != prv_readHead(buffer, bufferLen, indexP, &readMajor, &info, &value, &isIndefinite)) return -1;
+    // chunked strings are not supported
+    if (readMajor != major || isIndefinite) return -1;
+    if (value > bufferLen - *indexP) return -1;
+
+    *dataP = buffer + *indexP;
+    *lengthP = (size_t)value;
+    *indexP += (size_t)value;
+
+    return 0;
+}
+
+static int prv_skipItem(const uint8_t * buffer,
+                        size_t bufferLen,
+                        size_t * indexP,
+                        int depth)
+{
+    uint8_t major;
+    uint8_t info;
+    uint64_t value;
+    bool isIndefinite;
+
+    if (depth > PRV_MAX_DEPTH) return -1;
+    if (0 != prv_readHead(buffer, bufferLen, indexP, &major, &info, &value, &isIndefinite)) return -1;
+
+    switch (major)
+    {
+    case PRV_MAJOR_UNSIGNED:
+    case PRV_MAJOR_NEGATIVE:
+        return 0;
+
+    case PRV_MAJOR_BYTES:
+    case PRV_MAJOR_TEXT:
+        if (isIndefinite) return -1;
+        if (value > bufferLen - *indexP) return -1;
+        *indexP += (size_t)value;
+        return 0;
+
+    case PRV_MAJOR_ARRAY:
+    case PRV_MAJOR_MAP:
+        if (isIndefinite)
+        {
+            while (*indexP < bufferLen && buffer[*indexP] != PRV_BREAK)
+            {
+                if (0 != prv_skipItem(buffer, bufferLen, indexP, depth + 1)) return -1;
+            }
+            if (*indexP == bufferLen) return -1;
+            *indexP += 1;
+        }
+        else
+        {
+            if (major == PRV_MAJOR_MAP)
+            {
+                if (value > UINT64_MAX / 2) return -1;
+                value *= 2;
+            }
+            while (value > 0)
+            {
+                if (0 != prv_skipItem(buffer, bufferLen, indexP, depth + 1)) return -1;
+                value--;
+            }
+        }
+        return 0;
+
+    case PRV_MAJOR_TAG:
+        return prv_skipItem(buffer, bufferLen, indexP, depth + 1);
+
+    default:
+        // simple values and floats, but not a misplaced break
+        return isIndefinite ? -1 : 0;
+    }
+}
+
+// Decodes an IEEE 754 half precision float
+static double prv_halfToDouble(uint16_t half)
+{
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    double value;
+    int i;
+
+    if (exponent == 0)
+    {
+        value = mantissa / 1024.0;
+        exponent = -14;
+    }
+    else if (exponent == 0x1F)
+    {
+        value = (mantissa == 0) ? INFINITY : NAN;
+        exponent = 0;
+    }
+    else
+    {
+        value = 1 + mantissa / 1024.0;
+        exponent -= 15;
+    }
+    for (i = 0 ; i < exponent ; i++) value *= 2;
+    for (i = 0 ; i > exponent ; i--) value /= 2;
+
+    return (half & 0x8000) ? -value : value;
+}
+
+static int prv_readNumber(const uint8_t * buffer,
+                          size_t bufferLen,
+                          size_t * indexP,
+                          prv_value_t * valueP)
+{
+    uint8_t major;
+    uint8_t info;
+    uint64_t value;
+    bool isIndefinite;
+
+    if (0 != prv_readHead(buffer, bufferLen, indexP, &major, &info, &value, &isIndefinite)) return -1;
+
+    switch (major)
+    {
+    case PRV_MAJOR_UNSIGNED:
+        if (value > INT64_MAX) return -1;
+        valueP->type = PRV_VALUE_INTEGER;
+        valueP->asInteger = (int64_t)value;
+        return 0;
+
+    case PRV_MAJOR_NEGATIVE:
+        if (value > INT64_MAX) return -1;
+        valueP->type = PRV_VALUE_INTEGER;
+        valueP->asInteger = -1 - (int64_t)value;
+        return 0;
+
+    case PRV_MAJOR_SIMPLE:
+        valueP->type = PRV_VALUE_FLOAT;
+        switch (info)
+        {
+        case PRV_FLOAT_HALF:
+            valueP->asFloat = prv_halfToDouble((uint16_t)value);
+            return 0;
+        case PRV_FLOAT_SINGLE:
+        {
+            uint32_t bits = (uint32_t)value;
+            float single;
+
+            memcpy(&single, &bits, sizeof(single));
+            valueP->asFloat = single;
+            return 0;
+        }
+        case PRV_FLOAT_DOUBLE:
+            memcpy(&(valueP->asFloat), &value, sizeof(double));
+            return 0;
+        default:
+            return -1;
+        }
+
+    default:
+        return -1;
+    }
+}
+
+// Parses a record map. The base name, if any, is updated in baseNameP.
+static int prv_readRecord(const uint8_t * buffer,
+                          size_t bufferLen,
+                          size_t * indexP,
+                          const uint8_t ** baseNameP,
+                          size_t * baseNameLenP,
+                          const uint8_t ** nameP,
+                          size_t * nameLenP,
+                          prv_value_t * valueP)
+{
+    uint8_t major;
+    uint8_t info;
+    uint64_t count;
+    bool isIndefinite;
+
+    if (0 != prv_readHead(buffer, bufferLen, indexP, &major, &info, &count, &isIndefinite)) return -1;
+    if (major != PRV_MAJOR_MAP) return -1;
+
+    memset(valueP, 0, sizeof(prv_value_t));
+    *nameP = NULL;
+    *nameLenP = 0;
+
+    while (isIndefinite ? (*indexP < bufferLen && buffer[*indexP] != PRV_BREAK) : count > 0)
+    {
+        uint8_t keyMajor;
+        uint64_t key;
+        int64_t label;
+        prv_value_t value;
+
+        if (!isIndefinite) count--;
+
+        memset(&value, 0, sizeof(prv_value_t));
+        if (*indexP < bufferLen && (buffer[*indexP] >> 5) == PRV_MAJOR_TEXT)
+        {
+            const uint8_t * text;
+            size_t textLen;
+
+            if (0 != prv_readString(buffer, bufferLen, indexP, PRV_MAJOR_TEXT, &text, &textLen)) return -1;
+            if (textLen == PRV_LABEL_OBJLNK_LEN && 0 == memcmp(text, PRV_LABEL_OBJLNK, PRV_LABEL_OBJLNK_LEN))
+            {
+                value.type = PRV_VALUE_OBJECT_LINK;
+                if (0 != prv_readString(buffer, bufferLen, indexP, PRV_MAJOR_TEXT, &value.buffer, &value.length)) return -1;
+            }
+            else
+            {
+                // labels ending with an underscore must be understood
+                if (textLen > 0 && text[textLen - 1] == '_') return -1;
+                if (0 != prv_skipItem(buffer, bufferLen, indexP, 0)) return -1;
+            }
+        }
+        else
+        {
+            bool keyIndefinite;
+
+            if (0 != prv_readHead(buffer, bufferLen, indexP, &keyMajor, &info, &key, &keyIndefinite)) return -1;
+            if (keyMajor == PRV_MAJOR_UNSIGNED && key <= INT64_MAX) label = (int64_t)key;
+            else if (keyMajor == PRV_MAJOR_NEGATIVE && key <= INT64_MAX) label = -1 - (int64_t)key;
+            else return -1;
+
+            switch (label)
+            {
+            case PRV_LABEL_BASE_NAME:
+                if (0 != prv_readString(buffer, bufferLen, indexP, PRV_MAJOR_TEXT, baseNameP, baseNameLenP)) return -1;
+                break;
+
+            case PRV_LABEL_NAME:
+                if (0 != prv_readString(buffer, bufferLen, indexP, PRV_MAJOR_TEXT, nameP, nameLenP)) return -1;
+                break;
+
+            case PRV_LABEL_VALUE:
+                if (0 != prv_readNumber(buffer, bufferLen, indexP, &value)) return -1;
+                break;
+
+            case PRV_LABEL_STRING:
+                value.type = PRV_VALUE_STRING;
+                if (0 != prv_readString(buffer, bufferLen, indexP, PRV_MAJOR_TEXT, &value.buffer, &value.length)) return -1;
+                break;
+
+            case PRV_LABEL_DATA:
+                value.type = PRV_VALUE_OPAQUE;
+                if (0 != prv_readString(buffer, bufferLen, indexP, PRV_MAJOR_BYTES, &value.buffer, &value.length)) return -1;
+                break;
+
+            case PRV_LABEL_BOOLEAN:
+            {
+                uint64_t simple;
+                bool valueIndefinite;
+
+                if (0 != prv_readHead(buffer, bufferLen, indexP, &keyMajor, &info, &simple, &valueIndefinite)) return -1;
+                if (keyMajor != PRV_MAJOR_SIMPLE || (info != PRV_SIMPLE_TRUE && info != PRV_SIMPLE_FALSE)) return -1;
+                value.type = PRV_VALUE_BOOLEAN;
+                value.asBoolean = (info == PRV_SIMPLE_TRUE);
+                break;
+            }
+
+            default:
+                // time, unit, sum, version... are ignored
+                if (0 != prv_skipItem(buffer, bufferLen, indexP, 0)) return -1;
+                break;
+            }
+        }
+
+        if (value.type != PRV_VALUE_UNSET)
+        {
+            // only one value per record
+            if (valueP->type != PRV_VALUE_UNSET) return -1;
+            memcpy(valueP, &value, sizeof(prv_value_t));
+        }
+    }
+    if (isIndefinite)
+    {
+        if (*indexP == bufferLen) return -1;
+        *indexP += 1;
+    }
+
+    return valueP->type != PRV_VALUE_UNSET ? 0 : -1;
+}
+
+// Splits the concatenation of the base name and the name into IDs
+static int prv_parseName(const uint8_t * baseName,
+                         size_t baseNameLen,
+                         const uint8_t * name,
+                         size_t nameLen,
+                         uint16_t * ids)
+{
+    uint8_t fullName[PRV_NAME_MAX_LEN];
+    size_t length;
+    size_t i;
+    int count;
+
+    length = baseNameLen + nameLen;
+    if (length < 2 || length > PRV_NAME_MAX_LEN) return -1;
+    if (baseNameLen > 0) memcpy(fullName, baseName, baseNameLen);
+    if (nameLen > 0) memcpy(fullName + baseNameLen, name, nameLen);
+    if (fullName[0] != '/') return -1;
+
+    count = 0;
+    i = 1;
+    while (i < length)
+    {
+        uint32_t id;
+        size_t start;
+
+        if (count == 4) return -1;
+
+        id = 0;
+        start = i;
+        while (i < length && fullName[i] != '/')
+        {
+            if (fullName[i] < '0' || fullName[i] > '9') return -1;
+            id = id * 10 + (fullName[i] - '0');
+            if (id > LWM2M_MAX_ID) return -1;
+            i++;
+        }
+        if (i == start) return -1;
+        ids[count++] = (uint16_t)id;
+
+        if (i < length)
+        {
+            i++;
+            if (i == length) return -1;
+        }
+    }
+
+    return count;
+}
+
+static bool prv_convertValue(prv_value_t * valueP,
+                             lwm2m_data_t * dataP)
+{
+    switch (valueP->type)
+    {
+    case PRV_VALUE_INTEGER:
+        lwm2m_data_encode_int(valueP->asInteger, dataP);
+        break;
+
+    case PRV_VALUE_FLOAT:
+        lwm2m_data_encode_float(valueP->asFloat, dataP);
+        break;
+
+    case PRV_VALUE_BOOLEAN:
+        lwm2m_data_encode_bool(valueP->asBoolean, dataP);
+        break;
+
+    case PRV_VALUE_STRING:
+        lwm2m_data_encode_opaque((uint8_t *)valueP->buffer, valueP->length, dataP);
+        if (valueP->length != 0 && dataP->value.asBuffer.buffer == NULL) return false;
+        dataP->type = LWM2M_TYPE_STRING;
+        break;
+
+    case PRV_VALUE_OPAQUE:
+        lwm2m_data_encode_opaque((uint8_t *)valueP->buffer, valueP->length, dataP);
+        if (valueP->length != 0 && dataP->value.asBuffer.buffer == NULL) return false;
+        break;
+
+    case PRV_VALUE_OBJECT_LINK:
+    {
+        int64_t objectId;
+        int64_t objectInstanceId;
+        size_t i;
+
+        i = 0;
+        while (i < valueP->length && valueP->buffer[i] != ':') i++;
+        if (i == valueP->length
+         || 1 != utils_textToInt((uint8_t *)valueP->buffer, i, &objectId)
+         || 1 != utils_textToInt((uint8_t *)valueP->buffer + i + 1, valueP->length - i - 1, &objectInstanceId)
+         || objectId < 0 || objectId > LWM2M_MAX_ID
+         || objectInstanceId < 0 || objectInstanceId > LWM2M_MAX_ID)
+        {
+            return false;
+        }
+        lwm2m_data_encode_objlink((uint16_t)objectId, (uint16_t)objectInstanceId, dataP);
+        break;
+    }
+
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+// Inserts a resource or resource instance value in the objects tree below rootP
+static int prv_addRecord(lwm2m_data_t * rootP,
+                         uint16_t * ids,
+                         int count,
+                         prv_value_t * valueP)
+{
+    lwm2m_data_t * parentP;
+    lwm2m_data_t * targetP;
+    int i;
+
+    // resources or resource instances only
+    if (count < 3) return -1;
+
+    parentP = rootP;
+    targetP = NULL;
+    for (i = 0 ; i < count ; i++)
+    {
+        bool isLeaf = (i == count - 1);
+
+        targetP = data_findChild(parentP, ids[i]);
+        if (targetP == NULL)
+        {
+            targetP = data_addChild(parentP, ids[i]);
+            if (targetP == NULL) return -1;
+            if (!isLeaf)
+            {
+                switch (i)
+                {
+                case 0:
+                    targetP->type = LWM2M_TYPE_OBJECT;
+                    break;
+                case 1:
+                    targetP->type = LWM2M_TYPE_OBJECT_INSTANCE;
+                    break;
+                default:
+                    targetP->type = LWM2M_TYPE_MULTIPLE_RESOURCE;
+                    break;
+                }
+            }
+        }
+        else if (isLeaf)
+        {
+            // a later record overrides the previous value
+            if (targetP->type == LWM2M_TYPE_OBJECT
+             || targetP->type == LWM2M_TYPE_OBJECT_INSTANCE
+             || targetP->type == LWM2M_TYPE_MULTIPLE_RESOURCE)
+            {
+                return -1;
+            }
+            if ((targetP->type == LWM2M_TYPE_STRING || targetP->type == LWM2M_TYPE_OPAQUE)
+             && targetP->value.asBuffer.buffer != NULL)
+            {
+                lwm2m_free(targetP->value.asBuffer.buffer);
+            }
+            memset(&(targetP->value), 0, sizeof(targetP->value));
+            targetP->type = LWM2M_TYPE_UNDEFINED;
+        }
+        else if (targetP->type != LWM2M_TYPE_OBJECT
+              && targetP->type != LWM2M_TYPE_OBJECT_INSTANCE
+              && targetP->type != LWM2M_TYPE_MULTIPLE_RESOURCE)
+        {
+            return -1;
+        }
+        parentP = targetP;
+    }
+
+    return prv_convertValue(valueP, targetP) ? 0 : -1;
+}
+
+int senml_cbor_parse(lwm2m_uri_t * uriP,
+                     const uint8_t * buffer,
+                     size_t bufferLen,
+                     lwm2m_data_t ** dataP)
+{
+    lwm2m_data_t root;
+    const uint8_t * baseName;
+    size_t baseNameLen;
+    uint8_t major;
+    uint8_t info;
+    uint64_t count;
+    bool isIndefinite;
+    size_t index;
+
+    LOG_ARG("bufferLen: %d", bufferLen);
+    LOG_URI(uriP);
+    *dataP = NULL;
+
+    memset(&root, 0, sizeof(lwm2m_data_t));
+    baseName = NULL;
+    baseNameLen = 0;
+    index = 0;
+
+    if (0 != prv_readHead(buffer, bufferLen, &index, &major, &info, &count, &isIndefinite)) return -1;
+    if (major != PRV_MAJOR_ARRAY) return -1;
+
+    while (isIndefinite ? (index < bufferLen && buffer[index] != PRV_BREAK) : count > 0)
+    {
+        const uint8_t * name;
+        size_t nameLen;
+        prv_value_t value;
+        uint16_t ids[4];
+        int idCount;
+
+        if (!isIndefinite) count--;
+
+        if (0 != prv_readRecord(buffer, bufferLen, &index, &baseName, &baseNameLen, &name, &nameLen, &value)) goto error;
+        idCount = prv_parseName(baseName, baseNameLen, name, nameLen, ids);
+        if (idCount < 0) goto error;
+        if (0 != prv_addRecord(&root, ids, idCount, &value)) goto error;
+    }
+    if (isIndefinite)
+    {
+        if (index == bufferLen) goto error;
+        index++;
+    }
+    if (index != bufferLen || root.value.asChildren.count == 0) goto error;
+
+    return data_selectUri(uriP, root.value.asChildren.count, root.value.asChildren.array, dataP);
+
+error:
+    LOG("Parsing failed");
+    lwm2m_data_free((int)root.value.asChildren.count, root.value.asChildren.array);
+    return -1;
+}
+
+#endif
@@ -0,0 +1,203 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * Deadline scheduler shared by the transactions, the registered clients
+ * lifetimes and the observed resources.
+ *
+ * Timers are embedded in the objects they belong to and referenced from a
+ * binary min-heap ordered by deadline. Each timer remembers its position in
+ * the heap so that rescheduling or cancelling it is O(log n).
+ */
+
+#include "internals.h"
+
+#define PRV_TIMER_HEAP_MIN_SIZE 16
+
+static void prv_place(lwm2m_timer_heap_t * heapP,
+                      lwm2m_timer_t * timerP,
+                      size_t position)
+{
+    heapP->heap[position] = timerP;
+    timerP->index = position + 1;
+}
+
+static void prv_siftUp(lwm2m_timer_heap_t * heapP,
+                       size_t position)
+{
+    lwm2m_timer_t * timerP = heapP->heap[position];
+
+    while (position > 0)
+    {
+        size_t parent = (position - 1) / 2;
+
+        if (heapP->heap[parent]->deadline <= timerP->deadline) break;
+
+        prv_place(heapP, heapP->heap[parent], position);
+        position = parent;
+    }
+    prv_place(heapP, timerP, position);
+}
+
+static void prv_siftDown(lwm2m_timer_heap_t * heapP,
+                         size_t position)
+{
+    lwm2m_timer_t * timerP = heapP->heap[position];
+
+    while (2 * position + 1 < heapP->count)
+    {
+        size_t child = 2 * position + 1;
+
+        if (child + 1 < heapP->count
+         && heapP->heap[child + 1]->deadline < heapP->heap[child]->deadline)
+        {
+            child++;
+        }
+        if (timerP->deadline <= heapP->heap[child]->deadline) break;
+
+        prv_place(heapP, heapP->heap[child], position);
+        position = child;
+    }
+    prv_place(heapP, timerP, position);
+}
+
+static int prv_grow(lwm2m_timer_heap_t * heapP)
+{
+    lwm2m_timer_t ** newHeap;
+    size_t newSize;
+
+    newSize = (heapP->size == 0) ? PRV_TIMER_HEAP_MIN_SIZE : heapP->size * 2;
+    newHeap = (lwm2m_timer_t **)lwm2m_malloc(newSize * sizeof(lwm2m_timer_t *));
+    if (newHeap == NULL) return 0;
+
+    if (heapP->heap != NULL)
+    {
+        memcpy(newHeap, heapP->heap, heapP->count * sizeof(lwm2m_timer_t *));
+        lwm2m_free(heapP->heap);
+    }
+    heapP->heap = newHeap;
+    heapP->size = newSize;
+
+    return 1;
+}
+
+int timer_schedule(lwm2m_context_t * contextP,
+                   lwm2m_timer_t * timerP,
+                   time_t deadline)
+{
+    lwm2m_timer_heap_t * heapP = &contextP->timers;
+
+    // A timer rescheduled in the past while firing expired timers waits for
+    // the next step instead of looping.
+    if (heapP->stepping && deadline <= heapP->stepTime)
+    {
+        deadline = heapP->stepTime + 1;
+    }
+
+    if (timerP->index != 0)
+    {
+        size_t position = timerP->index - 1;
+        time_t previous = timerP->deadline;
+
+        timerP->deadline = deadline;
+        if (deadline < previous)
+        {
+            prv_siftUp(heapP, position);
+        }
+        else
+        {
+            prv_siftDown(heapP, position);
+        }
+        return 1;
+    }
+
+    if (heapP->count == heapP->size
+     && 0 == prv_grow(heapP))
+    {
+        LOG("Failed to grow the timer heap");
+        return 0;
+    }
+
+    timerP->deadline = deadline;
+    heapP->heap[heapP->count] = timerP;
+    heapP->count++;
+    prv_siftUp(heapP, heapP->count - 1);
+
+    return 1;
+}
+
+void timer_cancel(lwm2m_context_t * contextP,
+                  lwm2m_timer_t * timerP)
+{
+    lwm2m_timer_heap_t * heapP = &contextP->timers;
+    size_t position;
+    lwm2m_timer_t * lastP;
+
+    if (timerP->index == 0) return;
+
+    position = timerP->index - 1;
+    timerP->index = 0;
+    heapP->count--;
+    if (position == heapP->count) return;
+
+    lastP = heapP->heap[heapP->count];
+    prv_place(heapP, lastP, position);
+    if (position > 0 && heapP->heap[(position - 1) / 2]->deadline > lastP->deadline)
+    {
+        prv_siftUp(heapP, position);
+    }
+    else
+    {
+        prv_siftDown(heapP, position);
+    }
+}
+
+void timer_step(lwm2m_context_t * contextP,
+                time_t currentTime,
+                time_t * timeoutP)
+{
+    lwm2m_timer_heap_t * heapP = &contextP->timers;
+
+    LOG_ARG("timers: %d", heapP->count);
+
+    heapP->stepping = true;
+    heapP->stepTime = currentTime;
+
+    while (heapP->count > 0 && heapP->heap[0]->deadline <= currentTime)
+    {
+        lwm2m_timer_t * timerP = heapP->heap[0];
+
+        // the callback may free the timer or schedule it again
+        timer_cancel(contextP, timerP);
+        timerP->callback(contextP, timerP->userData, currentTime);
+    }
+
+    heapP->stepping = false;
+
+    if (heapP->count > 0)
+    {
+        time_t interval = heapP->heap[0]->deadline - currentTime;
+
+        if (*timeoutP > interval) *timeoutP = interval;
+    }
+}
+
+void timer_close(lwm2m_context_t * contextP)
+{
+    if (contextP->timers.heap != NULL) lwm2m_free(contextP->timers.heap);
+    memset(&contextP->timers, 0, sizeof(lwm2m_timer_heap_t));
+}
@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <float.h>
+#include <limits.h>
 
 #ifndef LWM2M_BIG_ENDIAN
 #ifndef LWM2M_LITTLE_ENDIAN
@@ -362,113 +363,27 @@ int tlv_parse(uint8_t * buffer,
 }
 
 
-static int prv_getLength(int size,
-                         lwm2m_data_t * dataP)
+// Appends the TLV encoding of dataP to outputP in a single pass. Instances and multiple
+// resources reserve room for the largest header, then the header is written once the
+// children length is known and the children are moved back over the unused bytes.
+static int prv_serializeTo(bool isResourceInstance,
+                           int size,
+                           lwm2m_data_t * dataP,
+                           utils_buffer_t * outputP)
 {
-    int length;
     int i;
 
-    length = 0;
-
-    for (i = 0 ; i < size && length != -1 ; i++)
-    {
-        switch (dataP[i].type)
-        {
-        case LWM2M_TYPE_OBJECT_INSTANCE:
-        case LWM2M_TYPE_MULTIPLE_RESOURCE:
-            {
-                int subLength;
-
-                subLength = prv_getLength(dataP[i].value.asChildren.count, dataP[i].value.asChildren.array);
-                if (subLength == -1)
-                {
-                    length = -1;
-                }
-                else
-                {
-                    length += prv_getHeaderLength(dataP[i].id, subLength) + subLength;
-                }
-            }
-            break;
-
-        case LWM2M_TYPE_STRING:
-        case LWM2M_TYPE_OPAQUE:
-            length += prv_getHeaderLength(dataP[i].id, dataP[i].value.asBuffer.length) + dataP[i].value.asBuffer.length;
-            break;
-
-        case LWM2M_TYPE_INTEGER:
-            {
-                size_t data_len;
-                uint8_t unused_buffer[_PRV_64BIT_BUFFER_SIZE];
-
-                data_len = prv_encodeInt(dataP[i].value.asInteger, unused_buffer);
-                length += prv_getHeaderLength(dataP[i].id, data_len) + data_len;
-            }
-            break;
-
-        case LWM2M_TYPE_FLOAT:
-            {
-                size_t data_len;
-
-                if ((dataP[i].value.asFloat < 0.0 - (double)FLT_MAX)
-                    || (dataP[i].value.asFloat >(double)FLT_MAX))
-                {
-                    data_len = 8;
-                }
-                else
-                {
-                    data_len = 4;
-                }
-
-                length += prv_getHeaderLength(dataP[i].id, data_len) + data_len;
-            }
-            break;
-
-        case LWM2M_TYPE_BOOLEAN:
-            // Booleans are always encoded on one byte
-            length += prv_getHeaderLength(dataP[i].id, 1) + 1;
-            break;
-
-        case LWM2M_TYPE_OBJECT_LINK:
-            // Object Link are always encoded on four bytes
-            length += prv_getHeaderLength(dataP[i].id, 4) + 4;
-            break;
-
-        default:
-            length = -1;
-            break;
-        }
-    }
-
-    return length;
-}
-
-
-int tlv_serialize(bool isResourceInstance, 
-                  int size,
-                  lwm2m_data_t * dataP,
-                  uint8_t ** bufferP)
-{
-    int length;
-    int index;
-    int i;
-
-    LOG_ARG("isResourceInstance: %s, size: %d", isResourceInstance?"true":"false", size);
-
-    *bufferP = NULL;
-    length = prv_getLength(size, dataP);
-    if (length <= 0) return length;
-
-    *bufferP = (uint8_t *)lwm2m_malloc(length);
-    if (*bufferP == NULL) return 0;
-
-    index = 0;
-    for (i = 0 ; i < size && length != 0 ; i++)
+    for (i = 0 ; i < size ; i++)
     {
+        uint8_t data_buffer[_PRV_64BIT_BUFFER_SIZE];
+        const uint8_t * valueP;
+        size_t data_len;
+        uint8_t * headerP;
         int headerLen;
         bool isInstance;
 
         isInstance = isResourceInstance;
+        valueP = data_buffer;
         switch (dataP[i].type)
         {
         case LWM2M_TYPE_MULTIPLE_RESOURCE:
@@ -476,105 +391,118 @@ int tlv_serialize(bool isResourceInstance,
             // fall through
         case LWM2M_TYPE_OBJECT_INSTANCE:
             {
-                uint8_t * tmpBuffer;
-                int res;
+                size_t start;
+                size_t childrenLen;
 
-                res = tlv_serialize(isInstance, dataP[i].value.asChildren.count, dataP[i].value.asChildren.array, &tmpBuffer);
-                if (res < 0)
-                {
-                    length = -1;
-                }
-                else
+                // the buffer may move while the children are written: keep offsets only
+                start = outputP->length;
+                if (NULL == utils_bufferReserve(outputP, _PRV_TLV_HEADER_MAX_LENGTH)) return -1;
+                outputP->length += _PRV_TLV_HEADER_MAX_LENGTH;
+
+                if (0 != prv_serializeTo(isInstance, dataP[i].value.asChildren.count, dataP[i].value.asChildren.array, outputP)) return -1;
+
+                childrenLen = outputP->length - start - _PRV_TLV_HEADER_MAX_LENGTH;
+                if (childrenLen > 0xFFFFFF) return -1;
+                headerLen = prv_createHeader(outputP->data + start, false, dataP[i].type, dataP[i].id, childrenLen);
+                if (headerLen < _PRV_TLV_HEADER_MAX_LENGTH)
                 {
-                    size_t tmpLength;
-
-                    tmpLength = (size_t)res;
-                    headerLen = prv_createHeader(*bufferP + index, false, dataP[i].type, dataP[i].id, tmpLength);
-                    index += headerLen;
-                    if (tmpLength > 0)
-                    {
-                        memcpy(*bufferP + index, tmpBuffer, tmpLength);
-                        index += tmpLength;
-                        lwm2m_free(tmpBuffer);
-                    }
+                    memmove(outputP->data + start + headerLen, outputP->data + start + _PRV_TLV_HEADER_MAX_LENGTH, childrenLen);
+                    outputP->length -= _PRV_TLV_HEADER_MAX_LENGTH - headerLen;
                 }
             }
-            break;
+            continue;
 
         case LWM2M_TYPE_OBJECT_LINK:
             {
                 int k;
-                uint8_t buf[4];
                 uint32_t v = dataP[i].value.asObjLink.objectId;
                 v <<= 16;
                 v |= dataP[i].value.asObjLink.objectInstanceId;
                 for (k = 3; k >= 0; --k) {
-                    buf[k] = (uint8_t)(v & 0xFF);
+                    data_buffer[k] = (uint8_t)(v & 0xFF);
                     v >>= 8;
                 }
                 // keep encoding as buffer
-                headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, 4);
-                index += headerLen;
-                memcpy(*bufferP + index, buf, 4);
-                index += 4;
+                data_len = 4;
             }
             break;
 
         case LWM2M_TYPE_STRING:
         case LWM2M_TYPE_OPAQUE:
-            headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, dataP[i].value.asBuffer.length);
-            index += headerLen;
-            memcpy(*bufferP + index, dataP[i].value.asBuffer.buffer, dataP[i].value.asBuffer.length);
-            index += dataP[i].value.asBuffer.length;
+            valueP = dataP[i].value.asBuffer.buffer;
+            data_len = dataP[i].value.asBuffer.length;
             break;
 
         case LWM2M_TYPE_INTEGER:
-            {
-                size_t data_len;
-                uint8_t data_buffer[_PRV_64BIT_BUFFER_SIZE];
-
-                data_len = prv_encodeInt(dataP[i].value.asInteger, data_buffer);
-                headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, data_len);
-                index += headerLen;
-                memcpy(*bufferP + index, data_buffer, data_len);
-                index += data_len;
-            }
+            data_len = prv_encodeInt(dataP[i].value.asInteger, data_buffer);
             break;
 
         case LWM2M_TYPE_FLOAT:
-            {
-                size_t data_len;
-                uint8_t data_buffer[_PRV_64BIT_BUFFER_SIZE];
-
-                data_len = prv_encodeFloat(dataP[i].value.asFloat, data_buffer);
-                headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, data_len);
-                index += headerLen;
-                memcpy(*bufferP + index, data_buffer, data_len);
-                index += data_len;
-            }
+            data_len = prv_encodeFloat(dataP[i].value.asFloat, data_buffer);
             break;
 
         case LWM2M_TYPE_BOOLEAN:
-            headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, 1);
-            index += headerLen;
-            (*bufferP)[index] = dataP[i].value.asBoolean ? 1 : 0;
-            index += 1;
+            // Booleans are always encoded on one byte
+            data_buffer[0] = dataP[i].value.asBoolean ? 1 : 0;
+            data_len = 1;
             break;
 
         default:
-            length = -1;
-            break;
+            return -1;
         }
+
+        if (data_len > 0xFFFFFF) return -1;
+        headerP = utils_bufferReserve(outputP, _PRV_TLV_HEADER_MAX_LENGTH + data_len);
+        if (headerP == NULL) return -1;
+        headerLen = prv_createHeader(headerP, isInstance, dataP[i].type, dataP[i].id, data_len);
+        if (data_len > 0) memcpy(headerP + headerLen, valueP, data_len);
+        outputP->length += headerLen + data_len;
     }
 
-    if (length < 0)
+    return 0;
+}
+
+int tlv_serializeTo(bool isResourceInstance,
+                    int size,
+                    lwm2m_data_t * dataP,
+                    utils_buffer_t * outputP)
+{
+    size_t start;
+
+    LOG_ARG("isResourceInstance: %s, size: %d", isResourceInstance?"true":"false", size);
+
+    start = outputP->length;
+    if (0 != prv_serializeTo(isResourceInstance, size, dataP, outputP)
+     || outputP->length - start > INT_MAX)
     {
-        lwm2m_free(*bufferP);
-        *bufferP = NULL;
+        outputP->length = start;
+        return -1;
     }
 
-    LOG_ARG("returning %u", length);
+    LOG_ARG("returning %u", outputP->length - start);
 
-    return length;
+    return (int)(outputP->length - start);
 }
 
+int tlv_serialize(bool isResourceInstance,
+                  int size,
+                  lwm2m_data_t * dataP,
+                  uint8_t ** bufferP)
+{
+    utils_buffer_t output;
+    int length;
+
+    utils_bufferInit(&output, NULL, 0, false);
+    length = tlv_serializeTo(isResourceInstance, size, dataP, &output);
+    if (length <= 0)
+    {
+        utils_bufferFree(&output);
+        *bufferP = NULL;
+    }
+    else
+    {
+        *bufferP = output.data;
+    }
+
+    return length;
+}
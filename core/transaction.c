@@ -100,8 +100,15 @@ Contains code snippets which are:
  *                  finish the transaction even without the ACK.MID.
  *  - NON without token => no transaction, no result expected!
  *  - NON with token => regular finished with response containing the token.
+ *  - A piggybacked response only finishes the request with its MID, as the blocks of a
+ *    Block1 transfer share their token.
  *  Responses (COAP_201_CREATED - ?):
  *  - CON with mid => regular finished with corresponding ACK.MID
+ *
+ *  The transactions in progress are chained in the transactionList of the context and
+ *  indexed by MID, by token and by peer in hash tables using links stored in
+ *  lwm2m_transaction_t. Peers are told apart by their session handle like in the client
+ *  registry, the matched transactions are still checked with lwm2m_session_is_equal().
  */
 
 #include "internals.h"
@@ -114,6 +121,128 @@ Contains code snippets which are:
 #define COAP_RESPONSE_TIMEOUT_TICKS         (CLOCK_SECOND * COAP_RESPONSE_TIMEOUT)
 #define COAP_RESPONSE_TIMEOUT_BACKOFF_MASK  ((CLOCK_SECOND * COAP_RESPONSE_TIMEOUT * (COAP_RESPONSE_RANDOM_FACTOR - 1)) + 1.5)
 
+#define PRV_INDEX_MIN_SIZE  64
+
+typedef enum
+{
+    PRV_INDEX_MID = 0,
+    PRV_INDEX_TOKEN,
+    PRV_INDEX_PEER
+} prv_index_t;
+
+static size_t prv_hashToken(const uint8_t * token,
+                            size_t length)
+{
+    return (size_t)utils_hashBytes(UTILS_HASH_SEED, token, length);
+}
+
+static lwm2m_transaction_t ** prv_getNext(lwm2m_transaction_t * transacP,
+                                          prv_index_t index)
+{
+    switch (index)
+    {
+    case PRV_INDEX_MID:
+        return &transacP->midNext;
+    case PRV_INDEX_TOKEN:
+        return &transacP->tokenNext;
+    case PRV_INDEX_PEER:
+    default:
+        return &transacP->peerNext;
+    }
+}
+
+static lwm2m_transaction_t ** prv_getBucket(lwm2m_transaction_index_t * indexP,
+                                            lwm2m_transaction_t * transacP,
+                                            prv_index_t index)
+{
+    coap_packet_t * messageP = (coap_packet_t *)transacP->message;
+
+    switch (index)
+    {
+    case PRV_INDEX_MID:
+        return indexP->midTable + utils_hashBucket(transacP->mID, indexP->size);
+    case PRV_INDEX_TOKEN:
+        return indexP->tokenTable + utils_hashBucket(prv_hashToken(messageP->token, messageP->token_len), indexP->size);
+    case PRV_INDEX_PEER:
+    default:
+        return indexP->peerTable + utils_hashBucket(utils_hashPointer(transacP->peerH), indexP->size);
+    }
+}
+
+static void prv_insert(lwm2m_transaction_index_t * indexP,
+                       lwm2m_transaction_t * transacP,
+                       prv_index_t index)
+{
+    lwm2m_transaction_t ** bucketP;
+
+    bucketP = prv_getBucket(indexP, transacP, index);
+    *prv_getNext(transacP, index) = *bucketP;
+    *bucketP = transacP;
+}
+
+static void prv_extract(lwm2m_transaction_index_t * indexP,
+                        lwm2m_transaction_t * transacP,
+                        prv_index_t index)
+{
+    lwm2m_transaction_t ** targetP;
+
+    targetP = prv_getBucket(indexP, transacP, index);
+    while (*targetP != NULL && *targetP != transacP)
+    {
+        targetP = prv_getNext(*targetP, index);
+    }
+    if (*targetP != NULL)
+    {
+        *targetP = *prv_getNext(transacP, index);
+    }
+    *prv_getNext(transacP, index) = NULL;
+}
+
+static int prv_resize(lwm2m_context_t * contextP,
+                      size_t size)
+{
+    lwm2m_transaction_index_t * indexP = &contextP->transactionIndex;
+    lwm2m_transaction_t ** tablesP;
+    lwm2m_transaction_t * transacP;
+
+    tablesP = (lwm2m_transaction_t **)utils_hashTableAlloc(size, 3);
+    if (tablesP == NULL) return 0;
+
+    if (indexP->midTable != NULL) lwm2m_free(indexP->midTable);
+    indexP->midTable = tablesP;
+    indexP->tokenTable = tablesP + size;
+    indexP->peerTable = tablesP + 2 * size;
+    indexP->size = size;
+
+    for (transacP = contextP->transactionList ; transacP != NULL ; transacP = transacP->next)
+    {
+        prv_insert(indexP, transacP, PRV_INDEX_MID);
+        prv_insert(indexP, transacP, PRV_INDEX_TOKEN);
+        prv_insert(indexP, transacP, PRV_INDEX_PEER);
+    }
+
+    return 1;
+}
+
+static lwm2m_transaction_t * prv_findByMid(lwm2m_context_t * contextP,
+                                           void * sessionH,
+                                           uint16_t mID)
+{
+    lwm2m_transaction_index_t * indexP = &contextP->transactionIndex;
+    lwm2m_transaction_t * transacP;
+
+    for (transacP = indexP->midTable[utils_hashBucket(mID, indexP->size)] ; transacP != NULL ; transacP = transacP->midNext)
+    {
+        if (transacP->mID == mID
+         && lwm2m_session_is_equal(sessionH, transacP->peerH, contextP->userData) == true)
+        {
+            return transacP;
+        }
+    }
+
+    return NULL;
+}
+
 static int prv_checkFinished(lwm2m_transaction_t * transacP,
                              coap_packet_t * receivedMessage)
 {
@@ -131,6 +260,11 @@ static int prv_checkFinished(lwm2m_transaction_t * transacP,
         // request without token
         return transacP->ack_received ? 1 : 0;
     }
+    if (COAP_TYPE_ACK == receivedMessage->type && transacP->mID != receivedMessage->mid)
+    {
+        // piggybacked response to another request with the same token, like another block
+        return 0;
+    }
 
     len = coap_get_header_token(receivedMessage, &token);
     if (transactionMessage->token_len == len)
@@ -141,6 +275,48 @@ static int prv_checkFinished(lwm2m_transaction_t * transacP,
     return 0;
 }
 
+// Returns the transaction the message finishes among the ones sharing its token.
+static lwm2m_transaction_t * prv_findByToken(lwm2m_context_t * contextP,
+                                             void * sessionH,
+                                             coap_packet_t * message)
+{
+    lwm2m_transaction_index_t * indexP = &contextP->transactionIndex;
+    lwm2m_transaction_t * transacP;
+    const uint8_t * token;
+    int len;
+
+    len = coap_get_header_token(message, &token);
+    if (len == 0) return NULL;
+
+    for (transacP = indexP->tokenTable[utils_hashBucket(prv_hashToken(token, len), indexP->size)] ; transacP != NULL ; transacP = transacP->tokenNext)
+    {
+        if (lwm2m_session_is_equal(sessionH, transacP->peerH, contextP->userData) == true
+         && prv_checkFinished(transacP, message))
+        {
+            return transacP;
+        }
+    }
+
+    return NULL;
+}
+
+// the clock counts seconds, a timeout is rounded up to the next one
+static time_t prv_toSeconds(uint32_t timeout)
+{
+    return (time_t)((timeout + 999) / 1000);
+}
+
+static void prv_timerCallback(lwm2m_context_t * contextP,
+                              void * userData,
+                              time_t currentTime)
+{
+    (void)currentTime;
+
+    // retransmits the message or times the transaction out
+    (void)transaction_send(contextP, (lwm2m_transaction_t *)userData);
+    congestion_dispatch(contextP);
+}
+
 lwm2m_transaction_t * transaction_new(void * sessionH,
                                       coap_method_t method,
                                       char * altPath,
@@ -159,12 +335,12 @@ lwm2m_transaction_t * transaction_new(void * sessionH,
     // no transactions without peer
     if (NULL == sessionH) return NULL;
 
-    transacP = (lwm2m_transaction_t *)lwm2m_malloc(sizeof(lwm2m_transaction_t));
+    transacP = POOL_ALLOC(LWM2M_POOL_TRANSACTION, lwm2m_transaction_t);
 
     if (NULL == transacP) return NULL;
     memset(transacP, 0, sizeof(lwm2m_transaction_t));
 
-    transacP->message = lwm2m_malloc(sizeof(coap_packet_t));
+    transacP->message = POOL_ALLOC(LWM2M_POOL_PACKET, coap_packet_t);
     if (NULL == transacP->message) goto error;
 
     coap_init_message(transacP->message, COAP_TYPE_CON, method, mID);
@@ -173,6 +349,9 @@ lwm2m_transaction_t * transaction_new(void * sessionH,
 
     transacP->mID = mID;
 
+    transacP->timer.callback = prv_timerCallback;
+    transacP->timer.userData = transacP;
+
     if (altPath != NULL)
     {
         // TODO: Support multi-segment alternative path
@@ -237,7 +416,8 @@ lwm2m_transaction_t * transaction_new(void * sessionH,
 
 error:
     LOG("Exiting on failure");
-    lwm2m_free(transacP);
+    // the message and its options would leak their pool slots otherwise
+    transaction_free(transacP);
     return NULL;
 }
 
@@ -247,21 +427,129 @@ void transaction_free(lwm2m_transaction_t * transacP)
     if (transacP->message)
     {
        coap_free_header(transacP->message);
-       lwm2m_free(transacP->message);
+       POOL_FREE(LWM2M_POOL_PACKET, transacP->message);
     }
 
     if (transacP->buffer) lwm2m_free(transacP->buffer);
-    lwm2m_free(transacP);
+    POOL_FREE(LWM2M_POOL_TRANSACTION, transacP);
+}
+
+int transaction_init(lwm2m_context_t * contextP)
+{
+    return prv_resize(contextP, PRV_INDEX_MIN_SIZE);
+}
+
+void transaction_add(lwm2m_context_t * contextP,
+                     lwm2m_transaction_t * transacP)
+{
+    lwm2m_transaction_index_t * indexP = &contextP->transactionIndex;
+    size_t size;
+
+    LOG_ARG("mID: %d", transacP->mID);
+
+    size = utils_hashTableSize(indexP->size, indexP->count, PRV_INDEX_MIN_SIZE);
+    if (size != indexP->size)
+    {
+        (void)prv_resize(contextP, size);
+    }
+
+    transacP->prev = NULL;
+    transacP->next = contextP->transactionList;
+    if (contextP->transactionList != NULL)
+    {
+        contextP->transactionList->prev = transacP;
+    }
+    contextP->transactionList = transacP;
+
+    prv_insert(indexP, transacP, PRV_INDEX_MID);
+    prv_insert(indexP, transacP, PRV_INDEX_TOKEN);
+    prv_insert(indexP, transacP, PRV_INDEX_PEER);
+    indexP->count++;
+}
+
+void transaction_unlink(lwm2m_context_t * contextP,
+                        lwm2m_transaction_t * transacP)
+{
+    lwm2m_transaction_index_t * indexP = &contextP->transactionIndex;
+
+    timer_cancel(contextP, &transacP->timer);
+    congestion_release(contextP, transacP);
+
+    // not added, like the block templates
+    if (transacP->prev == NULL && contextP->transactionList != transacP) return;
+
+    if (transacP->prev == NULL)
+    {
+        contextP->transactionList = transacP->next;
+    }
+    else
+    {
+        transacP->prev->next = transacP->next;
+    }
+    if (transacP->next != NULL)
+    {
+        transacP->next->prev = transacP->prev;
+    }
+    transacP->next = NULL;
+    transacP->prev = NULL;
+
+    prv_extract(indexP, transacP, PRV_INDEX_MID);
+    prv_extract(indexP, transacP, PRV_INDEX_TOKEN);
+    prv_extract(indexP, transacP, PRV_INDEX_PEER);
+    indexP->count--;
 }
 
 void transaction_remove(lwm2m_context_t * contextP,
                         lwm2m_transaction_t * transacP)
 {
     LOG("Entering");
-    contextP->transactionList = (lwm2m_transaction_t *) LWM2M_LIST_RM(contextP->transactionList, transacP->mID, NULL);
+    transaction_unlink(contextP, transacP);
     transaction_free(transacP);
 }
 
+void transaction_removePeer(lwm2m_context_t * contextP,
+                            void * sessionH)
+{
+    lwm2m_transaction_index_t * indexP = &contextP->transactionIndex;
+    lwm2m_transaction_t * transacP;
+
+    LOG("Entering");
+    // the block transfers answer and free the request they carry
+#if defined(LWM2M_SERVER_MODE) || defined(LWM2M_BOOTSTRAP_SERVER_MODE)
+    block1_removePeer(contextP, sessionH);
+#endif
+#ifdef LWM2M_SERVER_MODE
+    block2_removeFetches(contextP, sessionH);
+#endif
+    transacP = indexP->peerTable[utils_hashBucket(utils_hashPointer(sessionH), indexP->size)];
+    while (transacP != NULL)
+    {
+        lwm2m_transaction_t * nextP = transacP->peerNext;
+
+        if (transacP->peerH == sessionH)
+        {
+            transaction_remove(contextP, transacP);
+        }
+        transacP = nextP;
+    }
+    congestion_removePeer(contextP, sessionH);
+}
+
+void transaction_close(lwm2m_context_t * contextP)
+{
+    while (NULL != contextP->transactionList)
+    {
+        lwm2m_transaction_t * transacP;
+
+        transacP = contextP->transactionList;
+        contextP->transactionList = transacP->next;
+        transaction_free(transacP);
+    }
+    congestion_close(contextP);
+    if (contextP->transactionIndex.midTable != NULL) lwm2m_free(contextP->transactionIndex.midTable);
+    memset(&contextP->transactionIndex, 0, sizeof(lwm2m_transaction_index_t));
+}
+
 bool transaction_handleResponse(lwm2m_context_t * contextP,
                                  void * fromSessionH,
                                  coap_packet_t * message,
@@ -272,75 +560,89 @@ bool transaction_handleResponse(lwm2m_context_t * contextP,
     lwm2m_transaction_t * transacP;
 
     LOG("Entering");
-    transacP = contextP->transactionList;
-
-    while (NULL != transacP)
+    transacP = NULL;
+    if ((COAP_TYPE_ACK == message->type) || (COAP_TYPE_RST == message->type))
     {
-        if (lwm2m_session_is_equal(fromSessionH, transacP->peerH, contextP->userData) == true)
+        transacP = prv_findByMid(contextP, fromSessionH, message->mid);
+        if (transacP != NULL)
         {
             if (!transacP->ack_received)
             {
-                if ((COAP_TYPE_ACK == message->type) || (COAP_TYPE_RST == message->type))
-                {
-                    if (transacP->mID == message->mid)
-	                {
-    	                found = true;
-        	            transacP->ack_received = true;
-            	        reset = COAP_TYPE_RST == message->type;
-            	    }
-                }
+                found = true;
+                transacP->ack_received = true;
+                reset = COAP_TYPE_RST == message->type;
+            }
+            else if (!prv_checkFinished(transacP, message))
+            {
+                transacP = NULL;
             }
+        }
+    }
+    if (transacP == NULL)
+    {
+        // separate response
+        transacP = prv_findByToken(contextP, fromSessionH, message);
+        if (transacP == NULL) return false;
+    }
+    if (found || !transacP->ack_received)
+    {
+        congestion_sample(contextP, transacP);
+    }
 
-            if (reset || prv_checkFinished(transacP, message))
+    if (reset || prv_checkFinished(transacP, message))
+    {
+        // HACK: If a message is sent from the monitor callback,
+        // it will arrive before the registration ACK.
+        // So we resend transaction that were denied for authentication reason.
+        if (!reset)
+        {
+            if (COAP_TYPE_CON == message->type && NULL != response)
             {
-                // HACK: If a message is sent from the monitor callback,
-                // it will arrive before the registration ACK.
-                // So we resend transaction that were denied for authentication reason.
-                if (!reset)
-                {
-                    if (COAP_TYPE_CON == message->type && NULL != response)
-                    {
-                        coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
-                        message_send(contextP, response, fromSessionH);
-                    }
-                
-	                if ((COAP_401_UNAUTHORIZED == message->code) && (COAP_MAX_RETRANSMIT > transacP->retrans_counter))
-    	            {
-        	            transacP->ack_received = false;
-            	        transacP->retrans_time += COAP_RESPONSE_TIMEOUT;
-                	    return true;
-                	}
-				}       
-                if (transacP->callback != NULL)
-                {
-                    transacP->callback(transacP, message);
-                }
-                transaction_remove(contextP, transacP);
-                return true;
+                coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
+                message_send(contextP, response, fromSessionH);
             }
-            // if we found our guy, exit
-            if (found)
+
+            if ((COAP_401_UNAUTHORIZED == message->code) && (COAP_MAX_RETRANSMIT > transacP->retrans_counter))
             {
-                time_t tv_sec = lwm2m_gettime();
-                if (0 <= tv_sec)
-                {
-                    transacP->retrans_time = tv_sec;
-                }
-                if (transacP->response_timeout)
-                {
-                    transacP->retrans_time += transacP->response_timeout;
-                }
-                else
-                {
-                    transacP->retrans_time += COAP_RESPONSE_TIMEOUT * transacP->retrans_counter;
-                }
+                transacP->ack_received = false;
+                transacP->retrans_time += COAP_RESPONSE_TIMEOUT;
+                (void)timer_schedule(contextP, &transacP->timer, transacP->retrans_time);
                 return true;
             }
         }
+        if (transacP->callback != NULL)
+        {
+#ifdef LWM2M_SERVER_MODE
+            // the callback gets the whole response once the following blocks are fetched
+            if (block2_fetch(contextP, transacP, message)) return true;
+#endif
+            transacP->callback(transacP, message);
+        }
+        transaction_remove(contextP, transacP);
+        congestion_dispatch(contextP);
+        return true;
+    }
 
-        transacP = transacP->next;
+    // the empty ACK of a request answered separately
+    if (found)
+    {
+        time_t tv_sec = lwm2m_gettime();
+        if (0 <= tv_sec)
+        {
+            transacP->retrans_time = tv_sec;
+        }
+        if (transacP->response_timeout)
+        {
+            transacP->retrans_time += transacP->response_timeout;
+        }
+        else
+        {
+            transacP->retrans_time += COAP_RESPONSE_TIMEOUT * transacP->retrans_counter;
+        }
+        (void)timer_schedule(contextP, &transacP->timer, transacP->retrans_time);
     }
-    return false;
+
+    return true;
 }
 
 int transaction_send(lwm2m_context_t * contextP,
@@ -381,10 +683,16 @@ int transaction_send(lwm2m_context_t * contextP,
 
         if (0 == transacP->retrans_counter)
         {
-            time_t tv_sec = lwm2m_gettime();
+            time_t tv_sec;
+
+            // waits in the queue of its peer until a slot is free
+            if (!congestion_acquire(contextP, transacP)) return 0;
+
+            tv_sec = lwm2m_gettime();
             if (0 <= tv_sec)
             {
-                transacP->retrans_time = tv_sec + COAP_RESPONSE_TIMEOUT;
+                transacP->sendTime = tv_sec;
+                transacP->retrans_time = tv_sec + prv_toSeconds(congestion_getTimeout(contextP, transacP));
                 transacP->retrans_counter = 1;
                 timeout = 0;
             }
@@ -395,7 +703,7 @@ int transaction_send(lwm2m_context_t * contextP,
         }
         else
         {
-            timeout = COAP_RESPONSE_TIMEOUT << (transacP->retrans_counter - 1);
+            timeout = prv_toSeconds(congestion_getNextTimeout(transacP));
         }
 
         if (COAP_MAX_RETRANSMIT + 1 >= transacP->retrans_counter)
@@ -404,6 +712,12 @@ int transaction_send(lwm2m_context_t * contextP,
 
             transacP->retrans_time += timeout;
             transacP->retrans_counter += 1;
+
+            if (0 == timer_schedule(contextP, &transacP->timer, transacP->retrans_time))
+            {
+                // without a timer the transaction would never time out
+                maxRetriesReached = true;
+            }
         }
         else
         {
@@ -423,49 +737,3 @@ int transaction_send(lwm2m_context_t * contextP,
 
     return 0;
 }
-
-void transaction_step(lwm2m_context_t * contextP,
-                      time_t currentTime,
-                      time_t * timeoutP)
-{
-    lwm2m_transaction_t * transacP;
-
-    LOG("Entering");
-    transacP = contextP->transactionList;
-    while (transacP != NULL)
-    {
-        // transaction_send() may remove transaction from the linked list
-        lwm2m_transaction_t * nextP = transacP->next;
-        int removed = 0;
-
-        if (transacP->retrans_time <= currentTime)
-        {
-            removed = transaction_send(contextP, transacP);
-        }
-
-        if (0 == removed)
-        {
-            time_t interval;
-
-            if (transacP->retrans_time > currentTime)
-            {
-                interval = transacP->retrans_time - currentTime;
-            }
-            else
-            {
-                interval = 1;
-            }
-
-            if (*timeoutP > interval)
-            {
-                *timeoutP = interval;
-            }
-        }
-        else
-        {
-            *timeoutP = 1;
-        }
-
-        transacP = nextP;
-    }
-}
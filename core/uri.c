@@ -93,17 +93,14 @@ int uri_getNumber(uint8_t * uriString,
 }
 
 
-lwm2m_uri_t * uri_decode(char * altPath,
-                         multi_option_t *uriPath)
+bool uri_decode(char * altPath,
+                multi_option_t *uriPath,
+                lwm2m_uri_t * uriP)
 {
-    lwm2m_uri_t * uriP;
     int readNum;
 
     LOG_ARG("altPath: \"%s\"", altPath);
 
-    uriP = (lwm2m_uri_t *)lwm2m_malloc(sizeof(lwm2m_uri_t));
-    if (NULL == uriP) return NULL;
-
     memset(uriP, 0, sizeof(lwm2m_uri_t));
 
     // Read object ID
@@ -113,7 +110,7 @@ lwm2m_uri_t * uri_decode(char * altPath,
     {
         uriP->flag |= LWM2M_URI_FLAG_REGISTRATION;
         uriPath = uriPath->next;
-        if (uriPath == NULL) return uriP;
+        if (uriPath == NULL) return true;
     }
     else if (NULL != uriPath
      && URI_BOOTSTRAP_SEGMENT_LEN == uriPath->len
@@ -122,7 +119,7 @@ lwm2m_uri_t * uri_decode(char * altPath,
         uriP->flag |= LWM2M_URI_FLAG_BOOTSTRAP;
         uriPath = uriPath->next;
         if (uriPath != NULL) goto error;
-        return uriP;
+        return true;
     }
 
     if ((uriP->flag & LWM2M_URI_MASK_TYPE) != LWM2M_URI_FLAG_REGISTRATION)
@@ -133,15 +130,13 @@ lwm2m_uri_t * uri_decode(char * altPath,
             int i;
             if (NULL == uriPath)
             {
-                lwm2m_free(uriP);
-                return NULL;
+                return false;
             }
             for (i = 0 ; i < uriPath->len ; i++)
             {
                 if (uriPath->data[i] != altPath[i+1])
                 {
-                    lwm2m_free(uriP);
-                    return NULL;
+                    return false;
                 }
             }
             uriPath = uriPath->next;
@@ -149,7 +144,7 @@ lwm2m_uri_t * uri_decode(char * altPath,
         if (NULL == uriPath || uriPath->len == 0)
         {
             uriP->flag |= LWM2M_URI_FLAG_DELETE_ALL;
-            return uriP;
+            return true;
         }
     }
 
@@ -162,11 +157,11 @@ lwm2m_uri_t * uri_decode(char * altPath,
     if ((uriP->flag & LWM2M_URI_MASK_TYPE) == LWM2M_URI_FLAG_REGISTRATION)
     {
         if (uriPath != NULL) goto error;
-        return uriP;
+        return true;
     }
     uriP->flag |= LWM2M_URI_FLAG_DM;
 
-    if (uriPath == NULL) return uriP;
+    if (uriPath == NULL) return true;
 
     // Read object instance
     if (uriPath->len != 0)
@@ -178,7 +173,7 @@ lwm2m_uri_t * uri_decode(char * altPath,
     }
     uriPath = uriPath->next;
 
-    if (uriPath == NULL) return uriP;
+    if (uriPath == NULL) return true;
 
     // Read resource ID
     if (uriPath->len != 0)
@@ -196,13 +191,12 @@ lwm2m_uri_t * uri_decode(char * altPath,
     if (NULL == uriPath->next)
     {
         LOG_URI(uriP);
-        return uriP;
+        return true;
     }
 
 error:
     LOG("Exiting on error");
-    lwm2m_free(uriP);
-    return NULL;
+    return false;
 }
 
 int lwm2m_stringToUri(const char * buffer,
@@ -52,6 +52,8 @@
 #include <stdio.h>
 #include <float.h>
 
+// first heap allocation of a growable buffer
+#define PRV_BUFFER_MIN_SIZE 64
 
 int utils_textToInt(uint8_t * buffer,
                     int length,
@@ -120,7 +122,7 @@ int utils_textToFloat(uint8_t * buffer,
     }
 
     result = 0;
-    while (i < length && buffer[i] != '.')
+    while (i < length && buffer[i] != '.' && buffer[i] != 'e' && buffer[i] != 'E')
     {
         if ('0' <= buffer[i] && buffer[i] <= '9')
         {
@@ -134,7 +136,7 @@ int utils_textToFloat(uint8_t * buffer,
         }
         i++;
     }
-    if (buffer[i] == '.')
+    if (i < length && buffer[i] == '.')
     {
         double dec;
 
@@ -142,7 +144,7 @@ int utils_textToFloat(uint8_t * buffer,
         if (i == length) return 0;
 
         dec = 0.1;
-        while (i < length)
+        while (i < length && buffer[i] != 'e' && buffer[i] != 'E')
         {
             if ('0' <= buffer[i] && buffer[i] <= '9')
             {
@@ -157,6 +159,52 @@ int utils_textToFloat(uint8_t * buffer,
             i++;
         }
     }
+    if (i < length)
+    {
+        // exponent, as in 4E+38
+        int exponent;
+        bool negative;
+
+        i++;
+        if (i < length && (buffer[i] == '+' || buffer[i] == '-'))
+        {
+            negative = (buffer[i] == '-');
+            i++;
+        }
+        else
+        {
+            negative = false;
+        }
+        if (i == length) return 0;
+
+        exponent = 0;
+        while (i < length)
+        {
+            if ('0' <= buffer[i] && buffer[i] <= '9')
+            {
+                exponent = exponent * 10 + (buffer[i] - '0');
+                if (exponent > DBL_MAX_10_EXP - DBL_MIN_10_EXP) return 0;
+            }
+            else
+            {
+                return 0;
+            }
+            i++;
+        }
+        while (exponent > 0)
+        {
+            if (negative == true)
+            {
+                result /= 10;
+            }
+            else
+            {
+                if (result > (DBL_MAX / 10)) return 0;
+                result *= 10;
+            }
+            exponent--;
+        }
+    }
 
     *dataP = result * sign;
     return 1;
@@ -219,7 +267,33 @@ size_t utils_floatToText(double data,
     int64_t intPart;
     double decPart;
 
-    if (data <= (double)INT64_MIN || data >= (double)INT64_MAX) return 0;
+    if (data <= (double)INT64_MIN || data >= (double)INT64_MAX)
+    {
+        // too large for the integer part: use the exponent notation
+        double mantissa;
+        int exponent;
+        size_t mantissaLength;
+        size_t expLength;
+
+        mantissa = data;
+        exponent = 0;
+        while (mantissa <= -10 || mantissa >= 10)
+        {
+            mantissa /= 10;
+            exponent++;
+            // infinite or not a number
+            if (exponent > DBL_MAX_10_EXP) return 0;
+        }
+
+        mantissaLength = utils_floatToText(mantissa, string, length);
+        if (mantissaLength == 0 || mantissaLength + 2 >= length) return 0;
+        string[mantissaLength] = 'E';
+        string[mantissaLength + 1] = '+';
+        expLength = utils_intToText(exponent, string + mantissaLength + 2, length - mantissaLength - 2);
+        if (expLength == 0) return 0;
+
+        return mantissaLength + 2 + expLength;
+    }
 
     intPart = (int64_t)data;
     decPart = data - intPart;
@@ -348,6 +422,10 @@ lwm2m_media_type_t utils_convertMediaType(coap_content_type_t type)
         return LWM2M_CONTENT_JSON_OLD;
     case LWM2M_CONTENT_JSON:
         return LWM2M_CONTENT_JSON;
+#ifdef LWM2M_SUPPORT_SENML_CBOR
+    case LWM2M_CONTENT_SENML_CBOR:
+        return LWM2M_CONTENT_SENML_CBOR;
+#endif
     case APPLICATION_LINK_FORMAT:
         return LWM2M_CONTENT_LINK;
 
@@ -466,7 +544,7 @@ void utils_copyValue(void * dst,
 
 #define PRV_B64_PADDING '='
 
-static char b64Alphabet[64] =
+static const char b64Alphabet[64] =
 {
     'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
     'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
@@ -552,3 +630,162 @@ lwm2m_data_type_t utils_depthToDatatype(uri_depth_t depth)
 
     return LWM2M_TYPE_UNDEFINED;
 }
+
+void utils_bufferInit(utils_buffer_t * bufferP,
+                      uint8_t * storage,
+                      size_t size,
+                      bool isFixed)
+{
+    bufferP->data = storage;
+    bufferP->size = (storage != NULL) ? size : 0;
+    bufferP->length = 0;
+    bufferP->isAllocated = false;
+    bufferP->isFixed = isFixed;
+}
+
+// Returns where to write the next length bytes, or NULL if the buffer cannot hold them.
+// The caller advances bufferP->length by what it actually wrote.
+uint8_t * utils_bufferReserve(utils_buffer_t * bufferP,
+                              size_t length)
+{
+    if (bufferP->size - bufferP->length < length)
+    {
+        uint8_t * newData;
+        size_t newSize;
+
+        if (bufferP->isFixed) return NULL;
+
+        newSize = (bufferP->size < PRV_BUFFER_MIN_SIZE) ? PRV_BUFFER_MIN_SIZE : bufferP->size;
+        while (newSize - bufferP->length < length)
+        {
+            if (newSize > SIZE_MAX / 2) return NULL;
+            newSize *= 2;
+        }
+
+        newData = (uint8_t *)lwm2m_malloc(newSize);
+        if (newData == NULL) return NULL;
+        if (bufferP->length > 0) memcpy(newData, bufferP->data, bufferP->length);
+        if (bufferP->isAllocated) lwm2m_free(bufferP->data);
+        bufferP->data = newData;
+        bufferP->size = newSize;
+        bufferP->isAllocated = true;
+    }
+
+    return bufferP->data + bufferP->length;
+}
+
+void utils_bufferFree(utils_buffer_t * bufferP)
+{
+    if (bufferP->isAllocated) lwm2m_free(bufferP->data);
+    bufferP->data = NULL;
+    bufferP->size = 0;
+    bufferP->length = 0;
+    bufferP->isAllocated = false;
+}
+
+// FNV-1a, starting from UTILS_HASH_SEED or the hash of the previous bytes
+uint32_t utils_hashBytes(uint32_t hash,
+                         const uint8_t * buffer,
+                         size_t length)
+{
+    size_t i;
+
+    for (i = 0 ; i < length ; i++)
+    {
+        hash ^= buffer[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// Mixes the bits of pointers like session handles, whose low bits are mostly the same.
+size_t utils_hashPointer(void * pointer)
+{
+    uintptr_t hash;
+
+    hash = (uintptr_t)pointer;
+    hash ^= hash >> 16;
+    hash *= 0x45D9F3Bu;
+    hash ^= hash >> 16;
+
+    return (size_t)hash;
+}
+
+size_t utils_hashBucket(size_t hash,
+                        size_t size)
+{
+    return hash & (size - 1);
+}
+
+// Returns the size a table of count entries needs before adding one.
+size_t utils_hashTableSize(size_t size,
+                           size_t count,
+                           size_t minSize)
+{
+    // keep the load factor under 1. If growing fails, longer chains still work.
+    if (count < size) return size;
+
+    return size == 0 ? minSize : size * 2;
+}
+
+// Allocates tableCount tables of size empty buckets in a single block.
+void ** utils_hashTableAlloc(size_t size,
+                             size_t tableCount)
+{
+    void ** bucketsP;
+
+    LOG_ARG("size: %d", size);
+
+    bucketsP = (void **)lwm2m_malloc(tableCount * size * sizeof(void *));
+    if (bucketsP == NULL) return NULL;
+    memset(bucketsP, 0, tableCount * size * sizeof(void *));
+
+    return bucketsP;
+}
+
+// Moves the entries of the table of size buckets to newSize new buckets, keeping their order in each chain,
+// and frees the old buckets. The link of an entry is at nextOffset. The buckets and the links hold typed
+// pointers: they are only accessed with memcpy(). Returns the new buckets, or NULL and keeps the table if
+// allocating fails.
+void ** utils_hashTableResize(void ** bucketsP,
+                              size_t size,
+                              size_t newSize,
+                              size_t nextOffset,
+                              utils_hash_callback_t hashCb)
+{
+    void ** newBucketsP;
+    size_t i;
+
+    newBucketsP = utils_hashTableAlloc(newSize, 1);
+    if (newBucketsP == NULL) return NULL;
+
+    for (i = 0 ; i < size ; i++)
+    {
+        void * entryP;
+
+        memcpy(&entryP, bucketsP + i, sizeof(void *));
+        while (entryP != NULL)
+        {
+            uint8_t * targetP = (uint8_t *)(newBucketsP + utils_hashBucket(hashCb(entryP), newSize));
+            void * followingP;
+            void * nextP;
+
+            memcpy(&nextP, targetP, sizeof(void *));
+            while (nextP != NULL)
+            {
+                targetP = (uint8_t *)nextP + nextOffset;
+                memcpy(&nextP, targetP, sizeof(void *));
+            }
+            memcpy(&followingP, (uint8_t *)entryP + nextOffset, sizeof(void *));
+            memcpy(targetP, &entryP, sizeof(void *));
+            // nextP is NULL: the entry ends its chain
+            memcpy((uint8_t *)entryP + nextOffset, &nextP, sizeof(void *));
+            entryP = followingP;
+        }
+    }
+
+    if (bucketsP != NULL) lwm2m_free(bucketsP);
+
+    return newBucketsP;
+}
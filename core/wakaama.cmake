@@ -1,5 +1,7 @@
 # Provides WAKAAMA_SOURCES_DIR and WAKAAMA_SOURCES and WAKAAMA_DEFINITIONS variables.
 # Add LWM2M_WITH_LOGS to compile definitions to enable logging.
+# Add LWM2M_WITH_POOLS to allocate the core fixed-size structures from static pools (see pool.c).
+# The pools are shared by all the contexts and not thread-safe: only one thread may run the core.
 # Set LWM2M_LITTLE_ENDIAN to FALSE or TRUE according to your destination platform or leave
 # it unset to determine endianess automatically.
 
@@ -21,14 +23,24 @@ set(WAKAAMA_SOURCES
     ${WAKAAMA_SOURCES_DIR}/data.c
     ${WAKAAMA_SOURCES_DIR}/list.c
     ${WAKAAMA_SOURCES_DIR}/packet.c
+    ${WAKAAMA_SOURCES_DIR}/dedup.c
     ${WAKAAMA_SOURCES_DIR}/transaction.c
+    ${WAKAAMA_SOURCES_DIR}/congestion.c
+    ${WAKAAMA_SOURCES_DIR}/timer.c
+    ${WAKAAMA_SOURCES_DIR}/pool.c
     ${WAKAAMA_SOURCES_DIR}/registration.c
+    ${WAKAAMA_SOURCES_DIR}/registry.c
+    ${WAKAAMA_SOURCES_DIR}/objectlist.c
     ${WAKAAMA_SOURCES_DIR}/bootstrap.c
     ${WAKAAMA_SOURCES_DIR}/management.c
+    ${WAKAAMA_SOURCES_DIR}/bulk.c
+    ${WAKAAMA_SOURCES_DIR}/completion.c
     ${WAKAAMA_SOURCES_DIR}/observe.c
     ${WAKAAMA_SOURCES_DIR}/json.c
+    ${WAKAAMA_SOURCES_DIR}/senml_cbor.c
     ${WAKAAMA_SOURCES_DIR}/discover.c
     ${WAKAAMA_SOURCES_DIR}/block1.c
+    ${WAKAAMA_SOURCES_DIR}/block2.c
     ${WAKAAMA_SOURCES_DIR}/internals.h
 	${CORE_HEADERS}
     ${EXT_SOURCES})
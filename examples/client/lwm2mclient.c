@@ -104,6 +104,7 @@ typedef struct
     lwm2m_context_t * lwm2mH;
 #else
     connection_t * connList;
+    connection_batch_t * txBatchP;
 #endif
     int addressFamily;
 } client_data_t;
@@ -251,6 +252,7 @@ void * lwm2m_connect_server(uint16_t secObjInstID,
         fprintf(stderr, "Connection creation failed.\r\n");
     }
     else {
+        newConnP->txBatchP = dataP->txBatchP;
         dataP->connList = newConnP;
     }
 
@@ -780,6 +782,65 @@ static void close_backup_object()
 }
 #endif
 
+static void prv_handle_datagram(lwm2m_context_t * lwm2mH,
+                                client_data_t * dataP,
+                                uint8_t * buffer,
+                                int numBytes,
+                                struct sockaddr_storage * addrP,
+                                socklen_t addrLen)
+{
+    char s[INET6_ADDRSTRLEN];
+    in_port_t port;
+
+#ifdef WITH_TINYDTLS
+    dtls_connection_t * connP;
+#else
+    connection_t * connP;
+#endif
+    s[0] = 0;
+    port = 0;
+    if (AF_INET == addrP->ss_family)
+    {
+        struct sockaddr_in *saddr = (struct sockaddr_in *)addrP;
+        inet_ntop(saddr->sin_family, &saddr->sin_addr, s, INET6_ADDRSTRLEN);
+        port = saddr->sin_port;
+    }
+    else if (AF_INET6 == addrP->ss_family)
+    {
+        struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)addrP;
+        inet_ntop(saddr->sin6_family, &saddr->sin6_addr, s, INET6_ADDRSTRLEN);
+        port = saddr->sin6_port;
+    }
+    fprintf(stderr, "%d bytes received from [%s]:%hu\r\n", numBytes, s, ntohs(port));
+
+    /*
+     * Display it in the STDERR
+     */
+    output_buffer(stderr, buffer, numBytes, 0);
+
+    connP = connection_find(dataP->connList, addrP, addrLen);
+    if (connP != NULL)
+    {
+        /*
+         * Let liblwm2m respond to the query depending on the context
+         */
+#ifdef WITH_TINYDTLS
+        int result = connection_handle_packet(connP, buffer, numBytes);
+        if (0 != result)
+        {
+             printf("error handling message %d\n",result);
+        }
+#else
+        lwm2m_handle_packet(lwm2mH, buffer, numBytes, connP);
+#endif
+        conn_s_updateRxStatistic(objArray[7], numBytes, false);
+    }
+    else
+    {
+        fprintf(stderr, "received bytes ignored!\r\n");
+    }
+}
+
 void print_usage(void)
 {
     fprintf(stdout, "Usage: lwm2mclient [OPTION]\r\n");
@@ -793,6 +854,9 @@ void print_usage(void)
     fprintf(stdout, "  -t TIME\tSet the lifetime of the Client. Default: 300\r\n");
     fprintf(stdout, "  -b\t\tBootstrap requested.\r\n");
     fprintf(stdout, "  -c\t\tChange battery level over time.\r\n");
+#ifndef WITH_TINYDTLS
+    fprintf(stdout, "  -m\t\tSend and receive several datagrams per system call.\r\n");
+#endif
 #ifdef WITH_TINYDTLS
     fprintf(stdout, "  -i STRING\tSet the device management or bootstrap server PSK identity. If not set use none secure mode\r\n");
     fprintf(stdout, "  -s HEXSTRING\tSet the device management or bootstrap server Pre-Shared-Key. If not set use none secure mode\r\n");
@@ -816,6 +880,10 @@ int main(int argc, char *argv[])
     int opt;
     bool bootstrapRequested = false;
     bool serverPortChanged = false;
+#ifndef WITH_TINYDTLS
+    bool batchMode = false;
+    connection_batch_t * rxBatchP = NULL;
+#endif
 
 #ifdef LWM2M_BOOTSTRAP
     lwm2m_client_state_t previousState = STATE_INITIAL;
@@ -880,6 +948,11 @@ int main(int argc, char *argv[])
         case 'c':
             batterylevelchanging = 1;
             break;
+#ifndef WITH_TINYDTLS
+        case 'm':
+            batchMode = true;
+            break;
+#endif
         case 't':
             opt++;
             if (opt >= argc)
@@ -976,6 +1049,19 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+#ifndef WITH_TINYDTLS
+    if (batchMode)
+    {
+        rxBatchP = connection_batch_new();
+        data.txBatchP = connection_batch_new();
+        if (rxBatchP == NULL || data.txBatchP == NULL)
+        {
+            fprintf(stderr, "Failed to allocate the datagram batches\r\n");
+            return -1;
+        }
+    }
+#endif
+
     /*
      * Now the main function fill an array with each object, this list will be later passed to liblwm2m.
      * Those functions are located in their respective object file.
@@ -1238,6 +1324,13 @@ int main(int argc, char *argv[])
         }
 #ifdef LWM2M_BOOTSTRAP
         update_bootstrap_info(&previousState, lwm2mH);
+#endif
+#ifndef WITH_TINYDTLS
+        // everything queued since the last loop, responses included, goes out in one call
+        if (data.txBatchP != NULL && 0 != connection_batch_flush(data.txBatchP))
+        {
+            fprintf(stderr, "Error in sendmmsg(): %d %s\r\n", errno, strerror(errno));
+        }
 #endif
         /*
          * This part will set up an interruption until an event happen on SDTIN or the socket until "tv" timed out (set
@@ -1267,6 +1360,25 @@ int main(int argc, char *argv[])
 
                 addrLen = sizeof(addr);
 
+#ifndef WITH_TINYDTLS
+                if (rxBatchP != NULL)
+                {
+                    int count;
+
+                    count = connection_batch_receive(rxBatchP, data.sock);
+                    if (count == -1)
+                    {
+                        fprintf(stderr, "Error in recvmmsg(): %d %s\r\n", errno, strerror(errno));
+                    }
+                    for (i = 0 ; i < count ; i++)
+                    {
+                        prv_handle_datagram(lwm2mH, &data, rxBatchP->buffer[i], rxBatchP->length[i],
+                                            &(rxBatchP->addr[i]), rxBatchP->addrLen[i]);
+                    }
+                    continue;
+                }
+#endif
+
                 /*
                  * We retrieve the data received
                  */
@@ -1278,54 +1390,7 @@ int main(int argc, char *argv[])
                 }
                 else if (0 < numBytes)
                 {
-                    char s[INET6_ADDRSTRLEN];
-                    in_port_t port;
-
-#ifdef WITH_TINYDTLS
-                    dtls_connection_t * connP;
-#else
-                    connection_t * connP;
-#endif
-                    if (AF_INET == addr.ss_family)
-                    {
-                        struct sockaddr_in *saddr = (struct sockaddr_in *)&addr;
-                        inet_ntop(saddr->sin_family, &saddr->sin_addr, s, INET6_ADDRSTRLEN);
-                        port = saddr->sin_port;
-                    }
-                    else if (AF_INET6 == addr.ss_family)
-                    {
-                        struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)&addr;
-                        inet_ntop(saddr->sin6_family, &saddr->sin6_addr, s, INET6_ADDRSTRLEN);
-                        port = saddr->sin6_port;
-                    }
-                    fprintf(stderr, "%d bytes received from [%s]:%hu\r\n", numBytes, s, ntohs(port));
-
-                    /*
-                     * Display it in the STDERR
-                     */
-                    output_buffer(stderr, buffer, numBytes, 0);
-
-                    connP = connection_find(data.connList, &addr, addrLen);
-                    if (connP != NULL)
-                    {
-                        /*
-                         * Let liblwm2m respond to the query depending on the context
-                         */
-#ifdef WITH_TINYDTLS
-                        int result = connection_handle_packet(connP, buffer, numBytes);
-                        if (0 != result)
-                        {
-                             printf("error handling message %d\n",result);
-                        }
-#else
-                        lwm2m_handle_packet(lwm2mH, buffer, numBytes, connP);
-#endif
-                        conn_s_updateRxStatistic(objArray[7], numBytes, false);
-                    }
-                    else
-                    {
-                        fprintf(stderr, "received bytes ignored!\r\n");
-                    }
+                    prv_handle_datagram(lwm2mH, &data, buffer, numBytes, &addr, addrLen);
                 }
             }
 
@@ -1371,8 +1436,15 @@ int main(int argc, char *argv[])
 #endif
         lwm2m_close(lwm2mH);
     }
+#ifndef WITH_TINYDTLS
+    if (data.txBatchP != NULL) connection_batch_flush(data.txBatchP);
+#endif
     close(data.sock);
     connection_free(data.connList);
+#ifndef WITH_TINYDTLS
+    connection_batch_free(rxBatchP);
+    connection_batch_free(data.txBatchP);
+#endif
 
     clean_security_object(objArray[0]);
     lwm2m_free(objArray[0]);
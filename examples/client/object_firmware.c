@@ -68,6 +68,7 @@ typedef struct
     char pkg_version[256];
     uint8_t protocol_support[LWM2M_FIRMWARE_PROTOCOL_NUM];
     uint8_t delivery_method;
+    uint32_t package_size;
 } firmware_data_t;
 
 static uint8_t prv_firmware_read(uint16_t instanceId,
@@ -216,6 +217,43 @@ static uint8_t prv_firmware_write(uint16_t instanceId,
     return result;
 }
 
+// The package is received block by block, it is never held in memory as a whole.
+static uint8_t prv_firmware_write_block(uint16_t instanceId,
+                                        uint16_t resourceId,
+                                        uint32_t offset,
+                                        uint8_t * buffer,
+                                        size_t length,
+                                        bool more,
+                                        lwm2m_object_t * objectP)
+{
+    firmware_data_t * data = (firmware_data_t*)(objectP->userData);
+
+    (void)buffer;
+
+    // this is a single instance object
+    if (instanceId != 0)
+    {
+        return COAP_404_NOT_FOUND;
+    }
+    if (resourceId != RES_M_PACKAGE)
+    {
+        return COAP_405_METHOD_NOT_ALLOWED;
+    }
+
+    if (offset == 0)
+    {
+        data->package_size = 0;
+    }
+    // write buffer to your firmware storage here
+    data->package_size += length;
+    if (!more)
+    {
+        fprintf(stdout, "\n\t FIRMWARE PACKAGE RECEIVED: %u bytes\r\n\n", data->package_size);
+    }
+
+    return COAP_204_CHANGED;
+}
+
 static uint8_t prv_firmware_execute(uint16_t instanceId,
                                     uint16_t resourceId,
                                     uint8_t * buffer,
@@ -308,6 +346,7 @@ lwm2m_object_t * get_object_firmware(void)
         firmwareObj->readFunc    = prv_firmware_read;
         firmwareObj->writeFunc   = prv_firmware_write;
         firmwareObj->executeFunc = prv_firmware_execute;
+        firmwareObj->blockWriteFunc = prv_firmware_write_block;
         firmwareObj->userData    = lwm2m_malloc(sizeof(firmware_data_t));
 
         /*
@@ -319,6 +358,7 @@ lwm2m_object_t * get_object_firmware(void)
 
             data->state = 1;
             data->result = 0;
+            data->package_size = 0;
             strcpy(data->pkg_name, "lwm2mclient");
             strcpy(data->pkg_version, "1.0");
 
@@ -72,10 +72,12 @@
 
 #include "commandline.h"
 #include "connection.h"
+#include "eventloop.h"
 
 #define MAX_PACKET_SIZE 1024
 
 static int g_quit = 0;
+static event_loop_t * g_loopP = NULL;
 
 static void prv_print_error(uint8_t status)
 {
@@ -110,6 +112,7 @@ static char * prv_dump_binding(lwm2m_binding_t binding)
 static void prv_dump_client(lwm2m_client_t * targetP)
 {
     lwm2m_client_object_t * objectP;
+    uint16_t i;
 
     fprintf(stdout, "Client #%d:\r\n", targetP->internalID);
     fprintf(stdout, "\tname: \"%s\"\r\n", targetP->name);
@@ -118,19 +121,17 @@ static void prv_dump_client(lwm2m_client_t * targetP)
     if (targetP->altPath) fprintf(stdout, "\talternative path: \"%s\"\r\n", targetP->altPath);
     fprintf(stdout, "\tlifetime: %d sec\r\n", targetP->lifetime);
     fprintf(stdout, "\tobjects: ");
-    for (objectP = targetP->objectList; objectP != NULL ; objectP = objectP->next)
+    for (objectP = targetP->objectList->objects; objectP < targetP->objectList->objects + targetP->objectList->count ; objectP++)
     {
-        if (objectP->instanceList == NULL)
+        if (objectP->instanceCount == 0)
         {
             fprintf(stdout, "/%d, ", objectP->id);
         }
         else
         {
-            lwm2m_list_t * instanceP;
-
-            for (instanceP = objectP->instanceList; instanceP != NULL ; instanceP = instanceP->next)
+            for (i = 0 ; i < objectP->instanceCount ; i++)
             {
-                fprintf(stdout, "/%d/%d, ", objectP->id, instanceP->id);
+                fprintf(stdout, "/%d/%d, ", objectP->id, objectP->instances[i]);
             }
         }
     }
@@ -753,7 +754,7 @@ static void prv_monitor_callback(uint16_t clientID,
     case COAP_201_CREATED:
         fprintf(stdout, "\r\nNew client #%d registered.\r\n", clientID);
 
-        targetP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)lwm2mH->clientList, clientID);
+        targetP = lwm2m_get_client(lwm2mH, clientID);
 
         prv_dump_client(targetP);
         break;
@@ -765,7 +766,7 @@ static void prv_monitor_callback(uint16_t clientID,
     case COAP_204_CHANGED:
         fprintf(stdout, "\r\nClient #%d updated.\r\n", clientID);
 
-        targetP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)lwm2mH->clientList, clientID);
+        targetP = lwm2m_get_client(lwm2mH, clientID);
 
         prv_dump_client(targetP);
         break;
@@ -780,6 +781,53 @@ static void prv_monitor_callback(uint16_t clientID,
 }
 
 
+static void prv_handle_datagram(lwm2m_context_t * lwm2mH,
+                                connection_t ** connListP,
+                                int sock,
+                                uint8_t * buffer,
+                                int numBytes,
+                                struct sockaddr_storage * addrP,
+                                socklen_t addrLen,
+                                connection_batch_t * txBatchP)
+{
+    char s[INET6_ADDRSTRLEN];
+    in_port_t port;
+    connection_t * connP;
+
+    s[0] = 0;
+    port = 0;
+    if (AF_INET == addrP->ss_family)
+    {
+        struct sockaddr_in *saddr = (struct sockaddr_in *)addrP;
+        inet_ntop(saddr->sin_family, &saddr->sin_addr, s, INET6_ADDRSTRLEN);
+        port = saddr->sin_port;
+    }
+    else if (AF_INET6 == addrP->ss_family)
+    {
+        struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)addrP;
+        inet_ntop(saddr->sin6_family, &saddr->sin6_addr, s, INET6_ADDRSTRLEN);
+        port = saddr->sin6_port;
+    }
+
+    fprintf(stderr, "%d bytes received from [%s]:%hu\r\n", numBytes, s, ntohs(port));
+    output_buffer(stderr, buffer, numBytes, 0);
+
+    connP = connection_find(*connListP, addrP, addrLen);
+    if (connP == NULL)
+    {
+        connP = connection_new_incoming(*connListP, sock, (struct sockaddr *)addrP, addrLen);
+        if (connP != NULL)
+        {
+            connP->txBatchP = txBatchP;
+            *connListP = connP;
+        }
+    }
+    if (connP != NULL)
+    {
+        lwm2m_handle_packet(lwm2mH, buffer, numBytes, connP);
+    }
+}
+
 static void prv_quit(char * buffer,
                      void * user_data)
 {
@@ -789,6 +837,41 @@ static void prv_quit(char * buffer,
 void handle_sigint(int signum)
 {
     g_quit = 2;
+    if (g_loopP != NULL) event_loop_stop(g_loopP);
+}
+
+static void prv_read_command(command_desc_t * commands)
+{
+    char buffer[MAX_PACKET_SIZE];
+    int numBytes;
+
+    numBytes = read(STDIN_FILENO, buffer, MAX_PACKET_SIZE - 1);
+
+    if (numBytes > 1)
+    {
+        buffer[numBytes] = 0;
+        handle_command(commands, buffer);
+        fprintf(stdout, "\r\n");
+    }
+    if (g_quit == 0)
+    {
+        fprintf(stdout, "> ");
+        fflush(stdout);
+    }
+    else
+    {
+        fprintf(stdout, "\r\n");
+    }
+}
+
+static void prv_stdin_callback(event_loop_t * loopP,
+                               int fd,
+                               void * userData)
+{
+    (void)fd;
+
+    prv_read_command((command_desc_t *)userData);
+    if (g_quit != 0) event_loop_stop(loopP);
 }
 
 void print_usage(void)
@@ -798,6 +881,8 @@ void print_usage(void)
     fprintf(stdout, "Options:\r\n");
     fprintf(stdout, "  -4\t\tUse IPv4 connection. Default: IPv6 connection\r\n");
     fprintf(stdout, "  -l PORT\tSet the local UDP port of the Server. Default: "LWM2M_STANDARD_PORT_STR"\r\n");
+    fprintf(stdout, "  -m\t\tSend and receive several datagrams per system call.\r\n");
+    fprintf(stdout, "  -e\t\tRun on the epoll event loop (implies -m).\r\n");
     fprintf(stdout, "\r\n");
 }
 
@@ -814,6 +899,10 @@ int main(int argc, char *argv[])
     int addressFamily = AF_INET6;
     int opt;
     const char * localPort = LWM2M_STANDARD_PORT_STR;
+    bool batchMode = false;
+    bool eventMode = false;
+    connection_batch_t * rxBatchP = NULL;
+    connection_batch_t * txBatchP = NULL;
 
     command_desc_t commands[] =
     {
@@ -899,6 +988,12 @@ int main(int argc, char *argv[])
             }
             localPort = argv[opt];
             break;
+        case 'm':
+            batchMode = true;
+            break;
+        case 'e':
+            eventMode = true;
+            break;
         default:
             print_usage();
             return 0;
@@ -913,6 +1008,17 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    if (batchMode)
+    {
+        rxBatchP = connection_batch_new();
+        txBatchP = connection_batch_new();
+        if (rxBatchP == NULL || txBatchP == NULL)
+        {
+            fprintf(stderr, "Failed to allocate the datagram batches\r\n");
+            return -1;
+        }
+    }
+
     lwm2mH = lwm2m_init(NULL);
     if (NULL == lwm2mH)
     {
@@ -930,6 +1036,23 @@ int main(int argc, char *argv[])
 
     lwm2m_set_monitoring_callback(lwm2mH, prv_monitor_callback, lwm2mH);
 
+    if (eventMode)
+    {
+        g_loopP = event_loop_new(lwm2mH);
+        if (g_loopP == NULL
+         || 0 != event_loop_add_socket(g_loopP, sock)
+         || 0 != event_loop_add_fd(g_loopP, STDIN_FILENO, prv_stdin_callback, commands))
+        {
+            fprintf(stderr, "Failed to start the event loop: %d\r\n", errno);
+            return -1;
+        }
+        if (0 != event_loop_run(g_loopP))
+        {
+            fprintf(stderr, "Event loop failed: %d\r\n", errno);
+            return -1;
+        }
+    }
+
     while (0 == g_quit)
     {
         FD_ZERO(&readfds);
@@ -946,6 +1069,12 @@ int main(int argc, char *argv[])
             return -1;
         }
 
+        // everything queued since the last loop, responses included, goes out in one call
+        if (txBatchP != NULL && 0 != connection_batch_flush(txBatchP))
+        {
+            fprintf(stderr, "Error in sendmmsg(): %d\r\n", errno);
+        }
+
         result = select(FD_SETSIZE, &readfds, 0, 0, &tv);
 
         if ( result < 0 )
@@ -962,80 +1091,59 @@ int main(int argc, char *argv[])
 
             if (FD_ISSET(sock, &readfds))
             {
-                struct sockaddr_storage addr;
-                socklen_t addrLen;
-
-                addrLen = sizeof(addr);
-                numBytes = recvfrom(sock, buffer, MAX_PACKET_SIZE, 0, (struct sockaddr *)&addr, &addrLen);
-
-                if (numBytes == -1)
+                if (rxBatchP != NULL)
                 {
-                    fprintf(stderr, "Error in recvfrom(): %d\r\n", errno);
-                }
-                else
-                {
-                    char s[INET6_ADDRSTRLEN];
-                    in_port_t port;
-                    connection_t * connP;
+                    int count;
 
-					s[0] = 0;
-                    if (AF_INET == addr.ss_family)
+                    count = connection_batch_receive(rxBatchP, sock);
+                    if (count == -1)
                     {
-                        struct sockaddr_in *saddr = (struct sockaddr_in *)&addr;
-                        inet_ntop(saddr->sin_family, &saddr->sin_addr, s, INET6_ADDRSTRLEN);
-                        port = saddr->sin_port;
+                        fprintf(stderr, "Error in recvmmsg(): %d\r\n", errno);
                     }
-                    else if (AF_INET6 == addr.ss_family)
+                    for (i = 0 ; i < count ; i++)
                     {
-                        struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)&addr;
-                        inet_ntop(saddr->sin6_family, &saddr->sin6_addr, s, INET6_ADDRSTRLEN);
-                        port = saddr->sin6_port;
+                        prv_handle_datagram(lwm2mH, &connList, sock, rxBatchP->buffer[i], rxBatchP->length[i],
+                                            &(rxBatchP->addr[i]), rxBatchP->addrLen[i], txBatchP);
                     }
+                }
+                else
+                {
+                    struct sockaddr_storage addr;
+                    socklen_t addrLen;
 
-                    fprintf(stderr, "%d bytes received from [%s]:%hu\r\n", numBytes, s, ntohs(port));
-                    output_buffer(stderr, buffer, numBytes, 0);
+                    addrLen = sizeof(addr);
+                    numBytes = recvfrom(sock, buffer, MAX_PACKET_SIZE, 0, (struct sockaddr *)&addr, &addrLen);
 
-                    connP = connection_find(connList, &addr, addrLen);
-                    if (connP == NULL)
+                    if (numBytes == -1)
                     {
-                        connP = connection_new_incoming(connList, sock, (struct sockaddr *)&addr, addrLen);
-                        if (connP != NULL)
-                        {
-                            connList = connP;
-                        }
+                        fprintf(stderr, "Error in recvfrom(): %d\r\n", errno);
                     }
-                    if (connP != NULL)
+                    else
                     {
-                        lwm2m_handle_packet(lwm2mH, buffer, numBytes, connP);
+                        prv_handle_datagram(lwm2mH, &connList, sock, buffer, numBytes, &addr, addrLen, NULL);
                     }
                 }
             }
             else if (FD_ISSET(STDIN_FILENO, &readfds))
             {
-                numBytes = read(STDIN_FILENO, buffer, MAX_PACKET_SIZE - 1);
-
-                if (numBytes > 1)
-                {
-                    buffer[numBytes] = 0;
-                    handle_command(commands, (char*)buffer);
-                    fprintf(stdout, "\r\n");
-                }
-                if (g_quit == 0)
-                {
-                    fprintf(stdout, "> ");
-                    fflush(stdout);
-                }
-                else
-                {
-                    fprintf(stdout, "\r\n");
-                }
+                prv_read_command(commands);
             }
         }
     }
 
     lwm2m_close(lwm2mH);
+    if (g_loopP != NULL)
+    {
+        event_loop_t * loopP = g_loopP;
+
+        g_loopP = NULL;
+        event_loop_free(loopP);
+    }
+    if (txBatchP != NULL) connection_batch_flush(txBatchP);
     close(sock);
     connection_free(connList);
+    connection_batch_free(rxBatchP);
+    connection_batch_free(txBatchP);
 
 #ifdef MEMORY_TRACE
     if (g_quit == 1)
@@ -0,0 +1,687 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "shard.h"
+#include "connection.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/select.h>
+
+#ifdef LWM2M_WITH_POOLS
+// each shard runs its own context in its own thread, the pools of pool.c are shared and not thread-safe
+#error "The shard runtime does not support LWM2M_WITH_POOLS"
+#endif
+
+typedef enum
+{
+    PRV_OP_READ,
+    PRV_OP_WRITE,
+    PRV_OP_EXECUTE,
+    PRV_OP_OBSERVE,
+    PRV_OP_OBSERVE_CANCEL,
+    PRV_OP_FIND
+} prv_op_type_t;
+
+// shared by the operations posted to every shard by shard_find_client()
+typedef struct
+{
+    atomic_int              pending;
+    atomic_bool             found;
+    char *                  name;
+    shard_result_callback_t callback;
+    void *                  userData;
+} prv_lookup_t;
+
+typedef struct _prv_op_
+{
+    struct _prv_op_ * _Atomic   next;       // queue link
+    prv_op_type_t               type;
+    struct _shard_ *            shardP;
+    uint16_t                    internalID;
+    lwm2m_uri_t                 uri;
+    lwm2m_media_type_t          format;
+    uint8_t *                   buffer;
+    int                         length;
+    prv_lookup_t *              lookupP;
+    shard_result_callback_t     callback;
+    void *                      userData;
+} prv_op_t;
+
+// Intrusive multi-producer single-consumer queue (D. Vyukov).
+// Producers only exchange the head, the consumer owns the tail.
+typedef struct
+{
+    prv_op_t * _Atomic  head;
+    prv_op_t *          tail;
+    prv_op_t            stub;
+} prv_queue_t;
+
+typedef struct _shard_
+{
+    shard_runtime_t *    runtimeP;
+    int                  index;
+    pthread_t            thread;
+    bool                 started;
+    int                  sock;
+    int                  wakeFds[2];
+    atomic_bool          wakePending;
+    lwm2m_context_t *    lwm2mH;
+    connection_t *       connList;
+    connection_table_t   peers;
+    connection_batch_t * rxBatchP;
+    connection_batch_t * txBatchP;
+    prv_queue_t          queue;
+} shard_t;
+
+struct _shard_runtime_
+{
+    atomic_bool             quit;
+    int                     count;
+    shard_t *               shards;
+    shard_result_callback_t monitorCallback;
+    void *                  userData;
+};
+
+static void prv_queueInit(prv_queue_t * queueP)
+{
+    atomic_store(&queueP->stub.next, NULL);
+    atomic_store(&queueP->head, &queueP->stub);
+    queueP->tail = &queueP->stub;
+}
+
+static void prv_queuePush(prv_queue_t * queueP,
+                          prv_op_t * opP)
+{
+    prv_op_t * prevP;
+
+    atomic_store_explicit(&opP->next, NULL, memory_order_relaxed);
+    prevP = atomic_exchange_explicit(&queueP->head, opP, memory_order_acq_rel);
+    atomic_store_explicit(&prevP->next, opP, memory_order_release);
+}
+
+static prv_op_t * prv_queuePop(prv_queue_t * queueP)
+{
+    prv_op_t * tailP = queueP->tail;
+    prv_op_t * nextP = atomic_load_explicit(&tailP->next, memory_order_acquire);
+
+    if (tailP == &queueP->stub)
+    {
+        if (nextP == NULL) return NULL;
+        queueP->tail = nextP;
+        tailP = nextP;
+        nextP = atomic_load_explicit(&tailP->next, memory_order_acquire);
+    }
+
+    if (nextP == NULL)
+    {
+        if (tailP != atomic_load_explicit(&queueP->head, memory_order_acquire))
+        {
+            // a producer is between its exchange and its link: it will be done shortly
+            while (NULL == (nextP = atomic_load_explicit(&tailP->next, memory_order_acquire)))
+            {
+                sched_yield();
+            }
+        }
+        else
+        {
+            prv_queuePush(queueP, &queueP->stub);
+            nextP = atomic_load_explicit(&tailP->next, memory_order_acquire);
+            if (nextP == NULL) return NULL;
+        }
+    }
+
+    queueP->tail = nextP;
+    return tailP;
+}
+
+static void prv_freeOp(prv_op_t * opP)
+{
+    if (opP->buffer != NULL) lwm2m_free(opP->buffer);
+    lwm2m_free(opP);
+}
+
+static void prv_wake(shard_t * shardP)
+{
+    char c = 0;
+
+    if (!atomic_exchange(&shardP->wakePending, true))
+    {
+        // the pipe is non-blocking: if it is full, the shard is already awake
+        if (write(shardP->wakeFds[1], &c, 1) < 0) return;
+    }
+}
+
+static void prv_resultCallback(uint16_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int status,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    prv_op_t * opP = (prv_op_t *)userData;
+
+    opP->callback(SHARD_CLIENT_ID(opP->shardP->index, clientID), uriP, status, format, data, dataLength, opP->userData);
+
+    // an observe operation is freed when the core releases its observation
+    if (opP->type != PRV_OP_OBSERVE) prv_freeOp(opP);
+}
+
+static void prv_releaseCallback(uint16_t clientID,
+                                lwm2m_uri_t * uriP,
+                                lwm2m_result_callback_t callback,
+                                void * userData,
+                                void * releaseUserData)
+{
+    (void)clientID;
+    (void)uriP;
+    (void)releaseUserData;
+
+    if (callback == prv_resultCallback) prv_freeOp((prv_op_t *)userData);
+}
+
+static void prv_monitorCallback(uint16_t clientID,
+                                lwm2m_uri_t * uriP,
+                                int status,
+                                lwm2m_media_type_t format,
+                                uint8_t * data,
+                                int dataLength,
+                                void * userData)
+{
+    shard_t * shardP = (shard_t *)userData;
+
+    if (shardP->runtimeP->monitorCallback == NULL) return;
+
+    shardP->runtimeP->monitorCallback(SHARD_CLIENT_ID(shardP->index, clientID), uriP, status, format, data, dataLength, shardP->runtimeP->userData);
+}
+
+static void prv_find(shard_t * shardP,
+                     prv_op_t * opP)
+{
+    prv_lookup_t * lookupP = opP->lookupP;
+    lwm2m_client_t * clientP;
+
+    clientP = (shardP->lwm2mH != NULL) ? lwm2m_get_client_by_name(shardP->lwm2mH, lookupP->name) : NULL;
+    if (clientP != NULL)
+    {
+        atomic_store(&lookupP->found, true);
+        lookupP->callback(SHARD_CLIENT_ID(shardP->index, clientP->internalID), NULL, COAP_205_CONTENT, LWM2M_CONTENT_TEXT, NULL, 0, lookupP->userData);
+    }
+
+    // the last shard to answer releases the lookup
+    if (atomic_fetch_sub(&lookupP->pending, 1) == 1)
+    {
+        if (!atomic_load(&lookupP->found))
+        {
+            lookupP->callback(0, NULL, COAP_404_NOT_FOUND, LWM2M_CONTENT_TEXT, NULL, 0, lookupP->userData);
+        }
+        lwm2m_free(lookupP->name);
+        lwm2m_free(lookupP);
+    }
+}
+
+// Returns the observation of the client a cancel is about, matched exactly like the core does.
+static lwm2m_observation_t * prv_findObservation(shard_t * shardP,
+                                                 prv_op_t * opP)
+{
+    lwm2m_client_t * clientP;
+    lwm2m_observation_t * observationP;
+
+    clientP = lwm2m_get_client(shardP->lwm2mH, opP->internalID);
+    if (clientP == NULL) return NULL;
+
+    for (observationP = clientP->observationList ; observationP != NULL ; observationP = observationP->next)
+    {
+        if (observationP->uri.objectId == opP->uri.objectId
+         && observationP->uri.flag == opP->uri.flag
+         && observationP->uri.instanceId == opP->uri.instanceId
+         && observationP->uri.resourceId == opP->uri.resourceId)
+        {
+            return observationP;
+        }
+    }
+
+    return NULL;
+}
+
+static void prv_execute(shard_t * shardP,
+                        prv_op_t * opP)
+{
+    lwm2m_observation_t * observationP;
+    int result;
+
+    switch (opP->type)
+    {
+    case PRV_OP_READ:
+        result = lwm2m_dm_read(shardP->lwm2mH, opP->internalID, &opP->uri, prv_resultCallback, opP);
+        break;
+    case PRV_OP_WRITE:
+        result = lwm2m_dm_write(shardP->lwm2mH, opP->internalID, &opP->uri, opP->format, opP->buffer, opP->length, prv_resultCallback, opP);
+        break;
+    case PRV_OP_EXECUTE:
+        result = lwm2m_dm_execute(shardP->lwm2mH, opP->internalID, &opP->uri, opP->format, opP->buffer, opP->length, prv_resultCallback, opP);
+        break;
+    case PRV_OP_OBSERVE:
+        result = lwm2m_observe(shardP->lwm2mH, opP->internalID, &opP->uri, prv_resultCallback, opP);
+        break;
+    case PRV_OP_OBSERVE_CANCEL:
+        observationP = prv_findObservation(shardP, opP);
+        if (observationP != NULL && observationP->status == STATE_REG_PENDING)
+        {
+            // the core drops the observation once the client answers, without calling back the cancel
+            result = lwm2m_observe_cancel(shardP->lwm2mH, opP->internalID, &opP->uri, NULL, NULL);
+            if (result == 0)
+            {
+                opP->callback(SHARD_CLIENT_ID(shardP->index, opP->internalID), &opP->uri, COAP_NO_ERROR, LWM2M_CONTENT_TEXT, NULL, 0, opP->userData);
+                prv_freeOp(opP);
+                return;
+            }
+        }
+        else
+        {
+            result = lwm2m_observe_cancel(shardP->lwm2mH, opP->internalID, &opP->uri, prv_resultCallback, opP);
+        }
+        break;
+    case PRV_OP_FIND:
+    default:
+        prv_find(shardP, opP);
+        prv_freeOp(opP);
+        return;
+    }
+
+    // on -1, the request failed after calling back, which freed the operation or released the observation
+    if (result > 0)
+    {
+        opP->callback(SHARD_CLIENT_ID(shardP->index, opP->internalID), &opP->uri, result, LWM2M_CONTENT_TEXT, NULL, 0, opP->userData);
+        prv_freeOp(opP);
+    }
+}
+
+static void prv_drainQueue(shard_t * shardP)
+{
+    char buffer[64];
+    prv_op_t * opP;
+
+    while (read(shardP->wakeFds[0], buffer, sizeof(buffer)) > 0);
+    atomic_store(&shardP->wakePending, false);
+
+    while (NULL != (opP = prv_queuePop(&shardP->queue)))
+    {
+        prv_execute(shardP, opP);
+    }
+}
+
+static void * prv_shardThread(void * arg)
+{
+    shard_t * shardP = (shard_t *)arg;
+
+    while (!atomic_load(&shardP->runtimeP->quit))
+    {
+        struct timeval tv = {60, 0};
+        fd_set readfds;
+        int maxFd;
+
+        if (0 != lwm2m_step(shardP->lwm2mH, &(tv.tv_sec)))
+        {
+            tv.tv_sec = 1;
+        }
+        (void)connection_batch_flush(shardP->txBatchP);
+
+        FD_ZERO(&readfds);
+        FD_SET(shardP->sock, &readfds);
+        FD_SET(shardP->wakeFds[0], &readfds);
+        maxFd = shardP->sock > shardP->wakeFds[0] ? shardP->sock : shardP->wakeFds[0];
+
+        if (select(maxFd + 1, &readfds, NULL, NULL, &tv) < 0)
+        {
+            if (errno != EINTR)
+            {
+                fprintf(stderr, "Shard %d: error in select(): %d %s\r\n", shardP->index, errno, strerror(errno));
+            }
+            continue;
+        }
+
+        if (FD_ISSET(shardP->wakeFds[0], &readfds))
+        {
+            prv_drainQueue(shardP);
+        }
+
+        if (FD_ISSET(shardP->sock, &readfds))
+        {
+            connection_batch_t * batchP = shardP->rxBatchP;
+            int count;
+            int i;
+
+            count = connection_batch_receive(batchP, shardP->sock);
+            for (i = 0 ; i < count ; i++)
+            {
+                connection_t * connP;
+
+                connP = connection_table_find(&(shardP->peers), &(batchP->addr[i]), batchP->addrLen[i]);
+                if (connP == NULL)
+                {
+                    connP = connection_new_incoming(shardP->connList, shardP->sock, (struct sockaddr *)&(batchP->addr[i]), batchP->addrLen[i]);
+                    if (connP == NULL) continue;
+                    if (0 != connection_table_add(&(shardP->peers), connP))
+                    {
+                        free(connP);
+                        continue;
+                    }
+                    connP->txBatchP = shardP->txBatchP;
+                    shardP->connList = connP;
+                }
+                lwm2m_handle_packet(shardP->lwm2mH, batchP->buffer[i], batchP->length[i], connP);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int prv_shardInit(shard_runtime_t * runtimeP,
+                         shard_t * shardP,
+                         const char * portStr,
+                         int addressFamily)
+{
+    shardP->runtimeP = runtimeP;
+    shardP->sock = -1;
+    shardP->wakeFds[0] = -1;
+    shardP->wakeFds[1] = -1;
+    atomic_store(&shardP->wakePending, false);
+    prv_queueInit(&shardP->queue);
+
+    shardP->sock = create_reuseport_socket(portStr, addressFamily);
+    if (shardP->sock < 0) return -1;
+
+    shardP->rxBatchP = connection_batch_new();
+    shardP->txBatchP = connection_batch_new();
+    if (shardP->rxBatchP == NULL
+     || shardP->txBatchP == NULL
+     || 0 != connection_table_init(&(shardP->peers)))
+    {
+        return -1;
+    }
+
+    if (pipe(shardP->wakeFds) != 0) return -1;
+    fcntl(shardP->wakeFds[0], F_SETFL, O_NONBLOCK);
+    fcntl(shardP->wakeFds[1], F_SETFL, O_NONBLOCK);
+
+    shardP->lwm2mH = lwm2m_init(NULL);
+    if (shardP->lwm2mH == NULL) return -1;
+    lwm2m_set_monitoring_callback(shardP->lwm2mH, prv_monitorCallback, shardP);
+    lwm2m_set_observe_release_callback(shardP->lwm2mH, prv_releaseCallback, NULL);
+
+    if (0 != pthread_create(&shardP->thread, NULL, prv_shardThread, shardP)) return -1;
+    shardP->started = true;
+
+    return 0;
+}
+
+static void prv_shardClose(shard_t * shardP)
+{
+    prv_op_t * opP;
+
+    if (shardP->started)
+    {
+        pthread_join(shardP->thread, NULL);
+    }
+
+    // operations queued after the thread stopped are dropped
+    while (NULL != (opP = prv_queuePop(&shardP->queue)))
+    {
+        if (opP->type == PRV_OP_FIND)
+        {
+            prv_find(shardP, opP);
+        }
+        prv_freeOp(opP);
+    }
+
+    // releases the observations, and their operations, left
+    if (shardP->lwm2mH != NULL) lwm2m_close(shardP->lwm2mH);
+    if (shardP->txBatchP != NULL) (void)connection_batch_flush(shardP->txBatchP);
+    connection_free(shardP->connList);
+    connection_table_close(&(shardP->peers));
+    connection_batch_free(shardP->rxBatchP);
+    connection_batch_free(shardP->txBatchP);
+    if (shardP->sock >= 0) close(shardP->sock);
+    if (shardP->wakeFds[0] >= 0) close(shardP->wakeFds[0]);
+    if (shardP->wakeFds[1] >= 0) close(shardP->wakeFds[1]);
+}
+
+shard_runtime_t * shard_runtime_start(const char * portStr,
+                                      int addressFamily,
+                                      int shardCount,
+                                      shard_result_callback_t monitorCallback,
+                                      void * userData)
+{
+    shard_runtime_t * runtimeP;
+    int i;
+
+    if (shardCount < 1 || shardCount > SHARD_MAX_COUNT) return NULL;
+
+    runtimeP = (shard_runtime_t *)lwm2m_malloc(sizeof(shard_runtime_t));
+    if (runtimeP == NULL) return NULL;
+    memset(runtimeP, 0, sizeof(shard_runtime_t));
+    runtimeP->shards = (shard_t *)lwm2m_malloc(shardCount * sizeof(shard_t));
+    if (runtimeP->shards == NULL)
+    {
+        lwm2m_free(runtimeP);
+        return NULL;
+    }
+    memset(runtimeP->shards, 0, shardCount * sizeof(shard_t));
+    atomic_store(&runtimeP->quit, false);
+    runtimeP->monitorCallback = monitorCallback;
+    runtimeP->userData = userData;
+
+    for (i = 0 ; i < shardCount ; i++)
+    {
+        runtimeP->shards[i].index = i;
+        runtimeP->count++;
+        if (0 != prv_shardInit(runtimeP, runtimeP->shards + i, portStr, addressFamily))
+        {
+            shard_runtime_stop(runtimeP);
+            return NULL;
+        }
+    }
+
+    return runtimeP;
+}
+
+void shard_runtime_stop(shard_runtime_t * runtimeP)
+{
+    int i;
+
+    atomic_store(&runtimeP->quit, true);
+    for (i = 0 ; i < runtimeP->count ; i++)
+    {
+        if (runtimeP->shards[i].wakeFds[1] >= 0) prv_wake(runtimeP->shards + i);
+    }
+    for (i = 0 ; i < runtimeP->count ; i++)
+    {
+        prv_shardClose(runtimeP->shards + i);
+    }
+
+    lwm2m_free(runtimeP->shards);
+    lwm2m_free(runtimeP);
+}
+
+int shard_runtime_count(shard_runtime_t * runtimeP)
+{
+    return runtimeP->count;
+}
+
+lwm2m_client_t * shard_get_client(shard_runtime_t * runtimeP,
+                                  uint32_t clientID)
+{
+    if (SHARD_INDEX(clientID) >= runtimeP->count) return NULL;
+
+    return lwm2m_get_client(runtimeP->shards[SHARD_INDEX(clientID)].lwm2mH, SHARD_INTERNAL_ID(clientID));
+}
+
+static int prv_post(shard_runtime_t * runtimeP,
+                    prv_op_type_t type,
+                    uint32_t clientID,
+                    lwm2m_uri_t * uriP,
+                    lwm2m_media_type_t format,
+                    uint8_t * buffer,
+                    int length,
+                    shard_result_callback_t callback,
+                    void * userData)
+{
+    shard_t * shardP;
+    prv_op_t * opP;
+
+    if (SHARD_INDEX(clientID) >= runtimeP->count) return COAP_404_NOT_FOUND;
+    if (callback == NULL) return COAP_400_BAD_REQUEST;
+    shardP = runtimeP->shards + SHARD_INDEX(clientID);
+
+    opP = (prv_op_t *)lwm2m_malloc(sizeof(prv_op_t));
+    if (opP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+    memset(opP, 0, sizeof(prv_op_t));
+
+    if (length > 0)
+    {
+        // the caller's buffer may be gone by the time the shard runs the operation
+        opP->buffer = (uint8_t *)lwm2m_malloc(length);
+        if (opP->buffer == NULL)
+        {
+            lwm2m_free(opP);
+            return COAP_500_INTERNAL_SERVER_ERROR;
+        }
+        memcpy(opP->buffer, buffer, length);
+        opP->length = length;
+    }
+    opP->type = type;
+    opP->shardP = shardP;
+    opP->internalID = SHARD_INTERNAL_ID(clientID);
+    opP->uri = *uriP;
+    opP->format = format;
+    opP->callback = callback;
+    opP->userData = userData;
+
+    prv_queuePush(&shardP->queue, opP);
+    prv_wake(shardP);
+
+    return 0;
+}
+
+int shard_dm_read(shard_runtime_t * runtimeP,
+                  uint32_t clientID,
+                  lwm2m_uri_t * uriP,
+                  shard_result_callback_t callback,
+                  void * userData)
+{
+    return prv_post(runtimeP, PRV_OP_READ, clientID, uriP, LWM2M_CONTENT_TEXT, NULL, 0, callback, userData);
+}
+
+int shard_dm_write(shard_runtime_t * runtimeP,
+                   uint32_t clientID,
+                   lwm2m_uri_t * uriP,
+                   lwm2m_media_type_t format,
+                   uint8_t * buffer,
+                   int length,
+                   shard_result_callback_t callback,
+                   void * userData)
+{
+    return prv_post(runtimeP, PRV_OP_WRITE, clientID, uriP, format, buffer, length, callback, userData);
+}
+
+int shard_dm_execute(shard_runtime_t * runtimeP,
+                     uint32_t clientID,
+                     lwm2m_uri_t * uriP,
+                     lwm2m_media_type_t format,
+                     uint8_t * buffer,
+                     int length,
+                     shard_result_callback_t callback,
+                     void * userData)
+{
+    return prv_post(runtimeP, PRV_OP_EXECUTE, clientID, uriP, format, buffer, length, callback, userData);
+}
+
+int shard_observe(shard_runtime_t * runtimeP,
+                  uint32_t clientID,
+                  lwm2m_uri_t * uriP,
+                  shard_result_callback_t callback,
+                  void * userData)
+{
+    return prv_post(runtimeP, PRV_OP_OBSERVE, clientID, uriP, LWM2M_CONTENT_TEXT, NULL, 0, callback, userData);
+}
+
+int shard_observe_cancel(shard_runtime_t * runtimeP,
+                         uint32_t clientID,
+                         lwm2m_uri_t * uriP,
+                         shard_result_callback_t callback,
+                         void * userData)
+{
+    return prv_post(runtimeP, PRV_OP_OBSERVE_CANCEL, clientID, uriP, LWM2M_CONTENT_TEXT, NULL, 0, callback, userData);
+}
+
+int shard_find_client(shard_runtime_t * runtimeP,
+                      const char * name,
+                      shard_result_callback_t callback,
+                      void * userData)
+{
+    prv_lookup_t * lookupP;
+    prv_op_t * opList[SHARD_MAX_COUNT];
+    int i;
+
+    if (name == NULL || callback == NULL) return COAP_400_BAD_REQUEST;
+
+    lookupP = (prv_lookup_t *)lwm2m_malloc(sizeof(prv_lookup_t));
+    if (lookupP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+    lookupP->name = lwm2m_strdup(name);
+    if (lookupP->name == NULL)
+    {
+        lwm2m_free(lookupP);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    atomic_store(&lookupP->pending, runtimeP->count);
+    atomic_store(&lookupP->found, false);
+    lookupP->callback = callback;
+    lookupP->userData = userData;
+
+    // allocate everything first so that a failure leaves no shard with a dangling lookup
+    for (i = 0 ; i < runtimeP->count ; i++)
+    {
+        opList[i] = (prv_op_t *)lwm2m_malloc(sizeof(prv_op_t));
+        if (opList[i] == NULL)
+        {
+            while (i-- > 0) lwm2m_free(opList[i]);
+            lwm2m_free(lookupP->name);
+            lwm2m_free(lookupP);
+            return COAP_500_INTERNAL_SERVER_ERROR;
+        }
+        memset(opList[i], 0, sizeof(prv_op_t));
+        opList[i]->type = PRV_OP_FIND;
+        opList[i]->shardP = runtimeP->shards + i;
+        opList[i]->lookupP = lookupP;
+    }
+
+    for (i = 0 ; i < runtimeP->count ; i++)
+    {
+        prv_queuePush(&runtimeP->shards[i].queue, opList[i]);
+        prv_wake(runtimeP->shards + i);
+    }
+
+    return 0;
+}
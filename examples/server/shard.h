@@ -0,0 +1,69 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * Multi-threaded LWM2M Server runtime.
+ *
+ * The runtime runs one lwm2m_context_t per worker thread ("shard"). Every
+ * shard owns an UDP socket bound with SO_REUSEPORT to the same port so the
+ * kernel spreads the clients over the shards by source address. A client
+ * only ever talks to the shard it registered on.
+ *
+ * Clients are identified outside the runtime by a 32-bit ID combining the
+ * shard index and the internal ID of the client in the shard's context.
+ * Management operations can be issued from any thread: they are pushed on a
+ * lock-free queue of the owning shard and executed by its worker thread.
+ * Callbacks are always called from the worker thread of the shard.
+ */
+
+#ifndef SHARD_H_
+#define SHARD_H_
+
+#include "liblwm2m.h"
+
+#define SHARD_MAX_COUNT     64
+
+#define SHARD_CLIENT_ID(S, I)       (((uint32_t)(S) << 16) | (uint16_t)(I))
+#define SHARD_INDEX(C)              ((int)((C) >> 16))
+#define SHARD_INTERNAL_ID(C)        ((uint16_t)((C) & 0xFFFF))
+
+typedef struct _shard_runtime_ shard_runtime_t;
+
+// clientID is the runtime-wide ID built with SHARD_CLIENT_ID().
+typedef void (*shard_result_callback_t) (uint32_t clientID, lwm2m_uri_t * uriP, int status, lwm2m_media_type_t format, uint8_t * data, int dataLength, void * userData);
+
+// Starts shardCount worker threads listening on portStr. monitorCallback is called on registration events.
+shard_runtime_t * shard_runtime_start(const char * portStr, int addressFamily, int shardCount, shard_result_callback_t monitorCallback, void * userData);
+void shard_runtime_stop(shard_runtime_t * runtimeP);
+int shard_runtime_count(shard_runtime_t * runtimeP);
+// Only safe from a callback called by the shard owning the client.
+lwm2m_client_t * shard_get_client(shard_runtime_t * runtimeP, uint32_t clientID);
+
+// Management operations. They return 0 if the operation was queued to the owning shard, or a COAP_* error code.
+// The result (or the error returned by the core on the shard) is reported through the callback.
+int shard_dm_read(shard_runtime_t * runtimeP, uint32_t clientID, lwm2m_uri_t * uriP, shard_result_callback_t callback, void * userData);
+int shard_dm_write(shard_runtime_t * runtimeP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, shard_result_callback_t callback, void * userData);
+int shard_dm_execute(shard_runtime_t * runtimeP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, shard_result_callback_t callback, void * userData);
+int shard_observe(shard_runtime_t * runtimeP, uint32_t clientID, lwm2m_uri_t * uriP, shard_result_callback_t callback, void * userData);
+int shard_observe_cancel(shard_runtime_t * runtimeP, uint32_t clientID, lwm2m_uri_t * uriP, shard_result_callback_t callback, void * userData);
+
+// Cross-shard lookup of a client by endpoint name. Every shard is queried, the callback is called
+// (with a NULL uriP) once with COAP_205_CONTENT and the client ID by the owning shard, or once with COAP_404_NOT_FOUND
+// if no shard knows the client.
+int shard_find_client(shard_runtime_t * runtimeP, const char * name, shard_result_callback_t callback, void * userData);
+
+#endif
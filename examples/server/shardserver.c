@@ -0,0 +1,381 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * LWM2M Server running one context per thread on top of the shard runtime.
+ * Commands are read on stdin and posted to the shard owning the client.
+ */
+
+#include "liblwm2m.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <signal.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#include "commandline.h"
+#include "connection.h"
+#include "shard.h"
+
+#define MAX_COMMAND_SIZE 1024
+
+static int g_quit = 0;
+static shard_runtime_t * g_runtime = NULL;
+
+// callbacks are called concurrently from the shard threads
+static pthread_mutex_t g_outputMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void prv_print_uri(lwm2m_uri_t * uriP)
+{
+    fprintf(stdout, "/%d", uriP->objectId);
+    if (LWM2M_URI_IS_SET_INSTANCE(uriP))
+        fprintf(stdout, "/%d", uriP->instanceId);
+    else if (LWM2M_URI_IS_SET_RESOURCE(uriP))
+        fprintf(stdout, "/");
+    if (LWM2M_URI_IS_SET_RESOURCE(uriP))
+        fprintf(stdout, "/%d", uriP->resourceId);
+}
+
+static void prv_result_callback(uint32_t clientID,
+                                lwm2m_uri_t * uriP,
+                                int status,
+                                lwm2m_media_type_t format,
+                                uint8_t * data,
+                                int dataLength,
+                                void * userData)
+{
+    (void)userData;
+
+    pthread_mutex_lock(&g_outputMutex);
+
+    fprintf(stdout, "\r\nClient #%" PRIu32 " (shard %d) ", clientID, SHARD_INDEX(clientID));
+    if (uriP != NULL) prv_print_uri(uriP);
+    fprintf(stdout, " : ");
+    print_status(stdout, status);
+    fprintf(stdout, "\r\n");
+
+    output_data(stdout, format, data, dataLength, 1);
+
+    fprintf(stdout, "\r\n> ");
+    fflush(stdout);
+
+    pthread_mutex_unlock(&g_outputMutex);
+}
+
+static void prv_monitor_callback(uint32_t clientID,
+                                 lwm2m_uri_t * uriP,
+                                 int status,
+                                 lwm2m_media_type_t format,
+                                 uint8_t * data,
+                                 int dataLength,
+                                 void * userData)
+{
+    lwm2m_client_t * targetP;
+
+    (void)uriP;
+    (void)format;
+    (void)data;
+    (void)dataLength;
+    (void)userData;
+
+    pthread_mutex_lock(&g_outputMutex);
+
+    switch (status)
+    {
+    case COAP_201_CREATED:
+    case COAP_204_CHANGED:
+        // the client can be accessed here since we run on its shard
+        targetP = shard_get_client(g_runtime, clientID);
+        fprintf(stdout, "\r\nClient #%" PRIu32 " %s on shard %d: \"%s\"\r\n",
+                clientID, status == COAP_201_CREATED ? "registered" : "updated",
+                SHARD_INDEX(clientID), targetP != NULL ? targetP->name : "");
+        break;
+
+    case COAP_202_DELETED:
+        fprintf(stdout, "\r\nClient #%" PRIu32 " unregistered.\r\n", clientID);
+        break;
+
+    default:
+        fprintf(stdout, "\r\nMonitor callback called with an unknown status: %d.\r\n", status);
+        break;
+    }
+
+    fprintf(stdout, "\r\n> ");
+    fflush(stdout);
+
+    pthread_mutex_unlock(&g_outputMutex);
+}
+
+static int prv_read_args(char * buffer,
+                         uint32_t * clientIdP,
+                         lwm2m_uri_t * uriP)
+{
+    char * end = NULL;
+    unsigned long value;
+
+    if (1 != sscanf(buffer, "%lu", &value)) return 0;
+    *clientIdP = (uint32_t)value;
+
+    buffer = get_next_arg(buffer, &end);
+    if (buffer[0] == 0) return 0;
+
+    if (0 == lwm2m_stringToUri(buffer, end - buffer, uriP)) return 0;
+
+    return check_end_of_args(end);
+}
+
+static void prv_print_result(int result)
+{
+    if (result == 0)
+    {
+        fprintf(stdout, "OK");
+    }
+    else
+    {
+        fprintf(stdout, "Error: ");
+        print_status(stdout, result);
+    }
+}
+
+static void prv_find(char * buffer,
+                     void * user_data)
+{
+    char * end = NULL;
+
+    (void)user_data;
+
+    end = get_end_of_arg(buffer);
+    if (end == buffer) goto syntax_error;
+    *end = 0;
+
+    prv_print_result(shard_find_client(g_runtime, buffer, prv_result_callback, NULL));
+    return;
+
+syntax_error:
+    fprintf(stdout, "Syntax error !");
+}
+
+static void prv_read_client(char * buffer,
+                            void * user_data)
+{
+    uint32_t clientId;
+    lwm2m_uri_t uri;
+
+    (void)user_data;
+
+    if (!prv_read_args(buffer, &clientId, &uri)) goto syntax_error;
+
+    prv_print_result(shard_dm_read(g_runtime, clientId, &uri, prv_result_callback, NULL));
+    return;
+
+syntax_error:
+    fprintf(stdout, "Syntax error !");
+}
+
+static void prv_observe_client(char * buffer,
+                               void * user_data)
+{
+    uint32_t clientId;
+    lwm2m_uri_t uri;
+
+    (void)user_data;
+
+    if (!prv_read_args(buffer, &clientId, &uri)) goto syntax_error;
+
+    prv_print_result(shard_observe(g_runtime, clientId, &uri, prv_result_callback, NULL));
+    return;
+
+syntax_error:
+    fprintf(stdout, "Syntax error !");
+}
+
+static void prv_cancel_client(char * buffer,
+                              void * user_data)
+{
+    uint32_t clientId;
+    lwm2m_uri_t uri;
+
+    (void)user_data;
+
+    if (!prv_read_args(buffer, &clientId, &uri)) goto syntax_error;
+
+    prv_print_result(shard_observe_cancel(g_runtime, clientId, &uri, prv_result_callback, NULL));
+    return;
+
+syntax_error:
+    fprintf(stdout, "Syntax error !");
+}
+
+static void prv_quit(char * buffer,
+                     void * user_data)
+{
+    (void)buffer;
+    (void)user_data;
+
+    g_quit = 1;
+}
+
+void handle_sigint(int signum)
+{
+    (void)signum;
+
+    g_quit = 2;
+}
+
+void print_usage(void)
+{
+    fprintf(stderr, "Usage: lwm2mshardserver [OPTION]\r\n");
+    fprintf(stderr, "Launch a multi-threaded LWM2M server on localhost.\r\n\n");
+    fprintf(stdout, "Options:\r\n");
+    fprintf(stdout, "  -4\t\tUse IPv4 connection. Default: IPv6 connection\r\n");
+    fprintf(stdout, "  -l PORT\tSet the local UDP port of the Server. Default: "LWM2M_STANDARD_PORT_STR"\r\n");
+    fprintf(stdout, "  -t COUNT\tSet the number of worker threads. Default: number of online CPUs\r\n");
+    fprintf(stdout, "\r\n");
+}
+
+int main(int argc, char *argv[])
+{
+    fd_set readfds;
+    int result;
+    const char * localPort = LWM2M_STANDARD_PORT_STR;
+    int addressFamily = AF_INET6;
+    int shardCount;
+    int opt;
+
+    command_desc_t commands[] =
+    {
+            {"find", "Find on which shard a client is registered.", " find ENDPOINT\r\n"
+                                            "   ENDPOINT: endpoint name of the client\r\n"
+                                            "Result will be displayed asynchronously.", prv_find, NULL},
+            {"read", "Read from a client.", " read CLIENT# URI\r\n"
+                                            "   CLIENT#: client number as displayed on registration or by command 'find'\r\n"
+                                            "   URI: uri to read such as /3, /3/0/2, /1024/11, /1024/0/1\r\n"
+                                            "Result will be displayed asynchronously.", prv_read_client, NULL},
+            {"observe", "Observe from a client.", " observe CLIENT# URI\r\n"
+                                            "   CLIENT#: client number as displayed on registration or by command 'find'\r\n"
+                                            "   URI: uri to observe such as /3, /3/0/2, /1024/11\r\n"
+                                            "Result will be displayed asynchronously.", prv_observe_client, NULL},
+            {"cancel", "Cancel an observe.", " cancel CLIENT# URI\r\n"
+                                            "   CLIENT#: client number as displayed on registration or by command 'find'\r\n"
+                                            "   URI: uri on which to cancel an observe such as /3, /3/0/2, /1024/11\r\n"
+                                            "Result will be displayed asynchronously.", prv_cancel_client, NULL},
+
+            {"q", "Quit the server.", NULL, prv_quit, NULL},
+
+            COMMAND_END_LIST
+    };
+
+    shardCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (shardCount < 1) shardCount = 1;
+    if (shardCount > SHARD_MAX_COUNT) shardCount = SHARD_MAX_COUNT;
+
+    opt = 1;
+    while (opt < argc)
+    {
+        if (argv[opt] == NULL
+            || argv[opt][0] != '-'
+            || argv[opt][2] != 0)
+        {
+            print_usage();
+            return 0;
+        }
+        switch (argv[opt][1])
+        {
+        case '4':
+            addressFamily = AF_INET;
+            break;
+        case 'l':
+            opt++;
+            if (opt >= argc)
+            {
+                print_usage();
+                return 0;
+            }
+            localPort = argv[opt];
+            break;
+        case 't':
+            opt++;
+            if (opt >= argc
+             || 1 != sscanf(argv[opt], "%d", &shardCount)
+             || shardCount < 1
+             || shardCount > SHARD_MAX_COUNT)
+            {
+                print_usage();
+                return 0;
+            }
+            break;
+        default:
+            print_usage();
+            return 0;
+        }
+        opt += 1;
+    }
+
+    g_runtime = shard_runtime_start(localPort, addressFamily, shardCount, prv_monitor_callback, NULL);
+    if (g_runtime == NULL)
+    {
+        fprintf(stderr, "Failed to start %d shards on port %s: %d\r\n", shardCount, localPort, errno);
+        return -1;
+    }
+
+    signal(SIGINT, handle_sigint);
+
+    fprintf(stdout, "%d shards listening on port %s\r\n> ", shardCount, localPort);
+    fflush(stdout);
+
+    while (0 == g_quit)
+    {
+        char buffer[MAX_COMMAND_SIZE];
+        int numBytes;
+
+        FD_ZERO(&readfds);
+        FD_SET(STDIN_FILENO, &readfds);
+
+        result = select(STDIN_FILENO + 1, &readfds, NULL, NULL, NULL);
+        if (result < 0)
+        {
+            if (errno != EINTR)
+            {
+                fprintf(stderr, "Error in select(): %d\r\n", errno);
+            }
+            continue;
+        }
+
+        numBytes = read(STDIN_FILENO, buffer, MAX_COMMAND_SIZE - 1);
+        if (numBytes == 0) break;
+        if (numBytes > 1)
+        {
+            buffer[numBytes] = 0;
+            pthread_mutex_lock(&g_outputMutex);
+            handle_command(commands, buffer);
+            fprintf(stdout, "\r\n");
+            if (g_quit == 0) fprintf(stdout, "> ");
+            fflush(stdout);
+            pthread_mutex_unlock(&g_outputMutex);
+        }
+    }
+
+    shard_runtime_stop(g_runtime);
+
+    return 0;
+}
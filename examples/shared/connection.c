@@ -16,15 +16,23 @@
  *    
  *******************************************************************************/
 
+#ifdef __linux__
+// for recvmmsg() and sendmmsg()
+#define _GNU_SOURCE
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 #include "connection.h"
 
 // from commandline.c
 void output_buffer(FILE * stream, uint8_t * buffer, int length, int indent);
 
-int create_socket(const char * portStr, int addressFamily)
+static int prv_createSocket(const char * portStr,
+                            int addressFamily,
+                            bool reusePort)
 {
     int s = -1;
     struct addrinfo hints;
@@ -44,6 +52,17 @@ int create_socket(const char * portStr, int addressFamily)
     for(p = res ; p != NULL && s == -1 ; p = p->ai_next)
     {
         s = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        if (s >= 0 && reusePort)
+        {
+            int on = 1;
+
+            if (-1 == setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)))
+            {
+                close(s);
+                s = -1;
+                continue;
+            }
+        }
         if (s >= 0)
         {
             if (-1 == bind(s, p->ai_addr, p->ai_addrlen))
@@ -59,6 +78,16 @@ int create_socket(const char * portStr, int addressFamily)
     return s;
 }
 
+int create_socket(const char * portStr, int addressFamily)
+{
+    return prv_createSocket(portStr, addressFamily, false);
+}
+
+int create_reuseport_socket(const char * portStr, int addressFamily)
+{
+    return prv_createSocket(portStr, addressFamily, true);
+}
+
 connection_t * connection_find(connection_t * connList,
                                struct sockaddr_storage * addr,
                                size_t addrLen)
@@ -92,6 +121,8 @@ connection_t * connection_new_incoming(connection_t * connList,
         connP->sock = sock;
         memcpy(&(connP->addr), addr, addrLen);
         connP->addrLen = addrLen;
+        connP->txBatchP = NULL;
+        connP->hashNext = NULL;
         connP->next = connList;
     }
 
@@ -159,6 +190,320 @@ void connection_free(connection_t * connList)
     }
 }
 
+#define PRV_TABLE_INITIAL_SIZE  64
+
+// FNV-1a over the raw address, consistent with the memcmp() of connection_find()
+static size_t prv_hashAddress(const void * addr,
+                              size_t addrLen)
+{
+    const uint8_t * bytes = (const uint8_t *)addr;
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0 ; i < addrLen ; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static int prv_tableResize(connection_table_t * tableP,
+                           size_t size)
+{
+    connection_t ** buckets;
+    size_t i;
+
+    buckets = (connection_t **)calloc(size, sizeof(connection_t *));
+    if (buckets == NULL) return -1;
+
+    for (i = 0 ; i < tableP->size ; i++)
+    {
+        while (tableP->buckets[i] != NULL)
+        {
+            connection_t * connP = tableP->buckets[i];
+            size_t index;
+
+            tableP->buckets[i] = connP->hashNext;
+            index = prv_hashAddress(&(connP->addr), connP->addrLen) & (size - 1);
+            connP->hashNext = buckets[index];
+            buckets[index] = connP;
+        }
+    }
+    free(tableP->buckets);
+    tableP->buckets = buckets;
+    tableP->size = size;
+
+    return 0;
+}
+
+int connection_table_init(connection_table_t * tableP)
+{
+    tableP->count = 0;
+    tableP->size = 0;
+    tableP->buckets = NULL;
+
+    return prv_tableResize(tableP, PRV_TABLE_INITIAL_SIZE);
+}
+
+void connection_table_close(connection_table_t * tableP)
+{
+    free(tableP->buckets);
+    tableP->buckets = NULL;
+    tableP->size = 0;
+    tableP->count = 0;
+}
+
+connection_t * connection_table_find(connection_table_t * tableP,
+                                     struct sockaddr_storage * addr,
+                                     size_t addrLen)
+{
+    connection_t * connP;
+
+    connP = tableP->buckets[prv_hashAddress(addr, addrLen) & (tableP->size - 1)];
+    while (connP != NULL)
+    {
+        if ((connP->addrLen == addrLen)
+         && (memcmp(&(connP->addr), addr, addrLen) == 0))
+        {
+            return connP;
+        }
+        connP = connP->hashNext;
+    }
+
+    return NULL;
+}
+
+int connection_table_add(connection_table_t * tableP,
+                         connection_t * connP)
+{
+    size_t index;
+
+    // keep the load factor under 1
+    if (tableP->count >= tableP->size)
+    {
+        if (0 != prv_tableResize(tableP, tableP->size * 2)) return -1;
+    }
+
+    index = prv_hashAddress(&(connP->addr), connP->addrLen) & (tableP->size - 1);
+    connP->hashNext = tableP->buckets[index];
+    tableP->buckets[index] = connP;
+    tableP->count++;
+
+    return 0;
+}
+
+void connection_table_remove(connection_table_t * tableP,
+                             connection_t * connP)
+{
+    connection_t ** linkP;
+
+    linkP = &(tableP->buckets[prv_hashAddress(&(connP->addr), connP->addrLen) & (tableP->size - 1)]);
+    while (*linkP != NULL)
+    {
+        if (*linkP == connP)
+        {
+            *linkP = connP->hashNext;
+            connP->hashNext = NULL;
+            tableP->count--;
+            return;
+        }
+        linkP = &((*linkP)->hashNext);
+    }
+}
+
+connection_batch_t * connection_batch_new(void)
+{
+    connection_batch_t * batchP;
+
+    batchP = (connection_batch_t *)malloc(sizeof(connection_batch_t));
+    if (batchP != NULL)
+    {
+        batchP->count = 0;
+    }
+
+    return batchP;
+}
+
+void connection_batch_free(connection_batch_t * batchP)
+{
+    free(batchP);
+}
+
+int connection_batch_receive(connection_batch_t * batchP,
+                             int sock)
+{
+    int numMsg;
+#ifdef __linux__
+    struct mmsghdr msg[CONNECTION_BATCH_SIZE];
+    struct iovec iov[CONNECTION_BATCH_SIZE];
+    int count;
+    int i;
+
+    memset(msg, 0, sizeof(msg));
+    for (i = 0 ; i < CONNECTION_BATCH_SIZE ; i++)
+    {
+        iov[i].iov_base = batchP->buffer[i];
+        iov[i].iov_len = CONNECTION_BATCH_PACKET_SIZE;
+        msg[i].msg_hdr.msg_name = &(batchP->addr[i]);
+        msg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        msg[i].msg_hdr.msg_iov = &(iov[i]);
+        msg[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    do
+    {
+        numMsg = recvmmsg(sock, msg, CONNECTION_BATCH_SIZE, MSG_DONTWAIT, NULL);
+    } while (numMsg == -1 && errno == EINTR);
+
+    batchP->count = 0;
+    if (numMsg == -1)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+
+    count = 0;
+    for (i = 0 ; i < numMsg ; i++)
+    {
+        // a datagram larger than the buffer cannot be parsed, drop it
+        if (msg[i].msg_hdr.msg_flags & MSG_TRUNC)
+        {
+            fprintf(stderr, "Dropping a datagram larger than %d bytes\r\n", CONNECTION_BATCH_PACKET_SIZE);
+            continue;
+        }
+        if (count != i)
+        {
+            memcpy(batchP->buffer[count], batchP->buffer[i], msg[i].msg_len);
+            memcpy(&(batchP->addr[count]), &(batchP->addr[i]), msg[i].msg_hdr.msg_namelen);
+        }
+        batchP->sock[count] = sock;
+        batchP->addrLen[count] = msg[i].msg_hdr.msg_namelen;
+        batchP->length[count] = msg[i].msg_len;
+        count++;
+    }
+    numMsg = count;
+#else
+    // one recvmsg() per datagram until the socket is drained
+    batchP->count = 0;
+    numMsg = 0;
+    while (numMsg < CONNECTION_BATCH_SIZE)
+    {
+        struct msghdr msg;
+        struct iovec iov;
+        ssize_t numBytes;
+
+        memset(&msg, 0, sizeof(msg));
+        iov.iov_base = batchP->buffer[numMsg];
+        iov.iov_len = CONNECTION_BATCH_PACKET_SIZE;
+        msg.msg_name = &(batchP->addr[numMsg]);
+        msg.msg_namelen = sizeof(struct sockaddr_storage);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        numBytes = recvmsg(sock, &msg, MSG_DONTWAIT);
+        if (numBytes == -1)
+        {
+            if (errno == EINTR) continue;
+            if (numMsg == 0 && errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+            break;
+        }
+        // a datagram larger than the buffer cannot be parsed, drop it
+        if (msg.msg_flags & MSG_TRUNC)
+        {
+            fprintf(stderr, "Dropping a datagram larger than %d bytes\r\n", CONNECTION_BATCH_PACKET_SIZE);
+            continue;
+        }
+        batchP->sock[numMsg] = sock;
+        batchP->addrLen[numMsg] = msg.msg_namelen;
+        batchP->length[numMsg] = numBytes;
+        numMsg++;
+    }
+#endif
+    batchP->count = numMsg;
+
+    return numMsg;
+}
+
+int connection_batch_flush(connection_batch_t * batchP)
+{
+    int result = 0;
+    int first;
+
+    first = 0;
+    while (first < batchP->count)
+    {
+#ifdef __linux__
+        struct mmsghdr msg[CONNECTION_BATCH_SIZE];
+        struct iovec iov[CONNECTION_BATCH_SIZE];
+        int last;
+        int numSent;
+        int i;
+
+        // sendmmsg() works on a single socket
+        last = first + 1;
+        while (last < batchP->count && batchP->sock[last] == batchP->sock[first])
+        {
+            last++;
+        }
+
+        memset(msg, 0, (last - first) * sizeof(struct mmsghdr));
+        for (i = 0 ; i < last - first ; i++)
+        {
+            iov[i].iov_base = batchP->buffer[first + i];
+            iov[i].iov_len = batchP->length[first + i];
+            msg[i].msg_hdr.msg_name = &(batchP->addr[first + i]);
+            msg[i].msg_hdr.msg_namelen = batchP->addrLen[first + i];
+            msg[i].msg_hdr.msg_iov = &(iov[i]);
+            msg[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        numSent = sendmmsg(batchP->sock[first], msg, last - first, 0);
+        if (numSent == -1)
+        {
+            if (errno == EINTR) continue;
+            // the first datagram failed, drop it and go on with the others
+            result = -1;
+            first++;
+        }
+        else
+        {
+            first += numSent;
+        }
+#else
+        if (-1 == sendto(batchP->sock[first], batchP->buffer[first], batchP->length[first], 0,
+                         (struct sockaddr *)&(batchP->addr[first]), batchP->addrLen[first]))
+        {
+            result = -1;
+        }
+        first++;
+#endif
+    }
+    batchP->count = 0;
+
+    return result;
+}
+
+static void prv_batchQueue(connection_batch_t * batchP,
+                           connection_t * connP,
+                           uint8_t * buffer,
+                           size_t length)
+{
+    int index;
+
+    if (batchP->count == CONNECTION_BATCH_SIZE)
+    {
+        (void)connection_batch_flush(batchP);
+    }
+
+    index = batchP->count;
+    batchP->sock[index] = connP->sock;
+    memcpy(&(batchP->addr[index]), &(connP->addr), connP->addrLen);
+    batchP->addrLen[index] = connP->addrLen;
+    memcpy(batchP->buffer[index], buffer, length);
+    batchP->length[index] = length;
+    batchP->count++;
+}
+
 int connection_send(connection_t *connP,
                     uint8_t * buffer,
                     size_t length)
@@ -190,6 +535,18 @@ int connection_send(connection_t *connP,
     output_buffer(stderr, buffer, length, 0);
 #endif
 
+    if (connP->txBatchP != NULL
+     && length <= CONNECTION_BATCH_PACKET_SIZE)
+    {
+        prv_batchQueue(connP->txBatchP, connP, buffer, length);
+        return 0;
+    }
+    if (connP->txBatchP != NULL)
+    {
+        // too large to be queued, the queued datagrams go first
+        (void)connection_batch_flush(connP->txBatchP);
+    }
+
     offset = 0;
     while (offset != length)
     {
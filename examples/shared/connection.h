@@ -34,15 +34,42 @@
 #define LWM2M_BSSERVER_PORT_STR "5685"
 #define LWM2M_BSSERVER_PORT      5685
 
+#define CONNECTION_BATCH_SIZE           32
+#define CONNECTION_BATCH_PACKET_SIZE    1024
+
+// Datagrams exchanged with a single recvmmsg() or sendmmsg() call.
+typedef struct
+{
+    int                     count;
+    int                     sock[CONNECTION_BATCH_SIZE];
+    struct sockaddr_storage addr[CONNECTION_BATCH_SIZE];
+    socklen_t               addrLen[CONNECTION_BATCH_SIZE];
+    size_t                  length[CONNECTION_BATCH_SIZE];
+    uint8_t                 buffer[CONNECTION_BATCH_SIZE][CONNECTION_BATCH_PACKET_SIZE];
+} connection_batch_t;
+
 typedef struct _connection_t
 {
     struct _connection_t *  next;
     int                     sock;
     struct sockaddr_in6     addr;
     size_t                  addrLen;
+    connection_batch_t *    txBatchP;   // if not NULL, datagrams are queued until connection_batch_flush()
+    struct _connection_t *  hashNext;   // used by connection_table_t
 } connection_t;
 
+// Connections hashed on their address. The table does not own the connections.
+typedef struct
+{
+    size_t           count;
+    size_t           size;      // number of buckets, a power of two
+    connection_t **  buckets;
+} connection_table_t;
+
 int create_socket(const char * portStr, int ai_family);
+// Same as create_socket() but several sockets can be bound to the same port.
+// The kernel then spreads incoming datagrams by source address.
+int create_reuseport_socket(const char * portStr, int ai_family);
 
 connection_t * connection_find(connection_t * connList, struct sockaddr_storage * addr, size_t addrLen);
 connection_t * connection_new_incoming(connection_t * connList, int sock, struct sockaddr * addr, size_t addrLen);
@@ -52,4 +79,17 @@ void connection_free(connection_t * connList);
 
 int connection_send(connection_t *connP, uint8_t * buffer, size_t length);
 
+int connection_table_init(connection_table_t * tableP);
+void connection_table_close(connection_table_t * tableP);
+connection_t * connection_table_find(connection_table_t * tableP, struct sockaddr_storage * addr, size_t addrLen);
+int connection_table_add(connection_table_t * tableP, connection_t * connP);
+void connection_table_remove(connection_table_t * tableP, connection_t * connP);
+
+connection_batch_t * connection_batch_new(void);
+void connection_batch_free(connection_batch_t * batchP);
+// Reads the datagrams waiting on sock, up to CONNECTION_BATCH_SIZE. Returns their number or -1 on error.
+int connection_batch_receive(connection_batch_t * batchP, int sock);
+// Sends the queued datagrams and empties the batch. Returns -1 if some could not be sent.
+int connection_batch_flush(connection_batch_t * batchP);
+
 #endif
@@ -0,0 +1,212 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "eventloop.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/epoll.h>
+
+#define PRV_MAX_EVENTS      16
+// in seconds, stands for an infinite timeout while lwm2m_step() may lower it
+#define PRV_MAX_TIMEOUT     (INT_MAX / 1000)
+
+typedef struct _prv_watch_
+{
+    struct _prv_watch_ *    next;
+    int                     fd;
+    event_loop_callback_t   callback;
+    void *                  userData;
+} prv_watch_t;
+
+struct _event_loop_
+{
+    lwm2m_context_t *       lwm2mH;
+    int                     epollFd;
+    volatile sig_atomic_t   quit;
+    prv_watch_t *           watchList;
+    connection_t *          connList;
+    connection_table_t      peers;
+    connection_batch_t *    rxBatchP;
+    connection_batch_t *    txBatchP;
+};
+
+static void prv_socketCallback(event_loop_t * loopP,
+                               int sock,
+                               void * userData)
+{
+    connection_batch_t * batchP = loopP->rxBatchP;
+    int count;
+    int i;
+
+    (void)userData;
+
+    count = connection_batch_receive(batchP, sock);
+    for (i = 0 ; i < count ; i++)
+    {
+        connection_t * connP;
+
+        connP = connection_table_find(&(loopP->peers), &(batchP->addr[i]), batchP->addrLen[i]);
+        if (connP == NULL)
+        {
+            connP = connection_new_incoming(loopP->connList, sock, (struct sockaddr *)&(batchP->addr[i]), batchP->addrLen[i]);
+            if (connP == NULL) continue;
+            if (0 != connection_table_add(&(loopP->peers), connP))
+            {
+                free(connP);
+                continue;
+            }
+            connP->txBatchP = loopP->txBatchP;
+            loopP->connList = connP;
+        }
+        lwm2m_handle_packet(loopP->lwm2mH, batchP->buffer[i], batchP->length[i], connP);
+    }
+}
+
+event_loop_t * event_loop_new(lwm2m_context_t * lwm2mH)
+{
+    event_loop_t * loopP;
+
+    loopP = (event_loop_t *)malloc(sizeof(event_loop_t));
+    if (loopP == NULL) return NULL;
+    memset(loopP, 0, sizeof(event_loop_t));
+    loopP->lwm2mH = lwm2mH;
+
+    loopP->epollFd = epoll_create1(0);
+    loopP->rxBatchP = connection_batch_new();
+    loopP->txBatchP = connection_batch_new();
+    if (loopP->epollFd < 0
+     || loopP->rxBatchP == NULL
+     || loopP->txBatchP == NULL
+     || 0 != connection_table_init(&(loopP->peers)))
+    {
+        event_loop_free(loopP);
+        return NULL;
+    }
+
+    return loopP;
+}
+
+void event_loop_free(event_loop_t * loopP)
+{
+    if (loopP->txBatchP != NULL) (void)connection_batch_flush(loopP->txBatchP);
+    while (loopP->watchList != NULL)
+    {
+        prv_watch_t * watchP = loopP->watchList;
+
+        loopP->watchList = watchP->next;
+        free(watchP);
+    }
+    connection_free(loopP->connList);
+    connection_table_close(&(loopP->peers));
+    connection_batch_free(loopP->rxBatchP);
+    connection_batch_free(loopP->txBatchP);
+    if (loopP->epollFd >= 0) close(loopP->epollFd);
+    free(loopP);
+}
+
+int event_loop_add_fd(event_loop_t * loopP,
+                      int fd,
+                      event_loop_callback_t callback,
+                      void * userData)
+{
+    prv_watch_t * watchP;
+    struct epoll_event event;
+
+    watchP = (prv_watch_t *)malloc(sizeof(prv_watch_t));
+    if (watchP == NULL) return -1;
+    watchP->fd = fd;
+    watchP->callback = callback;
+    watchP->userData = userData;
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = watchP;
+    if (0 != epoll_ctl(loopP->epollFd, EPOLL_CTL_ADD, fd, &event))
+    {
+        free(watchP);
+        return -1;
+    }
+
+    watchP->next = loopP->watchList;
+    loopP->watchList = watchP;
+
+    return 0;
+}
+
+int event_loop_add_socket(event_loop_t * loopP,
+                          int sock)
+{
+    return event_loop_add_fd(loopP, sock, prv_socketCallback, NULL);
+}
+
+int event_loop_step(event_loop_t * loopP,
+                    int timeoutMs)
+{
+    struct epoll_event events[PRV_MAX_EVENTS];
+    time_t timeout;
+    int count;
+    int i;
+
+    // rounded up: a timeout under a second must not make lwm2m_step() ask for an immediate wake up
+    timeout = (timeoutMs < 0) ? PRV_MAX_TIMEOUT : (timeoutMs + 999) / 1000;
+    if (0 != lwm2m_step(loopP->lwm2mH, &timeout)) return -1;
+    if (timeoutMs < 0 || timeout * 1000 < timeoutMs) timeoutMs = (int)timeout * 1000;
+
+    // everything queued since the last iteration, responses included, goes out in one call
+    (void)connection_batch_flush(loopP->txBatchP);
+
+    count = epoll_wait(loopP->epollFd, events, PRV_MAX_EVENTS, timeoutMs);
+    if (count < 0)
+    {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    for (i = 0 ; i < count ; i++)
+    {
+        prv_watch_t * watchP = (prv_watch_t *)events[i].data.ptr;
+
+        watchP->callback(loopP, watchP->fd, watchP->userData);
+    }
+    (void)connection_batch_flush(loopP->txBatchP);
+
+    return 0;
+}
+
+int event_loop_run(event_loop_t * loopP)
+{
+    loopP->quit = 0;
+    while (loopP->quit == 0)
+    {
+        if (0 != event_loop_step(loopP, 60 * 1000)) return -1;
+    }
+
+    return 0;
+}
+
+void event_loop_stop(event_loop_t * loopP)
+{
+    loopP->quit = 1;
+}
+
+size_t event_loop_peer_count(event_loop_t * loopP)
+{
+    return loopP->peers.count;
+}
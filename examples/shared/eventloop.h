@@ -0,0 +1,58 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * epoll-based event loop driving a LWM2M context.
+ *
+ * LWM2M sockets added to the loop are read with connection_batch_receive().
+ * The sender of each datagram is looked up in a hash table of connections,
+ * and a connection is created on first contact. Datagrams sent by the
+ * context are queued and flushed once per iteration.
+ * Other file descriptors (e.g. a command line) can be watched with a callback.
+ */
+
+#ifndef EVENTLOOP_H_
+#define EVENTLOOP_H_
+
+#include "connection.h"
+
+typedef struct _event_loop_ event_loop_t;
+
+typedef void (*event_loop_callback_t) (event_loop_t * loopP, int fd, void * userData);
+
+event_loop_t * event_loop_new(lwm2m_context_t * lwm2mH);
+// Closes the connections created by the loop. Neither the sockets nor the context are closed.
+void event_loop_free(event_loop_t * loopP);
+
+// Serves LWM2M on the UDP socket sock.
+int event_loop_add_socket(event_loop_t * loopP, int sock);
+// callback is called when fd is readable.
+int event_loop_add_fd(event_loop_t * loopP, int fd, event_loop_callback_t callback, void * userData);
+
+// Runs lwm2m_step() then waits for events for at most timeoutMs milliseconds, or until the next
+// lwm2m_step() is due if sooner. A negative timeoutMs only waits for the next lwm2m_step().
+// Returns 0 or -1 on error.
+int event_loop_step(event_loop_t * loopP, int timeoutMs);
+// Calls event_loop_step() until event_loop_stop() is called. Returns 0 or -1 on error.
+int event_loop_run(event_loop_t * loopP);
+// Safe to call from a callback or a signal handler.
+void event_loop_stop(event_loop_t * loopP);
+
+// Number of known peers.
+size_t event_loop_peer_count(event_loop_t * loopP);
+
+#endif
@@ -23,6 +23,8 @@
 #undef free
 #undef strdup
 
+#include <pthread.h>
+
 typedef struct MemoryEntry {
     struct MemoryEntry* next;
     const char *file;
@@ -35,6 +37,9 @@ typedef struct MemoryEntry {
 
 static memory_entry_t prv_memory_malloc_list = { .next = NULL, .file = "head", .function="malloc", .lineno = 0, .size = 0, .count = 0};
 static memory_entry_t prv_memory_free_list = { .next = NULL, .file = "head", .function="free", .lineno = 0, .size = 0, .count = 0};
+static int prv_memory_allocations = 0;
+// the shard runtime allocates from several threads
+static pthread_mutex_t prv_memory_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static memory_entry_t* prv_memory_find_previous(memory_entry_t* list, void* memory)
 {
@@ -83,8 +88,8 @@ char* lwm2m_trace_strdup(const char* str, const char* file, const char* function
 
 void* lwm2m_trace_malloc(size_t size, const char* file, const char* function, int lineno)
 {
-    static int counter = 0;
     memory_entry_t* entry = malloc(size + sizeof(memory_entry_t));
+    pthread_mutex_lock(&prv_memory_mutex);
     entry->next = prv_memory_malloc_list.next;
     prv_memory_malloc_list.next = entry;
     ++prv_memory_malloc_list.count;
@@ -95,7 +100,8 @@ void* lwm2m_trace_malloc(size_t size, const char* file, const char* function, in
     entry->function = function;
     entry->lineno = lineno;
     entry->size = size;
-    entry->count = ++counter;
+    entry->count = ++prv_memory_allocations;
+    pthread_mutex_unlock(&prv_memory_mutex);
 
     return &(entry->data);
 }
@@ -104,7 +110,10 @@ void lwm2m_trace_free(void* mem, const char* file, const char* function, int lin
 {
     if (NULL != mem)
     {
-        memory_entry_t* entry = prv_memory_find_previous(&prv_memory_malloc_list, mem);
+        memory_entry_t* entry;
+
+        pthread_mutex_lock(&prv_memory_mutex);
+        entry = prv_memory_find_previous(&prv_memory_malloc_list, mem);
         if (NULL != entry)
         {
             memory_entry_t* remove = entry->next;
@@ -117,19 +126,21 @@ void lwm2m_trace_free(void* mem, const char* file, const char* function, int lin
         else
         {
             fprintf(stderr, "memory: free error (no malloc) %s, %d, %s\n", file, lineno, function);
-            memory_entry_t* entry = prv_memory_find_previous(&prv_memory_free_list, mem);
-            if (NULL != entry)
+            memory_entry_t* freed = prv_memory_find_previous(&prv_memory_free_list, mem);
+            if (NULL != freed)
             {
-                entry = entry->next;
-                fprintf(stderr, "memory: already frees at %s, %d, %s\n", entry->file, entry->lineno, entry->function);
+                freed = freed->next;
+                fprintf(stderr, "memory: already frees at %s, %d, %s\n", freed->file, freed->lineno, freed->function);
             }
         }
+        pthread_mutex_unlock(&prv_memory_mutex);
     }
 }
 
 void trace_print(int loops, int level)
 {
     static int counter = 0;
+    pthread_mutex_lock(&prv_memory_mutex);
     if (0 == loops)
     {
         counter = 0;
@@ -164,10 +175,17 @@ void trace_print(int loops, int level)
         }
         fprintf(stdout,"memory: %d entries, %lu total bytes\n", prv_memory_malloc_list.count, (unsigned long) prv_memory_malloc_list.size);
     }
+    pthread_mutex_unlock(&prv_memory_mutex);
+}
+
+int trace_allocations(void)
+{
+    return prv_memory_allocations;
 }
 
 void trace_status(int* blocks, size_t* size)
 {
+    pthread_mutex_lock(&prv_memory_mutex);
     if (NULL != blocks)
     {
         *blocks = prv_memory_malloc_list.count;
@@ -177,6 +195,7 @@ void trace_status(int* blocks, size_t* size)
     {
         *size = prv_memory_malloc_list.size;
     }
+    pthread_mutex_unlock(&prv_memory_mutex);
 }
 
 #endif
@@ -0,0 +1,30 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Bosch Software Innvoations GmbH and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Bosch Software Innovations GmbH - Please refer to git log
+ *
+ *******************************************************************************/
+
+#ifndef MEMTRACE_H_
+#define MEMTRACE_H_
+
+#include <stddef.h>
+
+// Only available when compiled with LWM2M_MEMORY_TRACE.
+
+void trace_print(int loops, int level);
+void trace_status(int* blocks, size_t* size);
+// Number of allocations done since the start of the program.
+int trace_allocations(void);
+
+#endif /* MEMTRACE_H_ */
@@ -23,7 +23,8 @@ if(DTLS)
 else()
     set(SHARED_SOURCES
 		${SHARED_SOURCES} 
-		${SHARED_SOURCES_DIR}/connection.c)
+		${SHARED_SOURCES_DIR}/connection.c
+		${SHARED_SOURCES_DIR}/eventloop.c)
 
     set(SHARED_INCLUDE_DIRS ${SHARED_SOURCES_DIR})
 endif()
@@ -19,6 +19,16 @@
 #include "CUnit/Basic.h"
 #include "internals.h"
 #include "liblwm2m.h"
+#include "connection.h"
+#include "testhelpers.h"
+#include "memtest.h"
+
+#define LARGE_BLOCK_SIZE    1024
+#define LARGE_BLOCK_COUNT   1024
+#define STREAM_OBJECT_ID    1024
+#define STREAM_BLOCK_COUNT  10
+#define SEND_LENGTH         3000
+#define SEND_PIPELINE       4
 
 
 static void handle_12345(lwm2m_block1_data_t ** blk1,
@@ -27,7 +37,7 @@ static void handle_12345(lwm2m_block1_data_t ** blk1,
     size_t bsize;
     uint8_t *resultBuffer = NULL;
 
-    uint8_t st = coap_block1_handler(blk1, mid, buffer, 5, 5, 0, true, &resultBuffer, &bsize);
+    uint8_t st = coap_block1_handler(blk1, (const uint8_t *)"\x01", 1, mid, buffer, 5, 5, 0, true, &resultBuffer, &bsize);
     CU_ASSERT_EQUAL(st, COAP_231_CONTINUE);
     CU_ASSERT_PTR_NULL(resultBuffer);
 }
@@ -38,7 +48,7 @@ static void handle_67(lwm2m_block1_data_t ** blk1,
     size_t bsize;
     uint8_t *resultBuffer = NULL;
 
-    uint8_t st = coap_block1_handler(blk1, mid, buffer, 2, 5, 1, false, &resultBuffer, &bsize);
+    uint8_t st = coap_block1_handler(blk1, (const uint8_t *)"\x01", 1, mid, buffer, 2, 5, 1, false, &resultBuffer, &bsize);
     CU_ASSERT_EQUAL(st, NO_ERROR);
     CU_ASSERT_PTR_NOT_NULL(*resultBuffer);
     CU_ASSERT_EQUAL(bsize, 7);
@@ -69,9 +79,435 @@ static void test_block1_retransmit(void)
     free_block1_buffer(blk1);
 }
 
+static uint8_t prv_handleBlock(lwm2m_block1_data_t ** blk1,
+                               uint8_t token,
+                               uint16_t mid,
+                               uint8_t * buffer,
+                               size_t length,
+                               uint32_t num,
+                               bool more,
+                               uint8_t ** resultP,
+                               size_t * sizeP)
+{
+    return coap_block1_handler(blk1, &token, 1, mid, buffer, length, LARGE_BLOCK_SIZE, num, more, resultP, sizeP);
+}
+
+static void test_block1_large(void)
+{
+    lwm2m_block1_data_t * blk1 = NULL;
+    uint8_t block[LARGE_BLOCK_SIZE];
+    uint8_t * resultBuffer = NULL;
+    size_t bsize = 0;
+    uint32_t num;
+    uint8_t st;
+    int i;
+
+    // 1 MB, the default limit
+    for (num = 0 ; num < LARGE_BLOCK_COUNT ; num++)
+    {
+        memset(block, (uint8_t)num, sizeof(block));
+        st = prv_handleBlock(&blk1, 1, (uint16_t)num, block, sizeof(block), num, num + 1 < LARGE_BLOCK_COUNT, &resultBuffer, &bsize);
+        CU_ASSERT_EQUAL_FATAL(st, num + 1 < LARGE_BLOCK_COUNT ? COAP_231_CONTINUE : NO_ERROR);
+    }
+    CU_ASSERT_EQUAL_FATAL(bsize, LARGE_BLOCK_SIZE * LARGE_BLOCK_COUNT);
+    for (i = 0 ; i < LARGE_BLOCK_COUNT ; i++)
+    {
+        CU_ASSERT_EQUAL(resultBuffer[i * LARGE_BLOCK_SIZE], (uint8_t)i);
+        CU_ASSERT_EQUAL(resultBuffer[(i + 1) * LARGE_BLOCK_SIZE - 1], (uint8_t)i);
+    }
+
+    // one more block is too much
+    for (num = 0 ; num < LARGE_BLOCK_COUNT ; num++)
+    {
+        st = prv_handleBlock(&blk1, 2, (uint16_t)(0x8000 + num), block, sizeof(block), num, true, &resultBuffer, &bsize);
+        CU_ASSERT_EQUAL_FATAL(st, COAP_231_CONTINUE);
+    }
+    st = prv_handleBlock(&blk1, 2, 0x8000 + LARGE_BLOCK_COUNT, block, 1, LARGE_BLOCK_COUNT, false, &resultBuffer, &bsize);
+    CU_ASSERT_EQUAL(st, COAP_413_ENTITY_TOO_LARGE);
+
+    free_block1_buffer(blk1);
+}
+
+static void test_block1_concurrent(void)
+{
+    lwm2m_block1_data_t * blk1 = NULL;
+    uint8_t * resultBuffer = NULL;
+    size_t bsize = 0;
+    uint8_t st;
+
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, (const uint8_t *)"A", 1, 1, (uint8_t *)"aaaaa", 5, 5, 0, true, &resultBuffer, &bsize), COAP_231_CONTINUE);
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, (const uint8_t *)"B", 1, 2, (uint8_t *)"bbbbb", 5, 5, 0, true, &resultBuffer, &bsize), COAP_231_CONTINUE);
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, (const uint8_t *)"A", 1, 3, (uint8_t *)"AA", 2, 5, 1, false, &resultBuffer, &bsize), NO_ERROR);
+    CU_ASSERT_EQUAL_FATAL(bsize, 7);
+    CU_ASSERT_NSTRING_EQUAL(resultBuffer, "aaaaaAA", 7);
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, (const uint8_t *)"B", 1, 4, (uint8_t *)"BBBBB", 5, 5, 1, true, &resultBuffer, &bsize), COAP_231_CONTINUE);
+
+    // the peer changed the token: the only transfer at this offset goes on
+    st = coap_block1_handler(&blk1, (const uint8_t *)"C", 1, 5, (uint8_t *)"b", 1, 5, 2, false, &resultBuffer, &bsize);
+    CU_ASSERT_EQUAL(st, NO_ERROR);
+    CU_ASSERT_EQUAL_FATAL(bsize, 11);
+    CU_ASSERT_NSTRING_EQUAL(resultBuffer, "bbbbbBBBBBb", 11);
+
+    // unknown transfer
+    st = coap_block1_handler(&blk1, (const uint8_t *)"D", 1, 6, (uint8_t *)"d", 1, 5, 3, false, &resultBuffer, &bsize);
+    CU_ASSERT_EQUAL(st, COAP_408_REQ_ENTITY_INCOMPLETE);
+
+    free_block1_buffer(blk1);
+}
+
+static uint32_t g_streamOffset;
+static int g_streamCalls;
+static bool g_streamDone;
+
+static uint8_t prv_writeBlock(uint16_t instanceId,
+                              uint16_t resourceId,
+                              uint32_t offset,
+                              uint8_t * buffer,
+                              size_t length,
+                              bool more,
+                              lwm2m_object_t * objectP)
+{
+    (void)objectP;
+
+    CU_ASSERT_EQUAL(instanceId, 0);
+    CU_ASSERT_EQUAL(resourceId, 0);
+    CU_ASSERT_EQUAL(offset, g_streamOffset);
+    CU_ASSERT_EQUAL(buffer[0], (uint8_t)(offset / REST_MAX_CHUNK_SIZE));
+    g_streamOffset += length;
+    g_streamCalls++;
+    g_streamDone = !more;
+
+    return COAP_204_CHANGED;
+}
+
+// Sends a block of a PUT /1024/0/0 and returns the code of the reply.
+static uint8_t prv_putBlock(lwm2m_context_t * contextP,
+                            connection_t * connP,
+                            uint16_t mid,
+                            uint32_t num,
+                            bool more)
+{
+    coap_packet_t request[1];
+    coap_packet_t reply[1];
+    uint8_t payload[REST_MAX_CHUNK_SIZE];
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    size_t length;
+
+    memset(payload, (uint8_t)num, sizeof(payload));
+    coap_init_message(request, COAP_TYPE_CON, COAP_PUT, mid);
+    coap_set_header_token(request, (const uint8_t *)"\x33", 1);
+    coap_set_header_uri_path(request, "/1024/0/0");
+    coap_set_header_content_type(request, LWM2M_CONTENT_OPAQUE);
+    coap_set_header_block1(request, num, more, REST_MAX_CHUNK_SIZE);
+    coap_set_payload(request, payload, sizeof(payload));
+    length = coap_serialize_message(request, buffer);
+    coap_free_header(request);
+    if (length == 0) return 0;
+
+    lwm2m_handle_packet(contextP, buffer, (int)length, connP);
+
+    if (!test_receive(connP, reply, buffer, sizeof(buffer))) return 0;
+
+    return reply->code;
+}
+
+static void test_block1_stream(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_server_t * serverP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    connection_t conn;
+    uint32_t num;
+
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    memset(&instance, 0, sizeof(instance));
+    memset(&object, 0, sizeof(object));
+    object.objID = STREAM_OBJECT_ID;
+    object.instanceList = &instance;
+    object.blockWriteFunc = prv_writeBlock;
+    contextP->objectList = &object;
+    serverP = (lwm2m_server_t *)lwm2m_malloc(sizeof(lwm2m_server_t));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(serverP);
+    memset(serverP, 0, sizeof(lwm2m_server_t));
+    serverP->sessionH = &conn;
+    serverP->status = STATE_REGISTERED;
+    contextP->serverList = serverP;
+
+    g_streamOffset = 0;
+    g_streamCalls = 0;
+    g_streamDone = false;
+    for (num = 0 ; num < STREAM_BLOCK_COUNT ; num++)
+    {
+        bool more = num + 1 < STREAM_BLOCK_COUNT;
+
+        CU_ASSERT_EQUAL(prv_putBlock(contextP, &conn, (uint16_t)(100 + num), num, more), more ? COAP_231_CONTINUE : COAP_204_CHANGED);
+        // nothing is buffered
+        CU_ASSERT_PTR_NULL(serverP->block1Data->chunkList);
+    }
+    CU_ASSERT_EQUAL(g_streamCalls, STREAM_BLOCK_COUNT);
+    CU_ASSERT_EQUAL(g_streamOffset, STREAM_BLOCK_COUNT * REST_MAX_CHUNK_SIZE);
+    CU_ASSERT_TRUE(g_streamDone);
+
+    // a retransmission is answered again without writing the block twice
+    CU_ASSERT_EQUAL(prv_putBlock(contextP, &conn, 100 + STREAM_BLOCK_COUNT - 1, STREAM_BLOCK_COUNT - 1, false), COAP_204_CHANGED);
+    CU_ASSERT_EQUAL(g_streamCalls, STREAM_BLOCK_COUNT);
+
+    // out of order
+    CU_ASSERT_EQUAL(prv_putBlock(contextP, &conn, 200, 3, true), COAP_408_REQ_ENTITY_INCOMPLETE);
+
+    close(conn.sock);
+    serverP->status = STATE_DEREGISTERED;
+    contextP->objectList = NULL;
+    lwm2m_close(contextP);
+}
+
+static int g_resultStatus;
+static int g_resultCalls;
+
+static void prv_resultCallback(uint16_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int status,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    (void)clientID;
+    (void)uriP;
+    (void)format;
+    (void)data;
+    (void)dataLength;
+    (void)userData;
+
+    g_resultStatus = status;
+    g_resultCalls++;
+}
+
+// Receives a request of the server and checks its block against payload.
+static int prv_recvBlock(connection_t * connP,
+                         uint8_t * payload,
+                         coap_packet_t * messageP,
+                         uint8_t * buffer,
+                         size_t size)
+{
+    if (!test_receive(connP, messageP, buffer, size)) return -1;
+
+    if (IS_OPTION(messageP, COAP_OPTION_BLOCK1))
+    {
+        size_t offset = (size_t)messageP->block1_num * messageP->block1_size;
+
+        if (messageP->block1_more && messageP->payload_len != messageP->block1_size) return -1;
+        if (!messageP->block1_more && offset + messageP->payload_len != SEND_LENGTH) return -1;
+        payload += offset;
+    }
+    if (0 != memcmp(messageP->payload, payload, messageP->payload_len)) return -1;
+
+    return 0;
+}
+
+static void prv_answer(lwm2m_context_t * contextP,
+                       connection_t * connP,
+                       coap_packet_t * requestP,
+                       uint8_t code,
+                       uint16_t blockSize)
+{
+    coap_packet_t response[1];
+
+    test_initAnswer(response, requestP, COAP_TYPE_ACK, code);
+    if (blockSize != 0)
+    {
+        coap_set_header_block1(response, requestP->block1_num, requestP->block1_more, blockSize);
+    }
+    test_deliver(contextP, connP, response);
+}
+
+// Answers the blocks one by one until the last one. Returns the number of blocks.
+static int prv_answerBlocks(lwm2m_context_t * contextP,
+                            connection_t * connP,
+                            uint8_t * payload,
+                            uint32_t firstNum,
+                            uint16_t blockSize)
+{
+    coap_packet_t message;
+    uint8_t buffer[1500];
+    uint32_t num;
+
+    num = firstNum;
+    do
+    {
+        CU_ASSERT_EQUAL_FATAL(prv_recvBlock(connP, payload, &message, buffer, sizeof(buffer)), 0);
+        CU_ASSERT_EQUAL(message.block1_num, num);
+        CU_ASSERT_EQUAL(message.block1_size, blockSize);
+        prv_answer(contextP, connP, &message, message.block1_more ? COAP_231_CONTINUE : COAP_204_CHANGED, blockSize);
+        num++;
+    } while (message.block1_more);
+
+    return (int)(num - firstNum);
+}
+
+static void test_block1_send(void)
+{
+    uint8_t payload[SEND_LENGTH];
+    uint8_t buffer[1500];
+    lwm2m_context_t * contextP;
+    coap_packet_t message;
+    connection_t conn;
+    lwm2m_uri_t uri;
+    uint16_t clientID;
+    int i;
+
+    for (i = 0 ; i < SEND_LENGTH ; i++)
+    {
+        payload[i] = (uint8_t)(i * 7);
+    }
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    clientID = test_addClient(contextP, &conn);
+    lwm2m_stringToUri("/1024/0/0", 9, &uri);
+
+    // small payloads are sent whole
+    g_resultCalls = 0;
+    CU_ASSERT_EQUAL(lwm2m_dm_write(contextP, clientID, &uri, LWM2M_CONTENT_OPAQUE, payload, 100, prv_resultCallback, NULL), 0);
+    CU_ASSERT_EQUAL_FATAL(prv_recvBlock(&conn, payload, &message, buffer, sizeof(buffer)), 0);
+    CU_ASSERT_FALSE(IS_OPTION(&message, COAP_OPTION_BLOCK1));
+    CU_ASSERT_EQUAL(message.payload_len, 100);
+    prv_answer(contextP, &conn, &message, COAP_204_CHANGED, 0);
+    CU_ASSERT_EQUAL(g_resultCalls, 1);
+    CU_ASSERT_EQUAL(g_resultStatus, COAP_204_CHANGED);
+
+    // the client answers the first block with a smaller size
+    g_resultCalls = 0;
+    CU_ASSERT_EQUAL(lwm2m_dm_write(contextP, clientID, &uri, LWM2M_CONTENT_OPAQUE, payload, SEND_LENGTH, prv_resultCallback, NULL), 0);
+    CU_ASSERT_EQUAL_FATAL(prv_recvBlock(&conn, payload, &message, buffer, sizeof(buffer)), 0);
+    CU_ASSERT_EQUAL(message.block1_num, 0);
+    CU_ASSERT_EQUAL(message.block1_size, 512);
+    prv_answer(contextP, &conn, &message, COAP_231_CONTINUE, 256);
+    CU_ASSERT_EQUAL(prv_answerBlocks(contextP, &conn, payload, 2, 256), 10);
+    CU_ASSERT_EQUAL(g_resultCalls, 1);
+    CU_ASSERT_EQUAL(g_resultStatus, COAP_204_CHANGED);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+
+    // a 4.13 starts the transfer again with the size of the client
+    g_resultCalls = 0;
+    CU_ASSERT_EQUAL(lwm2m_dm_write(contextP, clientID, &uri, LWM2M_CONTENT_OPAQUE, payload, SEND_LENGTH, prv_resultCallback, NULL), 0);
+    CU_ASSERT_EQUAL_FATAL(prv_recvBlock(&conn, payload, &message, buffer, sizeof(buffer)), 0);
+    prv_answer(contextP, &conn, &message, COAP_413_ENTITY_TOO_LARGE, 128);
+    CU_ASSERT_EQUAL(g_resultCalls, 0);
+    CU_ASSERT_EQUAL(prv_answerBlocks(contextP, &conn, payload, 0, 128), (SEND_LENGTH + 127) / 128);
+    CU_ASSERT_EQUAL(g_resultCalls, 1);
+    CU_ASSERT_EQUAL(g_resultStatus, COAP_204_CHANGED);
+
+    // a transfer in progress ends with the transactions of its peer
+    g_resultCalls = 0;
+    // without the state of the peer, which goes with it
+    transaction_removePeer(contextP, &conn);
+    MEMORY_TRACE_BEFORE;
+    CU_ASSERT_EQUAL(lwm2m_dm_write(contextP, clientID, &uri, LWM2M_CONTENT_OPAQUE, payload, SEND_LENGTH, prv_resultCallback, NULL), 0);
+    CU_ASSERT_EQUAL_FATAL(prv_recvBlock(&conn, payload, &message, buffer, sizeof(buffer)), 0);
+    prv_answer(contextP, &conn, &message, COAP_231_CONTINUE, 512);
+    CU_ASSERT_PTR_NOT_NULL(contextP->transactionList);
+    transaction_removePeer(contextP, &conn);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+    CU_ASSERT_EQUAL(g_resultCalls, 1);
+    CU_ASSERT_EQUAL(g_resultStatus, COAP_503_SERVICE_UNAVAILABLE);
+    MEMORY_TRACE_AFTER_EQ;
+
+    lwm2m_close(contextP);
+    close(conn.sock);
+}
+
+static void test_block1_send_pipeline(void)
+{
+    coap_packet_t messages[SEND_PIPELINE];
+    uint8_t buffers[SEND_PIPELINE][1500];
+    uint8_t payload[SEND_LENGTH];
+    lwm2m_context_t * contextP;
+    connection_t conn;
+    lwm2m_uri_t uri;
+    uint16_t clientID;
+    uint32_t num;
+    int i;
+
+    for (i = 0 ; i < SEND_LENGTH ; i++)
+    {
+        payload[i] = (uint8_t)(i * 13);
+    }
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    clientID = test_addClient(contextP, &conn);
+    lwm2m_stringToUri("/1024/0/0", 9, &uri);
+
+    CU_ASSERT_EQUAL(lwm2m_set_block1_options(contextP, 100, SEND_PIPELINE), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(lwm2m_set_block1_options(contextP, 256, 0), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(lwm2m_set_block1_options(contextP, 256, SEND_PIPELINE), COAP_NO_ERROR);
+    // the window is bounded by NSTART
+    CU_ASSERT_EQUAL(lwm2m_set_congestion_options(contextP, SEND_PIPELINE, 0), COAP_NO_ERROR);
+
+    g_resultCalls = 0;
+    CU_ASSERT_EQUAL(lwm2m_dm_write(contextP, clientID, &uri, LWM2M_CONTENT_OPAQUE, payload, SEND_LENGTH, prv_resultCallback, NULL), 0);
+
+    // the first block goes alone
+    CU_ASSERT_EQUAL_FATAL(prv_recvBlock(&conn, payload, messages, buffers[0], sizeof(buffers[0])), 0);
+    CU_ASSERT_EQUAL(messages[0].block1_size, 256);
+    CU_ASSERT_EQUAL(prv_recvBlock(&conn, payload, messages + 1, buffers[1], sizeof(buffers[1])), -1);
+    prv_answer(contextP, &conn, messages, COAP_231_CONTINUE, 256);
+
+    // then the window is kept full, each answer lets the next block go
+    for (i = 0 ; i < SEND_PIPELINE ; i++)
+    {
+        CU_ASSERT_EQUAL_FATAL(prv_recvBlock(&conn, payload, messages + i, buffers[i], sizeof(buffers[i])), 0);
+        CU_ASSERT_EQUAL(messages[i].block1_num, i + 1);
+    }
+    CU_ASSERT_EQUAL(prv_recvBlock(&conn, payload, messages, buffers[0], sizeof(buffers[0])), -1);
+    for (num = 1 ; num < (SEND_LENGTH + 255) / 256 ; num++)
+    {
+        i = (num - 1) % SEND_PIPELINE;
+        CU_ASSERT_EQUAL(messages[i].block1_num, num);
+        CU_ASSERT_EQUAL(g_resultCalls, 0);
+        prv_answer(contextP, &conn, messages + i, messages[i].block1_more ? COAP_231_CONTINUE : COAP_204_CHANGED, 256);
+        if (num + SEND_PIPELINE < (SEND_LENGTH + 255) / 256)
+        {
+            CU_ASSERT_EQUAL_FATAL(prv_recvBlock(&conn, payload, messages + i, buffers[i], sizeof(buffers[i])), 0);
+        }
+    }
+    CU_ASSERT_EQUAL(g_resultCalls, 1);
+    CU_ASSERT_EQUAL(g_resultStatus, COAP_204_CHANGED);
+
+    // an error on a block ends the transfer, the other blocks are dropped
+    g_resultCalls = 0;
+    CU_ASSERT_EQUAL(lwm2m_dm_write(contextP, clientID, &uri, LWM2M_CONTENT_OPAQUE, payload, SEND_LENGTH, prv_resultCallback, NULL), 0);
+    CU_ASSERT_EQUAL_FATAL(prv_recvBlock(&conn, payload, messages, buffers[0], sizeof(buffers[0])), 0);
+    prv_answer(contextP, &conn, messages, COAP_231_CONTINUE, 256);
+    for (i = 0 ; i < SEND_PIPELINE ; i++)
+    {
+        CU_ASSERT_EQUAL_FATAL(prv_recvBlock(&conn, payload, messages + i, buffers[i], sizeof(buffers[i])), 0);
+    }
+    prv_answer(contextP, &conn, messages + 1, COAP_408_REQ_ENTITY_INCOMPLETE, 0);
+    CU_ASSERT_EQUAL(g_resultCalls, 1);
+    CU_ASSERT_EQUAL(g_resultStatus, COAP_408_REQ_ENTITY_INCOMPLETE);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+    prv_answer(contextP, &conn, messages, COAP_231_CONTINUE, 256);
+    CU_ASSERT_EQUAL(g_resultCalls, 1);
+
+    // a transfer in progress is dropped on close
+    CU_ASSERT_EQUAL(lwm2m_dm_write(contextP, clientID, &uri, LWM2M_CONTENT_OPAQUE, payload, SEND_LENGTH, prv_resultCallback, NULL), 0);
+    lwm2m_close(contextP);
+    close(conn.sock);
+}
+
 static struct TestTable table[] = {
         { "test of test_block1_nominal()", test_block1_nominal },
         { "test of test_block1_retransmit()", test_block1_retransmit },
+        { "test of test_block1_large()", test_block1_large },
+        { "test of test_block1_concurrent()", test_block1_concurrent },
+        { "test of test_block1_stream()", test_block1_stream },
+        { "test of test_block1_send()", test_block1_send },
+        { "test of test_block1_send_pipeline()", test_block1_send_pipeline },
         { NULL, NULL },
 };
 
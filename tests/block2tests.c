@@ -0,0 +1,494 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+#include "connection.h"
+#include "testhelpers.h"
+#include "memtest.h"
+
+#define TEST_OBJECT_ID      1024
+#define TEST_RESOURCE_ID    1
+#define TEST_VALUE_LENGTH   600
+#define TEST_BLOCK_SIZE     64
+
+static char g_value[TEST_VALUE_LENGTH];
+static int g_readCount = 0;
+static uint16_t g_mid = 0x100;
+
+static uint8_t prv_read(uint16_t instanceId,
+                        int * numDataP,
+                        lwm2m_data_t ** dataArrayP,
+                        lwm2m_object_t * objectP)
+{
+    (void)instanceId;
+    (void)objectP;
+
+    if (*numDataP == 0)
+    {
+        *dataArrayP = lwm2m_data_new(1);
+        if (*dataArrayP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+        *numDataP = 1;
+        (*dataArrayP)->id = TEST_RESOURCE_ID;
+    }
+    if ((*dataArrayP)->id != TEST_RESOURCE_ID) return COAP_404_NOT_FOUND;
+
+    g_readCount++;
+    lwm2m_data_encode_nstring(g_value, TEST_VALUE_LENGTH, *dataArrayP);
+
+    return COAP_205_CONTENT;
+}
+
+static lwm2m_context_t * prv_createClient(connection_t * connP,
+                                          lwm2m_object_t * objectP,
+                                          lwm2m_list_t * instanceP)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_server_t * serverP;
+
+    contextP = lwm2m_init(NULL);
+    if (contextP == NULL) return NULL;
+
+    memset(instanceP, 0, sizeof(lwm2m_list_t));
+    memset(objectP, 0, sizeof(lwm2m_object_t));
+    objectP->objID = TEST_OBJECT_ID;
+    objectP->instanceList = instanceP;
+    objectP->readFunc = prv_read;
+    contextP->objectList = objectP;
+
+    serverP = (lwm2m_server_t *)lwm2m_malloc(sizeof(lwm2m_server_t));
+    if (serverP == NULL) return NULL;
+    memset(serverP, 0, sizeof(lwm2m_server_t));
+    serverP->shortID = 1;
+    serverP->sessionH = connP;
+    serverP->status = STATE_REGISTERED;
+    contextP->serverList = serverP;
+
+    return contextP;
+}
+
+static void prv_closeClient(lwm2m_context_t * contextP,
+                            connection_t * connP)
+{
+    close(connP->sock);
+    contextP->serverList->status = STATE_DEREGISTERED;
+    contextP->objectList = NULL;
+    lwm2m_close(contextP);
+}
+
+// Sends a GET /1024/0/1 for the given block and parses the reply in messageP.
+static int prv_getBlock(lwm2m_context_t * contextP,
+                        connection_t * connP,
+                        uint32_t num,
+                        bool observe,
+                        coap_packet_t * messageP,
+                        uint8_t * reply)
+{
+    coap_packet_t request[1];
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    size_t length;
+    int received;
+
+    // a new message ID each time, the same one would be answered as a retransmission
+    coap_init_message(request, COAP_TYPE_CON, COAP_GET, g_mid++);
+    coap_set_header_token(request, (const uint8_t *)"\x42", 1);
+    coap_set_header_uri_path(request, "/1024/0/1");
+    if (observe) coap_set_header_observe(request, 0);
+    coap_set_header_block2(request, num, 0, TEST_BLOCK_SIZE);
+    length = coap_serialize_message(request, buffer);
+    coap_free_header(request);
+    if (length == 0) return -1;
+
+    lwm2m_handle_packet(contextP, buffer, (int)length, connP);
+
+    received = recv(connP->sock, reply, COAP_MAX_PACKET_SIZE, MSG_DONTWAIT);
+    if (received <= 0) return -1;
+    if (NO_ERROR != coap_parse_message(messageP, reply, (uint16_t)received)) return -1;
+
+    return 0;
+}
+
+// Gets blocks from firstNum on and appends them to payload. Returns the length of the payload.
+static size_t prv_getRemainingBlocks(lwm2m_context_t * contextP,
+                                     connection_t * connP,
+                                     uint32_t firstNum,
+                                     uint8_t * payload,
+                                     size_t length)
+{
+    uint32_t num;
+    uint8_t more;
+
+    num = firstNum;
+    do
+    {
+        coap_packet_t message;
+        uint8_t reply[COAP_MAX_PACKET_SIZE];
+        uint32_t replyNum;
+
+        CU_ASSERT_EQUAL_FATAL(prv_getBlock(contextP, connP, num, false, &message, reply), 0);
+        CU_ASSERT_EQUAL(message.code, COAP_205_CONTENT);
+        CU_ASSERT_EQUAL(message.content_type, LWM2M_CONTENT_TLV);
+        CU_ASSERT_TRUE_FATAL(coap_get_header_block2(&message, &replyNum, &more, NULL, NULL));
+        CU_ASSERT_EQUAL(replyNum, num);
+        CU_ASSERT_TRUE_FATAL(length + message.payload_len <= TEST_VALUE_LENGTH + 8);
+        memcpy(payload + length, message.payload, message.payload_len);
+        length += message.payload_len;
+        coap_free_header(&message);
+        num++;
+    } while (more);
+
+    return length;
+}
+
+static void prv_checkPayload(uint8_t * payload,
+                             size_t length)
+{
+    lwm2m_data_t * dataP;
+    lwm2m_uri_t uri;
+    int size;
+
+    lwm2m_stringToUri("/1024/0/1", 9, &uri);
+    size = lwm2m_data_parse(&uri, payload, length, LWM2M_CONTENT_TLV, &dataP);
+    CU_ASSERT_EQUAL_FATAL(size, 1);
+    CU_ASSERT_EQUAL(dataP->value.asBuffer.length, TEST_VALUE_LENGTH);
+    CU_ASSERT(0 == memcmp(dataP->value.asBuffer.buffer, g_value, TEST_VALUE_LENGTH));
+    lwm2m_data_free(size, dataP);
+}
+
+static void test_block2_read(void)
+{
+    uint8_t payload[TEST_VALUE_LENGTH + 8];
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    connection_t conn;
+    time_t timeout;
+    size_t length;
+    int i;
+
+    for (i = 0 ; i < TEST_VALUE_LENGTH ; i++)
+    {
+        g_value[i] = 'a' + i % 26;
+    }
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = prv_createClient(&conn, &object, &instance);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    g_readCount = 0;
+    length = prv_getRemainingBlocks(contextP, &conn, 0, payload, 0);
+    prv_checkPayload(payload, length);
+    // the resource is read once for all the blocks
+    CU_ASSERT_EQUAL(g_readCount, 1);
+    CU_ASSERT_TRUE(length > 8 * TEST_BLOCK_SIZE);
+
+    // the payload is dropped after the last block
+    CU_ASSERT_PTR_NOT_NULL(contextP->block2List);
+    timeout = 60;
+    timer_step(contextP, lwm2m_gettime(), &timeout);
+    CU_ASSERT_PTR_NULL(contextP->block2List);
+
+    // without the kept payload, a block is read again and the following ones are not
+    g_readCount = 0;
+    length = prv_getRemainingBlocks(contextP, &conn, 3, payload, 0);
+    CU_ASSERT_EQUAL(g_readCount, 1);
+    CU_ASSERT_EQUAL(length + 3 * TEST_BLOCK_SIZE, TEST_VALUE_LENGTH + 4);
+
+    prv_closeClient(contextP, &conn);
+}
+
+static void test_block2_notify(void)
+{
+    uint8_t payload[TEST_VALUE_LENGTH + 8];
+    uint8_t reply[COAP_MAX_PACKET_SIZE];
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    coap_packet_t message;
+    connection_t conn;
+    lwm2m_uri_t uri;
+    time_t timeout;
+    uint8_t more;
+    size_t length;
+    int received;
+
+    memset(g_value, 'x', TEST_VALUE_LENGTH);
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = prv_createClient(&conn, &object, &instance);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    CU_ASSERT_EQUAL_FATAL(prv_getBlock(contextP, &conn, 0, true, &message, reply), 0);
+    CU_ASSERT_EQUAL(message.code, COAP_205_CONTENT);
+    CU_ASSERT_TRUE(IS_OPTION(&message, COAP_OPTION_OBSERVE));
+    coap_free_header(&message);
+
+    memset(g_value, 'y', TEST_VALUE_LENGTH);
+    g_readCount = 0;
+    lwm2m_stringToUri("/1024/0/1", 9, &uri);
+    lwm2m_resource_value_changed(contextP, &uri);
+    timeout = 60;
+    timer_step(contextP, lwm2m_gettime(), &timeout);
+    CU_ASSERT_EQUAL(g_readCount, 1);
+
+    // the notification carries the first block
+    received = recv(conn.sock, reply, sizeof(reply), MSG_DONTWAIT);
+    CU_ASSERT_TRUE_FATAL(received > 0);
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(&message, reply, (uint16_t)received), NO_ERROR);
+    CU_ASSERT_TRUE(IS_OPTION(&message, COAP_OPTION_OBSERVE));
+    CU_ASSERT_TRUE_FATAL(coap_get_header_block2(&message, NULL, &more, NULL, NULL));
+    CU_ASSERT_TRUE(more);
+    CU_ASSERT_EQUAL_FATAL(message.payload_len, TEST_BLOCK_SIZE);
+    memcpy(payload, message.payload, message.payload_len);
+    coap_free_header(&message);
+
+    // the server gets the others
+    length = prv_getRemainingBlocks(contextP, &conn, 1, payload, TEST_BLOCK_SIZE);
+    CU_ASSERT_EQUAL(g_readCount, 1);
+    prv_checkPayload(payload, length);
+
+    prv_closeClient(contextP, &conn);
+}
+
+static uint8_t g_resultPayload[TEST_VALUE_LENGTH];
+static int g_resultLength;
+static int g_resultStatus;
+static int g_resultCalls;
+static uint32_t g_size2 = 0;
+
+static void prv_resultCallback(uint16_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int status,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    (void)clientID;
+    (void)uriP;
+    (void)format;
+    (void)userData;
+
+    g_resultStatus = status;
+    g_resultLength = dataLength;
+    if (dataLength > 0 && dataLength <= TEST_VALUE_LENGTH) memcpy(g_resultPayload, data, dataLength);
+    g_resultCalls++;
+}
+
+// Receives a GET of the server and answers it, as a client, with the asked block of value.
+// Returns the number of the block sent.
+static int prv_answerGet(lwm2m_context_t * contextP,
+                         connection_t * connP,
+                         uint8_t * value,
+                         size_t length)
+{
+    coap_packet_t request[1];
+    coap_packet_t response[1];
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    uint32_t num = 0;
+    size_t offset;
+
+    if (!test_receive(connP, request, buffer, sizeof(buffer))) return -1;
+    CU_ASSERT_EQUAL(request->code, COAP_GET);
+    if (IS_OPTION(request, COAP_OPTION_BLOCK2))
+    {
+        // the following blocks are asked without observing and in the same format
+        CU_ASSERT_FALSE(IS_OPTION(request, COAP_OPTION_OBSERVE));
+        CU_ASSERT_EQUAL(request->block2_size, TEST_BLOCK_SIZE);
+        CU_ASSERT_TRUE(IS_OPTION(request, COAP_OPTION_ACCEPT));
+        CU_ASSERT_EQUAL(request->accept[0], LWM2M_CONTENT_TLV);
+        num = request->block2_num;
+    }
+    offset = (size_t)num * TEST_BLOCK_SIZE;
+    if (offset >= length) return -1;
+
+    test_initAnswer(response, request, COAP_TYPE_ACK, COAP_205_CONTENT);
+    coap_set_header_content_type(response, LWM2M_CONTENT_TLV);
+    if (IS_OPTION(request, COAP_OPTION_OBSERVE)) coap_set_header_observe(response, 1);
+    coap_set_header_block2(response, num, length - offset > TEST_BLOCK_SIZE, TEST_BLOCK_SIZE);
+    coap_set_payload(response, value + offset, MIN(length - offset, TEST_BLOCK_SIZE));
+    if (g_size2 != 0) coap_set_header_size(response, g_size2);
+    test_deliver(contextP, connP, response);
+
+    return (int)num;
+}
+
+static void test_block2_fetch(void)
+{
+    uint8_t other[TEST_VALUE_LENGTH / 2];
+    lwm2m_context_t * contextP;
+    connection_t conn1;
+    connection_t conn2;
+    lwm2m_uri_t uri;
+    uint16_t clientID1;
+    uint16_t clientID2;
+    int i;
+
+    for (i = 0 ; i < TEST_VALUE_LENGTH ; i++)
+    {
+        g_value[i] = 'a' + i % 26;
+    }
+    memset(other, 'z', sizeof(other));
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn1));
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn2));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    clientID1 = test_addClient(contextP, &conn1);
+    clientID2 = test_addClient(contextP, &conn2);
+    lwm2m_stringToUri("/1024/0/1", 9, &uri);
+
+    // two transfers at once, the callbacks get the whole responses
+    g_resultCalls = 0;
+    CU_ASSERT_EQUAL(lwm2m_dm_read(contextP, clientID1, &uri, prv_resultCallback, NULL), 0);
+    CU_ASSERT_EQUAL(lwm2m_dm_read(contextP, clientID2, &uri, prv_resultCallback, NULL), 0);
+    for (i = 0 ; i < TEST_VALUE_LENGTH / TEST_BLOCK_SIZE ; i++)
+    {
+        CU_ASSERT_EQUAL(prv_answerGet(contextP, &conn1, (uint8_t *)g_value, TEST_VALUE_LENGTH), i);
+        if (i < (int)sizeof(other) / TEST_BLOCK_SIZE)
+        {
+            CU_ASSERT_EQUAL(prv_answerGet(contextP, &conn2, other, sizeof(other)), i);
+            CU_ASSERT_EQUAL(g_resultCalls, 0);
+        }
+    }
+    // the last block of the second client
+    CU_ASSERT_EQUAL(prv_answerGet(contextP, &conn2, other, sizeof(other)), sizeof(other) / TEST_BLOCK_SIZE);
+    CU_ASSERT_EQUAL(g_resultCalls, 1);
+    CU_ASSERT_EQUAL(g_resultStatus, COAP_205_CONTENT);
+    CU_ASSERT_EQUAL(g_resultLength, sizeof(other));
+    CU_ASSERT(0 == memcmp(g_resultPayload, other, sizeof(other)));
+
+    CU_ASSERT_EQUAL(prv_answerGet(contextP, &conn1, (uint8_t *)g_value, TEST_VALUE_LENGTH), TEST_VALUE_LENGTH / TEST_BLOCK_SIZE);
+    CU_ASSERT_EQUAL(g_resultCalls, 2);
+    CU_ASSERT_EQUAL(g_resultStatus, COAP_205_CONTENT);
+    CU_ASSERT_EQUAL(g_resultLength, TEST_VALUE_LENGTH);
+    CU_ASSERT(0 == memcmp(g_resultPayload, g_value, TEST_VALUE_LENGTH));
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+
+    // too large to be reassembled
+    g_size2 = 2 * 1024 * 1024;
+    CU_ASSERT_EQUAL(lwm2m_dm_read(contextP, clientID1, &uri, prv_resultCallback, NULL), 0);
+    CU_ASSERT_EQUAL(prv_answerGet(contextP, &conn1, (uint8_t *)g_value, TEST_VALUE_LENGTH), 0);
+    g_size2 = 0;
+    CU_ASSERT_EQUAL(g_resultCalls, 3);
+    CU_ASSERT_EQUAL(g_resultStatus, COAP_413_ENTITY_TOO_LARGE);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+
+    // a transfer in progress ends with the transactions of its peer
+    g_resultCalls = 0;
+    // without the state of the peer, which goes with it
+    transaction_removePeer(contextP, &conn2);
+    MEMORY_TRACE_BEFORE;
+    CU_ASSERT_EQUAL(lwm2m_dm_read(contextP, clientID2, &uri, prv_resultCallback, NULL), 0);
+    CU_ASSERT_EQUAL(prv_answerGet(contextP, &conn2, other, sizeof(other)), 0);
+    CU_ASSERT_PTR_NOT_NULL(contextP->transactionList);
+    transaction_removePeer(contextP, &conn2);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+    CU_ASSERT_EQUAL(g_resultCalls, 1);
+    CU_ASSERT_EQUAL(g_resultStatus, COAP_503_SERVICE_UNAVAILABLE);
+    MEMORY_TRACE_AFTER_EQ;
+
+    // a transfer in progress is dropped on close
+    CU_ASSERT_EQUAL(lwm2m_dm_read(contextP, clientID1, &uri, prv_resultCallback, NULL), 0);
+    CU_ASSERT_EQUAL(prv_answerGet(contextP, &conn1, (uint8_t *)g_value, TEST_VALUE_LENGTH), 0);
+    CU_ASSERT_PTR_NOT_NULL(contextP->transactionList);
+
+    lwm2m_close(contextP);
+    close(conn1.sock);
+    close(conn2.sock);
+}
+
+static void test_block2_fetch_notify(void)
+{
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    lwm2m_context_t * contextP;
+    coap_packet_t message[1];
+    connection_t conn;
+    lwm2m_uri_t uri;
+    uint8_t token[4];
+    uint16_t clientID;
+    uint16_t obsID;
+    size_t length;
+    int i;
+
+    memset(g_value, 'n', TEST_VALUE_LENGTH);
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    clientID = test_addClient(contextP, &conn);
+    lwm2m_stringToUri("/1024/0/1", 9, &uri);
+
+    // the answer to the observe request is fetched
+    g_resultCalls = 0;
+    CU_ASSERT_EQUAL(lwm2m_observe(contextP, clientID, &uri, prv_resultCallback, NULL), 0);
+    for (i = 0 ; i <= TEST_VALUE_LENGTH / TEST_BLOCK_SIZE ; i++)
+    {
+        CU_ASSERT_EQUAL(prv_answerGet(contextP, &conn, (uint8_t *)g_value, TEST_VALUE_LENGTH), i);
+    }
+    CU_ASSERT_EQUAL(g_resultCalls, 1);
+    CU_ASSERT_EQUAL(g_resultStatus, 0);
+    CU_ASSERT_EQUAL(g_resultLength, TEST_VALUE_LENGTH);
+
+    // a notification with the first block, its token tells the client and the observation
+    memset(g_value, 'm', TEST_VALUE_LENGTH);
+    obsID = contextP->clientList->observationList->id;
+    token[0] = clientID >> 8;
+    token[1] = clientID & 0xFF;
+    token[2] = obsID >> 8;
+    token[3] = obsID & 0xFF;
+    coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, 0x4242);
+    coap_set_header_token(message, token, sizeof(token));
+    coap_set_header_observe(message, 7);
+    coap_set_header_content_type(message, LWM2M_CONTENT_TLV);
+    coap_set_header_block2(message, 0, 1, TEST_BLOCK_SIZE);
+    coap_set_payload(message, g_value, TEST_BLOCK_SIZE);
+    length = coap_serialize_message(message, buffer);
+    coap_free_header(message);
+    CU_ASSERT_FATAL(length != 0);
+    lwm2m_handle_packet(contextP, buffer, (int)length, &conn);
+    CU_ASSERT_EQUAL(g_resultCalls, 1);
+
+    for (i = 1 ; i <= TEST_VALUE_LENGTH / TEST_BLOCK_SIZE ; i++)
+    {
+        CU_ASSERT_EQUAL(prv_answerGet(contextP, &conn, (uint8_t *)g_value, TEST_VALUE_LENGTH), i);
+    }
+    CU_ASSERT_EQUAL(g_resultCalls, 2);
+    CU_ASSERT_EQUAL(g_resultStatus, 7);
+    CU_ASSERT_EQUAL(g_resultLength, TEST_VALUE_LENGTH);
+    CU_ASSERT(0 == memcmp(g_resultPayload, g_value, TEST_VALUE_LENGTH));
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+
+    lwm2m_close(contextP);
+    close(conn.sock);
+}
+
+static struct TestTable table[] = {
+        { "test of test_block2_read()", test_block2_read },
+        { "test of test_block2_notify()", test_block2_notify },
+        { "test of test_block2_fetch()", test_block2_fetch },
+        { "test of test_block2_fetch_notify()", test_block2_fetch_notify },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_block2_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_block2", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
@@ -0,0 +1,318 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+#include "connection.h"
+#include "testhelpers.h"
+
+#define TEST_CLIENT_COUNT   6
+#define TEST_PAYLOAD        "rollout"
+
+static connection_t g_conns[TEST_CLIENT_COUNT];
+static uint16_t g_clientIDs[TEST_CLIENT_COUNT];
+static coap_packet_t g_requests[TEST_CLIENT_COUNT];
+static uint8_t g_buffers[TEST_CLIENT_COUNT][256];
+static int g_resultCount;
+static int g_statusCount[2];    // successes, failures
+static int g_lastStatus;
+static int g_doneCount;
+static lwm2m_bulk_progress_t g_progress;
+
+static void prv_resultCallback(uint16_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int status,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    (void)clientID;
+    (void)uriP;
+    (void)format;
+    (void)data;
+    (void)dataLength;
+
+    CU_ASSERT_PTR_EQUAL(userData, g_conns);
+    g_resultCount++;
+    g_statusCount[(status == COAP_NO_ERROR || (status >> 5) == 2) ? 0 : 1]++;
+    g_lastStatus = status;
+}
+
+static void prv_doneCallback(lwm2m_bulk_t * bulkP,
+                             lwm2m_bulk_progress_t * progressP,
+                             void * userData)
+{
+    (void)bulkP;
+
+    CU_ASSERT_PTR_EQUAL(userData, g_conns);
+    g_doneCount++;
+    memcpy(&g_progress, progressP, sizeof(lwm2m_bulk_progress_t));
+}
+
+static bool prv_filter(lwm2m_client_t * clientP,
+                       void * userData)
+{
+    // all but the first client
+    return clientP->internalID != *(uint16_t *)userData;
+}
+
+static lwm2m_context_t * prv_setup(void)
+{
+    lwm2m_context_t * contextP;
+    int i;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    for (i = 0 ; i < TEST_CLIENT_COUNT ; i++)
+    {
+        CU_ASSERT_TRUE_FATAL(test_openLoopback(g_conns + i));
+        g_clientIDs[i] = test_addClient(contextP, g_conns + i);
+    }
+    g_resultCount = 0;
+    g_statusCount[0] = 0;
+    g_statusCount[1] = 0;
+    g_doneCount = 0;
+
+    return contextP;
+}
+
+static void prv_teardown(lwm2m_context_t * contextP)
+{
+    int i;
+
+    lwm2m_close(contextP);
+    for (i = 0 ; i < TEST_CLIENT_COUNT ; i++)
+    {
+        close(g_conns[i].sock);
+    }
+}
+
+// Returns the number of requests received by the clients, kept in g_requests.
+static int prv_receive(bool * receivedP)
+{
+    int count;
+    int i;
+
+    count = 0;
+    for (i = 0 ; i < TEST_CLIENT_COUNT ; i++)
+    {
+        receivedP[i] = test_receive(g_conns + i, g_requests + i, g_buffers[i], sizeof(g_buffers[i]));
+        if (receivedP[i]) count++;
+    }
+
+    return count;
+}
+
+static void prv_answer(lwm2m_context_t * contextP,
+                       int i,
+                       uint8_t code,
+                       bool observe)
+{
+    coap_packet_t response;
+
+    test_initAnswer(&response, g_requests + i, COAP_TYPE_ACK, code);
+    if (observe) coap_set_header_observe(&response, 1);
+    test_deliver(contextP, g_conns + i, &response);
+}
+
+static void prv_step(lwm2m_context_t * contextP,
+                     time_t currentTime)
+{
+    time_t timeout = 60;
+
+    timer_step(contextP, currentTime, &timeout);
+}
+
+static void test_bulk_write(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_bulk_request_t request;
+    lwm2m_bulk_t * bulkP;
+    bool received[TEST_CLIENT_COUNT];
+    int answered;
+    int round;
+    int i;
+
+    contextP = prv_setup();
+
+    memset(&request, 0, sizeof(request));
+    request.operation = LWM2M_BULK_WRITE;
+    lwm2m_stringToUri("/1024/0/1", 9, &request.uri);
+    request.format = LWM2M_CONTENT_TEXT;
+    request.buffer = (uint8_t *)TEST_PAYLOAD;
+    request.length = 0;
+    request.filter = prv_filter;
+    request.filterData = g_clientIDs;
+    request.concurrency = 2;
+    CU_ASSERT_EQUAL(lwm2m_bulk_start(contextP, &request, prv_resultCallback, prv_doneCallback, g_conns, &bulkP), COAP_400_BAD_REQUEST);
+    request.length = strlen(TEST_PAYLOAD);
+    CU_ASSERT_EQUAL(lwm2m_bulk_start(contextP, &request, prv_resultCallback, prv_doneCallback, g_conns, &bulkP), COAP_NO_ERROR);
+    CU_ASSERT_EQUAL(bulkP->progress.total, TEST_CLIENT_COUNT - 1);
+
+    // nothing is sent before the next step, then as many requests as allowed in flight
+    CU_ASSERT_EQUAL(prv_receive(received), 0);
+    prv_step(contextP, lwm2m_gettime());
+    CU_ASSERT_EQUAL(prv_receive(received), 2);
+    CU_ASSERT_FALSE(received[0]);
+    CU_ASSERT_EQUAL(bulkP->progress.inFlight, 2);
+
+    // each answer lets another request go, the first client is not targeted
+    answered = 0;
+    for (round = 0 ; round < TEST_CLIENT_COUNT && answered < TEST_CLIENT_COUNT - 1 ; round++)
+    {
+        for (i = 1 ; i < TEST_CLIENT_COUNT ; i++)
+        {
+            if (!received[i]) continue;
+            CU_ASSERT_EQUAL(g_requests[i].payload_len, strlen(TEST_PAYLOAD));
+            CU_ASSERT(0 == memcmp(g_requests[i].payload, TEST_PAYLOAD, strlen(TEST_PAYLOAD)));
+            prv_answer(contextP, i, i == 3 ? COAP_404_NOT_FOUND : COAP_204_CHANGED, false);
+            answered++;
+        }
+        CU_ASSERT_EQUAL(g_resultCount, answered);
+        prv_step(contextP, lwm2m_gettime());
+        CU_ASSERT(prv_receive(received) <= 2);
+    }
+
+    CU_ASSERT_EQUAL(g_doneCount, 1);
+    CU_ASSERT_EQUAL(g_progress.total, TEST_CLIENT_COUNT - 1);
+    CU_ASSERT_EQUAL(g_progress.started, TEST_CLIENT_COUNT - 1);
+    CU_ASSERT_EQUAL(g_progress.inFlight, 0);
+    CU_ASSERT_EQUAL(g_progress.succeeded, TEST_CLIENT_COUNT - 2);
+    CU_ASSERT_EQUAL(g_progress.failed, 1);
+    CU_ASSERT_EQUAL(g_statusCount[1], 1);
+    CU_ASSERT_PTR_NULL(contextP->bulkList);
+
+    prv_teardown(contextP);
+}
+
+static void test_bulk_rate(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_bulk_request_t request;
+    lwm2m_bulk_t * bulkP;
+    bool received[TEST_CLIENT_COUNT];
+    uint16_t clientIDs[TEST_CLIENT_COUNT + 1];
+    time_t now;
+    int i;
+
+    contextP = prv_setup();
+
+    // an unknown client fails without a request
+    clientIDs[0] = LWM2M_MAX_ID - 1;
+    memcpy(clientIDs + 1, g_clientIDs, sizeof(g_clientIDs));
+    memset(&request, 0, sizeof(request));
+    request.operation = LWM2M_BULK_READ;
+    lwm2m_stringToUri("/3/0", 4, &request.uri);
+    request.clientIDs = clientIDs;
+    request.clientCount = TEST_CLIENT_COUNT + 1;
+    request.rate = 3;
+    CU_ASSERT_EQUAL(lwm2m_bulk_start(contextP, &request, prv_resultCallback, prv_doneCallback, g_conns, &bulkP), COAP_NO_ERROR);
+
+    now = lwm2m_gettime();
+    prv_step(contextP, now);
+    CU_ASSERT_EQUAL(prv_receive(received), 2);
+    CU_ASSERT_EQUAL(g_resultCount, 1);
+    CU_ASSERT_EQUAL(g_lastStatus, COAP_404_NOT_FOUND);
+    for (i = 0 ; i < TEST_CLIENT_COUNT ; i++)
+    {
+        if (received[i]) prv_answer(contextP, i, COAP_205_CONTENT, false);
+    }
+    prv_step(contextP, now);
+    CU_ASSERT_EQUAL(prv_receive(received), 0);
+
+    // the following second
+    prv_step(contextP, now + 1);
+    CU_ASSERT_EQUAL(prv_receive(received), 3);
+    CU_ASSERT_EQUAL(bulkP->progress.started, 6);
+
+    // the last requests are not started
+    lwm2m_bulk_cancel(contextP, bulkP);
+    for (i = 0 ; i < TEST_CLIENT_COUNT ; i++)
+    {
+        if (received[i]) prv_answer(contextP, i, COAP_205_CONTENT, false);
+    }
+    prv_step(contextP, now + 1);
+    CU_ASSERT_EQUAL(prv_receive(received), 0);
+    CU_ASSERT_EQUAL(g_doneCount, 1);
+    CU_ASSERT_EQUAL(g_progress.total, TEST_CLIENT_COUNT + 1);
+    CU_ASSERT_EQUAL(g_progress.started, 6);
+    CU_ASSERT_EQUAL(g_progress.succeeded, 5);
+    CU_ASSERT_EQUAL(g_progress.failed, 1);
+    CU_ASSERT_PTR_NULL(contextP->bulkList);
+
+    prv_teardown(contextP);
+}
+
+static void test_bulk_observe(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_bulk_request_t request;
+    coap_packet_t notify;
+    bool received[TEST_CLIENT_COUNT];
+    int i;
+
+    contextP = prv_setup();
+
+    memset(&request, 0, sizeof(request));
+    request.operation = LWM2M_BULK_OBSERVE;
+    lwm2m_stringToUri("/3/0/9", 6, &request.uri);
+    CU_ASSERT_EQUAL(lwm2m_bulk_start(contextP, &request, prv_resultCallback, prv_doneCallback, g_conns, NULL), COAP_NO_ERROR);
+    prv_step(contextP, lwm2m_gettime());
+    CU_ASSERT_EQUAL(prv_receive(received), TEST_CLIENT_COUNT);
+    // an observation canceled before the client answers still finishes its request
+    CU_ASSERT_EQUAL(lwm2m_observe_cancel(contextP, g_clientIDs[1], &request.uri, NULL, NULL), COAP_NO_ERROR);
+    for (i = 0 ; i < TEST_CLIENT_COUNT ; i++)
+    {
+        prv_answer(contextP, i, COAP_205_CONTENT, true);
+    }
+    CU_ASSERT_EQUAL(g_lastStatus, COAP_NO_ERROR);
+    prv_step(contextP, lwm2m_gettime());
+    CU_ASSERT_EQUAL(g_doneCount, 1);
+    CU_ASSERT_EQUAL(g_progress.succeeded, TEST_CLIENT_COUNT - 1);
+    CU_ASSERT_EQUAL(g_progress.failed, 1);
+    CU_ASSERT_EQUAL(g_progress.inFlight, 0);
+    CU_ASSERT_PTR_NULL(contextP->bulkList);
+
+    // the notifications reach the application once the bulk is gone
+    g_resultCount = 0;
+    test_initAnswer(&notify, g_requests + 2, COAP_TYPE_NON, COAP_205_CONTENT);
+    coap_set_header_observe(&notify, 2);
+    test_deliver(contextP, g_conns + 2, &notify);
+    CU_ASSERT_EQUAL(g_resultCount, 1);
+
+    prv_teardown(contextP);
+}
+
+static struct TestTable table[] = {
+        { "test of test_bulk_write()", test_bulk_write },
+        { "test of test_bulk_rate()", test_bulk_rate },
+        { "test of test_bulk_observe()", test_bulk_observe },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_bulk_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_bulk", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
@@ -0,0 +1,135 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+#include "connection.h"
+#include "testhelpers.h"
+
+static int g_readTag;
+static int g_observeTag;
+
+// Plays the client: answers the request it received, or sends a notification of the observation when type is NON.
+static void prv_answer(lwm2m_context_t * contextP,
+                       connection_t * connP,
+                       coap_packet_t * requestP,
+                       coap_message_type_t type,
+                       int observe,
+                       const char * payload)
+{
+    coap_packet_t response;
+
+    test_initAnswer(&response, requestP, type, COAP_205_CONTENT);
+    coap_set_header_content_type(&response, LWM2M_CONTENT_TEXT);
+    if (observe >= 0) coap_set_header_observe(&response, observe);
+    coap_set_payload(&response, payload, strlen(payload));
+    test_deliver(contextP, connP, &response);
+}
+
+static void test_completion_queue(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_completion_t records[4];
+    coap_packet_t read;
+    coap_packet_t observe;
+    uint8_t readBuffer[256];
+    uint8_t observeBuffer[256];
+    connection_t conn;
+    lwm2m_uri_t uri;
+    uint16_t clientID;
+
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    clientID = test_addClient(contextP, &conn);
+    lwm2m_stringToUri("/3303/0/5700", 12, &uri);
+
+    // without a queue, the result of a request without a callback is dropped
+    CU_ASSERT_EQUAL(lwm2m_dm_read(contextP, clientID, &uri, NULL, &g_readTag), 0);
+    CU_ASSERT_TRUE_FATAL(test_receive(&conn, &read, readBuffer, sizeof(readBuffer)));
+    prv_answer(contextP, &conn, &read, COAP_TYPE_ACK, -1, "21.5");
+    CU_ASSERT_EQUAL(lwm2m_poll_completions(contextP, records, 4), 0);
+
+    CU_ASSERT_EQUAL(lwm2m_set_completion_queue(contextP, 2), COAP_NO_ERROR);
+
+    // a read
+    CU_ASSERT_EQUAL(lwm2m_dm_read(contextP, clientID, &uri, NULL, &g_readTag), 0);
+    CU_ASSERT_TRUE_FATAL(test_receive(&conn, &read, readBuffer, sizeof(readBuffer)));
+    prv_answer(contextP, &conn, &read, COAP_TYPE_ACK, -1, "21.5");
+    // the packet is gone, the record keeps a copy of the payload
+    memset(readBuffer, 0, sizeof(readBuffer));
+    CU_ASSERT_EQUAL_FATAL(lwm2m_poll_completions(contextP, records, 4), 1);
+    CU_ASSERT_PTR_EQUAL(records[0].userData, &g_readTag);
+    CU_ASSERT_EQUAL(records[0].clientID, clientID);
+    CU_ASSERT_EQUAL(records[0].uri.resourceId, 5700);
+    CU_ASSERT_EQUAL(records[0].status, COAP_205_CONTENT);
+    CU_ASSERT_EQUAL(records[0].format, LWM2M_CONTENT_TEXT);
+    CU_ASSERT_EQUAL_FATAL(records[0].dataLength, 4);
+    CU_ASSERT(0 == memcmp(records[0].data, "21.5", 4));
+    lwm2m_free(records[0].data);
+    CU_ASSERT_EQUAL(lwm2m_poll_completions(contextP, records, 4), 0);
+
+    // an observation and its notifications
+    CU_ASSERT_EQUAL(lwm2m_observe(contextP, clientID, &uri, NULL, &g_observeTag), 0);
+    CU_ASSERT_TRUE_FATAL(test_receive(&conn, &observe, observeBuffer, sizeof(observeBuffer)));
+    prv_answer(contextP, &conn, &observe, COAP_TYPE_ACK, 1, "21.5");
+    prv_answer(contextP, &conn, &observe, COAP_TYPE_NON, 2, "22.0");
+    // the queue is full
+    prv_answer(contextP, &conn, &observe, COAP_TYPE_NON, 3, "22.5");
+    CU_ASSERT_EQUAL(contextP->completions.count, 2);
+    CU_ASSERT_EQUAL(contextP->completions.dropped, 1);
+
+    // the records keep their order when the queue grows
+    CU_ASSERT_EQUAL(lwm2m_set_completion_queue(contextP, 1), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL_FATAL(lwm2m_poll_completions(contextP, records, 1), 1);
+    CU_ASSERT_EQUAL(lwm2m_set_completion_queue(contextP, 4), COAP_NO_ERROR);
+    prv_answer(contextP, &conn, &observe, COAP_TYPE_NON, 4, "23.0");
+    CU_ASSERT_EQUAL_FATAL(lwm2m_poll_completions(contextP, records + 1, 3), 2);
+    CU_ASSERT_PTR_EQUAL(records[0].userData, &g_observeTag);
+    CU_ASSERT_EQUAL(records[0].status, 0);
+    CU_ASSERT_EQUAL(records[1].status, 2);
+    CU_ASSERT_EQUAL(records[2].status, 4);
+    CU_ASSERT_PTR_EQUAL(records[2].userData, &g_observeTag);
+    CU_ASSERT(0 == memcmp(records[2].data, "23.0", 4));
+    lwm2m_free(records[0].data);
+    lwm2m_free(records[1].data);
+    lwm2m_free(records[2].data);
+
+    // the records left are freed with the context
+    prv_answer(contextP, &conn, &observe, COAP_TYPE_NON, 5, "23.5");
+    CU_ASSERT_EQUAL(contextP->completions.count, 1);
+
+    lwm2m_close(contextP);
+    close(conn.sock);
+}
+
+static struct TestTable table[] = {
+        { "test of test_completion_queue()", test_completion_queue },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_completion_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_completion", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
@@ -0,0 +1,375 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+#include "connection.h"
+#include "eventloop.h"
+#include "testhelpers.h"
+
+#include <time.h>
+
+#define LOOKUP_COUNT    200000
+#define LINEAR_MAX      10000
+#define PEER_COUNT      3
+
+// Peers are spread over 10.x.y.z:5683
+static connection_t * prv_createPeers(int count)
+{
+    connection_t * peers;
+    int i;
+
+    peers = (connection_t *)malloc(count * sizeof(connection_t));
+    if (peers == NULL) return NULL;
+    memset(peers, 0, count * sizeof(connection_t));
+
+    for (i = 0 ; i < count ; i++)
+    {
+        struct sockaddr_in * addrP = (struct sockaddr_in *)&(peers[i].addr);
+
+        addrP->sin_family = AF_INET;
+        addrP->sin_addr.s_addr = htonl(0x0A000000 + i);
+        addrP->sin_port = htons(LWM2M_STANDARD_PORT);
+        peers[i].addrLen = sizeof(struct sockaddr_in);
+        peers[i].next = i + 1 < count ? peers + i + 1 : NULL;
+    }
+
+    return peers;
+}
+
+static void test_connection_table(void)
+{
+    connection_table_t table;
+    connection_t * peers;
+    int count = 1000;
+    int i;
+
+    peers = prv_createPeers(count);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(peers);
+    CU_ASSERT_EQUAL_FATAL(connection_table_init(&table), 0);
+
+    for (i = 0 ; i < count ; i++)
+    {
+        CU_ASSERT_EQUAL(connection_table_add(&table, peers + i), 0);
+    }
+    CU_ASSERT_EQUAL(table.count, count);
+    // the table grew past its initial size
+    CU_ASSERT_TRUE(table.size >= (size_t)count);
+
+    for (i = 0 ; i < count ; i++)
+    {
+        CU_ASSERT_PTR_EQUAL(connection_table_find(&table, (struct sockaddr_storage *)&(peers[i].addr), peers[i].addrLen), peers + i);
+    }
+
+    // even peers leave
+    for (i = 0 ; i < count ; i += 2)
+    {
+        connection_table_remove(&table, peers + i);
+    }
+    CU_ASSERT_EQUAL(table.count, count / 2);
+    for (i = 0 ; i < count ; i++)
+    {
+        connection_t * connP;
+
+        connP = connection_table_find(&table, (struct sockaddr_storage *)&(peers[i].addr), peers[i].addrLen);
+        CU_ASSERT_PTR_EQUAL(connP, (i % 2) ? peers + i : NULL);
+    }
+
+    connection_table_close(&table);
+    free(peers);
+}
+
+static double prv_measureLookups(connection_table_t * tableP,
+                                 connection_t * peers,
+                                 int count)
+{
+    clock_t start;
+    int found;
+    int i;
+
+    found = 0;
+    start = clock();
+    for (i = 0 ; i < LOOKUP_COUNT ; i++)
+    {
+        connection_t * connP = peers + (i * 7919) % count;
+
+        if (tableP != NULL)
+        {
+            if (connection_table_find(tableP, (struct sockaddr_storage *)&(connP->addr), connP->addrLen) == connP) found++;
+        }
+        else
+        {
+            if (connection_find(peers, (struct sockaddr_storage *)&(connP->addr), connP->addrLen) == connP) found++;
+        }
+    }
+    CU_ASSERT_EQUAL(found, LOOKUP_COUNT);
+
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / LOOKUP_COUNT;
+}
+
+static void test_connection_benchmark(void)
+{
+    int sizes[] = { 100, 1000, 10000, 100000 };
+    size_t i;
+
+    for (i = 0 ; i < sizeof(sizes) / sizeof(sizes[0]) ; i++)
+    {
+        connection_table_t table;
+        connection_t * peers;
+        int j;
+
+        peers = prv_createPeers(sizes[i]);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(peers);
+        CU_ASSERT_EQUAL_FATAL(connection_table_init(&table), 0);
+        for (j = 0 ; j < sizes[i] ; j++)
+        {
+            CU_ASSERT_EQUAL_FATAL(connection_table_add(&table, peers + j), 0);
+        }
+
+        printf("\n    %6d peers: %.1f ns per lookup", sizes[i], prv_measureLookups(&table, peers, sizes[i]));
+        // the linear scan gets too slow to measure past that
+        if (sizes[i] <= LINEAR_MAX)
+        {
+            printf(" (linear scan: %.1f ns)", prv_measureLookups(NULL, peers, sizes[i]));
+        }
+
+        connection_table_close(&table);
+        free(peers);
+    }
+    printf("\n");
+}
+
+static int prv_openLoopback(struct sockaddr_in * addrP)
+{
+    socklen_t addrLen;
+    int sock;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) return -1;
+
+    memset(addrP, 0, sizeof(struct sockaddr_in));
+    addrP->sin_family = AF_INET;
+    addrP->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addrLen = sizeof(struct sockaddr_in);
+    if (0 != bind(sock, (struct sockaddr *)addrP, addrLen)
+     || 0 != getsockname(sock, (struct sockaddr *)addrP, &addrLen))
+    {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+// The tests are built in client mode too: lwm2m_step() needs a registered server.
+static lwm2m_context_t * prv_newContext(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_server_t * serverP;
+
+    contextP = lwm2m_init(NULL);
+    if (contextP == NULL) return NULL;
+    serverP = (lwm2m_server_t *)lwm2m_malloc(sizeof(lwm2m_server_t));
+    if (serverP == NULL)
+    {
+        lwm2m_close(contextP);
+        return NULL;
+    }
+    memset(serverP, 0, sizeof(lwm2m_server_t));
+    serverP->status = STATE_REGISTERED;
+    serverP->registration = lwm2m_gettime();
+    serverP->lifetime = 86400;
+    contextP->serverList = serverP;
+    contextP->state = STATE_READY;
+
+    return contextP;
+}
+
+static void prv_closeContext(lwm2m_context_t * contextP)
+{
+    contextP->serverList->status = STATE_DEREGISTERED;
+    lwm2m_close(contextP);
+}
+
+static void test_connection_event_loop(void)
+{
+    // unexpected confirmable 2.05 response, acknowledged by an empty ACK
+    uint8_t request[] = { 0x40, COAP_205_CONTENT, 0x12, 0x00 };
+    struct sockaddr_in serverAddr;
+    struct sockaddr_in peerAddr;
+    int peers[PEER_COUNT];
+    lwm2m_context_t * contextP;
+    event_loop_t * loopP;
+    int sock;
+    int round;
+    int i;
+
+    contextP = prv_newContext();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    sock = prv_openLoopback(&serverAddr);
+    CU_ASSERT_TRUE_FATAL(sock >= 0);
+    loopP = event_loop_new(contextP);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(loopP);
+    CU_ASSERT_EQUAL_FATAL(event_loop_add_socket(loopP, sock), 0);
+    for (i = 0 ; i < PEER_COUNT ; i++)
+    {
+        peers[i] = prv_openLoopback(&peerAddr);
+        CU_ASSERT_TRUE_FATAL(peers[i] >= 0);
+    }
+
+    for (round = 0 ; round < 2 ; round++)
+    {
+        for (i = 0 ; i < PEER_COUNT ; i++)
+        {
+            request[3] = (uint8_t)(round * PEER_COUNT + i);
+            CU_ASSERT_EQUAL(sendto(peers[i], request, sizeof(request), 0, (struct sockaddr *)&serverAddr, sizeof(serverAddr)), sizeof(request));
+        }
+
+        // the datagrams are all waiting, one iteration handles them
+        CU_ASSERT_EQUAL(event_loop_step(loopP, 1000), 0);
+        CU_ASSERT_EQUAL(event_loop_peer_count(loopP), PEER_COUNT);
+
+        for (i = 0 ; i < PEER_COUNT ; i++)
+        {
+            uint8_t reply[16];
+
+            CU_ASSERT_EQUAL(recv(peers[i], reply, sizeof(reply), MSG_DONTWAIT), 4);
+            CU_ASSERT_EQUAL(reply[0] & 0x30, COAP_TYPE_ACK << 4);
+            CU_ASSERT_EQUAL(reply[3], round * PEER_COUNT + i);
+        }
+    }
+
+    event_loop_free(loopP);
+    for (i = 0 ; i < PEER_COUNT ; i++)
+    {
+        close(peers[i]);
+    }
+    close(sock);
+    prv_closeContext(contextP);
+}
+
+static long prv_elapsedMs(struct timespec * startP)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - startP->tv_sec) * 1000 + (now.tv_nsec - startP->tv_nsec) / 1000000;
+}
+
+static void prv_timerCallback(lwm2m_context_t * contextP,
+                              void * userData,
+                              time_t currentTime)
+{
+    (void)contextP;
+    (void)userData;
+    (void)currentTime;
+}
+
+static void test_connection_event_loop_timeout(void)
+{
+    lwm2m_context_t * contextP;
+    event_loop_t * loopP;
+    lwm2m_timer_t timer;
+    struct timespec start;
+    long elapsed;
+
+    contextP = prv_newContext();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    loopP = event_loop_new(contextP);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(loopP);
+
+    // a timeout under a second is waited for, not rounded down to an immediate return
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    CU_ASSERT_EQUAL(event_loop_step(loopP, 300), 0);
+    elapsed = prv_elapsedMs(&start);
+    CU_ASSERT(elapsed >= 250);
+    CU_ASSERT(elapsed < 1000);
+
+    // an infinite timeout ends when the next lwm2m_step() is due
+    memset(&timer, 0, sizeof(timer));
+    timer.callback = prv_timerCallback;
+    CU_ASSERT_EQUAL_FATAL(timer_schedule(contextP, &timer, lwm2m_gettime() + 2), 1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    CU_ASSERT_EQUAL(event_loop_step(loopP, -1), 0);
+    elapsed = prv_elapsedMs(&start);
+    CU_ASSERT(elapsed >= 1000);
+    CU_ASSERT(elapsed < 3000);
+    timer_cancel(contextP, &timer);
+
+    event_loop_free(loopP);
+    prv_closeContext(contextP);
+}
+
+static void test_connection_batch(void)
+{
+    uint8_t large[CONNECTION_BATCH_PACKET_SIZE + 100];
+    uint8_t buffer[sizeof(large)];
+    connection_batch_t * rxBatchP;
+    connection_batch_t * txBatchP;
+    connection_t conn;
+
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    rxBatchP = connection_batch_new();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rxBatchP);
+    txBatchP = connection_batch_new();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(txBatchP);
+    memset(large, 0xAB, sizeof(large));
+
+    // a datagram larger than the buffers is dropped rather than cut
+    CU_ASSERT_EQUAL(connection_send(&conn, (uint8_t *)"one", 3), 0);
+    CU_ASSERT_EQUAL(connection_send(&conn, large, sizeof(large)), 0);
+    CU_ASSERT_EQUAL(connection_send(&conn, (uint8_t *)"two", 3), 0);
+    CU_ASSERT_EQUAL_FATAL(connection_batch_receive(rxBatchP, conn.sock), 2);
+    CU_ASSERT_EQUAL(rxBatchP->length[0], 3);
+    CU_ASSERT(0 == memcmp(rxBatchP->buffer[0], "one", 3));
+    CU_ASSERT_EQUAL(rxBatchP->length[1], 3);
+    CU_ASSERT(0 == memcmp(rxBatchP->buffer[1], "two", 3));
+
+    // a datagram too large to be queued does not overtake the queued ones
+    conn.txBatchP = txBatchP;
+    CU_ASSERT_EQUAL(connection_send(&conn, (uint8_t *)"one", 3), 0);
+    CU_ASSERT_EQUAL(recv(conn.sock, buffer, sizeof(buffer), MSG_DONTWAIT), -1);
+    CU_ASSERT_EQUAL(connection_send(&conn, large, sizeof(large)), 0);
+    CU_ASSERT_EQUAL(txBatchP->count, 0);
+    CU_ASSERT_EQUAL(recv(conn.sock, buffer, sizeof(buffer), MSG_DONTWAIT), 3);
+    CU_ASSERT_EQUAL(recv(conn.sock, buffer, sizeof(buffer), MSG_DONTWAIT), sizeof(large));
+
+    connection_batch_free(rxBatchP);
+    connection_batch_free(txBatchP);
+    close(conn.sock);
+}
+
+static struct TestTable table[] = {
+        { "test of test_connection_table()", test_connection_table },
+        { "test of test_connection_benchmark()", test_connection_benchmark },
+        { "test of test_connection_event_loop()", test_connection_event_loop },
+        { "test of test_connection_event_loop_timeout()", test_connection_event_loop_timeout },
+        { "test of test_connection_batch()", test_connection_batch },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_connection_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_connection", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
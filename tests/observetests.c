@@ -0,0 +1,308 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+#include "connection.h"
+#include "testhelpers.h"
+
+#define TEST_OBJECT_ID      1024
+#define TEST_RESOURCE_ID    1
+#define TEST_SERVER_COUNT   6
+
+static int64_t g_value = 0;
+static int g_readCount = 0;
+static void * g_released = NULL;
+static int g_releaseCount = 0;
+
+static uint8_t prv_read(uint16_t instanceId,
+                        int * numDataP,
+                        lwm2m_data_t ** dataArrayP,
+                        lwm2m_object_t * objectP)
+{
+    (void)instanceId;
+    (void)objectP;
+
+    if (*numDataP == 0)
+    {
+        *dataArrayP = lwm2m_data_new(1);
+        if (*dataArrayP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+        *numDataP = 1;
+        (*dataArrayP)->id = TEST_RESOURCE_ID;
+    }
+    if ((*dataArrayP)->id != TEST_RESOURCE_ID) return COAP_404_NOT_FOUND;
+
+    g_readCount++;
+    lwm2m_data_encode_int(g_value, *dataArrayP);
+
+    return COAP_205_CONTENT;
+}
+
+// Sends a CON GET /1024/0/1, or /1024/0, with the Observe option and returns the content format of the reply.
+static int prv_observe(lwm2m_context_t * contextP,
+                       connection_t * connP,
+                       uint8_t token,
+                       uint16_t accept,
+                       bool resource)
+{
+    uint8_t request[] = { 0x41, COAP_GET, 0x00, token, token,
+                          0x60,
+                          0x54, '1', '0', '2', '4', 0x01, '0', 0x01, '1',
+                          0x62, (uint8_t)(accept >> 8), (uint8_t)accept };
+    size_t length = sizeof(request);
+    uint8_t reply[COAP_MAX_PACKET_SIZE];
+    coap_packet_t message;
+
+    if (!resource)
+    {
+        // without the last Uri-Path option
+        memmove(request + 13, request + 15, sizeof(request) - 15);
+        length -= 2;
+    }
+    lwm2m_handle_packet(contextP, request, (int)length, connP);
+
+    if (!test_receive(connP, &message, reply, sizeof(reply))) return -1;
+    if (message.code != COAP_205_CONTENT) return -1;
+
+    return message.content_type;
+}
+
+static void prv_fanOut(uint16_t formats[TEST_SERVER_COUNT],
+                       bool resource)
+{
+    connection_t conn[TEST_SERVER_COUNT];
+    lwm2m_context_t * contextP;
+    lwm2m_server_t * serverP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_uri_t uri;
+    time_t timeout;
+    int i;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    memset(&instance, 0, sizeof(instance));
+    memset(&object, 0, sizeof(object));
+    object.objID = TEST_OBJECT_ID;
+    object.instanceList = &instance;
+    object.readFunc = prv_read;
+    contextP->objectList = &object;
+
+    for (i = 0 ; i < TEST_SERVER_COUNT ; i++)
+    {
+        CU_ASSERT_TRUE_FATAL(test_openLoopback(conn + i));
+        serverP = (lwm2m_server_t *)lwm2m_malloc(sizeof(lwm2m_server_t));
+        CU_ASSERT_PTR_NOT_NULL_FATAL(serverP);
+        memset(serverP, 0, sizeof(lwm2m_server_t));
+        serverP->shortID = i + 1;
+        serverP->sessionH = conn + i;
+        serverP->status = STATE_REGISTERED;
+        contextP->serverList = (lwm2m_server_t *)LWM2M_LIST_ADD(contextP->serverList, serverP);
+
+        CU_ASSERT_EQUAL(prv_observe(contextP, conn + i, 0x10 + i, formats[i], resource), formats[i]);
+    }
+
+    g_value = 42;
+    g_readCount = 0;
+    memset(&uri, 0, sizeof(uri));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = TEST_OBJECT_ID;
+    uri.instanceId = 0;
+    uri.resourceId = TEST_RESOURCE_ID;
+    lwm2m_resource_value_changed(contextP, &uri);
+    timeout = 60;
+    timer_step(contextP, lwm2m_gettime(), &timeout);
+
+    // the value is read once for all the watchers, whatever their formats
+    CU_ASSERT_EQUAL(g_readCount, 1);
+
+    for (i = 0 ; i < TEST_SERVER_COUNT ; i++)
+    {
+        uint8_t buffer[COAP_MAX_PACKET_SIZE];
+        coap_packet_t message;
+
+        CU_ASSERT_TRUE_FATAL(test_receive(conn + i, &message, buffer, sizeof(buffer)));
+        CU_ASSERT_EQUAL(message.type, COAP_TYPE_NON);
+        CU_ASSERT_EQUAL(message.code, COAP_205_CONTENT);
+        CU_ASSERT_EQUAL(message.token_len, 1);
+        CU_ASSERT_EQUAL(message.token[0], 0x10 + i);
+        // every watcher gets the format it asked for
+        CU_ASSERT_EQUAL(message.content_type, formats[i]);
+        if (!resource) continue;
+        if (formats[i] == LWM2M_CONTENT_TEXT)
+        {
+            CU_ASSERT_EQUAL(message.payload_len, 2);
+            CU_ASSERT_NSTRING_EQUAL(message.payload, "42", 2);
+        }
+        else if (formats[i] == LWM2M_CONTENT_SENML_CBOR)
+        {
+            lwm2m_data_t * dataP;
+            int64_t value;
+
+            CU_ASSERT_EQUAL_FATAL(lwm2m_data_parse(&uri, message.payload, message.payload_len, LWM2M_CONTENT_SENML_CBOR, &dataP), 1);
+            CU_ASSERT_EQUAL(lwm2m_data_decode_int(dataP, &value), 1);
+            CU_ASSERT_EQUAL(value, 42);
+            lwm2m_data_free(1, dataP);
+        }
+    }
+
+    for (i = 0 ; i < TEST_SERVER_COUNT ; i++)
+    {
+        close(conn[i].sock);
+    }
+    for (serverP = contextP->serverList ; serverP != NULL ; serverP = serverP->next)
+    {
+        serverP->status = STATE_DEREGISTERED;
+    }
+    contextP->objectList = NULL;
+    lwm2m_close(contextP);
+}
+
+static void test_observe_fan_out(void)
+{
+    uint16_t formats[TEST_SERVER_COUNT] = { LWM2M_CONTENT_TEXT, LWM2M_CONTENT_TLV, LWM2M_CONTENT_SENML_CBOR,
+                                            LWM2M_CONTENT_JSON, LWM2M_CONTENT_TLV_OLD, LWM2M_CONTENT_JSON_OLD };
+
+    prv_fanOut(formats, true);
+}
+
+static void test_observe_fan_out_instance(void)
+{
+    // an instance has no plain text representation
+    uint16_t formats[TEST_SERVER_COUNT] = { LWM2M_CONTENT_TLV, LWM2M_CONTENT_SENML_CBOR, LWM2M_CONTENT_JSON,
+                                            LWM2M_CONTENT_TLV_OLD, LWM2M_CONTENT_JSON_OLD, LWM2M_CONTENT_TLV };
+
+    prv_fanOut(formats, false);
+}
+
+static void prv_resultCallback(uint16_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int status,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    (void)clientID;
+    (void)uriP;
+    (void)status;
+    (void)format;
+    (void)data;
+    (void)dataLength;
+    (void)userData;
+}
+
+static void prv_releaseCallback(uint16_t clientID,
+                                lwm2m_uri_t * uriP,
+                                lwm2m_result_callback_t callback,
+                                void * userData,
+                                void * releaseUserData)
+{
+    (void)clientID;
+    (void)uriP;
+    (void)releaseUserData;
+
+    CU_ASSERT(callback == prv_resultCallback);
+    g_released = userData;
+    g_releaseCount++;
+}
+
+// Answers the observe request the client reached through connP got.
+static void prv_answerObserve(lwm2m_context_t * contextP,
+                              connection_t * connP,
+                              uint8_t code)
+{
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    coap_packet_t request;
+    coap_packet_t message;
+
+    CU_ASSERT_TRUE_FATAL(test_receive(connP, &request, buffer, sizeof(buffer)));
+    test_initAnswer(&message, &request, COAP_TYPE_ACK, code);
+    if (code == COAP_205_CONTENT) coap_set_header_observe(&message, 1);
+    test_deliver(contextP, connP, &message);
+}
+
+static void test_observe_release(void)
+{
+    connection_t conn;
+    lwm2m_context_t * contextP;
+    lwm2m_uri_t uri;
+    uint16_t clientID;
+    int first;
+    int second;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    lwm2m_set_observe_release_callback(contextP, prv_releaseCallback, NULL);
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    clientID = test_addClient(contextP, &conn);
+    g_releaseCount = 0;
+
+    memset(&uri, 0, sizeof(uri));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = TEST_OBJECT_ID;
+    uri.instanceId = 0;
+    uri.resourceId = TEST_RESOURCE_ID;
+
+    // observing again with the same callback and userData keeps the observation
+    CU_ASSERT_EQUAL(lwm2m_observe(contextP, clientID, &uri, prv_resultCallback, &first), 0);
+    prv_answerObserve(contextP, &conn, COAP_205_CONTENT);
+    CU_ASSERT_EQUAL(lwm2m_observe(contextP, clientID, &uri, prv_resultCallback, &first), 0);
+    prv_answerObserve(contextP, &conn, COAP_205_CONTENT);
+    CU_ASSERT_EQUAL(g_releaseCount, 0);
+
+    // another userData takes the observation over
+    CU_ASSERT_EQUAL(lwm2m_observe(contextP, clientID, &uri, prv_resultCallback, &second), 0);
+    CU_ASSERT_EQUAL(g_releaseCount, 1);
+    CU_ASSERT_PTR_EQUAL(g_released, &first);
+
+    // an error to the observe request ends the observation
+    prv_answerObserve(contextP, &conn, COAP_404_NOT_FOUND);
+    CU_ASSERT_EQUAL(g_releaseCount, 2);
+    CU_ASSERT_PTR_EQUAL(g_released, &second);
+    CU_ASSERT_PTR_NULL(lwm2m_get_client(contextP, clientID)->observationList);
+
+    // the observations left are released with their client
+    CU_ASSERT_EQUAL(lwm2m_observe(contextP, clientID, &uri, prv_resultCallback, &first), 0);
+    prv_answerObserve(contextP, &conn, COAP_205_CONTENT);
+    CU_ASSERT_EQUAL(g_releaseCount, 2);
+    lwm2m_close(contextP);
+    CU_ASSERT_EQUAL(g_releaseCount, 3);
+    CU_ASSERT_PTR_EQUAL(g_released, &first);
+
+    close(conn.sock);
+}
+
+static struct TestTable table[] = {
+        { "test of test_observe_fan_out()", test_observe_fan_out },
+        { "test of test_observe_fan_out_instance()", test_observe_fan_out_instance },
+        { "test of test_observe_release()", test_observe_release },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_observe_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_observe", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
@@ -0,0 +1,454 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+#include "connection.h"
+#include "memtrace.h"
+#include "testhelpers.h"
+
+#define ROUND_TRIP_COUNT    100
+#define PEER_COUNT          64
+
+static int prv_roundTrip(lwm2m_context_t * contextP,
+                         connection_t * connP,
+                         uint8_t * request,
+                         int requestLength,
+                         uint8_t * reply)
+{
+    uint8_t packet[COAP_MAX_PACKET_SIZE];
+
+    // the parser works in place
+    CU_ASSERT_FATAL(requestLength <= (int)sizeof(packet));
+    memcpy(packet, request, requestLength);
+    lwm2m_handle_packet(contextP, packet, requestLength, connP);
+
+    return recv(connP->sock, reply, COAP_MAX_PACKET_SIZE, MSG_DONTWAIT);
+}
+
+static void prv_checkNoAllocation(uint8_t * request,
+                                  int requestLength,
+                                  uint8_t replyType,
+                                  uint8_t replyCode)
+{
+    lwm2m_context_t * contextP;
+    connection_t conn;
+    uint8_t reply[COAP_MAX_PACKET_SIZE];
+    int before;
+    int i;
+
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    before = trace_allocations();
+    for (i = 0 ; i < ROUND_TRIP_COUNT ; i++)
+    {
+        int length;
+
+        length = prv_roundTrip(contextP, &conn, request, requestLength, reply);
+        CU_ASSERT_TRUE(length >= 4);
+        CU_ASSERT_EQUAL(reply[0] & 0x30, replyType << 4);
+        CU_ASSERT_EQUAL(reply[1], replyCode);
+        CU_ASSERT_EQUAL(reply[2], request[2]);
+        CU_ASSERT_EQUAL(reply[3], request[3]);
+    }
+    CU_ASSERT_EQUAL(trace_allocations() - before, 0);
+
+    lwm2m_close(contextP);
+    close(conn.sock);
+}
+
+static void test_packet_ack_no_allocation(void)
+{
+    // unexpected confirmable 2.05 response, acknowledged by an empty ACK
+    uint8_t request[] = { 0x40, COAP_205_CONTENT, 0x12, 0x34 };
+
+    prv_checkNoAllocation(request, sizeof(request), COAP_TYPE_ACK, 0);
+}
+
+static void test_packet_error_no_allocation(void)
+{
+    // unsupported CoAP version, answered by an error message
+    uint8_t request[] = { 0x80, COAP_GET, 0x9A, 0xBC };
+
+    prv_checkNoAllocation(request, sizeof(request), COAP_TYPE_ACK, COAP_400_BAD_REQUEST);
+}
+
+static void test_packet_parse_uri_no_allocation(void)
+{
+    // CON GET /3/0/0
+    uint8_t request[] = { 0x40, COAP_GET, 0x12, 0x34, 0xB1, '3', 0x01, '0', 0x01, '0' };
+    coap_packet_t message;
+    lwm2m_uri_t uri;
+    int before;
+
+    before = trace_allocations();
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(&message, request, sizeof(request)), NO_ERROR);
+    CU_ASSERT_TRUE(uri_decode(NULL, message.uri_path, &uri));
+    CU_ASSERT_EQUAL(trace_allocations() - before, 0);
+
+    CU_ASSERT_EQUAL(uri.flag, LWM2M_URI_FLAG_DM | LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID);
+    CU_ASSERT_EQUAL(uri.objectId, 3);
+    CU_ASSERT_EQUAL(uri.instanceId, 0);
+    CU_ASSERT_EQUAL(uri.resourceId, 0);
+    // the options point into the datagram
+    CU_ASSERT_PTR_EQUAL(message.uri_path->data, request + 5);
+    coap_free_header(&message);
+}
+
+static void test_packet_parse_many_options(void)
+{
+    uint8_t request[4 + 2 * (COAP_MAX_PARSED_OPTIONS + 4)];
+    coap_packet_t message;
+    multi_option_t * optP;
+    int blocksBefore;
+    size_t sizeBefore;
+    int blocksAfter;
+    size_t sizeAfter;
+    int count;
+    int i;
+
+    request[0] = 0x40;
+    request[1] = COAP_GET;
+    request[2] = 0x56;
+    request[3] = 0x78;
+    // Uri-Path options past the packet capacity fall back to the heap
+    request[4] = 0xB1;
+    request[5] = 'a';
+    for (i = 1 ; i < COAP_MAX_PARSED_OPTIONS + 4 ; i++)
+    {
+        request[4 + 2 * i] = 0x01;
+        request[5 + 2 * i] = 'a' + i;
+    }
+
+    trace_status(&blocksBefore, &sizeBefore);
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(&message, request, sizeof(request)), NO_ERROR);
+
+    count = 0;
+    for (optP = message.uri_path ; optP != NULL ; optP = optP->next)
+    {
+        CU_ASSERT_EQUAL(optP->data[0], 'a' + count);
+        count++;
+    }
+    CU_ASSERT_EQUAL(count, COAP_MAX_PARSED_OPTIONS + 4);
+
+    coap_free_header(&message);
+    trace_status(&blocksAfter, &sizeAfter);
+    CU_ASSERT_EQUAL(blocksBefore, blocksAfter);
+    CU_ASSERT_EQUAL(sizeBefore, sizeAfter);
+}
+
+static int g_objectAllocations;
+
+static uint8_t prv_readDevice(uint16_t instanceId,
+                              int * numDataP,
+                              lwm2m_data_t ** dataArrayP,
+                              lwm2m_object_t * objectP)
+{
+    int before;
+
+    (void)instanceId;
+    (void)objectP;
+
+    if (*numDataP != 1 || (*dataArrayP)->id != 0) return COAP_404_NOT_FOUND;
+
+    // the copy of the string belongs to the object, not to the stack
+    before = trace_allocations();
+    lwm2m_data_encode_string("Open Mobile Alliance", *dataArrayP);
+    g_objectAllocations += trace_allocations() - before;
+
+    return COAP_205_CONTENT;
+}
+
+static void test_packet_dispatch_no_allocation(void)
+{
+    // NON GET /3/0/0 with token 0x33
+    uint8_t request[] = { 0x51, COAP_GET, 0x40, 0x00, 0x33, 0xB1, '3', 0x01, '0', 0x01, '0' };
+    lwm2m_context_t * contextP;
+    lwm2m_server_t * serverP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    connection_t conn;
+    coap_packet_t response;
+    uint8_t reply[COAP_MAX_PACKET_SIZE];
+    lwm2m_data_t * dataP;
+    lwm2m_uri_t uri;
+    int before;
+    int i;
+
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    memset(&instance, 0, sizeof(instance));
+    memset(&object, 0, sizeof(object));
+    object.objID = LWM2M_DEVICE_OBJECT_ID;
+    object.instanceList = &instance;
+    object.readFunc = prv_readDevice;
+    contextP->objectList = &object;
+    serverP = (lwm2m_server_t *)lwm2m_malloc(sizeof(lwm2m_server_t));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(serverP);
+    memset(serverP, 0, sizeof(lwm2m_server_t));
+    serverP->shortID = 1;
+    serverP->sessionH = &conn;
+    serverP->status = STATE_REGISTERED;
+    contextP->serverList = serverP;
+
+    // the first read allocates the payload buffer of the context
+    CU_ASSERT_TRUE_FATAL(prv_roundTrip(contextP, &conn, request, sizeof(request), reply) >= 4);
+
+    g_objectAllocations = 0;
+    before = trace_allocations();
+    for (i = 0 ; i < ROUND_TRIP_COUNT ; i++)
+    {
+        request[3] = (uint8_t)(i + 1);
+        lwm2m_handle_packet(contextP, request, sizeof(request), &conn);
+        CU_ASSERT_TRUE_FATAL(test_receive(&conn, &response, reply, sizeof(reply)));
+        CU_ASSERT_EQUAL(response.code, COAP_205_CONTENT);
+        CU_ASSERT_EQUAL(response.token_len, 1);
+        CU_ASSERT_EQUAL(response.token[0], 0x33);
+    }
+    CU_ASSERT_EQUAL(trace_allocations() - before - g_objectAllocations, 0);
+
+    // the same request in CON, its response is kept in the store of the context.
+    // The first one allocates the timer heap of the context.
+    request[0] = 0x41;
+    request[3] = 0;
+    CU_ASSERT_TRUE_FATAL(prv_roundTrip(contextP, &conn, request, sizeof(request), reply) >= 4);
+    g_objectAllocations = 0;
+    before = trace_allocations();
+    for (i = 0 ; i < ROUND_TRIP_COUNT ; i++)
+    {
+        request[3] = (uint8_t)(ROUND_TRIP_COUNT + i + 1);
+        lwm2m_handle_packet(contextP, request, sizeof(request), &conn);
+        CU_ASSERT_TRUE_FATAL(test_receive(&conn, &response, reply, sizeof(reply)));
+        CU_ASSERT_EQUAL(response.type, COAP_TYPE_ACK);
+        CU_ASSERT_EQUAL(response.mid, (request[2] << 8) | request[3]);
+        CU_ASSERT_EQUAL(response.code, COAP_205_CONTENT);
+    }
+    CU_ASSERT_EQUAL(trace_allocations() - before - g_objectAllocations, 0);
+    CU_ASSERT(contextP->dedupCache.count > 0);
+
+    // the last response carries the value in TLV, the default format
+    CU_ASSERT_EQUAL(response.content_type, LWM2M_CONTENT_TLV);
+    lwm2m_stringToUri("/3/0/0", 6, &uri);
+    CU_ASSERT_EQUAL_FATAL(lwm2m_data_parse(&uri, response.payload, response.payload_len, LWM2M_CONTENT_TLV, &dataP), 1);
+    CU_ASSERT_EQUAL(dataP->id, 0);
+    CU_ASSERT_EQUAL(dataP->type, LWM2M_TYPE_OPAQUE);
+    CU_ASSERT_EQUAL(dataP->value.asBuffer.length, strlen("Open Mobile Alliance"));
+    lwm2m_data_free(1, dataP);
+
+    close(conn.sock);
+    serverP->status = STATE_DEREGISTERED;
+    contextP->objectList = NULL;
+    lwm2m_close(contextP);
+}
+
+static int g_executeCount = 0;
+
+static uint8_t prv_execute(uint16_t instanceId,
+                           uint16_t resourceId,
+                           uint8_t * buffer,
+                           int length,
+                           lwm2m_object_t * objectP)
+{
+    (void)instanceId;
+    (void)resourceId;
+    (void)buffer;
+    (void)length;
+    (void)objectP;
+
+    g_executeCount++;
+
+    return COAP_204_CHANGED;
+}
+
+static int prv_sendExecute(lwm2m_context_t * contextP,
+                           connection_t * connP,
+                           uint16_t mid,
+                           uint8_t * reply)
+{
+    // CON POST /1024/0/1 with token 0x42
+    uint8_t packet[] = { 0x41, COAP_POST, mid >> 8, mid & 0xFF, 0x42, 0xB4, '1', '0', '2', '4', 0x01, '0', 0x01, '1' };
+
+    lwm2m_handle_packet(contextP, packet, sizeof(packet), connP);
+
+    return recv(connP->sock, reply, COAP_MAX_PACKET_SIZE, MSG_DONTWAIT);
+}
+
+static void test_packet_duplicate_request(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_server_t * serverP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    connection_t conn;
+    uint8_t reply[COAP_MAX_PACKET_SIZE];
+    uint8_t firstReply[COAP_MAX_PACKET_SIZE];
+    int peers[PEER_COUNT];
+    int firstLength;
+    time_t timeout;
+    int before;
+    int i;
+
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    memset(&instance, 0, sizeof(instance));
+    memset(&object, 0, sizeof(object));
+    object.objID = 1024;
+    object.instanceList = &instance;
+    object.executeFunc = prv_execute;
+    contextP->objectList = &object;
+    serverP = (lwm2m_server_t *)lwm2m_malloc(sizeof(lwm2m_server_t));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(serverP);
+    memset(serverP, 0, sizeof(lwm2m_server_t));
+    serverP->shortID = 1;
+    serverP->sessionH = &conn;
+    serverP->status = STATE_REGISTERED;
+    contextP->serverList = serverP;
+    g_executeCount = 0;
+
+    firstLength = prv_sendExecute(contextP, &conn, 0x1234, firstReply);
+    CU_ASSERT_TRUE_FATAL(firstLength >= 4);
+    CU_ASSERT_EQUAL(firstReply[1], COAP_204_CHANGED);
+    CU_ASSERT_EQUAL(g_executeCount, 1);
+
+    // the retransmissions get the same response without executing again
+    before = trace_allocations();
+    for (i = 0 ; i < ROUND_TRIP_COUNT ; i++)
+    {
+        CU_ASSERT_EQUAL(prv_sendExecute(contextP, &conn, 0x1234, reply), firstLength);
+        CU_ASSERT(0 == memcmp(reply, firstReply, firstLength));
+    }
+    CU_ASSERT_EQUAL(trace_allocations() - before, 0);
+    CU_ASSERT_EQUAL(g_executeCount, 1);
+
+    // a new request is executed
+    CU_ASSERT_TRUE(prv_sendExecute(contextP, &conn, 0x1235, reply) >= 4);
+    CU_ASSERT_EQUAL(g_executeCount, 2);
+
+    // a peer only keeps its last responses
+    for (i = 0 ; i < ROUND_TRIP_COUNT ; i++)
+    {
+        CU_ASSERT_TRUE(prv_sendExecute(contextP, &conn, (uint16_t)(0x2000 + i), reply) >= 4);
+    }
+    CU_ASSERT(contextP->dedupCache.count < ROUND_TRIP_COUNT);
+    CU_ASSERT_TRUE(prv_sendExecute(contextP, &conn, 0x1234, reply) >= 4);
+    CU_ASSERT_EQUAL(g_executeCount, 3 + ROUND_TRIP_COUNT);
+
+    // and drops them after the exchange lifetime
+    timeout = 0;
+    timer_step(contextP, lwm2m_gettime() + COAP_EXCHANGE_LIFETIME + 1, &timeout);
+    CU_ASSERT_EQUAL(contextP->dedupCache.count, 0);
+    CU_ASSERT_PTR_NULL(contextP->dedupCache.oldest);
+
+    // when the store is full, the oldest response makes room without allocating
+    before = trace_allocations();
+    for (i = 0 ; i < PEER_COUNT ; i++)
+    {
+        dedup_store(contextP, peers + i, 0x3000, firstReply, firstLength);
+    }
+    CU_ASSERT_EQUAL(trace_allocations() - before, 0);
+    CU_ASSERT(contextP->dedupCache.count < PEER_COUNT);
+    CU_ASSERT_PTR_EQUAL(contextP->dedupCache.newest->sessionH, peers + PEER_COUNT - 1);
+    CU_ASSERT_PTR_NOT_EQUAL(contextP->dedupCache.oldest->sessionH, peers);
+
+    close(conn.sock);
+    serverP->status = STATE_DEREGISTERED;
+    contextP->objectList = NULL;
+    lwm2m_close(contextP);
+}
+
+static void test_packet_request_response(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_server_t * serverP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    connection_t conn;
+    coap_packet_t response;
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    int before;
+    int i;
+
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    memset(&instance, 0, sizeof(instance));
+    memset(&object, 0, sizeof(object));
+    object.objID = 1024;
+    object.instanceList = &instance;
+    object.executeFunc = prv_execute;
+    contextP->objectList = &object;
+    serverP = (lwm2m_server_t *)lwm2m_malloc(sizeof(lwm2m_server_t));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(serverP);
+    memset(serverP, 0, sizeof(lwm2m_server_t));
+    serverP->shortID = 1;
+    serverP->sessionH = &conn;
+    serverP->status = STATE_REGISTERED;
+    contextP->serverList = serverP;
+    g_executeCount = 0;
+
+    before = trace_allocations();
+    for (i = 0 ; i < ROUND_TRIP_COUNT ; i++)
+    {
+        // NON POST /1024/0/1 with token 0x24, its response is not kept for retransmissions
+        uint8_t request[] = { 0x51, COAP_POST, 0x30, (uint8_t)i, 0x24, 0xB4, '1', '0', '2', '4', 0x01, '0', 0x01, '1' };
+
+        lwm2m_handle_packet(contextP, request, sizeof(request), &conn);
+
+        CU_ASSERT_TRUE_FATAL(test_receive(&conn, &response, buffer, sizeof(buffer)));
+        CU_ASSERT_EQUAL(response.type, COAP_TYPE_NON);
+        CU_ASSERT_EQUAL(response.code, COAP_204_CHANGED);
+        CU_ASSERT_EQUAL(response.token_len, 1);
+        CU_ASSERT_EQUAL(response.token[0], 0x24);
+    }
+    CU_ASSERT_EQUAL(trace_allocations() - before, 0);
+    CU_ASSERT_EQUAL(g_executeCount, ROUND_TRIP_COUNT);
+
+    close(conn.sock);
+    serverP->status = STATE_DEREGISTERED;
+    contextP->objectList = NULL;
+    lwm2m_close(contextP);
+}
+
+static struct TestTable table[] = {
+        { "test of test_packet_ack_no_allocation()", test_packet_ack_no_allocation },
+        { "test of test_packet_error_no_allocation()", test_packet_error_no_allocation },
+        { "test of test_packet_parse_uri_no_allocation()", test_packet_parse_uri_no_allocation },
+        { "test of test_packet_parse_many_options()", test_packet_parse_many_options },
+        { "test of test_packet_dispatch_no_allocation()", test_packet_dispatch_no_allocation },
+        { "test of test_packet_duplicate_request()", test_packet_duplicate_request },
+        { "test of test_packet_request_response()", test_packet_request_response },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_packet_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_packet", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
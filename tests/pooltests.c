@@ -0,0 +1,139 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+
+#ifdef LWM2M_WITH_POOLS
+
+// Other suites use the pools too, so only deltas are checked.
+
+static void test_pool_reuse(void)
+{
+    lwm2m_pool_stats_t before;
+    lwm2m_pool_stats_t after;
+    void * firstP;
+    void * secondP;
+
+    lwm2m_pool_get_stats(LWM2M_POOL_DM_DATA, &before);
+    CU_ASSERT_EQUAL(before.objectSize, sizeof(dm_data_t));
+    CU_ASSERT_TRUE_FATAL(before.used < before.capacity);
+
+    firstP = pool_alloc(LWM2M_POOL_DM_DATA);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(firstP);
+    pool_free(LWM2M_POOL_DM_DATA, firstP);
+
+    // the freed slot is handed out again
+    secondP = pool_alloc(LWM2M_POOL_DM_DATA);
+    CU_ASSERT_PTR_EQUAL(secondP, firstP);
+    pool_free(LWM2M_POOL_DM_DATA, secondP);
+
+    lwm2m_pool_get_stats(LWM2M_POOL_DM_DATA, &after);
+    CU_ASSERT_EQUAL(after.used, before.used);
+    CU_ASSERT_EQUAL(after.allocations, before.allocations + 2);
+    CU_ASSERT_EQUAL(after.fallbacks, before.fallbacks);
+}
+
+static void test_pool_exhaustion(void)
+{
+    lwm2m_pool_stats_t before;
+    lwm2m_pool_stats_t after;
+    void * objects[64];
+    size_t count;
+    size_t i;
+
+    lwm2m_pool_get_stats(LWM2M_POOL_OBSERVATION, &before);
+    count = before.capacity - before.used + 2;
+    CU_ASSERT_TRUE_FATAL(count <= sizeof(objects) / sizeof(objects[0]));
+
+    for (i = 0 ; i < count ; i++)
+    {
+        objects[i] = pool_alloc(LWM2M_POOL_OBSERVATION);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(objects[i]);
+        memset(objects[i], 0xA5, sizeof(lwm2m_observation_t));
+    }
+
+    lwm2m_pool_get_stats(LWM2M_POOL_OBSERVATION, &after);
+    CU_ASSERT_EQUAL(after.used, before.capacity + 2);
+    CU_ASSERT_TRUE(after.peak >= after.used);
+    // the last two came from the heap
+    CU_ASSERT_EQUAL(after.fallbacks, before.fallbacks + 2);
+    CU_ASSERT_EQUAL(after.failures, before.failures);
+
+    for (i = 0 ; i < count ; i++)
+    {
+        pool_free(LWM2M_POOL_OBSERVATION, objects[i]);
+    }
+    lwm2m_pool_get_stats(LWM2M_POOL_OBSERVATION, &after);
+    CU_ASSERT_EQUAL(after.used, before.used);
+}
+
+static void test_pool_transaction(void)
+{
+    lwm2m_pool_stats_t transactions;
+    lwm2m_pool_stats_t packets;
+    lwm2m_pool_stats_t stats;
+    lwm2m_transaction_t * transacP;
+    lwm2m_uri_t uri;
+    uint8_t token[2] = { 0x12, 0x34 };
+    int session = 0;
+
+    memset(&uri, 0, sizeof(uri));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID;
+    uri.objectId = 3;
+    uri.instanceId = 0;
+
+    lwm2m_pool_get_stats(LWM2M_POOL_TRANSACTION, &transactions);
+    lwm2m_pool_get_stats(LWM2M_POOL_PACKET, &packets);
+
+    transacP = transaction_new(&session, COAP_GET, NULL, &uri, 1, sizeof(token), token);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(transacP);
+
+    lwm2m_pool_get_stats(LWM2M_POOL_TRANSACTION, &stats);
+    CU_ASSERT_EQUAL(stats.used, transactions.used + 1);
+    lwm2m_pool_get_stats(LWM2M_POOL_PACKET, &stats);
+    CU_ASSERT_EQUAL(stats.used, packets.used + 1);
+
+    transaction_free(transacP);
+
+    lwm2m_pool_get_stats(LWM2M_POOL_TRANSACTION, &stats);
+    CU_ASSERT_EQUAL(stats.used, transactions.used);
+    CU_ASSERT_EQUAL(stats.allocations, transactions.allocations + 1);
+    lwm2m_pool_get_stats(LWM2M_POOL_PACKET, &stats);
+    CU_ASSERT_EQUAL(stats.used, packets.used);
+}
+
+static struct TestTable table[] = {
+        { "test of test_pool_reuse()", test_pool_reuse },
+        { "test of test_pool_exhaustion()", test_pool_exhaustion },
+        { "test of test_pool_transaction()", test_pool_transaction },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_pool_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_pool", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
+
+#endif
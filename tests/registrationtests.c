@@ -0,0 +1,259 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+
+#include <stdio.h>
+
+#define TEST_OBJECT_ID      1024
+#define TEST_INSTANCE_COUNT 3
+
+static uint8_t prv_delete(uint16_t id,
+                          lwm2m_object_t * objectP)
+{
+    lwm2m_list_t * instanceP;
+
+    objectP->instanceList = lwm2m_list_remove(objectP->instanceList, id, &instanceP);
+    if (instanceP == NULL) return COAP_404_NOT_FOUND;
+
+    return COAP_202_DELETED;
+}
+
+// the cached payload must match a payload built from scratch
+static void prv_checkPayload(lwm2m_context_t * contextP,
+                             uint8_t * payload,
+                             int length)
+{
+    uint8_t buffer[256];
+    int freshLength;
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(payload);
+    freshLength = object_getRegisterPayloadBufferLength(contextP);
+    CU_ASSERT_FATAL(freshLength > 0 && freshLength <= (int)sizeof(buffer));
+    freshLength = object_getRegisterPayload(contextP, buffer, freshLength);
+    CU_ASSERT_EQUAL_FATAL(length, freshLength);
+    CU_ASSERT(0 == memcmp(payload, buffer, length));
+}
+
+static void test_registration_payload_cache(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_object_t other;
+    lwm2m_list_t * instanceP;
+    lwm2m_uri_t uri;
+    uint8_t * payload;
+    uint8_t * cachedP;
+    int length;
+    int i;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    memset(&object, 0, sizeof(object));
+    object.objID = TEST_OBJECT_ID;
+    object.deleteFunc = prv_delete;
+    for (i = TEST_INSTANCE_COUNT - 1 ; i >= 0 ; i--)
+    {
+        instanceP = (lwm2m_list_t *)lwm2m_malloc(sizeof(lwm2m_list_t));
+        CU_ASSERT_PTR_NOT_NULL_FATAL(instanceP);
+        instanceP->id = i;
+        instanceP->next = object.instanceList;
+        object.instanceList = instanceP;
+    }
+    memset(&other, 0, sizeof(other));
+    other.objID = 5;
+    contextP->objectList = &object;
+
+    payload = object_getCachedRegisterPayload(contextP, &length);
+    prv_checkPayload(contextP, payload, length);
+    CU_ASSERT_PTR_NOT_NULL(strstr((char *)payload, "</1024/2>"));
+
+    // nothing changed: the same buffer is reused
+    cachedP = object_getCachedRegisterPayload(contextP, &length);
+    CU_ASSERT_PTR_EQUAL(cachedP, payload);
+
+    CU_ASSERT_EQUAL(lwm2m_add_object(contextP, &other), COAP_NO_ERROR);
+    CU_ASSERT_PTR_NULL(contextP->registerPayload);
+    payload = object_getCachedRegisterPayload(contextP, &length);
+    prv_checkPayload(contextP, payload, length);
+    CU_ASSERT_PTR_NOT_NULL(strstr((char *)payload, "</5>"));
+
+    lwm2m_stringToUri("/1024/1", 7, &uri);
+    CU_ASSERT_EQUAL(object_delete(contextP, &uri), COAP_202_DELETED);
+    CU_ASSERT_PTR_NULL(contextP->registerPayload);
+    payload = object_getCachedRegisterPayload(contextP, &length);
+    prv_checkPayload(contextP, payload, length);
+    CU_ASSERT_PTR_NULL(strstr((char *)payload, "</1024/1>"));
+
+    CU_ASSERT_EQUAL(lwm2m_remove_object(contextP, 5), COAP_NO_ERROR);
+    CU_ASSERT_PTR_NULL(contextP->registerPayload);
+    payload = object_getCachedRegisterPayload(contextP, &length);
+    prv_checkPayload(contextP, payload, length);
+    CU_ASSERT_PTR_NULL(strstr((char *)payload, "</5>"));
+
+    // instances added by the application are picked up on the next update with objects
+    instanceP = (lwm2m_list_t *)lwm2m_malloc(sizeof(lwm2m_list_t));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(instanceP);
+    instanceP->id = 7;
+    instanceP->next = NULL;
+    object.instanceList = LWM2M_LIST_ADD(object.instanceList, instanceP);
+    lwm2m_update_registration(contextP, 0, true);
+    CU_ASSERT_PTR_NULL(contextP->registerPayload);
+    payload = object_getCachedRegisterPayload(contextP, &length);
+    prv_checkPayload(contextP, payload, length);
+    CU_ASSERT_PTR_NOT_NULL(strstr((char *)payload, "</1024/7>"));
+
+    while (object.instanceList != NULL)
+    {
+        instanceP = object.instanceList;
+        object.instanceList = instanceP->next;
+        lwm2m_free(instanceP);
+    }
+    contextP->objectList = NULL;
+    lwm2m_close(contextP);
+}
+
+#define TEST_CLIENT_COUNT   100
+#define TEST_PAYLOAD        "</>;rt=\"oma.lwm2m\",</1/0>,</3/0>,</3303/0>,</3303/1>,</5>"
+
+static uint8_t prv_register(lwm2m_context_t * contextP,
+                            const char * query,
+                            uint16_t clientID,
+                            const char * payload)
+{
+    coap_packet_t message;
+    coap_packet_t response;
+    lwm2m_uri_t uri;
+    uint8_t result;
+
+    memset(&uri, 0, sizeof(uri));
+    if (clientID != LWM2M_MAX_ID)
+    {
+        uri.objectId = clientID;
+        uri.flag = LWM2M_URI_FLAG_OBJECT_ID;
+    }
+    coap_init_message(&message, COAP_TYPE_CON, COAP_POST, 0);
+    coap_init_message(&response, COAP_TYPE_ACK, 0, 0);
+    if (query != NULL) coap_set_header_uri_query(&message, query);
+    coap_set_header_content_type(&message, LWM2M_CONTENT_LINK);
+    if (payload != NULL) coap_set_payload(&message, payload, strlen(payload));
+
+    result = registration_handleRequest(contextP, &uri, NULL, &message, &response);
+
+    coap_free_header(&message);
+    coap_free_header(&response);
+
+    return result;
+}
+
+static void test_registration_object_lists(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_client_t * clientP;
+    lwm2m_client_object_list_t * sharedP;
+    lwm2m_client_object_t * objectP;
+    lwm2m_object_list_stats_t stats;
+    char query[32];
+    int i;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    for (i = 0 ; i < TEST_CLIENT_COUNT ; i++)
+    {
+        snprintf(query, sizeof(query), "ep=dev-%d&lwm2m=1.0", i);
+        CU_ASSERT_EQUAL(prv_register(contextP, query, LWM2M_MAX_ID, TEST_PAYLOAD), COAP_201_CREATED);
+    }
+    // the same objects in another order
+    CU_ASSERT_EQUAL(prv_register(contextP, "ep=other&lwm2m=1.0", LWM2M_MAX_ID,
+                                 "</3303/1>, </5>,</3/0>,</1/0>,</3303/0>,</>;rt=\"oma.lwm2m\",</3303/0>"), COAP_201_CREATED);
+
+    sharedP = contextP->clientList->objectList;
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sharedP);
+    for (clientP = contextP->clientList ; clientP != NULL ; clientP = clientP->next)
+    {
+        CU_ASSERT_PTR_EQUAL(clientP->objectList, sharedP);
+    }
+    CU_ASSERT_EQUAL(sharedP->count, 4);
+    CU_ASSERT_PTR_NULL(objectlist_findObject(sharedP, 4));
+    objectP = objectlist_findObject(sharedP, 3303);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(objectP);
+    CU_ASSERT_EQUAL(objectP->instanceCount, 2);
+    CU_ASSERT_TRUE(objectlist_hasInstance(objectP, 1));
+    CU_ASSERT_FALSE(objectlist_hasInstance(objectP, 2));
+    objectP = objectlist_findObject(sharedP, 5);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(objectP);
+    CU_ASSERT_EQUAL(objectP->instanceCount, 0);
+
+    lwm2m_get_object_list_stats(contextP, &stats);
+    CU_ASSERT_EQUAL(stats.clients, TEST_CLIENT_COUNT + 1);
+    CU_ASSERT_EQUAL(stats.lists, 1);
+    CU_ASSERT_EQUAL(stats.bytes, sharedP->size);
+    CU_ASSERT_EQUAL(stats.savedBytes, TEST_CLIENT_COUNT * sharedP->size);
+    CU_ASSERT_EQUAL(stats.savedPerClient, stats.savedBytes / stats.clients);
+
+    // an update with other objects does not touch the shared list
+    clientP = lwm2m_get_client_by_name(contextP, "dev-0");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(clientP);
+    CU_ASSERT_EQUAL(prv_register(contextP, NULL, clientP->internalID, "</1/0>,</3/0>,</3303/0>,</3303/1>,</3303/2>"), COAP_204_CHANGED);
+    CU_ASSERT_PTR_NOT_EQUAL(clientP->objectList, sharedP);
+    CU_ASSERT_EQUAL(objectlist_findObject(clientP->objectList, 3303)->instanceCount, 3);
+    CU_ASSERT_EQUAL(objectlist_findObject(sharedP, 3303)->instanceCount, 2);
+    CU_ASSERT_EQUAL(sharedP->refCount, TEST_CLIENT_COUNT);
+
+    // an update with the same objects keeps the list
+    clientP = lwm2m_get_client_by_name(contextP, "dev-1");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(clientP);
+    CU_ASSERT_EQUAL(prv_register(contextP, NULL, clientP->internalID, TEST_PAYLOAD), COAP_204_CHANGED);
+    CU_ASSERT_PTR_EQUAL(clientP->objectList, sharedP);
+    CU_ASSERT_EQUAL(sharedP->refCount, TEST_CLIENT_COUNT);
+
+    // the alternate path is part of the list
+    CU_ASSERT_EQUAL(prv_register(contextP, "ep=alt&lwm2m=1.0", LWM2M_MAX_ID,
+                                 "</lwm2m>;rt=\"oma.lwm2m\",</1/0>,</3/0>,</3303/0>,</3303/1>,</5>"), COAP_201_CREATED);
+    clientP = lwm2m_get_client_by_name(contextP, "alt");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(clientP);
+    CU_ASSERT_PTR_NOT_EQUAL(clientP->objectList, sharedP);
+    CU_ASSERT_PTR_NOT_NULL(clientP->altPath);
+    CU_ASSERT_PTR_EQUAL(clientP->altPath, clientP->objectList->altPath);
+
+    lwm2m_get_object_list_stats(contextP, &stats);
+    CU_ASSERT_EQUAL(stats.clients, TEST_CLIENT_COUNT + 2);
+    CU_ASSERT_EQUAL(stats.lists, 3);
+
+    lwm2m_close(contextP);
+}
+
+static struct TestTable table[] = {
+        { "test of test_registration_payload_cache()", test_registration_payload_cache },
+        { "test of test_registration_object_lists()", test_registration_object_lists },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_registration_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_registration", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
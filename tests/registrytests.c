@@ -0,0 +1,192 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NAME_LENGTH         16
+#define LOOKUP_COUNT        200000
+
+static lwm2m_client_t * prv_createClients(lwm2m_context_t * contextP,
+                                          int count,
+                                          char ** namesP)
+{
+    lwm2m_client_t * clients;
+    int i;
+
+    clients = (lwm2m_client_t *)calloc(count, sizeof(lwm2m_client_t));
+    *namesP = (char *)calloc(count, NAME_LENGTH);
+    if (clients == NULL || *namesP == NULL) return NULL;
+
+    for (i = 0 ; i < count ; i++)
+    {
+        lwm2m_client_t * clientP = clients + i;
+
+        clientP->name = *namesP + i * NAME_LENGTH;
+        snprintf(clientP->name, NAME_LENGTH, "ep-%d", i);
+        CU_ASSERT_TRUE(registry_newId(contextP, &clientP->internalID));
+        CU_ASSERT_EQUAL(registry_add(contextP, clientP), 1);
+    }
+
+    return clients;
+}
+
+static void test_registry_nominal(void)
+{
+    lwm2m_context_t context;
+    lwm2m_client_t * clients;
+    lwm2m_client_t * clientP;
+    char * names;
+    int count;
+
+    memset(&context, 0, sizeof(lwm2m_context_t));
+    clients = prv_createClients(&context, 100, &names);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(clients);
+
+    CU_ASSERT_PTR_EQUAL(registry_findById(&context, 42), clients + 42);
+    CU_ASSERT_PTR_EQUAL(lwm2m_get_client(&context, 42), clients + 42);
+    CU_ASSERT_PTR_EQUAL(registry_findByName(&context, "ep-17"), clients + 17);
+    CU_ASSERT_PTR_NULL(registry_findById(&context, 100));
+    CU_ASSERT_PTR_NULL(registry_findByName(&context, "ep-100"));
+
+    // the clientList stays sorted and compatible with the list API
+    CU_ASSERT_PTR_EQUAL(lwm2m_list_find((lwm2m_list_t *)context.clientList, 63), clients + 63);
+
+    registry_remove(&context, clients + 42);
+    registry_remove(&context, clients);
+    registry_remove(&context, clients + 99);
+    CU_ASSERT_PTR_NULL(registry_findById(&context, 42));
+    CU_ASSERT_PTR_NULL(registry_findByName(&context, "ep-0"));
+
+    count = 0;
+    for (clientP = context.clientList ; clientP != NULL ; clientP = clientP->next)
+    {
+        if (clientP->next != NULL)
+        {
+            CU_ASSERT(clientP->internalID < clientP->next->internalID);
+        }
+        count++;
+    }
+    CU_ASSERT_EQUAL(count, 97);
+    CU_ASSERT_EQUAL(context.clientRegistry.count, 97);
+
+    // a freed ID is reused after the counter wraps, clientList order is kept
+    context.clientRegistry.nextID = 0;
+    CU_ASSERT_TRUE(registry_newId(&context, &clients[0].internalID));
+    CU_ASSERT_EQUAL(clients[0].internalID, 0);
+    CU_ASSERT_EQUAL(registry_add(&context, clients), 1);
+    CU_ASSERT_PTR_EQUAL(context.clientList, clients);
+
+    registry_close(&context);
+    free(clients);
+    free(names);
+}
+
+static double prv_measureLookups(lwm2m_context_t * contextP,
+                                 lwm2m_client_t * clients,
+                                 int count)
+{
+    clock_t start;
+    int i;
+    int found;
+
+    found = 0;
+    start = clock();
+    for (i = 0 ; i < LOOKUP_COUNT ; i++)
+    {
+        lwm2m_client_t * clientP = clients + (i * 7919) % count;
+
+        if (registry_findById(contextP, clientP->internalID) == clientP) found++;
+        if (registry_findByName(contextP, clientP->name) == clientP) found++;
+    }
+    CU_ASSERT_EQUAL(found, 2 * LOOKUP_COUNT);
+
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / (2 * LOOKUP_COUNT);
+}
+
+// Average number of clients compared by a successful lookup, over the two tables.
+static double prv_countProbes(lwm2m_client_registry_t * registryP)
+{
+    size_t probes;
+    size_t i;
+
+    probes = 0;
+    for (i = 0 ; i < registryP->size ; i++)
+    {
+        lwm2m_client_t * clientP;
+        size_t length;
+
+        length = 0;
+        for (clientP = registryP->idTable[i] ; clientP != NULL ; clientP = clientP->idNext) probes += ++length;
+        length = 0;
+        for (clientP = registryP->nameTable[i] ; clientP != NULL ; clientP = clientP->nameNext) probes += ++length;
+    }
+
+    return (double)probes / (2 * registryP->count);
+}
+
+static void test_registry_benchmark(void)
+{
+    int sizes[] = { 100, 1000, 10000, 60000 };
+    double probes[sizeof(sizes) / sizeof(sizes[0])];
+    size_t i;
+
+    for (i = 0 ; i < sizeof(sizes) / sizeof(sizes[0]) ; i++)
+    {
+        lwm2m_context_t context;
+        lwm2m_client_t * clients;
+        char * names;
+
+        memset(&context, 0, sizeof(lwm2m_context_t));
+        clients = prv_createClients(&context, sizes[i], &names);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(clients);
+
+        probes[i] = prv_countProbes(&context.clientRegistry);
+        CU_ASSERT(probes[i] < 2.0);
+        printf("\n    %6d clients: %.1f ns per lookup, %.2f clients compared", sizes[i], prv_measureLookups(&context, clients, sizes[i]), probes[i]);
+
+        registry_close(&context);
+        free(clients);
+        free(names);
+    }
+    printf("\n");
+
+    // the time also grows with the cache misses, the work of a lookup does not
+    CU_ASSERT(probes[sizeof(sizes) / sizeof(sizes[0]) - 1] < 1.5 * probes[0]);
+}
+
+static struct TestTable table[] = {
+        { "test of test_registry_nominal()", test_registry_nominal },
+        { "test of test_registry_benchmark()", test_registry_benchmark },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_registry_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_registry", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
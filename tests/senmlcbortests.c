@@ -0,0 +1,195 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+
+static void test_senml_cbor_serialize(void)
+{
+    // [{-2: "/3/0/", 0: "0", 3: "ab"}, {0: "1", 2: -5}, {0: "6/0", 2: 1.5}, {0: "6/1", 4: true}]
+    uint8_t expected[] = { 0x84,
+                           0xA3, 0x21, 0x65, '/', '3', '/', '0', '/', 0x00, 0x61, '0', 0x03, 0x62, 'a', 'b',
+                           0xA2, 0x00, 0x61, '1', 0x02, 0x24,
+                           0xA2, 0x00, 0x63, '6', '/', '0', 0x02, 0xFA, 0x3F, 0xC0, 0x00, 0x00,
+                           0xA2, 0x00, 0x63, '6', '/', '1', 0x04, 0xF5 };
+    lwm2m_data_t * dataP;
+    lwm2m_data_t * childrenP;
+    lwm2m_media_type_t format;
+    lwm2m_uri_t uri;
+    uint8_t * buffer;
+    int length;
+
+    dataP = lwm2m_data_new(3);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    dataP[0].id = 0;
+    lwm2m_data_encode_string("ab", dataP);
+    dataP[1].id = 1;
+    lwm2m_data_encode_int(-5, dataP + 1);
+    childrenP = lwm2m_data_new(2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(childrenP);
+    childrenP[0].id = 0;
+    lwm2m_data_encode_float(1.5, childrenP);
+    childrenP[1].id = 1;
+    lwm2m_data_encode_bool(true, childrenP + 1);
+    dataP[2].id = 6;
+    lwm2m_data_include(childrenP, 2, dataP + 2);
+
+    lwm2m_stringToUri("/3/0", 4, &uri);
+    format = LWM2M_CONTENT_SENML_CBOR;
+    length = lwm2m_data_serialize(&uri, 3, dataP, &format, &buffer);
+    CU_ASSERT_EQUAL(format, LWM2M_CONTENT_SENML_CBOR);
+    CU_ASSERT_EQUAL_FATAL(length, sizeof(expected));
+    CU_ASSERT(0 == memcmp(buffer, expected, length));
+
+    lwm2m_free(buffer);
+    lwm2m_data_free(3, dataP);
+}
+
+static void test_senml_cbor_round_trip(void)
+{
+    uint8_t opaque[] = { 0x00, 0xFF, 0x10 };
+    lwm2m_data_t * dataP;
+    lwm2m_data_t * parsedP;
+    lwm2m_media_type_t format;
+    lwm2m_uri_t uri;
+    uint8_t * buffer;
+    int64_t intValue;
+    double floatValue;
+    int length;
+    int size;
+    int i;
+
+    dataP = lwm2m_data_new(20);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    for (i = 0 ; i < 20 ; i++)
+    {
+        lwm2m_data_t * subP = lwm2m_data_new(5);
+
+        CU_ASSERT_PTR_NOT_NULL_FATAL(subP);
+        subP[0].id = 0;
+        lwm2m_data_encode_string("Open Mobile Alliance", subP);
+        subP[1].id = 1;
+        lwm2m_data_encode_int(-7000000000LL * i, subP + 1);
+        subP[2].id = 2;
+        lwm2m_data_encode_float(3.14 * i, subP + 2);
+        subP[3].id = 3;
+        lwm2m_data_encode_opaque(opaque, sizeof(opaque), subP + 3);
+        subP[4].id = 4;
+        lwm2m_data_encode_objlink(66, i, subP + 4);
+        dataP[i].id = i;
+        lwm2m_data_include(subP, 5, dataP + i);
+    }
+
+    lwm2m_stringToUri("/12", 3, &uri);
+    format = LWM2M_CONTENT_SENML_CBOR;
+    length = lwm2m_data_serialize(&uri, 20, dataP, &format, &buffer);
+    CU_ASSERT_FATAL(length > 0);
+
+    size = lwm2m_data_parse(&uri, buffer, length, LWM2M_CONTENT_SENML_CBOR, &parsedP);
+    CU_ASSERT_EQUAL_FATAL(size, 20);
+    for (i = 0 ; i < 20 ; i++)
+    {
+        lwm2m_data_t * subP = parsedP[i].value.asChildren.array;
+
+        CU_ASSERT_EQUAL(parsedP[i].id, i);
+        CU_ASSERT_EQUAL(parsedP[i].type, LWM2M_TYPE_OBJECT_INSTANCE);
+        CU_ASSERT_EQUAL_FATAL(parsedP[i].value.asChildren.count, 5);
+        CU_ASSERT_EQUAL(subP[0].type, LWM2M_TYPE_STRING);
+        CU_ASSERT_EQUAL(subP[0].value.asBuffer.length, 20);
+        CU_ASSERT(0 == memcmp(subP[0].value.asBuffer.buffer, "Open Mobile Alliance", 20));
+        CU_ASSERT_EQUAL(lwm2m_data_decode_int(subP + 1, &intValue), 1);
+        CU_ASSERT_EQUAL(intValue, -7000000000LL * i);
+        // no text conversion: the value is exact
+        CU_ASSERT_EQUAL(lwm2m_data_decode_float(subP + 2, &floatValue), 1);
+        CU_ASSERT(0 == memcmp(&floatValue, &(dataP[i].value.asChildren.array[2].value.asFloat), sizeof(double)));
+        CU_ASSERT_EQUAL(subP[3].type, LWM2M_TYPE_OPAQUE);
+        CU_ASSERT_EQUAL(subP[3].value.asBuffer.length, sizeof(opaque));
+        CU_ASSERT(0 == memcmp(subP[3].value.asBuffer.buffer, opaque, sizeof(opaque)));
+        CU_ASSERT_EQUAL(subP[4].type, LWM2M_TYPE_OBJECT_LINK);
+        CU_ASSERT_EQUAL(subP[4].value.asObjLink.objectId, 66);
+        CU_ASSERT_EQUAL(subP[4].value.asObjLink.objectInstanceId, i);
+    }
+    lwm2m_data_free(size, parsedP);
+
+    lwm2m_free(buffer);
+    lwm2m_data_free(20, dataP);
+}
+
+static void test_senml_cbor_parse(void)
+{
+    // indefinite length array and map, base name changing, time and unknown labels, half float
+    uint8_t buffer[] = { 0x9F,
+                         0xBF, 0x21, 0x65, '/', '3', '/', '0', '/', 0x00, 0x61, '1', 0x06, 0x01, 0x03, 0x61, 'x', 0xFF,
+                         0xA3, 0x21, 0x67, '/', '3', '/', '0', '/', '7', '/', 0x00, 0x61, '0', 0x02, 0x19, 0x0E, 0x10,
+                         0xA3, 0x63, 'f', 'o', 'o', 0x80, 0x00, 0x61, '1', 0x02, 0xF9, 0x3E, 0x00,
+                         0xFF };
+    uint8_t mustUnderstand[] = { 0x81, 0xA3, 0x00, 0x66, '/', '3', '/', '0', '/', '1', 0x02, 0x01, 0x64, 'f', 'o', 'o', '_', 0x01 };
+    lwm2m_data_t * dataP;
+    lwm2m_uri_t uri;
+    int64_t intValue;
+    double floatValue;
+    int size;
+
+    lwm2m_stringToUri("/3/0", 4, &uri);
+    size = lwm2m_data_parse(&uri, buffer, sizeof(buffer), LWM2M_CONTENT_SENML_CBOR, &dataP);
+    CU_ASSERT_EQUAL_FATAL(size, 2);
+    CU_ASSERT_EQUAL(dataP[0].id, 1);
+    CU_ASSERT_EQUAL(dataP[0].type, LWM2M_TYPE_STRING);
+    CU_ASSERT_EQUAL(dataP[1].id, 7);
+    CU_ASSERT_EQUAL(dataP[1].type, LWM2M_TYPE_MULTIPLE_RESOURCE);
+    CU_ASSERT_EQUAL_FATAL(dataP[1].value.asChildren.count, 2);
+    CU_ASSERT_EQUAL(lwm2m_data_decode_int(dataP[1].value.asChildren.array, &intValue), 1);
+    CU_ASSERT_EQUAL(intValue, 3600);
+    CU_ASSERT_EQUAL(lwm2m_data_decode_float(dataP[1].value.asChildren.array + 1, &floatValue), 1);
+    CU_ASSERT_DOUBLE_EQUAL(floatValue, 1.5, 0);
+    lwm2m_data_free(size, dataP);
+
+    // a single resource
+    lwm2m_stringToUri("/3/0/1", 6, &uri);
+    size = lwm2m_data_parse(&uri, buffer, sizeof(buffer), LWM2M_CONTENT_SENML_CBOR, &dataP);
+    CU_ASSERT_EQUAL_FATAL(size, 1);
+    CU_ASSERT_EQUAL(dataP->id, 1);
+    CU_ASSERT_EQUAL(dataP->value.asBuffer.length, 1);
+    lwm2m_data_free(size, dataP);
+
+    // truncated
+    lwm2m_stringToUri("/3/0", 4, &uri);
+    size = lwm2m_data_parse(&uri, buffer, sizeof(buffer) - 1, LWM2M_CONTENT_SENML_CBOR, &dataP);
+    CU_ASSERT(size <= 0);
+
+    size = lwm2m_data_parse(&uri, mustUnderstand, sizeof(mustUnderstand), LWM2M_CONTENT_SENML_CBOR, &dataP);
+    CU_ASSERT(size <= 0);
+}
+
+static struct TestTable table[] = {
+        { "test of test_senml_cbor_serialize()", test_senml_cbor_serialize },
+        { "test of test_senml_cbor_round_trip()", test_senml_cbor_round_trip },
+        { "test of test_senml_cbor_parse()", test_senml_cbor_parse },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_senml_cbor_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_senml_cbor", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
@@ -0,0 +1,363 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+#include "shard.h"
+#include "testhelpers.h"
+#include "memtest.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define SHARD_COUNT     2
+#define PRODUCER_COUNT  4
+#define POST_COUNT      2000
+#define TEST_PORT       56830
+#define TEST_PORT_STR   "56830"
+#define WAIT_MS         5000
+
+static shard_runtime_t * g_runtime = NULL;
+static atomic_int g_results;
+static atomic_int g_errors;
+static atomic_int g_lookups;
+static atomic_int g_lookupStatus;
+static atomic_int g_monitorStatus;
+static atomic_uint g_clientID;
+// written by the shard threads only, each to its own row
+static int g_lastSeq[SHARD_COUNT][PRODUCER_COUNT];
+static uint16_t g_mid = 0x2000;
+
+static bool prv_wait(atomic_int * valueP,
+                     int value)
+{
+    struct timespec delay = { 0, 1000000 };
+    int i;
+
+    for (i = 0 ; i < WAIT_MS && atomic_load(valueP) != value ; i++)
+    {
+        nanosleep(&delay, NULL);
+    }
+
+    return atomic_load(valueP) == value;
+}
+
+// Waits for the shard threads to be done with their last event: they allocate nothing while idle.
+static void prv_settle(int * blocksP,
+                       size_t * sizeP)
+{
+    struct timespec delay = { 0, 20000000 };
+    int blocks;
+    size_t size;
+    int i;
+
+    trace_status(blocksP, sizeP);
+    for (i = 0 ; i < WAIT_MS / 20 ; i++)
+    {
+        nanosleep(&delay, NULL);
+        trace_status(&blocks, &size);
+        if (blocks == *blocksP && size == *sizeP) return;
+        *blocksP = blocks;
+        *sizeP = size;
+    }
+}
+
+static void prv_queueCallback(uint32_t clientID,
+                              lwm2m_uri_t * uriP,
+                              int status,
+                              lwm2m_media_type_t format,
+                              uint8_t * data,
+                              int dataLength,
+                              void * userData)
+{
+    int producer = (int)((intptr_t)userData / POST_COUNT);
+    int seq = (int)((intptr_t)userData % POST_COUNT);
+    int shard = SHARD_INDEX(clientID);
+
+    (void)uriP;
+    (void)format;
+    (void)data;
+    (void)dataLength;
+
+    // the operations of a producer reach each shard in the order they were posted
+    if (status != COAP_404_NOT_FOUND || seq <= g_lastSeq[shard][producer])
+    {
+        atomic_fetch_add(&g_errors, 1);
+    }
+    g_lastSeq[shard][producer] = seq;
+    atomic_fetch_add(&g_results, 1);
+}
+
+static void prv_lookupCallback(uint32_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int status,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    (void)clientID;
+    (void)uriP;
+    (void)format;
+    (void)data;
+    (void)dataLength;
+    (void)userData;
+
+    atomic_store(&g_lookupStatus, status);
+    atomic_fetch_add(&g_lookups, 1);
+}
+
+static void * prv_producer(void * arg)
+{
+    int producer = (int)(intptr_t)arg;
+    lwm2m_uri_t uri;
+    int i;
+
+    memset(&uri, 0, sizeof(uri));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID;
+    uri.objectId = 3;
+
+    for (i = 0 ; i < POST_COUNT ; i++)
+    {
+        // no client is registered: every read is answered by its shard with COAP_404_NOT_FOUND
+        if (0 != shard_dm_read(g_runtime, SHARD_CLIENT_ID(i % SHARD_COUNT, 1), &uri,
+                               prv_queueCallback, (void *)(intptr_t)(producer * POST_COUNT + i)))
+        {
+            atomic_fetch_add(&g_errors, 1);
+        }
+    }
+
+    return NULL;
+}
+
+static void test_shard_queue(void)
+{
+    pthread_t threads[PRODUCER_COUNT];
+    int i;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(g_lastSeq, 0xFF, sizeof(g_lastSeq));
+    atomic_store(&g_results, 0);
+    atomic_store(&g_errors, 0);
+    atomic_store(&g_lookups, 0);
+
+    g_runtime = shard_runtime_start("0", AF_INET, SHARD_COUNT, NULL, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(g_runtime);
+
+    for (i = 0 ; i < PRODUCER_COUNT ; i++)
+    {
+        CU_ASSERT_EQUAL_FATAL(pthread_create(threads + i, NULL, prv_producer, (void *)(intptr_t)i), 0);
+    }
+    for (i = 0 ; i < PRODUCER_COUNT ; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    // no operation is lost or reordered
+    CU_ASSERT_TRUE(prv_wait(&g_results, PRODUCER_COUNT * POST_COUNT));
+    CU_ASSERT_EQUAL(atomic_load(&g_errors), 0);
+
+    // every shard answers the lookup, only the last one reports it
+    CU_ASSERT_EQUAL(shard_find_client(g_runtime, "nobody", prv_lookupCallback, NULL), 0);
+    CU_ASSERT_TRUE(prv_wait(&g_lookups, 1));
+    CU_ASSERT_EQUAL(atomic_load(&g_lookupStatus), COAP_404_NOT_FOUND);
+
+    shard_runtime_stop(g_runtime);
+    g_runtime = NULL;
+    CU_ASSERT_EQUAL(atomic_load(&g_lookups), 1);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void prv_monitorCallback(uint32_t clientID,
+                                lwm2m_uri_t * uriP,
+                                int status,
+                                lwm2m_media_type_t format,
+                                uint8_t * data,
+                                int dataLength,
+                                void * userData)
+{
+    (void)uriP;
+    (void)format;
+    (void)data;
+    (void)dataLength;
+    (void)userData;
+
+    atomic_store(&g_clientID, clientID);
+    atomic_store(&g_monitorStatus, status);
+}
+
+static void prv_observeCallback(uint32_t clientID,
+                                lwm2m_uri_t * uriP,
+                                int status,
+                                lwm2m_media_type_t format,
+                                uint8_t * data,
+                                int dataLength,
+                                void * userData)
+{
+    (void)clientID;
+    (void)uriP;
+    (void)format;
+    (void)data;
+    (void)dataLength;
+    (void)userData;
+
+    if (status != COAP_NO_ERROR) atomic_fetch_add(&g_errors, 1);
+    atomic_fetch_add(&g_results, 1);
+}
+
+// Sends the message of the client to the shard and frees its options.
+static void prv_send(connection_t * connP,
+                     coap_packet_t * messageP)
+{
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    struct sockaddr_in addr;
+    size_t length;
+
+    length = coap_serialize_message(messageP, buffer);
+    coap_free_header(messageP);
+    CU_ASSERT_FATAL(length != 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(TEST_PORT);
+    CU_ASSERT_EQUAL(sendto(connP->sock, buffer, length, 0, (struct sockaddr *)&addr, sizeof(addr)), (ssize_t)length);
+}
+
+static bool prv_receive(connection_t * connP,
+                        coap_packet_t * messageP,
+                        uint8_t * buffer,
+                        size_t size)
+{
+    struct pollfd pfd;
+
+    pfd.fd = connP->sock;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, WAIT_MS) != 1) return false;
+
+    return test_receive(connP, messageP, buffer, size);
+}
+
+// Registers a client, observes the same instance twice and deregisters the client.
+static void prv_observeCycle(connection_t * connP)
+{
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    char path[16];
+    coap_packet_t message;
+    coap_packet_t request;
+    lwm2m_uri_t uri;
+    uint32_t clientID;
+    int i;
+
+    atomic_store(&g_results, 0);
+    atomic_store(&g_errors, 0);
+    atomic_store(&g_monitorStatus, 0);
+
+    coap_init_message(&message, COAP_TYPE_CON, COAP_POST, g_mid++);
+    coap_set_header_uri_path(&message, "/"URI_REGISTRATION_SEGMENT);
+    coap_set_header_uri_query(&message, QUERY_NAME "shardtest&" QUERY_VERSION_FULL);
+    coap_set_header_content_type(&message, LWM2M_CONTENT_LINK);
+    coap_set_payload(&message, "</1024/0>", 9);
+    prv_send(connP, &message);
+    CU_ASSERT_TRUE_FATAL(prv_receive(connP, &message, buffer, sizeof(buffer)));
+    CU_ASSERT_EQUAL_FATAL(message.code, COAP_201_CREATED);
+    CU_ASSERT_TRUE_FATAL(prv_wait(&g_monitorStatus, COAP_201_CREATED));
+    clientID = atomic_load(&g_clientID);
+
+    memset(&uri, 0, sizeof(uri));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID;
+    uri.objectId = 1024;
+    uri.instanceId = 0;
+
+    // the second observe takes the observation of the first one over, which releases its operation
+    for (i = 0 ; i < 2 ; i++)
+    {
+        CU_ASSERT_EQUAL(shard_observe(g_runtime, clientID, &uri, prv_observeCallback, NULL), 0);
+        CU_ASSERT_TRUE_FATAL(prv_receive(connP, &request, buffer, sizeof(buffer)));
+        CU_ASSERT_EQUAL(request.code, COAP_GET);
+        CU_ASSERT_TRUE(IS_OPTION(&request, COAP_OPTION_OBSERVE));
+
+        test_initAnswer(&message, &request, COAP_TYPE_ACK, COAP_205_CONTENT);
+        coap_set_header_observe(&message, i + 1);
+        coap_set_header_content_type(&message, LWM2M_CONTENT_TEXT);
+        coap_set_payload(&message, "1", 1);
+        prv_send(connP, &message);
+        CU_ASSERT_TRUE(prv_wait(&g_results, i + 1));
+    }
+    CU_ASSERT_EQUAL(atomic_load(&g_errors), 0);
+
+    coap_init_message(&message, COAP_TYPE_CON, COAP_DELETE, g_mid++);
+    snprintf(path, sizeof(path), "/"URI_REGISTRATION_SEGMENT"/%u", SHARD_INTERNAL_ID(clientID));
+    coap_set_header_uri_path(&message, path);
+    prv_send(connP, &message);
+    CU_ASSERT_TRUE_FATAL(prv_receive(connP, &message, buffer, sizeof(buffer)));
+    CU_ASSERT_EQUAL(message.code, COAP_202_DELETED);
+    CU_ASSERT_TRUE(prv_wait(&g_monitorStatus, COAP_202_DELETED));
+}
+
+static void test_shard_observe_release(void)
+{
+    connection_t conn;
+    int blocksBefore;
+    size_t sizeBefore;
+    int blocksAfter;
+    size_t sizeAfter;
+
+    MEMORY_TRACE_BEFORE;
+
+    g_runtime = shard_runtime_start(TEST_PORT_STR, AF_INET, 1, prv_monitorCallback, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(g_runtime);
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+
+    // the first cycle leaves the state the shard keeps per peer, like its congestion control
+    prv_observeCycle(&conn);
+    prv_settle(&blocksBefore, &sizeBefore);
+
+    // the observe operations are freed with their observations, here with the client
+    prv_observeCycle(&conn);
+    prv_settle(&blocksAfter, &sizeAfter);
+    CU_ASSERT_EQUAL(blocksAfter, blocksBefore);
+    CU_ASSERT_EQUAL(sizeAfter, sizeBefore);
+
+    close(conn.sock);
+    shard_runtime_stop(g_runtime);
+    g_runtime = NULL;
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of test_shard_queue()", test_shard_queue },
+        { "test of test_shard_observe_release()", test_shard_observe_release },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_shard_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_shard", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "testhelpers.h"
+#include "CUnit/Basic.h"
+
+static uint16_t g_nextMid = 0x7000;
+
+int test_openLoopback(connection_t * connP)
+{
+    struct sockaddr_in * addrP = (struct sockaddr_in *)&connP->addr;
+    socklen_t addrLen;
+
+    memset(connP, 0, sizeof(connection_t));
+    connP->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (connP->sock < 0) return 0;
+
+    addrP->sin_family = AF_INET;
+    addrP->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addrP->sin_port = 0;
+    addrLen = sizeof(struct sockaddr_in);
+    if (0 != bind(connP->sock, (struct sockaddr *)addrP, addrLen)
+     || 0 != getsockname(connP->sock, (struct sockaddr *)addrP, &addrLen))
+    {
+        close(connP->sock);
+        return 0;
+    }
+    connP->addrLen = addrLen;
+
+    return 1;
+}
+
+uint16_t test_addClient(lwm2m_context_t * contextP,
+                        connection_t * connP)
+{
+    lwm2m_client_t * clientP;
+
+    clientP = (lwm2m_client_t *)lwm2m_malloc(sizeof(lwm2m_client_t));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(clientP);
+    memset(clientP, 0, sizeof(lwm2m_client_t));
+    clientP->sessionH = connP;
+    CU_ASSERT_TRUE_FATAL(registry_newId(contextP, &clientP->internalID));
+    CU_ASSERT_EQUAL_FATAL(registry_add(contextP, clientP), 1);
+
+    return clientP->internalID;
+}
+
+bool test_receive(connection_t * connP,
+                  coap_packet_t * messageP,
+                  uint8_t * buffer,
+                  size_t size)
+{
+    int length;
+
+    length = recv(connP->sock, buffer, size, MSG_DONTWAIT);
+    if (length <= 0) return false;
+    if (NO_ERROR != coap_parse_message(messageP, buffer, (uint16_t)length)) return false;
+    coap_free_header(messageP);
+
+    return true;
+}
+
+void test_initAnswer(coap_packet_t * messageP,
+                     coap_packet_t * requestP,
+                     coap_message_type_t type,
+                     uint8_t code)
+{
+    coap_init_message(messageP, type, code, type == COAP_TYPE_ACK ? requestP->mid : g_nextMid++);
+    coap_set_header_token(messageP, requestP->token, requestP->token_len);
+}
+
+void test_deliver(lwm2m_context_t * contextP,
+                  connection_t * connP,
+                  coap_packet_t * messageP)
+{
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    size_t length;
+
+    length = coap_serialize_message(messageP, buffer);
+    coap_free_header(messageP);
+    CU_ASSERT_FATAL(length != 0);
+
+    lwm2m_handle_packet(contextP, buffer, (int)length, connP);
+}
@@ -0,0 +1,42 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+/*
+ * Fixtures shared by the tests playing the peers of a context over the loopback.
+ */
+
+#ifndef TESTHELPERS_H_
+#define TESTHELPERS_H_
+
+#include "internals.h"
+#include "connection.h"
+
+// Opens a UDP socket bound to the loopback. The connection sends to its own socket so the test
+// reads back what the stack sent.
+int test_openLoopback(connection_t * connP);
+// Registers a client reached through connP on the server side of contextP. Returns its internal ID.
+uint16_t test_addClient(lwm2m_context_t * contextP, connection_t * connP);
+// Reads the next datagram sent to connP and parses it in messageP, with buffer as its storage.
+// Returns false if there is none.
+bool test_receive(connection_t * connP, coap_packet_t * messageP, uint8_t * buffer, size_t size);
+// Starts the message of the peer answering requestP with code: an ACK of the request, or a separate
+// message with the same token.
+void test_initAnswer(coap_packet_t * messageP, coap_packet_t * requestP, coap_message_type_t type, uint8_t code);
+// Serializes the message of the peer, frees its options and hands it to contextP.
+void test_deliver(lwm2m_context_t * contextP, connection_t * connP, coap_packet_t * messageP);
+
+#endif /* TESTHELPERS_H_ */
@@ -32,5 +32,18 @@ CU_ErrorCode create_object_read_suit();
 CU_ErrorCode create_convert_numbers_suit();
 CU_ErrorCode create_tlv_json_suit();
 CU_ErrorCode create_block1_suit();
+CU_ErrorCode create_registry_suit();
+CU_ErrorCode create_timer_suit();
+CU_ErrorCode create_packet_suit();
+CU_ErrorCode create_observe_suit();
+CU_ErrorCode create_connection_suit();
+CU_ErrorCode create_pool_suit();
+CU_ErrorCode create_senml_cbor_suit();
+CU_ErrorCode create_block2_suit();
+CU_ErrorCode create_registration_suit();
+CU_ErrorCode create_transaction_suit();
+CU_ErrorCode create_bulk_suit();
+CU_ErrorCode create_completion_suit();
+CU_ErrorCode create_shard_suit();
 
 #endif /* TESTS_H_ */
@@ -0,0 +1,136 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+
+#define TIMER_COUNT 1000
+
+static time_t lastFired;
+static int firedCount;
+static bool orderKept;
+
+static void prv_callback(lwm2m_context_t * contextP,
+                         void * userData,
+                         time_t currentTime)
+{
+    lwm2m_timer_t * timerP = (lwm2m_timer_t *)userData;
+
+    (void)contextP;
+    (void)currentTime;
+
+    if (timerP->deadline < lastFired) orderKept = false;
+    lastFired = timerP->deadline;
+    firedCount++;
+}
+
+static void prv_rescheduleCallback(lwm2m_context_t * contextP,
+                                   void * userData,
+                                   time_t currentTime)
+{
+    firedCount++;
+    // rescheduling in the past must not fire again in the same step
+    timer_schedule(contextP, (lwm2m_timer_t *)userData, currentTime - 10);
+}
+
+static void test_timer_order(void)
+{
+    lwm2m_context_t context;
+    lwm2m_timer_t timers[TIMER_COUNT];
+    time_t timeout;
+    int i;
+
+    memset(&context, 0, sizeof(lwm2m_context_t));
+    memset(timers, 0, sizeof(timers));
+    for (i = 0 ; i < TIMER_COUNT ; i++)
+    {
+        timers[i].callback = prv_callback;
+        timers[i].userData = timers + i;
+        CU_ASSERT_EQUAL(timer_schedule(&context, timers + i, 100 + (i * 7919) % TIMER_COUNT), 1);
+    }
+    // move some timers and cancel others
+    for (i = 0 ; i < TIMER_COUNT ; i += 10)
+    {
+        timer_cancel(&context, timers + i);
+        CU_ASSERT_EQUAL(timer_schedule(&context, timers + i + 1, 50 + i), 1);
+    }
+    CU_ASSERT_EQUAL(context.timers.count, TIMER_COUNT - TIMER_COUNT / 10);
+
+    lastFired = 0;
+    firedCount = 0;
+    orderKept = true;
+    timeout = 1000;
+    timer_step(&context, 99, &timeout);
+    CU_ASSERT_EQUAL(firedCount, 5);
+    CU_ASSERT_EQUAL(timeout, 1);
+
+    timeout = 1000;
+    timer_step(&context, 100 + TIMER_COUNT, &timeout);
+    CU_ASSERT_EQUAL(firedCount, TIMER_COUNT - TIMER_COUNT / 10);
+    CU_ASSERT_TRUE(orderKept);
+    CU_ASSERT_EQUAL(timeout, 1000);
+    CU_ASSERT_EQUAL(context.timers.count, 0);
+
+    timer_close(&context);
+}
+
+static void test_timer_reschedule(void)
+{
+    lwm2m_context_t context;
+    lwm2m_timer_t timer;
+    time_t timeout;
+
+    memset(&context, 0, sizeof(lwm2m_context_t));
+    memset(&timer, 0, sizeof(lwm2m_timer_t));
+    timer.callback = prv_rescheduleCallback;
+    timer.userData = &timer;
+
+    firedCount = 0;
+    CU_ASSERT_EQUAL(timer_schedule(&context, &timer, 0), 1);
+    timeout = 60;
+    timer_step(&context, 20, &timeout);
+    CU_ASSERT_EQUAL(firedCount, 1);
+    CU_ASSERT_EQUAL(timer.deadline, 21);
+    CU_ASSERT_EQUAL(timeout, 1);
+
+    timer_cancel(&context, &timer);
+    CU_ASSERT_EQUAL(timer.index, 0);
+    timeout = 60;
+    timer_step(&context, 30, &timeout);
+    CU_ASSERT_EQUAL(firedCount, 1);
+    CU_ASSERT_EQUAL(timeout, 60);
+
+    timer_close(&context);
+}
+
+static struct TestTable table[] = {
+        { "test of test_timer_order()", test_timer_order },
+        { "test of test_timer_reschedule()", test_timer_reschedule },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_timer_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_timer", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
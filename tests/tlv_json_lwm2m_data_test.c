@@ -24,12 +24,15 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <ctype.h> // isspace
+#include <time.h>
 
 #include "commandline.h"
 
 #include "tests.h"
 #include "CUnit/Basic.h"
 
+#define PARSE_LOOP_COUNT    2000
+
 static void test_data(const char * uriStr,
                         lwm2m_media_type_t format,
                         lwm2m_data_t * tlvP,
@@ -384,6 +387,173 @@ static void test_10(void)
     test_data("/12/0", LWM2M_CONTENT_JSON, data1, 17, "10b");
 }
 
+// 40 instances of 4 resources: more than the 1024 bytes the serializer used to be limited to
+static lwm2m_data_t * prv_createLargeObject(void)
+{
+    lwm2m_data_t * dataP;
+    uint8_t opaque[] = { 0x01, 0x02, 0x03, 0x04 };
+    int i;
+
+    dataP = lwm2m_data_new(40);
+    if (dataP == NULL) return NULL;
+    for (i = 0; i < 40; i++)
+    {
+        lwm2m_data_t * subP = lwm2m_data_new(4);
+
+        if (subP == NULL) return NULL;
+        subP[0].id = 0;
+        lwm2m_data_encode_string("Open Mobile Alliance", subP);
+        subP[1].id = 1;
+        lwm2m_data_encode_int(-1000 * i, subP + 1);
+        subP[2].id = 2;
+        lwm2m_data_encode_bool(i % 2, subP + 2);
+        subP[3].id = 3;
+        lwm2m_data_encode_opaque(opaque, sizeof(opaque), subP + 3);
+        dataP[i].id = i;
+        lwm2m_data_include(subP, 4, dataP + i);
+    }
+
+    return dataP;
+}
+
+static void test_11(void)
+{
+    const char * expected = "{\"bn\":\"/12/\",\"e\":["
+                            "{\"n\":\"0/0\",\"sv\":\"Open Mobile Alliance\"},"
+                            "{\"n\":\"0/1\",\"v\":0},"
+                            "{\"n\":\"0/2\",\"bv\":false},"
+                            "{\"n\":\"0/3\",\"sv\":\"AQIDBA==\"},"
+                            "{\"n\":\"1/0\",\"sv\":\"Open Mobile Alliance\"},"
+                            "{\"n\":\"1/1\",\"v\":-1000},"
+                            "{\"n\":\"1/2\",\"bv\":true},";
+    const char * end = "{\"n\":\"39/3\",\"sv\":\"AQIDBA==\"}]}";
+    lwm2m_data_t * dataP;
+    lwm2m_media_type_t format;
+    lwm2m_uri_t uri;
+    uint8_t * buffer;
+    int length;
+
+    dataP = prv_createLargeObject();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    lwm2m_stringToUri("/12", 3, &uri);
+
+    format = LWM2M_CONTENT_JSON;
+    length = lwm2m_data_serialize(&uri, 40, dataP, &format, &buffer);
+    CU_ASSERT_FATAL(length > 1024);
+    CU_ASSERT_EQUAL(format, LWM2M_CONTENT_JSON);
+    CU_ASSERT_NSTRING_EQUAL(buffer, expected, strlen(expected));
+    CU_ASSERT_NSTRING_EQUAL(buffer + length - strlen(end), end, strlen(end));
+
+    lwm2m_free(buffer);
+    lwm2m_data_free(40, dataP);
+}
+
+static void test_12(void)
+{
+    lwm2m_data_t * dataP;
+    lwm2m_data_t * parsedP;
+    lwm2m_uri_t uri;
+    uint8_t * buffer;
+    int64_t value;
+    int length;
+    int size;
+    int i;
+
+    dataP = prv_createLargeObject();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    lwm2m_stringToUri("/12", 3, &uri);
+    length = json_serialize(&uri, 40, dataP, &buffer);
+    CU_ASSERT_FATAL(length > 0);
+
+    // the records of the 40 instances are gathered in one pass
+    size = json_parse(&uri, buffer, length, &parsedP);
+    CU_ASSERT_EQUAL_FATAL(size, 40);
+    for (i = 0; i < 40; i++)
+    {
+        CU_ASSERT_EQUAL(parsedP[i].id, i);
+        CU_ASSERT_EQUAL(parsedP[i].type, LWM2M_TYPE_OBJECT_INSTANCE);
+        CU_ASSERT_EQUAL_FATAL(parsedP[i].value.asChildren.count, 4);
+        CU_ASSERT_EQUAL(parsedP[i].value.asChildren.array[0].type, LWM2M_TYPE_STRING);
+        CU_ASSERT_EQUAL(lwm2m_data_decode_int(parsedP[i].value.asChildren.array + 1, &value), 1);
+        CU_ASSERT_EQUAL(value, -1000 * i);
+    }
+    lwm2m_data_free(size, parsedP);
+
+    // a single resource
+    lwm2m_stringToUri("/12/39/1", 8, &uri);
+    size = json_parse(&uri, buffer, length, &parsedP);
+    CU_ASSERT_EQUAL_FATAL(size, 1);
+    CU_ASSERT_EQUAL(parsedP->id, 1);
+    CU_ASSERT_EQUAL(lwm2m_data_decode_int(parsedP, &value), 1);
+    CU_ASSERT_EQUAL(value, -39000);
+    lwm2m_data_free(size, parsedP);
+
+    lwm2m_free(buffer);
+    lwm2m_data_free(40, dataP);
+}
+
+// Throughput of json_parse() on the serialized large object, compact then indented
+static double prv_measureParse(lwm2m_uri_t * uriP,
+                               uint8_t * buffer,
+                               size_t length)
+{
+    clock_t start;
+    double seconds;
+    int i;
+
+    start = clock();
+    for (i = 0; i < PARSE_LOOP_COUNT; i++)
+    {
+        lwm2m_data_t * dataP;
+        int size;
+
+        size = json_parse(uriP, buffer, length, &dataP);
+        CU_ASSERT_EQUAL_FATAL(size, 40);
+        lwm2m_data_free(size, dataP);
+    }
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (seconds <= 0) return 0;
+
+    return (double)length * PARSE_LOOP_COUNT / seconds / 1e6;
+}
+
+static void test_json_benchmark(void)
+{
+    lwm2m_data_t * dataP;
+    lwm2m_uri_t uri;
+    uint8_t * buffer;
+    uint8_t * indented;
+    size_t indentedLen;
+    int length;
+    int i;
+
+    dataP = prv_createLargeObject();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    lwm2m_stringToUri("/12", 3, &uri);
+    length = json_serialize(&uri, 40, dataP, &buffer);
+    CU_ASSERT_FATAL(length > 0);
+
+    indented = (uint8_t *)lwm2m_malloc(length * 16);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(indented);
+    indentedLen = 0;
+    for (i = 0; i < length; i++)
+    {
+        indented[indentedLen++] = buffer[i];
+        if (buffer[i] == '[' || (buffer[i] == ',' && buffer[i + 1] == '{'))
+        {
+            memcpy(indented + indentedLen, "\n                ", 17);
+            indentedLen += 17;
+        }
+    }
+
+    printf("\n    compact, %d bytes: %.1f MB/s", length, prv_measureParse(&uri, buffer, length));
+    printf("\n    indented, %d bytes: %.1f MB/s\n", (int)indentedLen, prv_measureParse(&uri, indented, indentedLen));
+
+    lwm2m_free(indented);
+    lwm2m_free(buffer);
+    lwm2m_data_free(40, dataP);
+}
+
 static struct TestTable table[] = {
         { "test of test_1()", test_1 },
         { "test of test_2()", test_2 },
@@ -395,6 +565,9 @@ static struct TestTable table[] = {
         { "test of test_8()", test_8 },
         { "test of test_9()", test_9 },
         { "test of test_10()", test_10 },
+        { "test of test_11()", test_11 },
+        { "test of test_12()", test_12 },
+        { "test of test_json_benchmark()", test_json_benchmark },
         { NULL, NULL },
 };
 
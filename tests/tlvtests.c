@@ -227,6 +227,96 @@ static void test_tlv_serialize()
     MEMORY_TRACE_AFTER_EQ;
 }
 
+// Two instances holding an integer, a multiple resource and a 300 bytes opaque resource
+static lwm2m_data_t * prv_createObject(uint8_t * opaque,
+                                       size_t opaqueLen)
+{
+    lwm2m_data_t * dataP;
+    int i;
+
+    dataP = lwm2m_data_new(2);
+    if (dataP == NULL) return NULL;
+    for (i = 0 ; i < 2 ; i++)
+    {
+        lwm2m_data_t * subP = lwm2m_data_new(3);
+        lwm2m_data_t * instP = lwm2m_data_new(2);
+
+        if (subP == NULL || instP == NULL) return NULL;
+        subP[0].id = 1;
+        lwm2m_data_encode_int(100000 * (i + 1), subP);
+        instP[0].id = 0;
+        lwm2m_data_encode_bool(true, instP);
+        instP[1].id = 1;
+        lwm2m_data_encode_string("instance", instP + 1);
+        subP[1].id = 7;
+        lwm2m_data_encode_instances(instP, 2, subP + 1);
+        subP[2].id = 300;
+        lwm2m_data_encode_opaque(opaque, opaqueLen, subP + 2);
+        dataP[i].id = i;
+        lwm2m_data_include(subP, 3, dataP + i);
+    }
+
+    return dataP;
+}
+
+static void test_tlv_serialize_to()
+{
+    MEMORY_TRACE_BEFORE;
+
+    lwm2m_data_t * dataP;
+    uint8_t opaque[300];
+    uint8_t * expected;
+    uint8_t small[16];
+    uint8_t large[1024];
+    utils_buffer_t output;
+    int length;
+    int result;
+
+    memset(opaque, 0x5A, sizeof(opaque));
+    dataP = prv_createObject(opaque, sizeof(opaque));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+
+    length = tlv_serialize(false, 2, dataP, &expected);
+    CU_ASSERT_FATAL(length > 0);
+    // instance headers are two bytes long, the opaque headers use a 16-bit length
+    CU_ASSERT_EQUAL(expected[0], 0x10);
+    CU_ASSERT_EQUAL(expected[1], 0);
+    CU_ASSERT_EQUAL((expected[2] << 8) + expected[3], length / 2 - 4);
+    CU_ASSERT_EQUAL(expected[4], 0xC4);
+    CU_ASSERT_EQUAL(expected[5], 1);
+
+    // caller storage, moved to the heap when too small
+    utils_bufferInit(&output, small, sizeof(small), false);
+    result = tlv_serializeTo(false, 2, dataP, &output);
+    CU_ASSERT_EQUAL(result, length);
+    CU_ASSERT_EQUAL(output.length, (size_t)length);
+    CU_ASSERT_TRUE(output.isAllocated);
+    CU_ASSERT(0 == memcmp(output.data, expected, length));
+    utils_bufferFree(&output);
+
+    // fixed storage too small: nothing written
+    utils_bufferInit(&output, small, sizeof(small), true);
+    result = tlv_serializeTo(false, 2, dataP, &output);
+    CU_ASSERT_EQUAL(result, -1);
+    CU_ASSERT_EQUAL(output.length, 0);
+    CU_ASSERT_FALSE(output.isAllocated);
+
+    // appended after existing content, without any allocation
+    utils_bufferInit(&output, large, sizeof(large), true);
+    output.data[0] = 0xFF;
+    output.length = 1;
+    result = tlv_serializeTo(false, 2, dataP, &output);
+    CU_ASSERT_EQUAL(result, length);
+    CU_ASSERT_EQUAL(output.length, (size_t)length + 1);
+    CU_ASSERT_EQUAL(large[0], 0xFF);
+    CU_ASSERT(0 == memcmp(large + 1, expected, length));
+
+    lwm2m_free(expected);
+    lwm2m_data_free(2, dataP);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
 static void test_tlv_int(void)
 {
    MEMORY_TRACE_BEFORE;
@@ -252,6 +342,7 @@ static void test_tlv_int(void)
    result = lwm2m_data_decode_int(dataP, &value);
    CU_ASSERT_EQUAL(result, 1);
    CU_ASSERT_EQUAL(value, 18);
+   lwm2m_free(dataP->value.asBuffer.buffer);
 
    lwm2m_data_encode_string("-14678", dataP);
    CU_ASSERT_EQUAL(dataP->type, LWM2M_TYPE_STRING);
@@ -260,6 +351,7 @@ static void test_tlv_int(void)
    result = lwm2m_data_decode_int(dataP, &value);
    CU_ASSERT_EQUAL(result, 1);
    CU_ASSERT_EQUAL(value, -14678);
+   lwm2m_free(dataP->value.asBuffer.buffer);
 
    uint8_t data1[] = { 0xed, 0xcc };
    lwm2m_data_encode_opaque(data1, sizeof(data1), dataP);
@@ -318,6 +410,7 @@ static void test_tlv_bool(void)
    result = lwm2m_data_decode_bool(dataP, &value);
    CU_ASSERT_EQUAL(result, 1);
    CU_ASSERT_EQUAL(value, true);
+   lwm2m_free(dataP->value.asBuffer.buffer);
 
    lwm2m_data_encode_string("0", dataP);
    CU_ASSERT_EQUAL(dataP->type, LWM2M_TYPE_STRING);
@@ -326,6 +419,7 @@ static void test_tlv_bool(void)
    result = lwm2m_data_decode_bool(dataP, &value);
    CU_ASSERT_EQUAL(result, 1);
    CU_ASSERT_EQUAL(value, false);
+   lwm2m_free(dataP->value.asBuffer.buffer);
 
    uint8_t data1[] = { 0x00 };
    lwm2m_data_encode_opaque(data1, sizeof(data1), dataP);
@@ -377,6 +471,7 @@ static void test_tlv_float(void)
     result = lwm2m_data_decode_float(dataP, &value);
     CU_ASSERT_EQUAL(result, 1);
     CU_ASSERT_EQUAL(value, 1234.56);
+    lwm2m_free(dataP->value.asBuffer.buffer);
 
     lwm2m_data_encode_string("-123456789.987", dataP);
     CU_ASSERT_EQUAL(dataP->type, LWM2M_TYPE_STRING);
@@ -396,6 +491,7 @@ static struct TestTable table[] = {
         { "test of lwm2m_decodeTLV()", test_decodeTLV },
         { "test of lwm2m_data_parse()", test_tlv_parse },
         { "test of lwm2m_data_serialize()", test_tlv_serialize },
+        { "test of tlv_serializeTo()", test_tlv_serialize_to },
         { "test of lwm2m_data_encode_int() and lwm2m_data_decode_int()", test_tlv_int },
         { "test of lwm2m_data_encode_bool()and lwm2m_data_decode_bool()", test_tlv_bool },
         { "test of lwm2m_data_encode_float() and lwm2m_data_decode_float()", test_tlv_float },
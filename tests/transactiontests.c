@@ -0,0 +1,373 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2016 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "liblwm2m.h"
+#include "connection.h"
+#include "testhelpers.h"
+
+#define TEST_PEER_COUNT         8
+#define TEST_TRANSACTION_COUNT  500
+#define TEST_SAMPLE_COUNT       20
+
+static int g_peers[TEST_PEER_COUNT];
+static int g_callbackCount = 0;
+static lwm2m_transaction_t * g_lastTransacP = NULL;
+
+static void prv_callback(lwm2m_transaction_t * transacP,
+                         void * message)
+{
+    (void)message;
+
+    g_callbackCount++;
+    g_lastTransacP = transacP;
+}
+
+// The transactions are only added, the tests play the peers' answers.
+static lwm2m_transaction_t * prv_add(lwm2m_context_t * contextP,
+                                     void * peerH,
+                                     uint16_t mID,
+                                     uint16_t tokenValue)
+{
+    lwm2m_transaction_t * transacP;
+    uint8_t token[2];
+
+    token[0] = tokenValue >> 8;
+    token[1] = tokenValue & 0xFF;
+    transacP = transaction_new(peerH, COAP_GET, NULL, NULL, mID, sizeof(token), token);
+    if (transacP == NULL) return NULL;
+    transacP->callback = prv_callback;
+    transaction_add(contextP, transacP);
+
+    return transacP;
+}
+
+static bool prv_answer(lwm2m_context_t * contextP,
+                       void * peerH,
+                       coap_message_type_t type,
+                       uint8_t code,
+                       uint16_t mID,
+                       uint16_t tokenValue)
+{
+    coap_packet_t message;
+    uint8_t token[2];
+    bool result;
+
+    token[0] = tokenValue >> 8;
+    token[1] = tokenValue & 0xFF;
+    coap_init_message(&message, type, code, mID);
+    if (code != 0) coap_set_header_token(&message, token, sizeof(token));
+    g_callbackCount = 0;
+    g_lastTransacP = NULL;
+
+    result = transaction_handleResponse(contextP, peerH, &message, NULL);
+    coap_free_header(&message);
+
+    return result;
+}
+
+static int prv_count(lwm2m_context_t * contextP)
+{
+    lwm2m_transaction_t * transacP;
+    int count;
+
+    count = 0;
+    for (transacP = contextP->transactionList ; transacP != NULL ; transacP = transacP->next)
+    {
+        count++;
+    }
+    CU_ASSERT_EQUAL(count, contextP->transactionIndex.count);
+
+    return count;
+}
+
+static void test_transaction_match(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_transaction_t * firstP;
+    lwm2m_transaction_t * secondP;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    // the same MID and token sent to two peers
+    firstP = prv_add(contextP, g_peers, 10, 0x1234);
+    secondP = prv_add(contextP, g_peers + 1, 10, 0x1234);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(firstP);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(secondP);
+
+    // piggybacked response
+    CU_ASSERT_TRUE(prv_answer(contextP, g_peers + 1, COAP_TYPE_ACK, COAP_205_CONTENT, 10, 0x1234));
+    CU_ASSERT_EQUAL(g_callbackCount, 1);
+    CU_ASSERT_PTR_EQUAL(g_lastTransacP, secondP);
+    CU_ASSERT_EQUAL(prv_count(contextP), 1);
+
+    // unknown peer, MID or token
+    CU_ASSERT_FALSE(prv_answer(contextP, g_peers + 2, COAP_TYPE_ACK, COAP_205_CONTENT, 10, 0x1234));
+    CU_ASSERT_FALSE(prv_answer(contextP, g_peers, COAP_TYPE_CON, COAP_205_CONTENT, 11, 0x4321));
+    CU_ASSERT_EQUAL(prv_count(contextP), 1);
+
+    // empty ACK then separate response with its own MID
+    CU_ASSERT_TRUE(prv_answer(contextP, g_peers, COAP_TYPE_ACK, 0, 10, 0));
+    CU_ASSERT_EQUAL(g_callbackCount, 0);
+    CU_ASSERT_TRUE(firstP->ack_received);
+    CU_ASSERT_TRUE(prv_answer(contextP, g_peers, COAP_TYPE_NON, COAP_205_CONTENT, 1000, 0x1234));
+    CU_ASSERT_EQUAL(g_callbackCount, 1);
+    CU_ASSERT_PTR_EQUAL(g_lastTransacP, firstP);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+
+    // a reset ends the transaction
+    firstP = prv_add(contextP, g_peers, 12, 0x1235);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(firstP);
+    CU_ASSERT_TRUE(prv_answer(contextP, g_peers, COAP_TYPE_RST, 0, 12, 0));
+    CU_ASSERT_EQUAL(g_callbackCount, 1);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+
+    lwm2m_close(contextP);
+}
+
+static void test_transaction_many(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_transaction_t * transacP;
+    int count;
+    int i;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    for (i = 0 ; i < TEST_TRANSACTION_COUNT ; i++)
+    {
+        CU_ASSERT_PTR_NOT_NULL_FATAL(prv_add(contextP, g_peers + (i % TEST_PEER_COUNT), (uint16_t)(65500 + i), (uint16_t)i));
+    }
+    CU_ASSERT_EQUAL(prv_count(contextP), TEST_TRANSACTION_COUNT);
+    CU_ASSERT(contextP->transactionIndex.size >= TEST_TRANSACTION_COUNT);
+
+    // answered in another order than sent
+    for (i = TEST_TRANSACTION_COUNT - 1 ; i >= 0 ; i -= 2)
+    {
+        CU_ASSERT_TRUE(prv_answer(contextP, g_peers + (i % TEST_PEER_COUNT), COAP_TYPE_ACK, COAP_205_CONTENT, (uint16_t)(65500 + i), (uint16_t)i));
+        CU_ASSERT_EQUAL(g_callbackCount, 1);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(g_lastTransacP);
+        CU_ASSERT_EQUAL(g_lastTransacP->mID, (uint16_t)(65500 + i));
+    }
+    CU_ASSERT_EQUAL(prv_count(contextP), TEST_TRANSACTION_COUNT / 2);
+
+    // the transactions of a peer leave without calling back
+    count = 0;
+    for (transacP = contextP->transactionList ; transacP != NULL ; transacP = transacP->next)
+    {
+        if (transacP->peerH == g_peers) count++;
+    }
+    CU_ASSERT(count > 0);
+    transaction_removePeer(contextP, g_peers);
+    CU_ASSERT_EQUAL(g_callbackCount, 1);
+    CU_ASSERT_EQUAL(prv_count(contextP), TEST_TRANSACTION_COUNT / 2 - count);
+    CU_ASSERT_FALSE(prv_answer(contextP, g_peers, COAP_TYPE_ACK, COAP_205_CONTENT, 65500, 0));
+
+    lwm2m_close(contextP);
+}
+
+// Returns the number of transmissions received by the peer since the last call.
+static int prv_received(connection_t * connP)
+{
+    uint8_t buffer[64];
+    int count;
+
+    count = 0;
+    while (recv(connP->sock, buffer, sizeof(buffer), MSG_DONTWAIT) > 0)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+static lwm2m_transaction_t * prv_send(lwm2m_context_t * contextP,
+                                      connection_t * connP,
+                                      uint16_t mID)
+{
+    lwm2m_transaction_t * transacP;
+
+    transacP = prv_add(contextP, connP, mID, mID);
+    if (transacP == NULL) return NULL;
+    if (transaction_send(contextP, transacP) != 0) return NULL;
+
+    return transacP;
+}
+
+static void test_transaction_nstart(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_transaction_t * transacP[3];
+    connection_t conn;
+    int i;
+
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    // one request in flight, the following ones wait for their turn
+    for (i = 0 ; i < 3 ; i++)
+    {
+        transacP[i] = prv_send(contextP, &conn, (uint16_t)(20 + i));
+        CU_ASSERT_PTR_NOT_NULL_FATAL(transacP[i]);
+    }
+    CU_ASSERT_EQUAL(prv_received(&conn), 1);
+    CU_ASSERT_TRUE(transacP[0]->inFlight);
+    CU_ASSERT_TRUE(transacP[1]->queued);
+    CU_ASSERT_TRUE(transacP[2]->queued);
+    CU_ASSERT_EQUAL(transacP[1]->retrans_counter, 0);
+    CU_ASSERT_EQUAL(contextP->peers.inFlight, 1);
+
+    // the answer lets the next one go
+    CU_ASSERT_TRUE(prv_answer(contextP, &conn, COAP_TYPE_ACK, COAP_205_CONTENT, 20, 20));
+    CU_ASSERT_EQUAL(g_callbackCount, 1);
+    CU_ASSERT_EQUAL(prv_received(&conn), 1);
+    CU_ASSERT_TRUE(transacP[1]->inFlight);
+    CU_ASSERT_EQUAL(transacP[1]->retrans_counter, 2);
+
+    // a waiting request leaves the queue without being sent
+    transaction_remove(contextP, transacP[2]);
+    CU_ASSERT_TRUE(prv_answer(contextP, &conn, COAP_TYPE_ACK, COAP_205_CONTENT, 21, 21));
+    CU_ASSERT_EQUAL(prv_received(&conn), 0);
+    CU_ASSERT_EQUAL(contextP->peers.inFlight, 0);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+
+    // more requests in flight on demand
+    CU_ASSERT_EQUAL(lwm2m_set_congestion_options(contextP, 0, 0), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(lwm2m_set_congestion_options(contextP, 2, 0), COAP_NO_ERROR);
+    for (i = 0 ; i < 3 ; i++)
+    {
+        transacP[i] = prv_send(contextP, &conn, (uint16_t)(30 + i));
+        CU_ASSERT_PTR_NOT_NULL_FATAL(transacP[i]);
+    }
+    CU_ASSERT_EQUAL(prv_received(&conn), 2);
+    CU_ASSERT_TRUE(transacP[2]->queued);
+
+    // the state of the peer goes with it
+    transaction_removePeer(contextP, &conn);
+    CU_ASSERT_EQUAL(contextP->peers.count, 0);
+    CU_ASSERT_EQUAL(contextP->peers.inFlight, 0);
+
+    lwm2m_close(contextP);
+    close(conn.sock);
+}
+
+static void test_transaction_max_in_flight(void)
+{
+    lwm2m_context_t * contextP;
+    connection_t conn[2];
+    int i;
+
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(conn));
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(conn + 1));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    CU_ASSERT_EQUAL(lwm2m_set_congestion_options(contextP, 4, 1), COAP_NO_ERROR);
+
+    for (i = 0 ; i < 4 ; i++)
+    {
+        CU_ASSERT_PTR_NOT_NULL_FATAL(prv_send(contextP, conn, (uint16_t)(40 + i)));
+    }
+    CU_ASSERT_PTR_NOT_NULL_FATAL(prv_send(contextP, conn + 1, 50));
+    CU_ASSERT_EQUAL(prv_received(conn), 1);
+    CU_ASSERT_EQUAL(prv_received(conn + 1), 0);
+
+    // the peers take turns: the second one waits behind a single request of the first one
+    CU_ASSERT_TRUE(prv_answer(contextP, conn, COAP_TYPE_ACK, COAP_205_CONTENT, 40, 40));
+    CU_ASSERT_EQUAL(prv_received(conn), 1);
+    CU_ASSERT_EQUAL(prv_received(conn + 1), 0);
+    CU_ASSERT_TRUE(prv_answer(contextP, conn, COAP_TYPE_ACK, COAP_205_CONTENT, 41, 41));
+    CU_ASSERT_EQUAL(prv_received(conn), 0);
+    CU_ASSERT_EQUAL(prv_received(conn + 1), 1);
+    CU_ASSERT_TRUE(prv_answer(contextP, conn + 1, COAP_TYPE_ACK, COAP_205_CONTENT, 50, 50));
+    CU_ASSERT_EQUAL(prv_received(conn), 1);
+    CU_ASSERT_EQUAL(contextP->peers.inFlight, 1);
+
+    lwm2m_close(contextP);
+    close(conn[0].sock);
+    close(conn[1].sock);
+}
+
+static void test_transaction_rto(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_transaction_t * transacP;
+    connection_t conn;
+    time_t timeout;
+    time_t sendTime;
+    uint32_t rto;
+    int i;
+
+    CU_ASSERT_TRUE_FATAL(test_openLoopback(&conn));
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    // the first timeout is randomized from the default
+    transacP = prv_send(contextP, &conn, 60);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(transacP);
+    CU_ASSERT(transacP->rto >= COAP_RESPONSE_TIMEOUT * 1000 && transacP->rto <= COAP_RESPONSE_TIMEOUT * 1500);
+    CU_ASSERT_EQUAL(transacP->backoff, 4);
+
+    // and grows by the backoff factor on each retransmission
+    rto = transacP->rto;
+    sendTime = transacP->retrans_time;
+    timer_step(contextP, transacP->retrans_time, &timeout);
+    CU_ASSERT_EQUAL(prv_received(&conn), 2);
+    CU_ASSERT_EQUAL(transacP->retrans_counter, 3);
+    CU_ASSERT_EQUAL(transacP->rto, rto * 2);
+    CU_ASSERT_EQUAL(transacP->retrans_time, sendTime + (time_t)(rto * 2 + 999) / 1000);
+    transaction_remove(contextP, transacP);
+
+    // a peer answering at once gets a shorter timeout
+    for (i = 0 ; i < TEST_SAMPLE_COUNT ; i++)
+    {
+        transacP = prv_send(contextP, &conn, (uint16_t)(70 + i));
+        CU_ASSERT_PTR_NOT_NULL_FATAL(transacP);
+        CU_ASSERT_TRUE(prv_answer(contextP, &conn, COAP_TYPE_ACK, COAP_205_CONTENT, (uint16_t)(70 + i), (uint16_t)(70 + i)));
+    }
+    transacP = prv_send(contextP, &conn, 100);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(transacP);
+    CU_ASSERT(transacP->rto < 1500);
+    CU_ASSERT_EQUAL(transacP->backoff, 6);
+    CU_ASSERT(transacP->retrans_time - transacP->sendTime <= 2);
+
+    lwm2m_close(contextP);
+    close(conn.sock);
+}
+
+static struct TestTable table[] = {
+        { "test of test_transaction_match()", test_transaction_match },
+        { "test of test_transaction_many()", test_transaction_many },
+        { "test of test_transaction_nstart()", test_transaction_nstart },
+        { "test of test_transaction_max_in_flight()", test_transaction_max_in_flight },
+        { "test of test_transaction_rto()", test_transaction_rto },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_transaction_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_transaction", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
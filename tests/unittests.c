@@ -50,17 +50,90 @@ CU_ErrorCode add_tests(CU_pSuite pSuite, struct TestTable* testTable)
 
 int main()
 {
+   int result;
+
    /* initialize the CUnit test registry */
    if (CUE_SUCCESS != CU_initialize_registry())
       return CU_get_error();
 
+    if (CUE_SUCCESS != create_tlv_suit()) {
+       goto exit;
+   }
+
     if (CUE_SUCCESS != create_tlv_json_suit()) {
        goto exit;
    }
 
+    if (CUE_SUCCESS != create_uri_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_registry_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_timer_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_packet_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_observe_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_connection_suit()) {
+       goto exit;
+   }
+
+#ifdef LWM2M_WITH_POOLS
+    if (CUE_SUCCESS != create_pool_suit()) {
+       goto exit;
+   }
+#endif
+
+    if (CUE_SUCCESS != create_senml_cbor_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_block1_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_block2_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_registration_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_transaction_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_bulk_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_completion_suit()) {
+       goto exit;
+   }
+
+#ifndef LWM2M_WITH_POOLS
+    if (CUE_SUCCESS != create_shard_suit()) {
+       goto exit;
+   }
+#endif
+
    CU_basic_set_mode(CU_BRM_VERBOSE);
    CU_basic_run_tests();
 exit:
+   // a failed assertion fails the run
+   result = CU_get_error();
+   if (result == CUE_SUCCESS && CU_get_number_of_failures() != 0) result = -1;
    CU_cleanup_registry();
-   return CU_get_error();
+   return result;
 }
@@ -23,7 +23,7 @@
 
 static void test_uri_decode(void)
 {
-    lwm2m_uri_t* uri;
+    lwm2m_uri_t uri;
     multi_option_t extraID = { .next = NULL, .is_static = 1, .len = 3, .data = (uint8_t *) "555" };
     multi_option_t rID = { .next = NULL, .is_static = 1, .len = 1, .data = (uint8_t *) "0" };
     multi_option_t iID = { .next = &rID, .is_static = 1, .len = 2, .data = (uint8_t *) "11" };
@@ -36,73 +36,53 @@ static void test_uri_decode(void)
     MEMORY_TRACE_BEFORE;
 
     /* "/rd" */
-    uri = uri_decode(NULL, &reg);
-    CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
-    CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_REGISTRATION);
-    lwm2m_free(uri);
+    CU_ASSERT_TRUE_FATAL(uri_decode(NULL, &reg, &uri));
+    CU_ASSERT_EQUAL(uri.flag, LWM2M_URI_FLAG_REGISTRATION);
 
     /* "/rd/5a3f" */
     reg.next = &location;
-    uri = uri_decode(NULL, &reg);
     /* should not fail, error in uri_parse */
-    /* CU_ASSERT_PTR_NOT_NULL(uri); */
-    lwm2m_free(uri);
+    /* CU_ASSERT_TRUE(uri_decode(NULL, &reg, &uri)); */
 
     /* "/rd/5312" */
     reg.next = &locationDecimal;
-    uri = uri_decode(NULL, &reg);
-    CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
-    CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_REGISTRATION | LWM2M_URI_FLAG_OBJECT_ID);
-    CU_ASSERT_EQUAL(uri->objectId, 5312);
-    lwm2m_free(uri);
+    CU_ASSERT_TRUE_FATAL(uri_decode(NULL, &reg, &uri));
+    CU_ASSERT_EQUAL(uri.flag, LWM2M_URI_FLAG_REGISTRATION | LWM2M_URI_FLAG_OBJECT_ID);
+    CU_ASSERT_EQUAL(uri.objectId, 5312);
 
     /* "/bs" */
-    uri = uri_decode(NULL, &boot);
-    CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
-    CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_BOOTSTRAP);
-    lwm2m_free(uri);
+    CU_ASSERT_TRUE_FATAL(uri_decode(NULL, &boot, &uri));
+    CU_ASSERT_EQUAL(uri.flag, LWM2M_URI_FLAG_BOOTSTRAP);
 
     /* "/bs/5a3f" */
     boot.next = &location;
-    uri = uri_decode(NULL, &boot);
-    CU_ASSERT_PTR_NULL(uri);
-    lwm2m_free(uri);
+    CU_ASSERT_FALSE(uri_decode(NULL, &boot, &uri));
 
     /* "/9050/11/0" */
-    uri = uri_decode(NULL, &oID);
-    CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
-    CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_DM | LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID);
-    CU_ASSERT_EQUAL(uri->objectId, 9050);
-    CU_ASSERT_EQUAL(uri->instanceId, 11);
-    CU_ASSERT_EQUAL(uri->resourceId, 0);
-    lwm2m_free(uri);
+    CU_ASSERT_TRUE_FATAL(uri_decode(NULL, &oID, &uri));
+    CU_ASSERT_EQUAL(uri.flag, LWM2M_URI_FLAG_DM | LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID);
+    CU_ASSERT_EQUAL(uri.objectId, 9050);
+    CU_ASSERT_EQUAL(uri.instanceId, 11);
+    CU_ASSERT_EQUAL(uri.resourceId, 0);
 
     /* "/11/0" */
-    uri = uri_decode(NULL, &iID);
-    CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
-    CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_DM | LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID);
-    CU_ASSERT_EQUAL(uri->objectId, 11);
-    CU_ASSERT_EQUAL(uri->instanceId, 0);
-    lwm2m_free(uri);
+    CU_ASSERT_TRUE_FATAL(uri_decode(NULL, &iID, &uri));
+    CU_ASSERT_EQUAL(uri.flag, LWM2M_URI_FLAG_DM | LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID);
+    CU_ASSERT_EQUAL(uri.objectId, 11);
+    CU_ASSERT_EQUAL(uri.instanceId, 0);
 
     /* "/0" */
-    uri = uri_decode(NULL, &rID);
-    CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
-    CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_DM | LWM2M_URI_FLAG_OBJECT_ID);
-    CU_ASSERT_EQUAL(uri->objectId, 0);
-    lwm2m_free(uri);
+    CU_ASSERT_TRUE_FATAL(uri_decode(NULL, &rID, &uri));
+    CU_ASSERT_EQUAL(uri.flag, LWM2M_URI_FLAG_DM | LWM2M_URI_FLAG_OBJECT_ID);
+    CU_ASSERT_EQUAL(uri.objectId, 0);
 
     /* "/9050/11/0/555" */
     rID.next = &extraID;
-    uri = uri_decode(NULL, &oID);
-    CU_ASSERT_PTR_NULL(uri);
-    lwm2m_free(uri);
+    CU_ASSERT_FALSE(uri_decode(NULL, &oID, &uri));
 
     /* "/0/5a3f" */
     rID.next = &location;
-    uri = uri_decode(NULL, &rID);
-    CU_ASSERT_PTR_NULL(uri);
-    lwm2m_free(uri);
+    CU_ASSERT_FALSE(uri_decode(NULL, &rID, &uri));
 
     MEMORY_TRACE_AFTER_EQ;
 }